@@ -0,0 +1,677 @@
+/* ---------------------------------------------------------------------------
+ * Sweep Bench
+ *
+ * All structures linked into one program: runs the workload bench (see
+ * util/bench.h) on each selected structure for each thread count, picking the
+ * structures from the registry (see util/registry.h) at run time.
+ *
+ * With a list of open-loop rates (-O), each structure and thread count is
+ * also run at each rate, and the runs are summarized as a throughput-latency
+ * curve whose knee is the highest rate that is still served: the structure
+ * achieves at least KNEE_ACHIEVED of it, and its p99 latency stays within
+ * KNEE_P99_FACTOR times the p99 at the lowest rate.
+ *
+ * With a list of lock kinds (-L), each structure is run with each of them, and
+ * the lock kind is part of every point.
+ *
+ * Each point (structure, lock kind, thread count, rate) is run 'warmup' times unmeasured
+ * and 'repeats' times measured, each time on a fresh instance, and the
+ * measured runs are aggregated and reported by scaling.c: throughput with its
+ * confidence interval, speedup and parallel efficiency, optionally as CSV or
+ * JSON and against a baseline CSV. 'make bench' runs such a sweep of all
+ * structures and lock kinds.
+ *
+ * With a filter (-F), every structure with keys is run behind a Bloom or
+ * cuckoo filter (see util/filter.h), which answers the lookups of absent
+ * keys without touching the structure.
+ *
+ * With -D, each structure, lock kind and thread count is instead run on 4 KB pages and
+ * on huge pages, with the hardware counters on, and the change of the dTLB
+ * load misses and of the throughput is reported.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "lock.h"
+#include "affinity.h"
+#include "bench.h"
+#include "filter.h"
+#include "registry.h"
+#include "scaling.h"
+
+#define MAX_THREADS 200
+#define MAX_REPEATS 1000
+#define MAX_RUNS 64                     /* entries of -t and of -O */
+#define MAX_LOCKS 16                    /* entries of -L */
+#define MAX_ALGORITHMS 64
+#define DEFAULT_ALGORITHMS "all"
+#define DEFAULT_THREADS "1"
+#define DEFAULT_ALLOCATOR "slab"
+#define DEFAULT_LOCK "ttas"
+#define DEFAULT_AFFINITY "none"
+#define QUEUE_MIX "i50,d50"             /* for queues when the mix has reads or scans */
+#define KNEE_ACHIEVED 0.95
+#define KNEE_P99_FACTOR 10.0
+#define DEFAULT_THRESHOLD 5.0           /* percent */
+
+static struct {
+    const char *algorithms;
+    const char *threads;
+    char *allocator;
+    int hugepage;
+    char *lock;
+    char *affinity;
+    const char *filter;
+    const char *rates;
+    int repeats;
+    int warmup;
+    int hugepage_compare;
+    const char *csv;
+    const char *json;
+    const char *baseline;
+    double threshold;
+} system_variables;
+
+static bench_config_t bench_config;
+
+static const ds_ops_t *selected[MAX_ALGORITHMS];
+static int selected_num;
+static int thread_num[MAX_RUNS];
+static int thread_runs;
+static double rate[MAX_RUNS];
+static int rate_runs;
+static lock_kind_t lock_kind[MAX_LOCKS];
+static int lock_runs;
+
+
+static void select_ops(const ds_ops_t * ops)
+{
+    int i;
+
+    for (i = 0; i < selected_num; i++)
+      if (selected[i] == ops)
+	return;
+    if (selected_num < MAX_ALGORITHMS)
+      selected[selected_num++] = ops;
+}
+
+/*
+ * int select_algorithms(const char *str)
+ *
+ * Select the structures in 'str', a comma-separated list of names, family
+ * names (queue, list, hash) and "all".
+ * success : return 1
+ * failure : return 0
+ */
+static int select_algorithms(const char *str)
+{
+    char buf[1024], *name, *save;
+    const ds_ops_t *ops;
+    int i, family;
+
+    if (sizeof(buf) <= strlen(str))
+      return 0;
+    strcpy(buf, str);
+    for (name = strtok_r(buf, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+      if (strcmp(name, "all") == 0)
+	family = -2;
+      else if (strcmp(name, "queue") == 0)
+	family = REGISTRY_QUEUE;
+      else if (strcmp(name, "list") == 0)
+	family = REGISTRY_LIST;
+      else if (strcmp(name, "hash") == 0)
+	family = REGISTRY_HASH;
+      else
+	family = -1;
+
+      if (family == -1) {
+	if ((ops = registry_find(name)) == NULL) {
+	  fprintf(stderr, "Error: algorithm %s is not valid\n", name);
+	  return 0;
+	}
+	select_ops(ops);
+      } else
+	for (i = 0; registry[i] != NULL; i++)
+	  if (family == -2 || registry[i]->family == (registry_family_t) family)
+	    select_ops(registry[i]);
+    }
+    return (0 < selected_num) ? 1 : 0;
+}
+
+/*
+ * int parse_threads(const char *str)
+ *
+ * Parse a comma-separated list of thread counts, such as "1,2,4,8", or
+ * "pow2[:max]": the powers of two below max and max, which is the number of
+ * online CPUs by default.
+ * success : return 1
+ * failure : return 0
+ */
+static int parse_threads(const char *str)
+{
+    const char *p = str;
+    char *end;
+    long n, max;
+
+    thread_runs = 0;
+    if (strncmp(str, "pow2", 4) == 0) {
+      if (str[4] == ':') {
+	max = strtol(str + 5, &end, 10);
+	if (end == str + 5 || *end != '\0')
+	  return 0;
+      } else if (str[4] == '\0')
+	max = sysconf(_SC_NPROCESSORS_ONLN);
+      else
+	return 0;
+      if (max <= 0 || MAX_THREADS < max)
+	return 0;
+      for (n = 1; n < max; n *= 2)
+	thread_num[thread_runs++] = (int) n;
+      thread_num[thread_runs++] = (int) max;
+      return 1;
+    }
+    while (*p != '\0') {
+      n = strtol(p, &end, 10);
+      if (end == p || n <= 0 || MAX_THREADS < n || MAX_RUNS <= thread_runs)
+	return 0;
+      thread_num[thread_runs++] = (int) n;
+      if (*end == ',')
+	end++;
+      else if (*end != '\0')
+	return 0;
+      p = end;
+    }
+    return (0 < thread_runs) ? 1 : 0;
+}
+
+/*
+ * int parse_rates(const char *str)
+ *
+ * Parse a comma-separated list of open-loop rates, such as "1e5,2e5,4e5:poisson";
+ * the arrival process of the last rate applies to all.
+ * success : return 1
+ * failure : return 0
+ */
+static int parse_rates(const char *str)
+{
+    char buf[1024], *r, *save;
+
+    if (sizeof(buf) <= strlen(str))
+      return 0;
+    strcpy(buf, str);
+    rate_runs = 0;
+    for (r = strtok_r(buf, ",", &save); r != NULL; r = strtok_r(NULL, ",", &save)) {
+      if (MAX_RUNS <= rate_runs || bench_parse_rate(&bench_config, r) != 1)
+	return 0;
+      rate[rate_runs++] = bench_config.rate;
+    }
+    return (0 < rate_runs) ? 1 : 0;
+}
+
+/*
+ * int parse_locks(const char *str)
+ *
+ * Parse a comma-separated list of lock kinds, such as "ttas,mcs,pthread".
+ * success : return 1
+ * failure : return 0
+ */
+static int parse_locks(const char *str)
+{
+    char buf[1024], *name, *save;
+
+    if (sizeof(buf) <= strlen(str))
+      return 0;
+    strcpy(buf, str);
+    lock_runs = 0;
+    for (name = strtok_r(buf, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save))
+      if (MAX_LOCKS <= lock_runs || lock_kind_by_name(name, &lock_kind[lock_runs++]) != 1)
+	return 0;
+    return (0 < lock_runs) ? 1 : 0;
+}
+
+/*
+ * int run(const ds_ops_t * ops, const int threads, const double r, bench_result_t * result)
+ *
+ * Create an instance of 'ops' on a fresh allocator, drive it by bench_run()
+ * with 'threads' threads, open-loop at rate 'r' unless it is 0, and free it.
+ * success : return 1
+ * failure : return 0
+ */
+static int run(const ds_ops_t * ops, const int threads, const double r, bench_result_t * result)
+{
+    allocator_t *allocator;
+    bench_config_t cfg = bench_config;
+    bench_ops_t bops;
+    filtered_t fs;
+    filter_t *filter = NULL;
+    int ret;
+
+    memset(result, 0, sizeof(bench_result_t));
+    if (ops->find == NULL && (0 < cfg.mix[BENCH_READ] || 0 < cfg.mix[BENCH_SCAN]))
+      bench_parse_mix(&cfg, QUEUE_MIX);
+    if (ops->find != NULL && ops->max_key < cfg.key_range) {
+      fprintf(stderr, "Skip %s: key range must be at most %llu\n", ops->name,
+	      (unsigned long long int) ops->max_key);
+      return 1;
+    }
+    cfg.thread_num = threads;
+    cfg.rate = r;
+
+    if ((allocator = allocator_create(system_variables.allocator,
+				      (system_variables.hugepage == 1) ? ALLOC_HUGEPAGE : 0)) == NULL) {
+      fprintf(stderr, "Error: allocator %s is not valid\n", system_variables.allocator);
+      exit(-1);
+    }
+    set_allocator(allocator);
+
+    if ((bops.ds = ops->init()) == NULL) {
+      fprintf(stderr, "Error: %s: init error\n", ops->name);
+      allocator_destroy(allocator);
+      return 0;
+    }
+    bops.name = ops->name;
+    bops.insert = ops->add;
+    bops.delete = ops->delete;
+    bops.lookup = ops->find;
+    bops.size = ops->size;
+
+    if (system_variables.filter != NULL && ops->find != NULL) {
+      if ((filter = filter_create(system_variables.filter, cfg.key_range)) == NULL) {
+	fprintf(stderr, "Error: filter %s is not valid\n", system_variables.filter);
+	exit(-1);
+      }
+      filtered_init(&fs, ops, bops.ds, filter);
+      bops.ds = &fs;
+      bops.insert = filtered_add;
+      bops.delete = filtered_delete;
+      bops.lookup = filtered_find;
+      bops.size = (ops->size != NULL) ? filtered_size : NULL;
+    }
+
+    ret = bench_run(&bops, &cfg, result);
+
+    if (filter != NULL) {
+      filter_destroy(filter);
+      bops.ds = fs.ds;
+    }
+    ops->free(bops.ds);
+    allocator_destroy(allocator);
+    return ret;
+}
+
+/*
+ * void report_curve(const scaling_point_t * point)
+ *
+ * Print the throughput-latency curve of the rate_runs points of one structure,
+ * lock kind and thread count, and its knee.
+ */
+static void report_curve(const scaling_point_t * point)
+{
+    double base = point[0].p99;
+    int i, knee = -1;
+
+    if (point[0].runs == 0)
+      return;                           /* skipped */
+    printf ("open loop curve: %s, %s lock, %d threads, %s arrivals\n", point[0].name,
+	    point[0].lock, point[0].threads, (bench_config.arrival == BENCH_POISSON) ? "poisson" : "fixed");
+    printf ("\t%14s %14s %10s %10s %10s %8s\n", "target[ops/s]", "achieved", "p50[ns]",
+	    "p99[ns]", "p99.9[ns]", "late[%]");
+    for (i = 0; i < rate_runs; i++) {
+      printf ("\t%14.0f %14.0f %10.0f %10.0f %10.0f %8.2f\n", rate[i], point[i].mean,
+	      point[i].p50, point[i].p99, point[i].p999, 100.0 * point[i].late);
+      if (knee == i - 1 && KNEE_ACHIEVED * rate[i] <= point[i].mean
+	  && point[i].p99 <= KNEE_P99_FACTOR * base)
+	knee = i;
+    }
+    if (knee < 0)
+      printf ("\tknee: below %.0f ops/s\n", rate[0]);
+    else if (knee == rate_runs - 1)
+      printf ("\tknee: not reached up to %.0f ops/s\n", rate[knee]);
+    else
+      printf ("\tknee: %.0f ops/s\n", rate[knee]);
+}
+
+/* Relative change from 'before' to 'after' in percent. */
+static double change_pct(const double before, const double after)
+{
+    return 100.0 * (after / before - 1.0);
+}
+
+/*
+ * int compare_hugepages(const ds_ops_t * ops, const int threads)
+ *
+ * Run 'ops' with the current lock kind and 'threads' threads on 4 KB pages and then on huge pages, with
+ * the hardware counters on, and print the dTLB load misses / operation and
+ * the throughput of both runs and their change.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+static int compare_hugepages(const ds_ops_t * ops, const int threads)
+{
+    bench_result_t result[2];
+    int hugepage = system_variables.hugepage, counters = bench_config.counters;
+    int h, ret = 1;
+
+    bench_config.counters = 1;
+    for (h = 0; h < 2 && ret == 1; h++) {
+      system_variables.hugepage = h;
+      ret = run(ops, threads, 0.0, &result[h]);
+    }
+    system_variables.hugepage = hugepage;
+    bench_config.counters = counters;
+    if (ret != 1 || result[0].ops == 0)
+      return ret;                       /* failed or skipped */
+
+    printf ("huge pages: %s, %s lock, %d threads\n", ops->name, lock_kind_name(get_lock_kind()),
+	    threads);
+    printf ("\t%-12s %16s %12s\n", "", "dTLB misses/op", "Mops/s");
+    for (h = 0; h < 2; h++) {
+      printf ("\t%-12s ", (h == 0) ? "4 KB pages" : "huge pages");
+      if (0.0 <= result[h].dtlb_misses)
+	printf ("%16.4f", result[h].dtlb_misses);
+      else
+	printf ("%16s", "n/a");
+      printf (" %12.3f%s\n", result[h].throughput * 1e-6,
+	      (result[h].dtlb_scaled == 1) ? "  (dTLB misses scaled)" : "");
+    }
+    printf ("\t%-12s ", "change");
+    if (0.0 < result[0].dtlb_misses && 0.0 <= result[1].dtlb_misses)
+      printf ("%+15.1f%%", change_pct(result[0].dtlb_misses, result[1].dtlb_misses));
+    else
+      printf ("%16s", "n/a");
+    printf (" %+11.1f%%\n", change_pct(result[0].throughput, result[1].throughput));
+    return 1;
+}
+
+static void usage(char **argv)
+{
+    int i;
+
+    fprintf(stderr, "sweep bench\n");
+    fprintf(stderr, "usage: %s [Options<default>]\n", argv[0]);
+    fprintf(stderr, "\t\t-A algorithms(name,...|queue|list|hash|all)<%s>\n", DEFAULT_ALGORITHMS);
+    fprintf(stderr, "\t\t-t threads(e.g. 1,2,4,8|pow2[:max])<%s>\n", DEFAULT_THREADS);
+    fprintf(stderr, "\t\t-n operations / thread<%llu>\n", (unsigned long long int) bench_config.ops);
+    fprintf(stderr, "\t\t-W mix(e.g. r90,i5,d5,s0)<r%d,i%d,d%d,s%d>  :queues run %s if it has reads or scans\n",
+	    bench_config.mix[BENCH_READ], bench_config.mix[BENCH_INSERT],
+	    bench_config.mix[BENCH_DELETE], bench_config.mix[BENCH_SCAN], QUEUE_MIX);
+    fprintf(stderr, "\t\t-K dist(uniform|zipf[:theta]|latest[:theta]|hotspot[:keys:ops])<uniform>\n");
+    fprintf(stderr, "\t\t-k key_range<%llu>  -p prefill<%llu>\n",
+	    (unsigned long long int) bench_config.key_range, (unsigned long long int) bench_config.prefill);
+    fprintf(stderr, "\t\t-d seconds       :run for this long instead of -n operations / thread\n");
+    fprintf(stderr, "\t\t-T               :report per-operation latency percentiles\n");
+    fprintf(stderr, "\t\t-E               :report hardware counters (cycles, LLC misses, ...) per operation\n");
+    fprintf(stderr, "\t\t-O rates(e.g. 1e5,2e5,4e5[:fixed|poisson]) :sweep open-loop rates / second of all threads\n");
+    fprintf(stderr, "\t\t-a allocator(malloc|slab)<%s>\n", DEFAULT_ALLOCATOR);
+    fprintf(stderr, "\t\t-H               :back tables and node pools with huge pages\n");
+    fprintf(stderr, "\t\t-D               :compare the dTLB misses and throughput without and with -H\n");
+    fprintf(stderr, "\t\t-L locks(e.g. ttas,mcs,pthread; each of pthread|ttas|ticket|mcs|clh)<%s>\n",
+	    DEFAULT_LOCK);
+    fprintf(stderr, "\t\t-F filter(bloom|cuckoo) :put a filter in front of the structures with keys\n");
+    fprintf(stderr, "\t\t-c affinity(none|compact|scatter|smt|cpu_list e.g. 0,2,4-7)<%s>\n", DEFAULT_AFFINITY);
+    fprintf(stderr, "\t\t-r repeats       :measured runs of each point<1>\n");
+    fprintf(stderr, "\t\t-w warmup        :unmeasured runs before them<0>\n");
+    fprintf(stderr, "\t\t-o file.csv      :write the scaling report as CSV\n");
+    fprintf(stderr, "\t\t-J file.json     :write the scaling report as JSON\n");
+    fprintf(stderr, "\t\t-B baseline.csv  :compare with a CSV written by -o\n");
+    fprintf(stderr, "\t\t-x threshold(%%)  :slowdown reported as a regression<%.0f>\n", DEFAULT_THRESHOLD);
+    fprintf(stderr, "\t\t-q               :print only the summaries, not every run\n");
+    fprintf(stderr, "\t\t-h               :help\n");
+    fprintf(stderr, "\talgorithms:\n");
+    for (i = 0; registry[i] != NULL; i++)
+      fprintf(stderr, "\t\t%s\n", registry[i]->name);
+}
+
+static void init_system_variables(void)
+{
+    system_variables.algorithms = DEFAULT_ALGORITHMS;
+    system_variables.threads = DEFAULT_THREADS;
+    system_variables.allocator = DEFAULT_ALLOCATOR;
+    system_variables.hugepage = 0;
+    system_variables.lock = DEFAULT_LOCK;
+    system_variables.affinity = DEFAULT_AFFINITY;
+    system_variables.filter = NULL;
+    system_variables.rates = NULL;
+    system_variables.repeats = 1;
+    system_variables.hugepage_compare = 0;
+    system_variables.warmup = 0;
+    system_variables.csv = NULL;
+    system_variables.json = NULL;
+    system_variables.baseline = NULL;
+    system_variables.threshold = DEFAULT_THRESHOLD;
+    bench_config_init(&bench_config);
+}
+
+
+int main(int argc, char **argv)
+{
+    int c, i, j, k, l, r, rate_n, point_num, failed = 0, regressions = 0;
+    affinity_t *affinity;
+    bench_result_t result;
+    scaling_point_t *points, *p;
+
+    init_system_variables();
+
+    while ((c = getopt(argc, argv, "A:t:n:W:K:k:p:d:O:TEa:HDL:F:c:r:w:o:J:B:x:qh")) != -1) {
+	switch (c) {
+	case 'A':		/* algorithms */
+	    system_variables.algorithms = optarg;
+	    break;
+	case 't':		/* thread counts */
+	    system_variables.threads = optarg;
+	    break;
+	case 'n':		/* operations per thread */
+	    bench_config.ops = strtoull(optarg, NULL, 10);
+	    if (bench_config.ops == 0) {
+		fprintf(stderr, "Error: operation number %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'W':		/* mix */
+	    if (bench_parse_mix(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: mix %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'K':		/* key distribution */
+	    if (bench_parse_dist(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: distribution %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'k':		/* key range */
+	    bench_config.key_range = strtoull(optarg, NULL, 10);
+	    if (bench_config.key_range == 0) {
+		fprintf(stderr, "Error: key range %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'p':		/* prefill */
+	    bench_config.prefill = strtoull(optarg, NULL, 10);
+	    break;
+	case 'd':		/* duration */
+	    bench_config.duration = strtod(optarg, NULL);
+	    if (bench_config.duration <= 0.0) {
+		fprintf(stderr, "Error: duration %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'T':		/* latency histograms */
+	    bench_config.latency = 1;
+	    break;
+	case 'E':		/* hardware counters */
+	    bench_config.counters = 1;
+	    break;
+	case 'O':		/* open-loop rates */
+	    system_variables.rates = optarg;
+	    break;
+	case 'a':		/* allocator */
+	    system_variables.allocator = optarg;
+	    break;
+	case 'H':		/* huge pages */
+	    system_variables.hugepage = 1;
+	    break;
+	case 'D':		/* huge pages or not */
+	    system_variables.hugepage_compare = 1;
+	    break;
+	case 'L':		/* lock */
+	    system_variables.lock = optarg;
+	    break;
+	case 'F':		/* filter */
+	    system_variables.filter = optarg;
+	    break;
+	case 'c':		/* thread placement */
+	    system_variables.affinity = optarg;
+	    break;
+	case 'r':		/* repeats */
+	    system_variables.repeats = atoi(optarg);
+	    if (system_variables.repeats <= 0 || MAX_REPEATS < system_variables.repeats) {
+		fprintf(stderr, "Error: repeats %s are not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'w':		/* warmup runs */
+	    system_variables.warmup = atoi(optarg);
+	    if (system_variables.warmup < 0 || MAX_REPEATS < system_variables.warmup) {
+		fprintf(stderr, "Error: warmup %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'o':		/* CSV */
+	    system_variables.csv = optarg;
+	    break;
+	case 'J':		/* JSON */
+	    system_variables.json = optarg;
+	    break;
+	case 'B':		/* baseline CSV */
+	    system_variables.baseline = optarg;
+	    break;
+	case 'x':		/* regression threshold */
+	    system_variables.threshold = strtod(optarg, NULL);
+	    if (system_variables.threshold < 0.0) {
+		fprintf(stderr, "Error: threshold %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'q':		/* quiet */
+	    bench_config.quiet = 1;
+	    break;
+	case 'h':		/* help */
+	    usage(argv);
+	    exit(0);
+	default:
+	    fprintf(stderr, "ERROR: option error: -%c is not valid\n", optopt);
+	    exit(-1);
+	}
+    }
+
+    if (select_algorithms(system_variables.algorithms) != 1)
+      exit(-1);
+    if (parse_threads(system_variables.threads) != 1) {
+      fprintf(stderr, "Error: threads %s are not valid\n", system_variables.threads);
+      exit(-1);
+    }
+    if (system_variables.rates != NULL && parse_rates(system_variables.rates) != 1) {
+      fprintf(stderr, "Error: rates %s are not valid\n", system_variables.rates);
+      exit(-1);
+    }
+    if (parse_locks(system_variables.lock) != 1) {
+      fprintf(stderr, "Error: locks %s are not valid\n", system_variables.lock);
+      exit(-1);
+    }
+    if ((affinity = affinity_create(system_variables.affinity)) == NULL) {
+      fprintf(stderr, "Error: affinity %s is not valid\n", system_variables.affinity);
+      exit(-1);
+    }
+    bench_config.affinity = affinity;
+
+    if (system_variables.hugepage_compare == 1) {
+      for (i = 0; i < selected_num; i++)
+	for (l = 0; l < lock_runs; l++) {
+	  set_lock_kind(lock_kind[l]);
+	  for (j = 0; j < thread_runs; j++)
+	    if (compare_hugepages(selected[i], thread_num[j]) != 1) {
+	      fprintf(stderr, "FAILED: %s, %s lock, %d threads\n", selected[i]->name,
+		      lock_kind_name(lock_kind[l]), thread_num[j]);
+	      failed++;
+	    }
+	}
+      affinity_destroy(affinity);
+      if (0 < failed)
+	fprintf(stderr, "%d runs FAILED\n", failed);
+      return (0 < failed) ? 1 : 0;
+    }
+
+    /* One point per structure, lock kind, thread count and rate, in this order. */
+    rate_n = (0 < rate_runs) ? rate_runs : 1;
+    point_num = selected_num * lock_runs * thread_runs * rate_n;
+    if ((points = (scaling_point_t *) calloc(point_num, sizeof(scaling_point_t))) == NULL) {
+      fprintf(stderr, "Error: calloc error\n");
+      exit(-1);
+    }
+
+    for (i = 0; i < selected_num; i++)
+      for (l = 0; l < lock_runs; l++) {
+	set_lock_kind(lock_kind[l]);
+	for (j = 0; j < thread_runs; j++) {
+	  for (k = 0; k < rate_n; k++) {
+	    p = &points[((i * lock_runs + l) * thread_runs + j) * rate_n + k];
+	    p->name = selected[i]->name;
+	    p->lock = lock_kind_name(lock_kind[l]);
+	    p->threads = thread_num[j];
+	    p->rate = (0 < rate_runs) ? rate[k] : 0.0;
+	    for (r = -system_variables.warmup; r < system_variables.repeats; r++) {
+	      if (run(selected[i], p->threads, p->rate, &result) != 1) {
+		fprintf(stderr, "FAILED: %s, %s lock, %d threads", p->name, p->lock, p->threads);
+		if (0.0 < p->rate)
+		  fprintf(stderr, ", %.0f ops/s", p->rate);
+		fprintf(stderr, "\n");
+		failed++;
+		continue;
+	      }
+	      if (result.ops == 0)
+		break;                  /* skipped */
+	      if (bench_config.quiet == 1)
+		fprintf(stderr, "%s, %s lock, %d threads%s: %s %d: %.3f Mops/s\n", p->name, p->lock,
+			p->threads, (0.0 < p->rate) ? " (open loop)" : "", (r < 0) ? "warmup" : "run",
+			(r < 0) ? system_variables.warmup + r + 1 : r + 1, result.throughput * 1e-6);
+	      if (0 <= r)
+		scaling_add(p, &result);
+	    }
+	  }
+	  if (0 < rate_runs)
+	    report_curve(&points[((i * lock_runs + l) * thread_runs + j) * rate_n]);
+	}
+      }
+    affinity_destroy(affinity);
+
+    scaling_finish(points, point_num);
+    if (system_variables.baseline != NULL
+	&& (regressions = scaling_compare(points, point_num, system_variables.baseline,
+					  system_variables.threshold)) < 0) {
+      fprintf(stderr, "Error: baseline %s can not be read\n", system_variables.baseline);
+      regressions = 0;
+      failed++;
+    }
+    scaling_report(points, point_num);
+    if (system_variables.csv != NULL && scaling_write_csv(points, point_num, system_variables.csv) != 1)
+      failed++;
+    if (system_variables.json != NULL && scaling_write_json(points, point_num, system_variables.json) != 1)
+      failed++;
+    free(points);
+
+    if (0 < regressions)
+      fprintf(stderr, "%d points REGRESSED by more than %.1f%%\n", regressions,
+	      system_variables.threshold);
+    if (0 < failed)
+      fprintf(stderr, "%d runs FAILED\n", failed);
+    return (0 < failed || 0 < regressions) ? 1 : 0;
+}
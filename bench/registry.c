@@ -0,0 +1,75 @@
+/* ---------------------------------------------------------------------------
+ * Structure Registry
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "registry.h"
+
+extern const ds_ops_t LLSCLockFreeQueue_ops;
+extern const ds_ops_t CASLockFreeQueue_ops;
+
+extern const ds_ops_t CoarseGrainedSynchroList_ops;
+extern const ds_ops_t FineGrainedSynchroList_ops;
+extern const ds_ops_t LazySynchroList_ops;
+extern const ds_ops_t NonBlockingList_ops;
+extern const ds_ops_t LockFreeList_ops;
+extern const ds_ops_t Skiplist_ops;
+extern const ds_ops_t LazySkiplist_ops;
+extern const ds_ops_t LockFreeSkiplist_ops;
+
+extern const ds_ops_t Hash_ops;
+extern const ds_ops_t CuckooHash_ops;
+extern const ds_ops_t StripedHash_ops;
+extern const ds_ops_t RefinableHash_ops;
+extern const ds_ops_t OpenAddressHash_ops;
+extern const ds_ops_t ConcurrentCuckooHash_ops;
+extern const ds_ops_t LockFreeOpenAddressHash_ops;
+extern const ds_ops_t BucketizedCuckooHash_ops;
+extern const ds_ops_t HopscotchHash_ops;
+extern const ds_ops_t PartitionedHash_ops;
+
+/* All structures, terminated by NULL. */
+const ds_ops_t *const registry[] = {
+    &LLSCLockFreeQueue_ops,
+    &CASLockFreeQueue_ops,
+
+    &CoarseGrainedSynchroList_ops,
+    &FineGrainedSynchroList_ops,
+    &LazySynchroList_ops,
+    &NonBlockingList_ops,
+    &LockFreeList_ops,
+    &Skiplist_ops,
+    &LazySkiplist_ops,
+    &LockFreeSkiplist_ops,
+
+    &Hash_ops,
+    &CuckooHash_ops,
+    &StripedHash_ops,
+    &RefinableHash_ops,
+    &OpenAddressHash_ops,
+    &ConcurrentCuckooHash_ops,
+    &LockFreeOpenAddressHash_ops,
+    &BucketizedCuckooHash_ops,
+    &HopscotchHash_ops,
+    &PartitionedHash_ops,
+    NULL,
+};
+
+/*
+ * const ds_ops_t *registry_find(const char *name)
+ *
+ * Return the ops of the structure 'name', or NULL if there is none.
+ */
+const ds_ops_t *registry_find(const char *name)
+{
+    int i;
+
+    for (i = 0; registry[i] != NULL; i++)
+      if (strcmp(registry[i]->name, name) == 0)
+	return registry[i];
+    return NULL;
+}
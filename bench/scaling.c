@@ -0,0 +1,275 @@
+/* ---------------------------------------------------------------------------
+ * Scaling Report
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "scaling.h"
+
+#define scaling_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#define MAX_LINE    1024
+#define MAX_COLUMNS 32
+
+/* Two-sided 95% quantiles of Student's t for 1..30 degrees of freedom. */
+static const double t95[] = {
+  12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static const char *csv_header =
+  "structure,lock,threads,rate,runs,throughput,stddev,ci95_low,ci95_high,speedup,efficiency,"
+  "p50_ns,p99_ns,p999_ns,baseline,change,regression";
+
+
+/*
+ * void scaling_add(scaling_point_t * p, const bench_result_t * r)
+ *
+ * Add the result of one run to point p; the throughput is accumulated by
+ * Welford's method.
+ */
+void scaling_add(scaling_point_t * p, const bench_result_t * r)
+{
+    double delta;
+
+    p->runs++;
+    delta = r->throughput - p->mean;
+    p->mean += delta / p->runs;
+    p->m2 += delta * (r->throughput - p->mean);
+    p->p50 += (r->p50 - p->p50) / p->runs;
+    p->p99 += (r->p99 - p->p99) / p->runs;
+    p->p999 += (r->p999 - p->p999) / p->runs;
+    p->late += (r->late - p->late) / p->runs;
+}
+
+/*
+ * void scaling_finish(scaling_point_t * points, const int n)
+ *
+ * Compute the deviation and the confidence interval of each of the n points,
+ * and its speedup and efficiency over the point of the same structure, lock kind
+ * and rate with the fewest threads.
+ */
+void scaling_finish(scaling_point_t * points, const int n)
+{
+    scaling_point_t *p, *base;
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (1 < p->runs) {
+	p->sd = sqrt(p->m2 / (p->runs - 1));
+	p->ci = ((p->runs - 1 <= (int) (sizeof(t95) / sizeof(t95[0]))) ? t95[p->runs - 2] : 1.960)
+	  * p->sd / sqrt((double) p->runs);
+      }
+    }
+
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (p->runs == 0)
+	continue;
+      base = p;
+      for (j = 0; j < n; j++)
+	if (0 < points[j].runs && points[j].name == p->name && points[j].lock == p->lock
+	    && points[j].rate == p->rate && points[j].threads < base->threads)
+	  base = &points[j];
+      if (0.0 < base->mean) {
+	p->speedup = p->mean / base->mean;
+	p->efficiency = p->speedup * base->threads / p->threads;
+      }
+    }
+}
+
+/* Split a CSV line in place; return the number of fields. */
+static int split_csv(char *line, char **field)
+{
+    int n = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    field[n++] = line;
+    while (n < MAX_COLUMNS && (line = strchr(line, ',')) != NULL) {
+      *line++ = '\0';
+      field[n++] = line;
+    }
+    return n;
+}
+
+static int column(char **field, const int n, const char *name)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+      if (strcmp(field[i], name) == 0)
+	return i;
+    return -1;
+}
+
+/*
+ * int scaling_compare(scaling_point_t * points, const int n, const char *path, const double threshold)
+ *
+ * Load the baseline CSV 'path', written by scaling_write_csv(), and mark the
+ * points whose throughput is more than 'threshold' percent below it. The points
+ * are matched by structure, lock kind, thread count and rate; a CSV without the
+ * lock column matches every lock kind.
+ *
+ * success : return the number of regressions
+ * failure(the file can not be read, or is not such a CSV) : return -1
+ */
+int scaling_compare(scaling_point_t * points, const int n, const char *path, const double threshold)
+{
+    FILE *fp;
+    char line[MAX_LINE], *field[MAX_COLUMNS];
+    int c_name, c_lock, c_threads, c_rate, c_tp, fields, i, regressions = 0;
+    scaling_point_t *p;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+      scaling_elog("fopen error");
+      return -1;
+    }
+    if (fgets(line, sizeof(line), fp) == NULL) {
+      fclose(fp);
+      return -1;
+    }
+    fields = split_csv(line, field);
+    c_name = column(field, fields, "structure");
+    c_lock = column(field, fields, "lock");
+    c_threads = column(field, fields, "threads");
+    c_rate = column(field, fields, "rate");
+    c_tp = column(field, fields, "throughput");
+    if (c_name < 0 || c_threads < 0 || c_rate < 0 || c_tp < 0) {
+      fclose(fp);
+      return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+      if ((fields = split_csv(line, field)) <= c_name || fields <= c_threads
+	  || fields <= c_rate || fields <= c_tp || fields <= c_lock)
+	continue;
+      for (i = 0; i < n; i++) {
+	p = &points[i];
+	if (0 < p->runs && strcmp(p->name, field[c_name]) == 0
+	    && (c_lock < 0 || strcmp(p->lock, field[c_lock]) == 0)
+	    && p->threads == atoi(field[c_threads]) && p->rate == strtod(field[c_rate], NULL))
+	  p->baseline = strtod(field[c_tp], NULL);
+      }
+    }
+    fclose(fp);
+
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (0 < p->runs && 0.0 < p->baseline
+	  && p->mean + p->ci < p->baseline * (1.0 - threshold / 100.0)) {
+	p->regression = 1;
+	regressions++;
+      }
+    }
+    return regressions;
+}
+
+/* Relative change of the throughput against the baseline; 0 if there is none. */
+static double change(const scaling_point_t * p)
+{
+    return (0.0 < p->baseline) ? p->mean / p->baseline - 1.0 : 0.0;
+}
+
+/*
+ * int scaling_write_csv(const scaling_point_t * points, const int n, const char *path)
+ *
+ * Write the points that were measured to 'path', one line each.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int scaling_write_csv(const scaling_point_t * points, const int n, const char *path)
+{
+    const scaling_point_t *p;
+    FILE *fp;
+    int i;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+      scaling_elog("fopen error");
+      return 0;
+    }
+    fprintf(fp, "%s\n", csv_header);
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (p->runs == 0)
+	continue;
+      fprintf(fp, "%s,%s,%d,%.0f,%d,%.1f,%.1f,%.1f,%.1f,%.4f,%.4f,%.0f,%.0f,%.0f,%.1f,%.4f,%d\n",
+	      p->name, p->lock, p->threads, p->rate, p->runs, p->mean, p->sd, p->mean - p->ci,
+	      p->mean + p->ci, p->speedup, p->efficiency, p->p50, p->p99, p->p999,
+	      p->baseline, change(p), p->regression);
+    }
+    fclose(fp);
+    return 1;
+}
+
+/*
+ * int scaling_write_json(const scaling_point_t * points, const int n, const char *path)
+ *
+ * Write the points that were measured to 'path' as an array of objects with
+ * the fields of the CSV.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int scaling_write_json(const scaling_point_t * points, const int n, const char *path)
+{
+    const scaling_point_t *p;
+    FILE *fp;
+    int i, first = 1;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+      scaling_elog("fopen error");
+      return 0;
+    }
+    fprintf(fp, "[\n");
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (p->runs == 0)
+	continue;
+      fprintf(fp, "%s  {\"structure\": \"%s\", \"lock\": \"%s\", \"threads\": %d, \"rate\": %.0f, \"runs\": %d, "
+	      "\"throughput\": %.1f, \"stddev\": %.1f, \"ci95\": [%.1f, %.1f], "
+	      "\"speedup\": %.4f, \"efficiency\": %.4f, "
+	      "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, "
+	      "\"baseline\": %.1f, \"change\": %.4f, \"regression\": %s}",
+	      (first == 1) ? "" : ",\n", p->name, p->lock, p->threads, p->rate, p->runs, p->mean, p->sd,
+	      p->mean - p->ci, p->mean + p->ci, p->speedup, p->efficiency, p->p50, p->p99, p->p999,
+	      p->baseline, change(p), (p->regression == 1) ? "true" : "false");
+      first = 0;
+    }
+    fprintf(fp, "\n]\n");
+    fclose(fp);
+    return 1;
+}
+
+/*
+ * void scaling_report(const scaling_point_t * points, const int n)
+ *
+ * Print the points that were measured as a table.
+ */
+void scaling_report(const scaling_point_t * points, const int n)
+{
+    const scaling_point_t *p;
+    int i;
+
+    printf ("scaling =>\n");
+    printf ("\t%-28s %-7s %7s %10s %4s %10s %10s %8s %10s %8s\n", "structure", "lock", "threads",
+	    "rate", "runs", "Mops/s", "+-ci95", "speedup", "efficiency", "change");
+    for (i = 0; i < n; i++) {
+      p = &points[i];
+      if (p->runs == 0)
+	continue;
+      printf ("\t%-28s %-7s %7d %10.0f %4d %10.3f %10.3f %8.2f %9.1f%%", p->name, p->lock,
+	      p->threads, p->rate, p->runs, p->mean * 1e-6, p->ci * 1e-6, p->speedup, 100.0 * p->efficiency);
+      if (0.0 < p->baseline)
+	printf (" %+7.1f%%%s", 100.0 * change(p), (p->regression == 1) ? " REGRESSION" : "");
+      printf ("\n");
+    }
+}
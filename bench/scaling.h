@@ -0,0 +1,57 @@
+/* ---------------------------------------------------------------------------
+ * Scaling Report
+ *
+ * Aggregates the repeated runs of bench/bench into one point per structure,
+ * lock kind, thread count and open-loop rate, and reports them for comparing
+ * versions:
+ *
+ *  - the mean throughput, its standard deviation and its 95% confidence
+ *    interval (Student's t over the repeats);
+ *  - speedup, the mean throughput over that of the smallest thread count of
+ *    the same structure, lock kind and rate, and parallel efficiency, the speedup over
+ *    the ratio of the thread counts;
+ *  - the mean p50, p99 and p99.9 latency of the runs, if they were recorded.
+ *
+ * The points are written as CSV or JSON. A CSV written before can be loaded
+ * as the baseline: a point is a regression if even the upper bound of its
+ * confidence interval is more than 'threshold' percent below the baseline
+ * throughput of the same structure, lock kind, thread count and rate. A
+ * baseline without a lock column matches the points of every lock kind.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _SCALING_H_
+#define _SCALING_H_
+
+#include "bench.h"
+
+typedef struct _scaling_point_t
+{
+  const char *name;
+  const char *lock;                   /* lock kind the structure was run with */
+  int threads;
+  double rate;                        /* open loop; 0: closed loop */
+  int runs;                           /* measured runs; 0: skipped */
+  double mean;                        /* throughput [ops/s] */
+  double m2;                          /* sum of the squared deviations from the mean */
+  double sd;
+  double ci;                          /* half width of the 95% confidence interval */
+  double speedup;
+  double efficiency;
+  double p50, p99, p999;              /* mean latency of the runs [ns] */
+  double late;                        /* open loop: mean share of the operations started late */
+  double baseline;                    /* throughput of the baseline; 0: not in the baseline */
+  int regression;
+} scaling_point_t;
+
+
+void scaling_add (scaling_point_t *, const bench_result_t *);
+void scaling_finish (scaling_point_t *, const int);
+int scaling_compare (scaling_point_t *, const int, const char *, const double);
+int scaling_write_csv (const scaling_point_t *, const int, const char *);
+int scaling_write_json (const scaling_point_t *, const int, const char *);
+void scaling_report (const scaling_point_t *, const int);
+
+#endif
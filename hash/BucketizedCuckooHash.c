@@ -0,0 +1,891 @@
+/* ---------------------------------------------------------------------------
+ * Bucketized Concurrent Cuckoo Hash Table
+ *
+ * "Algorithmic Improvements for Fast Concurrent Cuckoo Hashing" by X. Li, D. G. Andersen,
+ *  M. Kaminsky, M. J. Freedman  (libcuckoo)
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+
+#include "BucketizedCuckooHash.h"
+#include "registry.h"
+#include "stats.h"
+
+#define MAX_BFS_QUEUE  1024   /* maximum number of buckets visited by bfs() */
+#define SPIN_LIMIT     64     /* spins before sched_yield() */
+
+/* An entry of the BFS queue: 'key' in slot 'slot' of the parent bucket moves to 'bucket'. */
+typedef struct _bfs_entry_t
+{
+  unsigned int bucket;
+  int parent;            /* index of the parent entry, -1 for b0 and b1 */
+  int slot;
+  lkey_t key;
+  int depth;
+} bfs_entry_t;
+
+static bucket_t *init_bucket(allocator_t *, const unsigned int);
+static void lock_bucket(hashtable_t *, const unsigned int);
+static void unlock_bucket(hashtable_t *, const unsigned int);
+static void lock_two(hashtable_t *, const unsigned int, const unsigned int);
+static void unlock_two(hashtable_t *, const unsigned int, const unsigned int);
+static unsigned int lock_key(hashtable_t *, const lkey_t, unsigned int *, unsigned int *);
+static int find_slot(const bucket_t *, const lkey_t);
+static int empty_slot(const bucket_t *);
+static void set_slot(bucket_t *, const int, const lkey_t, const val_t);
+static int bfs(const bucket_t *, const unsigned int, const unsigned int, const unsigned int,
+	       bfs_entry_t *, int *);
+static bool_t move_path(hashtable_t *, bucket_t *, const unsigned int, const bfs_entry_t *,
+			int, int);
+static bool_t cuckoo_path(hashtable_t *, const unsigned int, const unsigned int,
+			  const unsigned int);
+static bool_t insert_nolock(bucket_t *, const unsigned int, const lkey_t, const val_t);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static void prefetch_key(hashtable_t *, const lkey_t);
+static void resize(hashtable_t *, const unsigned int);
+static unsigned int hashCode0(lkey_t, const unsigned int);
+static unsigned int hashCode1(lkey_t, const unsigned int);
+static unsigned int alt_bucket(lkey_t, const unsigned int, const unsigned int);
+
+
+#ifdef _X86_64_
+static inline bool_t cas(volatile uintptr_t * addr, const uintptr_t oldv, const uintptr_t newv)
+{
+  uintptr_t result;
+  __asm__ __volatile__("lock; cmpxchgq %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+#else
+static inline bool_t cas(volatile uintptr_t * addr, const uintptr_t oldv, const uintptr_t newv)
+{
+  uintptr_t result;
+  __asm__ __volatile__("lock; cmpxchgl %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+#endif
+
+
+#define hashmask(_hp_)   ((1U << (_hp_)) - 1)
+#define lockIdx(_b_)     ((_b_) & (LOCK_SIZE - 1))
+
+
+/*
+ * Version locks
+ *
+ * A lock is a counter which is odd while locked. Every lock/unlock pair increments it
+ * by two, so a reader which saw the same even value before and after reading a bucket
+ * knows that no writer has touched the bucket in the meantime.
+ */
+static void lock_bucket(hashtable_t * ht, const unsigned int l)
+{
+    version_lock_t *lk = &ht->lock[l];
+    uintptr_t v;
+    int spin = 0;
+
+    while (1) {
+      v = lk->version;
+      if ((v & 1) == 0 && cas(&lk->version, v, v + 1) == true)
+	return;
+      if (++spin % SPIN_LIMIT == 0)
+	sched_yield();
+    }
+}
+
+static void unlock_bucket(hashtable_t * ht, const unsigned int l)
+{
+    WMB();
+    ht->lock[l].version++;
+}
+
+static void lock_two(hashtable_t * ht, const unsigned int b0, const unsigned int b1)
+{
+    unsigned int l0 = lockIdx(b0);
+    unsigned int l1 = lockIdx(b1);
+
+    if (l1 < l0) {
+      lock_bucket(ht, l1);
+      lock_bucket(ht, l0);
+    } else {
+      lock_bucket(ht, l0);
+      if (l0 != l1)
+	lock_bucket(ht, l1);
+    }
+}
+
+static void unlock_two(hashtable_t * ht, const unsigned int b0, const unsigned int b1)
+{
+    unsigned int l0 = lockIdx(b0);
+    unsigned int l1 = lockIdx(b1);
+
+    unlock_bucket(ht, l0);
+    if (l0 != l1)
+      unlock_bucket(ht, l1);
+}
+
+/*
+ * unsigned int lock_key(hashtable_t * ht, const lkey_t key, unsigned int *b0, unsigned int *b1)
+ *
+ * Lock both candidate buckets of 'key', write them to *b0 and *b1,
+ * and return the hashpower they were computed with.
+ */
+static unsigned int lock_key(hashtable_t * ht, const lkey_t key, unsigned int *b0,
+			     unsigned int *b1)
+{
+    unsigned int hp;
+
+    while (1) {
+      hp = ht->hashpower;
+      *b0 = hashCode0(key, hp);	/* T1: */
+      *b1 = hashCode1(key, hp);
+      lock_two(ht, *b0, *b1);	/* T2: */
+      if (hp == ht->hashpower)
+	return hp;
+      /* resize() executed between T1: and T2:. */
+      unlock_two(ht, *b0, *b1);
+      STATS_INC(STATS_RETRY);
+    }
+}
+
+
+/*
+ * Buckets
+ */
+static int find_slot(const bucket_t * b, const lkey_t key)
+{
+    int i;
+    for (i = 0; i < SLOTS_PER_BUCKET; i++)
+      if (b->key[i] == key)
+	return i;
+    return -1;
+}
+
+static int empty_slot(const bucket_t * b)
+{
+    return find_slot(b, EMPTY_KEY);
+}
+
+static void set_slot(bucket_t * b, const int slot, const lkey_t key, const val_t val)
+{
+    b->value[slot] = val;
+    WMB();
+    b->key[slot] = key;
+}
+
+static bucket_t *init_bucket(allocator_t * a, const unsigned int hashpower)
+{
+    bucket_t *bucket;
+    size_t size = (size_t) (hashmask(hashpower) + 1) * sizeof(bucket_t);
+
+    /* Regions are zero-filled (EMPTY_KEY) and aligned to CACHE_LINE_SIZE. */
+    if ((bucket = (bucket_t *) allocator_alloc_region(a, size)) == NULL) {
+      elog("allocator_alloc_region error");
+      return NULL;
+    }
+
+    return bucket;
+}
+
+
+/*
+ * int bfs(const bucket_t * bucket, const unsigned int hp, const unsigned int b0, const unsigned int b1,
+ *                                              bfs_entry_t * queue, int *slot)
+ *
+ * Breadth-first search for the shortest cuckoo path from b0 or b1 to a bucket with an empty slot.
+ * The buckets are read without locks, so the path is only a hint; move_path() validates every step.
+ *
+ * found     : return the index of the last entry of the path in 'queue', and write the empty slot to *slot
+ * not found : return -1
+ */
+static int bfs(const bucket_t * bucket, const unsigned int hp, const unsigned int b0,
+	       const unsigned int b1, bfs_entry_t * queue, int *slot)
+{
+    int head = 0, tail = 0;
+    int s;
+    lkey_t k;
+    bfs_entry_t *e;
+
+    queue[tail].bucket = b0; queue[tail].parent = -1; queue[tail].depth = 0; tail++;
+    queue[tail].bucket = b1; queue[tail].parent = -1; queue[tail].depth = 0; tail++;
+
+    for (head = 0; head < tail; head++) {
+      e = &queue[head];
+
+      if ((s = empty_slot(&bucket[e->bucket])) != -1) {
+	*slot = s;
+	return head;
+      }
+
+      if (MAX_BFS_DEPTH <= e->depth)
+	continue;
+
+      for (s = 0; s < SLOTS_PER_BUCKET && tail < MAX_BFS_QUEUE; s++) {
+	if ((k = bucket[e->bucket].key[s]) == EMPTY_KEY)
+	  continue;
+	queue[tail].bucket = alt_bucket(k, e->bucket, hp);
+	queue[tail].parent = head;
+	queue[tail].slot = s;
+	queue[tail].key = k;
+	queue[tail].depth = e->depth + 1;
+	tail++;
+      }
+    }
+    return -1;
+}
+
+
+/*
+ * bool_t move_path(hashtable_t * ht, bucket_t * bucket, const unsigned int hp,
+ *                             const bfs_entry_t * queue, int idx, int slot)
+ *
+ * Move the keys along the path which ends at queue[idx], starting from the end, so that
+ * every key is always in one of its buckets. If 'ht' is not NULL, lock the two buckets of
+ * each step and give up if the step is not valid any more.
+ *
+ * success : return true
+ * failure : return false
+ */
+static bool_t move_path(hashtable_t * ht, bucket_t * bucket, const unsigned int hp,
+			const bfs_entry_t * queue, int idx, int slot)
+{
+    const bfs_entry_t *e, *p;
+    bucket_t *src, *dst;
+    bool_t valid = true;
+
+    for (e = &queue[idx]; e->parent != -1; e = p) {
+      p = &queue[e->parent];
+
+      if (ht != NULL) {
+	lock_two(ht, p->bucket, e->bucket);
+	bucket = ht->bucket;
+      }
+      src = &bucket[p->bucket];
+      dst = &bucket[e->bucket];
+
+      if (ht != NULL)
+	valid = (ht->hashpower == hp && src->key[e->slot] == e->key
+		 && dst->key[slot] == EMPTY_KEY);
+
+      if (valid == true) {
+	set_slot(dst, slot, e->key, src->value[e->slot]);
+	WMB();
+	src->key[e->slot] = EMPTY_KEY;
+      }
+
+      if (ht != NULL)
+	unlock_two(ht, p->bucket, e->bucket);
+
+      if (valid != true)
+	return false;
+
+      slot = e->slot;
+    }
+    return true;
+}
+
+
+/*
+ * bool_t cuckoo_path(hashtable_t * ht, const unsigned int hp, const unsigned int b0, const unsigned int b1)
+ *
+ * Make an empty slot in b0 or b1.
+ *
+ * success(or the path became stale; try again) : return true
+ * failure(no cuckoo path; the table is too full) : return false
+ */
+static bool_t cuckoo_path(hashtable_t * ht, const unsigned int hp, const unsigned int b0,
+			  const unsigned int b1)
+{
+    bfs_entry_t queue[MAX_BFS_QUEUE];
+    int idx, slot;
+
+    STATS_INC(STATS_RELOCATE);
+    if ((idx = bfs(ht->bucket, hp, b0, b1, queue, &slot)) == -1) {
+      STATS_INC(STATS_RELOCATE_FAIL);
+      return false;
+    }
+    STATS_RECORD(STATS_KICKS, queue[idx].depth);
+
+    if (move_path(ht, NULL, hp, queue, idx, slot) != true)
+      STATS_INC(STATS_RETRY);	/* the path became stale */
+    return true;
+}
+
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the entry of 'key' with both its buckets locked. If the entry exists,
+ * write its value to *getval, and replace it with 'val' (UPSERT), leave it
+ * (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD). Otherwise store 'val', or
+ * fn(key) for COMPUTE_IF_ABSENT if fn is not NULL, and write it to *getval.
+ * fn() is called at most once, under the bucket locks, so it must not access the table.
+ *
+ * added : return true
+ * found, or reserved key : return false
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    unsigned int hp, b0, b1;
+    bucket_t *bucket, *b;
+    val_t newval = val;
+    bool_t computed = false;
+    int s;
+
+    if (key == EMPTY_KEY) {
+      elog("reserved key");
+      return false;
+    }
+
+    while (1) {
+      hp = lock_key(ht, key, &b0, &b1);
+      bucket = ht->bucket;
+
+      b = &bucket[b0];
+      if ((s = find_slot(b, key)) == -1) {
+	b = &bucket[b1];
+	s = find_slot(b, key);
+      }
+      if (s != -1) {
+	*getval = b->value[s];
+	if (op == UPSERT)
+	  b->value[s] = val;
+	else if (op == FETCH_ADD)
+	  b->value[s] += val;
+	unlock_two(ht, b0, b1);
+	return false;
+      }
+
+      if (op == COMPUTE_IF_ABSENT && fn != NULL && computed == false) {
+	newval = fn(key);
+	computed = true;
+      }
+
+      b = &bucket[b0];
+      if ((s = empty_slot(b)) == -1) {
+	b = &bucket[b1];
+	s = empty_slot(b);
+      }
+
+      if (s != -1) {
+	set_slot(b, s, key, newval);
+	unlock_two(ht, b0, b1);
+	*getval = newval;
+	counter_inc(&ht->setSize);
+	return true;
+      }
+
+      unlock_two(ht, b0, b1);
+
+      if (cuckoo_path(ht, hp, b0, b1) != true)
+	resize(ht, hp);
+    }
+}
+
+/*
+ * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable 'ht'.
+ *
+ * success : return true
+ * failure(key already exists) : return false
+ */
+bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, COMPUTE_IF_ABSENT, val, NULL, &getval);
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval = 0;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval = 0;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/*
+ * bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Delete node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ *
+ * success : return true
+ * failure(key not found): return false
+ */
+bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int b0, b1;
+    bucket_t *b;
+    int s;
+    bool_t ret = false;
+
+    lock_key(ht, key, &b0, &b1);
+
+    b = &ht->bucket[b0];
+    if ((s = find_slot(b, key)) == -1) {
+      b = &ht->bucket[b1];
+      s = find_slot(b, key);
+    }
+
+    if (s != -1) {
+      *getval = b->value[s];
+      b->key[s] = EMPTY_KEY;
+      ret = true;
+    }
+
+    unlock_two(ht, b0, b1);
+
+    if (ret == true)
+      counter_dec(&ht->setSize);
+
+    return ret;
+}
+
+
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Find node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ * Take no lock: read the versions of both buckets, look in the buckets,
+ * and retry if any version is odd or has changed.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int hp, b0, b1, l0, l1;
+    uintptr_t v0, v1;
+    bucket_t *bucket;
+    bool_t ret;
+    val_t val = 0;
+    int s, spin = 0;
+
+    while (1) {
+      hp = ht->hashpower;
+      bucket = ht->bucket;
+      b0 = hashCode0(key, hp);
+      b1 = hashCode1(key, hp);
+      l0 = lockIdx(b0);
+      l1 = lockIdx(b1);
+
+      v0 = ht->lock[l0].version;
+      v1 = ht->lock[l1].version;
+      if (((v0 | v1) & 1) != 0) {
+	STATS_INC(STATS_RETRY);
+	if (++spin % SPIN_LIMIT == 0)
+	  sched_yield();
+	continue;
+      }
+      RMB();
+      if (hp != ht->hashpower || bucket != ht->bucket) {
+	STATS_INC(STATS_RETRY);
+	continue;
+      }
+
+      ret = true;
+      if ((s = find_slot(&bucket[b0], key)) != -1)
+	val = bucket[b0].value[s];
+      else if ((s = find_slot(&bucket[b1], key)) != -1)
+	val = bucket[b1].value[s];
+      else
+	ret = false;
+
+      RMB();
+      if (ht->lock[l0].version == v0 && ht->lock[l1].version == v1) {
+	if (ret == true)
+	  *getval = val;
+	return ret;
+      }
+      STATS_INC(STATS_RETRY);
+    }
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node '(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/* Prefetch both candidate buckets of 'key' and their version locks. */
+static void prefetch_key(hashtable_t * ht, const lkey_t key)
+{
+    unsigned int hp = ht->hashpower;
+    unsigned int b0 = hashCode0(key, hp);
+    unsigned int b1 = hashCode1(key, hp);
+
+    PREFETCH(&ht->lock[lockIdx(b0)]);
+    PREFETCH(&ht->lock[lockIdx(b1)]);
+    PREFETCH(&ht->bucket[b0]);
+    PREFETCH(&ht->bucket[b1]);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value. Both candidate buckets of
+ * keys[i + BATCH_WIDTH] are prefetched while keys[i] is looked up, so that the
+ * misses of later keys overlap the current lookup. The old bucket arrays are kept
+ * until free_hashtable(), so prefetching during resize() is harmless.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < n && i < BATCH_WIDTH; i++)
+      prefetch_key(ht, keys[i]);
+
+    for (i = 0; i < n; i++) {
+      if (i + BATCH_WIDTH < n)
+	prefetch_key(ht, keys[i + BATCH_WIDTH]);
+      if ((found[i] = get(ht, keys[i], &getval[i])) == true)
+	ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * bool_t insert_nolock(bucket_t * bucket, const unsigned int hp, const lkey_t key, const val_t val)
+ *
+ * Insert '(key, val)' into a bucket array which no other thread can see.
+ */
+static bool_t insert_nolock(bucket_t * bucket, const unsigned int hp, const lkey_t key,
+			    const val_t val)
+{
+    bfs_entry_t queue[MAX_BFS_QUEUE];
+    unsigned int b0 = hashCode0(key, hp);
+    unsigned int b1 = hashCode1(key, hp);
+    int idx, s;
+
+    if ((idx = bfs(bucket, hp, b0, b1, queue, &s)) == -1)
+      return false;
+    move_path(NULL, bucket, hp, queue, idx, s);
+
+    /* Now queue[root of the path] has an empty slot. */
+    while (queue[idx].parent != -1) {
+      s = queue[idx].slot;
+      idx = queue[idx].parent;
+    }
+    set_slot(&bucket[queue[idx].bucket], s, key, val);
+    return true;
+}
+
+
+/*
+ * void resize(hashtable_t * ht, const unsigned int hp)
+ *
+ * Double the number of buckets, unless another thread has already resized the table
+ * of hashpower 'hp'. Hold all locks while rehashing.
+ */
+static void resize(hashtable_t * ht, const unsigned int hp)
+{
+    bucket_t *newb, *oldb;
+    retired_t *r;
+    unsigned int i, new_hp;
+    int s;
+    bool_t ok;
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    for (i = 0; i < LOCK_SIZE; i++)
+      lock_bucket(ht, i);
+
+    if (ht->hashpower != hp) {
+      for (i = 0; i < LOCK_SIZE; i++)
+	unlock_bucket(ht, i);
+      return;
+    }
+
+    oldb = ht->bucket;
+    new_hp = hp;
+    do {
+      new_hp++;
+      if ((newb = init_bucket(ht->allocator, new_hp)) == NULL)
+	abort();
+
+      ok = true;
+      for (i = 0; ok == true && i <= hashmask(hp); i++)
+	for (s = 0; ok == true && s < SLOTS_PER_BUCKET; s++)
+	  if (oldb[i].key[s] != EMPTY_KEY)
+	    ok = insert_nolock(newb, new_hp, oldb[i].key[s], oldb[i].value[s]);
+
+      if (ok != true)
+	allocator_free_region(ht->allocator, newb);
+    } while (ok != true);
+
+    /* Keep the old array until free_hashtable(), because find() may still be reading it. */
+    if ((r = (retired_t *) calloc(1, sizeof(retired_t))) == NULL) {
+      elog("calloc error");
+      abort();
+    }
+    r->bucket = oldb;
+    r->next = ht->retired;
+    ht->retired = r;
+
+    ht->bucket = newb;
+    WMB();
+    ht->hashpower = new_hp;
+
+    for (i = 0; i < LOCK_SIZE; i++)
+      unlock_bucket(ht, i);
+
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
+    fprintf (stderr, "Resized\n");
+}
+
+
+/*
+ * hashtable_t *init_hashtable(const unsigned int size)
+ *
+ * Create hashtable with (2^size) buckets, i.e. (2^size * SLOTS_PER_BUCKET) slots.
+ *
+ * success : return pointer to this hashtable
+ * failure : return NULL
+ */
+hashtable_t *init_hashtable(const unsigned int size)
+{
+    hashtable_t *ht;
+
+    if ((ht = (hashtable_t *) calloc(1, sizeof(hashtable_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+
+    ht->allocator = get_allocator();
+    if ((ht->lock = (version_lock_t *) allocator_alloc_region(ht->allocator,
+							       LOCK_SIZE * sizeof(version_lock_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      free(ht);
+      return NULL;
+    }
+
+    if ((ht->bucket = init_bucket(ht->allocator, size)) == NULL) {
+      allocator_free_region(ht->allocator, ht->lock);
+      free(ht);
+      return NULL;
+    }
+
+    if (counter_init(&ht->setSize) != true) {
+      allocator_free_region(ht->allocator, ht->bucket);
+      allocator_free_region(ht->allocator, ht->lock);
+      free(ht);
+      return NULL;
+    }
+
+    ht->hashpower = size;
+    ht->retired = NULL;
+
+    return ht;
+}
+
+void free_hashtable(hashtable_t * ht)
+{
+    retired_t *r;
+
+    while ((r = ht->retired) != NULL) {
+      ht->retired = r->next;
+      allocator_free_region(ht->allocator, r->bucket);
+      free(r);
+    }
+    allocator_free_region(ht->allocator, ht->bucket);
+    allocator_free_region(ht->allocator, ht->lock);
+    counter_destroy(&ht->setSize);
+    free(ht);
+}
+
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static unsigned int hashCode0(lkey_t key, const unsigned int hp)
+{
+    return (unsigned int) (mix((uint64_t) key) & hashmask(hp));
+}
+
+static unsigned int hashCode1(lkey_t key, const unsigned int hp)
+{
+    return (unsigned int) (mix((uint64_t) key ^ 0x9e3779b97f4a7c15ULL) & hashmask(hp));
+}
+
+/* Return the other candidate bucket of 'key' which is now in bucket 'b'. */
+static unsigned int alt_bucket(lkey_t key, const unsigned int b, const unsigned int hp)
+{
+    unsigned int b0 = hashCode0(key, hp);
+    return (b == b0 ? hashCode1(key, hp) : b0);
+}
+
+
+void show_hashtable(hashtable_t * ht)
+{
+    unsigned int i;
+    int s;
+
+    for (i = 0; i <= hashmask(ht->hashpower); i++) {
+      printf("[");
+      for (s = 0; s < SLOTS_PER_BUCKET; s++) {
+	if (ht->bucket[i].key[s] == EMPTY_KEY)
+	  printf(" NiL");
+	else
+	  printf(" %3d", (int) ht->bucket[i].value[s]);
+      }
+      printf("]");
+    }
+    printf("\n");
+}
+
+
+
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t BucketizedCuckooHash_ops = {"BucketizedCuckooHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
+#ifdef _SINGLE_THREAD_
+
+hashtable_t *ht;
+
+int main(int argc, char **argv)
+{
+    val_t getval;
+    int i;
+    int n = 40;
+
+    ht = init_hashtable(2);
+
+    for (i = 1; i <= n; i++) {
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      add(ht, i, i);
+      show_hashtable(ht);
+    }
+
+    for (i = 1; i <= n; i++)
+      assert(find(ht, i) == true);
+    assert(find(ht, n + 1) == false);
+
+    for (i = 1; i <= n; i++) {
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      delete(ht, i, &getval);
+      assert(getval == i);
+      show_hashtable(ht);
+    }
+
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
+    free_hashtable(ht);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/* ---------------------------------------------------------------------------
+ * Bucketized Concurrent Cuckoo Hash Table
+ *
+ * "Algorithmic Improvements for Fast Concurrent Cuckoo Hashing" by X. Li, D. G. Andersen,
+ *  M. Kaminsky, M. J. Freedman  (libcuckoo)
+ *
+ * Every key has two candidate buckets, and a bucket holds SLOTS_PER_BUCKET entries
+ * inline (one cache line). Writers lock the two buckets through a fixed-size array
+ * of version locks, and make room for a new key by moving the keys along a short
+ * cuckoo path found by breadth-first search. Readers take no lock: they read the
+ * versions, look in both buckets, and retry if a version has changed.
+ *
+ * Reserved word:
+ *   key : EMPTY_KEY (0) can not be stored.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _BUCKETIZED_CUCKOO_HASH_H_
+#define _BUCKETIZED_CUCKOO_HASH_H_
+
+#include "common.h"
+#include "counter.h"
+#include "alloc.h"
+
+#define EMPTY_KEY          ((lkey_t) 0)
+
+#define SLOTS_PER_BUCKET   4
+#define LOCK_SIZE          2048   /* number of version locks, independent of the table size */
+#define MAX_BFS_DEPTH      5      /* maximum length of a cuckoo path */
+
+
+typedef struct _bucket_t
+{
+  volatile lkey_t key[SLOTS_PER_BUCKET];   /* keys */
+  volatile val_t value[SLOTS_PER_BUCKET];  /* values */
+} __attribute__((aligned(CACHE_LINE_SIZE))) bucket_t;
+
+
+typedef struct _version_lock_t
+{
+  volatile uintptr_t version;              /* odd while locked */
+} __attribute__((aligned(CACHE_LINE_SIZE))) version_lock_t;
+
+
+typedef struct _retired_t
+{
+  bucket_t *bucket;                        /* bucket array replaced by resize() */
+  struct _retired_t *next;
+} retired_t;
+
+
+typedef struct _hashtable_t
+{
+  counter_t setSize;                       /* number of nodes */
+  allocator_t *allocator;                  /* table allocator */
+
+  bucket_t * volatile bucket;              /* hashtable */
+  volatile unsigned int hashpower;         /* number of buckets = 2^hashpower */
+
+  version_lock_t *lock;                    /* version lock array (length = LOCK_SIZE) */
+
+  retired_t *retired;                      /* old bucket arrays, kept until free_hashtable() */
+} hashtable_t;
+
+
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     BucketizedCuckooHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     BucketizedCuckooHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     BucketizedCuckooHash_free_hashtable(__VA_ARGS__)
+#define add(...)                BucketizedCuckooHash_add(__VA_ARGS__)
+#define delete(...)             BucketizedCuckooHash_delete(__VA_ARGS__)
+#define find(...)               BucketizedCuckooHash_find(__VA_ARGS__)
+#define get(...)                BucketizedCuckooHash_get(__VA_ARGS__)
+#define upsert(...)             BucketizedCuckooHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  BucketizedCuckooHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          BucketizedCuckooHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         BucketizedCuckooHash_find_batch(__VA_ARGS__)
+
+void show_hashtable (hashtable_t *);
+hashtable_t * init_hashtable (const unsigned int);
+void free_hashtable (hashtable_t *);
+bool_t add (hashtable_t *, const lkey_t, const val_t);
+bool_t delete (hashtable_t *, const lkey_t, val_t *);
+bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
+
+#endif
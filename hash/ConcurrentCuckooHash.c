@@ -13,33 +13,45 @@
 #include <assert.h>
 
 #include "ConcurrentCuckooHash.h"
+#include "registry.h"
+#include "stats.h"
 
 static void acquire (hashtable_t *, const lkey_t);
 static void release (hashtable_t *, const lkey_t);
+static void read_acquire (hashtable_t *, const lkey_t);
+static void read_release (hashtable_t *, const lkey_t);
+static void free_locks (hashtable_t *);
 static void aLock (hashtable_t *);
 static void aUnLock (hashtable_t *);
 
 static bool_t add_node_atTail(list_t *, node_t *);
-static node_t *create_node(const lkey_t, const val_t);
-static void free_node(node_t *);
+static node_t *create_node(allocator_t *, const lkey_t, const val_t);
+static void free_node(allocator_t *, node_t *);
+static void free_list(allocator_t *, list_t *);
 static node_t *get_head_node(list_t *);
 static node_t *delete_node(list_t *, lkey_t);
-static list_t *init_list(void);
-static bool_t search_list(list_t *, const lkey_t);
+static list_t *init_list(allocator_t *);
+static bool_t search_list(list_t *, const lkey_t, val_t *);
 static list_t *get_list(hashtable_t *, const int, const lkey_t);
 static bool_t init_tables(hashtable_t *, const unsigned int, const int,
 			const int);
-static void free_tables(list_t ***, const unsigned int);
+static void free_tables(allocator_t *, list_t ***, const unsigned int);
 static unsigned long int hashCode0(lkey_t, const hashtable_t *);
 static unsigned long int hashCode1(lkey_t, const hashtable_t *);
 static void resize(hashtable_t *);
-static bool_t contains_op(hashtable_t *, const lkey_t);
+static bool_t contains_op(hashtable_t *, const lkey_t, val_t *);
+static node_t *find_node(hashtable_t *, const lkey_t);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static void prefetch_key(hashtable_t *, const lkey_t);
 static bool_t relocate(hashtable_t *, int, int);
 static void show_list(list_t *, const unsigned int);
 
 
 /*
  * Utitles
+ *
+ * For STATS_STRIPE(), the stripes of mtx[1] are numbered after those of mtx[0].
  */
 static void
 acquire (hashtable_t *ht, const lkey_t key)
@@ -49,8 +61,10 @@ acquire (hashtable_t *ht, const lkey_t key)
   i = (unsigned int)(hashCode0(key, ht) % ht->mtx_size);
   j = (unsigned int)(hashCode1(key, ht) % ht->mtx_size);
 
-  pthread_mutex_lock(&ht->mtx[0][i]);
-  pthread_mutex_lock(&ht->mtx[1][j]);
+  rwlock_write_lock(ht->lock_kind, &ht->mtx[0][i]);
+  STATS_STRIPE(i);
+  rwlock_write_lock(ht->lock_kind, &ht->mtx[1][j]);
+  STATS_STRIPE(ht->mtx_size + j);
 }
 
 static void
@@ -61,28 +75,70 @@ release (hashtable_t *ht, const lkey_t key)
   i = (unsigned int)(hashCode0(key, ht) % ht->mtx_size);
   j = (unsigned int)(hashCode1(key, ht) % ht->mtx_size);
 
-  pthread_mutex_unlock(&ht->mtx[0][i]);
-  pthread_mutex_unlock(&ht->mtx[1][j]);
+  rwlock_write_unlock(ht->lock_kind, &ht->mtx[1][j]);
+  rwlock_write_unlock(ht->lock_kind, &ht->mtx[0][i]);
 }
 
+/* Same as acquire() and release(), but in shared mode for contains(). */
 static void
-aLock (hashtable_t *ht)
+read_acquire (hashtable_t *ht, const lkey_t key)
 {
-  int i;
-  for (i = 0; i < ht->mtx_size; i++) {
-    pthread_mutex_lock(&ht->mtx[0][i]);
-    pthread_mutex_lock(&ht->mtx[1][i]);
-  }
+  unsigned int i, j;
+
+  i = (unsigned int)(hashCode0(key, ht) % ht->mtx_size);
+  j = (unsigned int)(hashCode1(key, ht) % ht->mtx_size);
+
+  rwlock_read_lock(&ht->mtx[0][i]);
+  rwlock_read_lock(&ht->mtx[1][j]);
+}
 
+static void
+read_release (hashtable_t *ht, const lkey_t key)
+{
+  unsigned int i, j;
+
+  i = (unsigned int)(hashCode0(key, ht) % ht->mtx_size);
+  j = (unsigned int)(hashCode1(key, ht) % ht->mtx_size);
+
+  rwlock_read_unlock(&ht->mtx[1][j]);
+  rwlock_read_unlock(&ht->mtx[0][i]);
+}
+
+/*
+ * Lock all of mtx[0] before mtx[1], the same order as acquire(); interleaving
+ * the two arrays could deadlock with a thread holding mtx[0][i] for a larger i.
+ */
+static void
+aLock (hashtable_t *ht)
+{
+  int i, j;
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < ht->mtx_size; i++) {
+      rwlock_write_lock(ht->lock_kind, &ht->mtx[j][i]);
+      STATS_STRIPE(j * ht->mtx_size + i);
+    }
 }
 
 static void
 aUnLock (hashtable_t *ht)
 {
-  int i;
-  for (i = 0; i < ht->mtx_size; i++) {
-    pthread_mutex_unlock(&ht->mtx[1][i]);
-    pthread_mutex_unlock(&ht->mtx[0][i]);
+  int i, j;
+  for (j = 1; 0 <= j; j--)
+    for (i = ht->mtx_size - 1; 0 <= i; i--)
+      rwlock_write_unlock(ht->lock_kind, &ht->mtx[j][i]);
+}
+
+/* Destroy and free the lock arrays; the region is zero-filled, so unused locks are harmless. */
+static void
+free_locks (hashtable_t *ht)
+{
+  int i, j;
+  for (j = 0; j < 2; j++) {
+    if (ht->mtx[j] == NULL)
+      continue;
+    for (i = 0; i < ht->mtx_size; i++)
+      rwlock_destroy(ht->lock_kind, &ht->mtx[j][i]);
+    allocator_free_region(ht->allocator, ht->mtx[j]);
   }
 }
 
@@ -110,12 +166,12 @@ static bool_t add_node_atTail(list_t * l, node_t * newNode)
 
 /**
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
     node_t *node;
 
-    if ((node = (node_t *)calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((node = (node_t *)allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
       return NULL;
     }
 
@@ -129,9 +185,9 @@ static node_t *create_node(const lkey_t key, const val_t val)
 
 /**
  */
-static void free_node(node_t * node)
+static void free_node(allocator_t * a, node_t * node)
 {
-    free(node);
+    allocator_free(a, node);
 }
 
 static node_t *get_head_node(list_t * l)
@@ -158,10 +214,10 @@ static node_t *delete_node(list_t * l, lkey_t key)
 	curr = curr->next;
     }
 
-    pred->next = curr->next;
-
-    if (ret != NULL)
+    if (ret != NULL) {
+      pred->next = curr->next;
       l->size--;
+    }
 
     return ret;
 }
@@ -173,7 +229,7 @@ static node_t *delete_node(list_t * l, lkey_t key)
 
 /**
  */
-static list_t *init_list(void)
+static list_t *init_list(allocator_t * a)
 {
     list_t *l;
 
@@ -181,8 +237,8 @@ static list_t *init_list(void)
       elog("calloc error");
       	return NULL;
     }
-    if ((l->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((l->head = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
       free (l);
       return NULL;
     }
@@ -196,7 +252,7 @@ static list_t *init_list(void)
 
 /**
  */
-void free_list(list_t * l)
+static void free_list(allocator_t * a, list_t * l)
 {
     node_t *curr, *next;
     curr = l->head->next;
@@ -204,15 +260,15 @@ void free_list(list_t * l)
 
     while (curr != NULL) {
 	next = curr->next;
-	free_node(curr);
+	free_node(a, curr);
 	curr = next;
     }
 
-    free(l->head);
+    allocator_free(a, l->head);
     free(l);
 }
 
-static bool_t search_list(list_t * list, const lkey_t key)
+static bool_t search_list(list_t * list, const lkey_t key, val_t * getval)
 {
     bool_t ret = false;
     node_t *node;
@@ -221,6 +277,7 @@ static bool_t search_list(list_t * list, const lkey_t key)
 	node = list->head->next;
 	while (node != NULL) {
 	    if (node->key == key) {
+		*getval = node->value;
 		ret = true;
 		break;
 	    }
@@ -255,34 +312,34 @@ static bool_t init_tables(hashtable_t * ht, const unsigned int table_size,
     unsigned int i;
 
     if ((ht->table[0] =
-	 (list_t **) calloc(table_size, sizeof(list_t))) == NULL)
+	 (list_t **) allocator_alloc_region(ht->allocator, table_size * sizeof(list_t *))) == NULL)
       return false;
     if ((ht->table[1] =
-	 (list_t **) calloc(table_size, sizeof(list_t))) == NULL) {
-      free (ht->table[0]);
+	 (list_t **) allocator_alloc_region(ht->allocator, table_size * sizeof(list_t *))) == NULL) {
+      allocator_free_region(ht->allocator, ht->table[0]);
       return false;
     }
 
     for (i = 0; i < table_size; i++) {
-	ht->table[0][i] = init_list();
-	ht->table[1][i] = init_list();
+	ht->table[0][i] = init_list(ht->allocator);
+	ht->table[1][i] = init_list(ht->allocator);
     }
 
     return true;
 }
 
 
-static void free_tables(list_t **table[2], const unsigned int table_size)
+static void free_tables(allocator_t * a, list_t **table[2], const unsigned int table_size)
 {
     int i;
 
     for (i = 0; i < table_size; i++) {
-	free_list(table[0][i]);
-	free_list(table[1][i]);
+	free_list(a, table[0][i]);
+	free_list(a, table[1][i]);
     }
 
-    free(table[0]);
-    free(table[1]);
+    allocator_free_region(a, table[0]);
+    allocator_free_region(a, table[1]);
 }
 
 /*
@@ -308,25 +365,31 @@ hashtable_t *init_hashtable(const unsigned int size, const int probe_size,
       return NULL;
     }
 
-    ht->setSize = 0;
+    if (counter_init(&ht->setSize) != true) {
+      free(ht);
+      return NULL;
+    }
     ht->table_size = table_size;
+    ht->allocator = get_allocator();
     ht->probe_size = probe_size;
     ht->threshold = threshold;
 
+    ht->lock_kind = get_lock_kind();
     ht->mtx_size = table_size;
-    if ((ht->mtx[0] = (pthread_mutex_t *) calloc(table_size, sizeof(pthread_mutex_t))) == NULL) {
-      elog("calloc eror");
+    if ((ht->mtx[0] = (rwlock_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(rwlock_t))) == NULL) {
+      elog("allocator_alloc_region error");
       goto end;
     }
 
-    if ((ht->mtx[1] = (pthread_mutex_t *) calloc(table_size, sizeof(pthread_mutex_t))) == NULL) {
-      elog("calloc error");
+    if ((ht->mtx[1] = (rwlock_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(rwlock_t))) == NULL) {
+      elog("allocator_alloc_region error");
       goto end;
     }
 
-    for (i = 0; i <= table_size; i++) {
-      ht->mtx[0][i] = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
-      ht->mtx[1][i] = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    for (i = 0; i < table_size; i++) {
+      if (rwlock_init(ht->lock_kind, &ht->mtx[0][i]) != true
+	  || rwlock_init(ht->lock_kind, &ht->mtx[1][i]) != true)
+	goto end;
     }
 
     if (init_tables(ht, table_size, probe_size, threshold) != true)
@@ -335,7 +398,8 @@ hashtable_t *init_hashtable(const unsigned int size, const int probe_size,
     return ht;
 
  end:
-    free(ht->mtx[0]);
+    free_locks(ht);
+    counter_destroy(&ht->setSize);
     free (ht);
     
     return NULL;
@@ -343,9 +407,9 @@ hashtable_t *init_hashtable(const unsigned int size, const int probe_size,
 
 void free_hashtable(hashtable_t * ht, const unsigned int table_size)
 {
-  free_tables(ht->table, table_size);
-  pthread_mutex_destroy(ht->mtx[0]);
-  pthread_mutex_destroy(ht->mtx[1]);
+  free_tables(ht->allocator, ht->table, table_size);
+  free_locks(ht);
+  counter_destroy(&ht->setSize);
   free(ht);
   
 }
@@ -366,7 +430,9 @@ static void resize(hashtable_t * ht)
 {
     list_t *old_list;
     unsigned int i, j;
+    STATS_DECLARE(t0);
 
+    STATS_TICKS(t0);
     aLock(ht);
 
     ht->old_table_size = ht->table_size;
@@ -398,17 +464,17 @@ static void resize(hashtable_t * ht)
 		    list_t *set1 = ht->table[1][h1];
 
 		    if (set0->size < ht->threshold) {
-		      if (add_node_atTail(set0, node) == true) ht->setSize++;
+		      add_node_atTail(set0, node);
 		    } else if (set1->size < ht->threshold) {
-		      if (add_node_atTail(set1, node) == true) ht->setSize++;
+		      add_node_atTail(set1, node);
 		    } else if (set0->size < ht->probe_size) {
-		      if (add_node_atTail(set0, node) == true) ht->setSize++;
+		      add_node_atTail(set0, node);
 		    } else if (set1->size < ht->probe_size) {
-		      if (add_node_atTail(set1, node) == true) ht->setSize++;
+		      add_node_atTail(set1, node);
 		    } else {
 			printf("ERRRRR!!!! a5e\n");
 			exit(-1);
-			free_node(node);
+			free_node(ht->allocator, node);
 		    }
 		    node = next;
 		}
@@ -418,15 +484,17 @@ static void resize(hashtable_t * ht)
 
     //    free(ht->old_table[0]->head);
     //    free(ht->old_table[1]->head);
-    free(ht->old_table[0]);
-    free(ht->old_table[1]);
+    allocator_free_region(ht->allocator, ht->old_table[0]);
+    allocator_free_region(ht->allocator, ht->old_table[1]);
     //    free_tables(ht->old_table, ht->old_table_size);
 
     aUnLock(ht);    
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 
-static bool_t contains_op(hashtable_t * ht, const lkey_t key)
+static bool_t contains_op(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
     list_t *list;
     bool_t ret = false;
@@ -434,60 +502,113 @@ static bool_t contains_op(hashtable_t * ht, const lkey_t key)
 
     for (i = 0; i <= 1; i++) {
 	list = get_list(ht, i, key);
-	if ((ret = search_list(list, key)) == true)
+	if ((ret = search_list(list, key, getval)) == true)
 	    break;
     }
     return ret;
 }
 
+/* Return the node of 'key', or NULL. The caller holds the locks of 'key'. */
+static node_t *find_node(hashtable_t * ht, const lkey_t key)
+{
+    node_t *node;
+    int i;
+
+    for (i = 0; i <= 1; i++) {
+	node = get_list(ht, i, key)->head->next;
+	while (node != NULL) {
+	    if (node->key == key)
+		return node;
+	    node = node->next;
+	}
+    }
+    return NULL;
+}
 
+
+/* Return the bucket of 'key' in table 'no'. The caller holds a lock of the table. */
+static unsigned int bucket_of(hashtable_t * ht, const int no, const lkey_t key)
+{
+    return (unsigned int)(((no == 0) ? hashCode0(key, ht) : hashCode1(key, ht)) % ht->table_size);
+}
+
+/*
+ * Move the head node y of the overfull bucket table[i][hi] to its bucket in the
+ * other table, and so on for up to LIMIT rounds.
+ *
+ * Everything is read under locks: the head's key under the stripe lock of
+ * table[i][hi], since the node may be deleted and freed at any time, and the
+ * buckets under the locks of that key. Between the two, y may have been deleted
+ * or the table resized, in which case table[i][hi] may no longer be the bucket
+ * of the key and its stripe lock may not be held; so the bucket is checked again
+ * once the locks of the key are held.
+ */
 static bool_t relocate(hashtable_t * ht, int i, int hi)
 {
-    int hj = 0;
+    unsigned int hj;
     int j = 1 - i;
     int LIMIT = 8;
     int round;
+    rwlock_t *stripe;
     list_t *iSet, *jSet;
     node_t *y;
     lkey_t lock_key;
 
+    STATS_INC(STATS_RELOCATE);
     for (round = 0; round < LIMIT; round++) {
-	iSet = ht->table[i][hi];
-	y = get_head_node(iSet);
-	lock_key = y->key;
-
-	switch (i) {
-	case 0:	    hj = (unsigned int)(hashCode1(y->key, ht) % ht->table_size);	    break;
-	case 1:	    hj = (unsigned int)(hashCode0(y->key, ht) % ht->table_size);	    break;
+	stripe = &ht->mtx[i][hi % ht->mtx_size];
+	rwlock_read_lock(stripe);
+	if ((y = get_head_node(ht->table[i][hi])) == NULL) {
+	    rwlock_read_unlock(stripe);
+	    STATS_RECORD(STATS_KICKS, round);
+	    return true;                /* emptied by deletes */
 	}
+	lock_key = y->key;
+	rwlock_read_unlock(stripe);
 
 	acquire(ht, lock_key);
+	if (bucket_of(ht, i, lock_key) != hi) {
+	    /* Resized: the new table has placed every node within the threshold. */
+	    release(ht, lock_key);
+	    STATS_RECORD(STATS_KICKS, round);
+	    return true;
+	}
+	iSet = ht->table[i][hi];
+	hj = bucket_of(ht, j, lock_key);
 	jSet = ht->table[j][hj];
 
 	if ((y = delete_node(iSet, lock_key)) != NULL) {
 	    if (jSet->size < ht->threshold) {
-	      if (add_node_atTail(jSet, y) == true) ht->setSize++;
+	      add_node_atTail(jSet, y);
 	      release(ht, lock_key);
+	      STATS_RECORD(STATS_KICKS, round + 1);
 	      return true;
 	    } else if (jSet->size < ht->probe_size) {
-	      if (add_node_atTail(jSet, y) == true) ht->setSize++;
+	      add_node_atTail(jSet, y);
 	      i = 1 - i;
 	      hi = hj;
 	      j = 1 - j;
 	    } else {
-	      if (add_node_atTail(iSet, y) == true) ht->setSize++;
+	      add_node_atTail(iSet, y);
 	      release(ht, lock_key);
+	      STATS_RECORD(STATS_KICKS, round);
+	      STATS_INC(STATS_RELOCATE_FAIL);
 	      return false;
 	    }
-	} else if (iSet->size >= ht->threshold)
+	} else if (iSet->size >= ht->threshold) {
+	  /* y has gone, but the bucket is still overfull: try its new head. */
+	  release(ht, lock_key);
 	  continue;
-	else {
+	} else {
 	  release(ht, lock_key);
+	  STATS_RECORD(STATS_KICKS, round);
 	  return true;
 	}
 	release(ht, lock_key);
     }
 
+    STATS_RECORD(STATS_KICKS, round);
+    STATS_INC(STATS_RELOCATE_FAIL);
     return false;
 }
 
@@ -500,16 +621,17 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
     unsigned int h;
     bool_t mustResize = false;
     list_t *set0, *set1;
+    val_t getval;
 
 
     acquire(ht, key);
 
-    if (contains_op(ht, key) == true) {
+    if (contains_op(ht, key, &getval) == true) {
       release(ht, key);
 	return false;
     }
 
-    if ((newNode = create_node(key, val)) == NULL) {
+    if ((newNode = create_node(ht->allocator, key, val)) == NULL) {
       release(ht, key);
       return false;
     }
@@ -520,21 +642,21 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
     set1 = ht->table[1][h1];
 
     if (set0->size < ht->threshold) {
-      if (add_node_atTail(set0, newNode) == true) ht->setSize++;
+      if (add_node_atTail(set0, newNode) == true) counter_inc(&ht->setSize);
       release(ht, key);
       return true;
     } else if (set1->size < ht->threshold) {
-      if (add_node_atTail(set1, newNode) == true) ht->setSize++;
+      if (add_node_atTail(set1, newNode) == true) counter_inc(&ht->setSize);
       release(ht, key);
       return true;
     } else if (set0->size < ht->probe_size) {
-      if (add_node_atTail(set0, newNode) == true) ht->setSize++;
+      if (add_node_atTail(set0, newNode) == true) counter_inc(&ht->setSize);
       i = 0;	h = h0;
     } else if (set1->size < ht->probe_size) {
-      if (add_node_atTail(set1, newNode) == true) ht->setSize++;
+      if (add_node_atTail(set1, newNode) == true) counter_inc(&ht->setSize);
       i = 1;	h = h1;
     } else {
-      free_node(newNode);
+      free_node(ht->allocator, newNode);
       mustResize = true;
     }
     release(ht, key);
@@ -550,6 +672,118 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
     return true;
 }
 
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the entry of 'key' with its locks held. If the entry exists, write
+ * its value to *getval, and replace it with 'val' (UPSERT), leave it (COMPUTE_IF_ABSENT)
+ * or add 'val' to it (FETCH_ADD). Otherwise add '(key, val)', or '(key, fn(key))' for
+ * COMPUTE_IF_ABSENT, and write the value to *getval. The new node goes straight into
+ * one of the key's buckets while the locks are held if either is below the threshold;
+ * only when a relocation or a resize is needed are the locks released and the node
+ * added by add(). fn() is called at most once, under the locks, so it must not access
+ * the table. If another thread adds 'key' after the locks are released, 'op' is applied
+ * to its entry instead.
+ *
+ * added : return true
+ * found : return false
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    node_t *node;
+    list_t *set0, *set1;
+    val_t newval = val;
+    bool_t computed = false;
+
+    while (1) {
+	acquire(ht, key);
+	if ((node = find_node(ht, key)) != NULL) {
+	    *getval = node->value;
+	    if (op == UPSERT)
+		node->value = val;
+	    else if (op == FETCH_ADD)
+		node->value += val;
+	    release(ht, key);
+	    return false;
+	}
+	if (op == COMPUTE_IF_ABSENT && computed == false) {
+	    newval = fn(key);
+	    computed = true;
+	}
+
+	set0 = ht->table[0][bucket_of(ht, 0, key)];
+	set1 = ht->table[1][bucket_of(ht, 1, key)];
+	if (set0->size < ht->threshold || set1->size < ht->threshold) {
+	    if ((node = create_node(ht->allocator, key, newval)) == NULL) {
+		release(ht, key);
+		return false;
+	    }
+	    if (add_node_atTail((set0->size < ht->threshold) ? set0 : set1, node) == true)
+		counter_inc(&ht->setSize);
+	    release(ht, key);
+	    *getval = newval;
+	    return true;
+	}
+	release(ht, key);
+
+	if (add(ht, key, newval) == true) {
+	    *getval = newval;
+	    return true;
+	}
+    }
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval = 0;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval = 0;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
 
 bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
@@ -561,20 +795,20 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 
     set0 = get_list(ht, 0, key);
 
-    if (search_list(set0, key) == true) {
+    if (search_list(set0, key, getval) == true) {
 	if ((node = delete_node(set0, key)) != NULL) {
 	    *getval = node->value;
-	    ht->setSize--;
-	    free_node(node);
+	    counter_dec(&ht->setSize);
+	    free_node(ht->allocator, node);
 	    ret = true;
 	}
     } else {
 	set1 = get_list(ht, 1, key);
-	if (search_list(set1, key) == true) {
+	if (search_list(set1, key, getval) == true) {
 	    if ((node = delete_node(set1, key)) != NULL) {
 		*getval = node->value;
-		ht->setSize--;
-		free_node(node);
+		counter_dec(&ht->setSize);
+		free_node(ht->allocator, node);
 		ret = true;
 	    }
 	}
@@ -586,13 +820,61 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 }
 
 
-bool_t contains(hashtable_t * ht, const lkey_t key)
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
     bool_t ret;
 
-    acquire(ht, key);
-    ret = contains_op(ht, key);
-    release(ht, key);
+    read_acquire(ht, key);
+    ret = contains_op(ht, key, getval);
+    read_release(ht, key);
+
+    return ret;
+}
+
+bool_t contains(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/* Prefetch the locks and the table entries of 'key'; only their addresses are read. */
+static void prefetch_key(hashtable_t * ht, const lkey_t key)
+{
+    PREFETCH(&ht->mtx[0][hashCode0(key, ht) % ht->mtx_size]);
+    PREFETCH(&ht->mtx[1][hashCode1(key, ht) % ht->mtx_size]);
+    PREFETCH(&ht->table[0][hashCode0(key, ht) % ht->table_size]);
+    PREFETCH(&ht->table[1][hashCode1(key, ht) % ht->table_size]);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Same as contains() for keys[0..n-1]; found[i] tells whether keys[i] is found,
+ * and if so, getval[i] is its value.
+ *
+ * While keys[i] is looked up, the locks and both table entries of keys[i + BATCH_WIDTH]
+ * are prefetched. Only their addresses are computed without the locks, because
+ * resize() frees the old tables.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < n && i < BATCH_WIDTH; i++)
+	prefetch_key(ht, keys[i]);
+
+    for (i = 0; i < n; i++) {
+	if (i + BATCH_WIDTH < n)
+	    prefetch_key(ht, keys[i + BATCH_WIDTH]);
+
+	read_acquire(ht, keys[i]);
+	if ((found[i] = contains_op(ht, keys[i], &getval[i])) == true)
+	    ret++;
+	read_release(ht, keys[i]);
+    }
 
     return ret;
 }
@@ -637,6 +919,39 @@ void show_hashtable(hashtable_t * ht)
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4, 4, 2);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht, ((hashtable_t *) ht)->table_size);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (contains((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t ConcurrentCuckooHash_ops = {"ConcurrentCuckooHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
 #ifdef _SINGLE_THREAD_
 
 hashtable_t *ht;
@@ -649,18 +964,21 @@ int main(int argc, char **argv)
     ht = init_hashtable(4, 4, 2);
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(contains(ht, 11) == false);
+
     free_hashtable(ht, ht->table_size);
 
     return 0;
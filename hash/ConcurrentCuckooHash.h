@@ -10,6 +10,9 @@
 #define _CONCURRENT_CUCKOO_HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 #define CH_DEFAULT_MAX_SIZE 16
 
@@ -28,7 +31,8 @@ typedef struct _list_t {
 
 
 typedef struct _hashtable_t {
-  unsigned long int setSize;        /* number of nodes */
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* node allocator */
   
   int probe_size;
   int threshold;
@@ -39,11 +43,25 @@ typedef struct _hashtable_t {
   list_t **old_table[2];            /* temporary hashtable for keep the original hashtable before resize */
   unsigned int old_table_size;      /* size of old_table[0] */
   
-  pthread_mutex_t *mtx[2];          /* mutex lock array */
+  rwlock_t *mtx[2];                 /* lock arrays; contains() takes them in shared mode */
   int mtx_size;                     /* length of mtx[2] */
+  lock_kind_t lock_kind;            /* kind of the locks */
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define init_hashtable(...)     ConcurrentCuckooHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     ConcurrentCuckooHash_free_hashtable(__VA_ARGS__)
+#define show_hashtable(...)     ConcurrentCuckooHash_show_hashtable(__VA_ARGS__)
+#define add(...)                ConcurrentCuckooHash_add(__VA_ARGS__)
+#define delete(...)             ConcurrentCuckooHash_delete(__VA_ARGS__)
+#define contains(...)           ConcurrentCuckooHash_contains(__VA_ARGS__)
+#define get(...)                ConcurrentCuckooHash_get(__VA_ARGS__)
+#define upsert(...)             ConcurrentCuckooHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  ConcurrentCuckooHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          ConcurrentCuckooHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         ConcurrentCuckooHash_find_batch(__VA_ARGS__)
+
 hashtable_t *init_hashtable(const unsigned int, const int, const int);
 void free_hashtable(hashtable_t *, const unsigned int);
 void show_hashtable(hashtable_t *);
@@ -51,5 +69,10 @@ void show_hashtable(hashtable_t *);
 bool_t add(hashtable_t *, const lkey_t, const val_t);
 bool_t delete(hashtable_t *, const lkey_t, val_t *);
 bool_t contains(hashtable_t *, const lkey_t);
+bool_t get(hashtable_t *, const lkey_t, val_t *);
+bool_t upsert(hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent(hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add(hashtable_t *, const lkey_t, const val_t);
+int find_batch(hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 
 #endif
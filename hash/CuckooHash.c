@@ -3,6 +3,10 @@
  * 
  * "R.Pagh, F.F.Rodler, Cuchoo Hashing" http://cs.nyu.edu/courses/fall05/G22.3520-001/cuckoo-jour.pdf
  *
+ * Writers are serialized by ht->lock. Readers take no lock (MemC3 style):
+ * a key being displaced keeps its version counter odd until it is stored
+ * again, so find() retries when the counter is odd or has changed.
+ *
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Nov.17
  * Copyright (C) 2009-2025  suzuki hironobu
  *
@@ -12,25 +16,42 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
 
 #include "CuckooHash.h"
+#include "registry.h"
+#include "stats.h"
 
 static bool_t init_tables(hashtable_t *, const unsigned int);
-static void free_tables(node_t **);
+static void free_tables(allocator_t *, node_t **);
 static void resize(hashtable_t *);
 static void del_op(hashtable_t *, node_t *);
 static unsigned int hashCode0(lkey_t, const hashtable_t *);
 static unsigned int hashCode1(lkey_t, const hashtable_t *);
-static bool_t find_op(hashtable_t *, const lkey_t);
+static bool_t find_op(hashtable_t *, const lkey_t, val_t *);
+static bool_t insert_op(hashtable_t *, const lkey_t, const val_t);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
 static void set_node(node_t *, const lkey_t, const val_t,
 		     const node_stat);
-static bool_t swap_node(hashtable_t *, const int, node_t, node_t *);
+static bool_t swap_node(hashtable_t *, const int, node_t, node_t *, const bool_t);
 static node_t *get_node(hashtable_t *, const int, const lkey_t);
 
 
-#define lock(mtx)      pthread_mutex_lock(&(mtx))
-#define unlock(mtx)    pthread_mutex_unlock(&(mtx))
+#define lock(_ht_)     lock_acquire((_ht_)->lock_kind, &(_ht_)->lock)
+#define unlock(_ht_)   lock_release((_ht_)->lock_kind, &(_ht_)->lock)
+
+#define SPIN_LIMIT     64     /* spins before sched_yield() */
+
+#define versionIdx(_key_)  ((unsigned int) (_key_) & (VERSION_SIZE - 1))
+
+static void version_inc(hashtable_t * ht, const unsigned int idx)
+{
+    WMB();
+    ht->version[idx]++;
+    WMB();
+}
 
 static void
 set_node(node_t * node, const lkey_t key, const val_t val,
@@ -41,18 +62,50 @@ set_node(node_t * node, const lkey_t key, const val_t val,
     node->stat = stat;
 }
 
+/*
+ * bool_t swap_node(hashtable_t * ht, const int no, node_t node, node_t * next, const bool_t moving)
+ *
+ * Store 'node' into table[no], and write the evicted node to *next.
+ * 'moving' is true if 'node' itself was evicted by the previous swap_node().
+ *
+ * The version counter of the evicted key becomes odd before it leaves the table,
+ * and that of 'node' becomes even after it is stored again. A new key ('moving'
+ * is false) has its counter made odd before the slot is rewritten, since the
+ * slot stays OCC while its key and value change under a reader. If both keys
+ * share a counter, the counter simply stays odd. While resizing, the tables are
+ * not visible to the readers and the counters are left alone.
+ *
+ * return true if the evicted node is not occupied (i.e. the chain ends)
+ */
 static bool_t
-swap_node(hashtable_t * ht, const int no, node_t node, node_t * next)
+swap_node(hashtable_t * ht, const int no, node_t node, node_t * next,
+	  const bool_t moving)
 {
     node_t *tmp;
     bool_t ret = false;
+    int in = -1, out = -1;
 
     tmp = get_node(ht, no, node.key);
+
+    if ((ht->seq & 1) == 0) {
+	in = versionIdx(node.key);
+	if (tmp->stat == OCC)
+	    out = versionIdx(tmp->key);
+    }
+
+    if (in != -1 && moving == false)
+	version_inc(ht, in);
+    if (out != -1 && out != in)
+	version_inc(ht, out);
+
     set_node(next, tmp->key, tmp->value, tmp->stat);
     set_node(tmp, node.key, node.value, OCC);
     if (next->stat != OCC)
 	ret = true;
 
+    if (in != -1 && in != out)
+	version_inc(ht, in);
+
     return ret;
 }
 
@@ -72,40 +125,41 @@ static node_t *get_node(hashtable_t * ht, const int no, const lkey_t key)
 
 
 /*
- * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ * bool_t insert_op(hashtable_t * ht, const lkey_t key, const val_t val)
  *
- * Add node '(key,val)' to hashtable ht.
+ * Store node '(key,val)', which is not in hashtable ht, displacing other nodes and
+ * resizing the tables if needed. Must be called with the lock held.
  *
  * success : return true
  * failure : return false
  */
-bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+static bool_t insert_op(hashtable_t * ht, const lkey_t key, const val_t val)
 {
     unsigned int i;
     node_t node;
     bool_t ret = false;
     node_t tmp;
     int try = 10;
-
-    lock(ht->mtx);
-
-    if (find_op(ht, key) == true) {
-	unlock(ht->mtx);
-	return false;
-    }
+    bool_t moving = false;
+    STATS_DECLARE(kicks);
 
     set_node(&node, key, val, OCC);
 
   retry:
     for (i = 0; i < ht->table_size; i++) {
-	if ((ret = swap_node(ht, 1, node, &tmp)) == true) {
-	    ht->setSize++;
+	if ((ret = swap_node(ht, 0, node, &tmp, moving)) == true) {
+	    counter_inc(&ht->setSize);
 	    break;
-	} else if ((ret = swap_node(ht, 2, tmp, &node)) == true) {
-	    ht->setSize++;
+	}
+	moving = true;
+	STATS_COUNT(kicks);
+	if ((ret = swap_node(ht, 1, tmp, &node, true)) == true) {
+	    counter_inc(&ht->setSize);
 	    break;
 	}
+	STATS_COUNT(kicks);
     }
+    STATS_RECORD(STATS_KICKS, kicks);
 
     if (ret == false && try-- > 0) {
 	resize(ht);
@@ -113,16 +167,46 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 	goto retry;
     }
 
-    unlock(ht->mtx);
+    /* Give up: 'node' is lost, but its version counter must not stay odd. */
+    if (ret == false && moving == true)
+	version_inc(ht, versionIdx(node.key));
+
+    return ret;
+}
+
+/*
+ * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key,val)' to hashtable ht.
+ *
+ * success : return true
+ * failure : return false
+ */
+bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    bool_t ret = false;
+    val_t getval;
+
+    lock(ht);
+
+    if (find_op(ht, key, &getval) != true)
+	ret = insert_op(ht, key, val);
+
+    unlock(ht);
 
     return ret;
 }
 
 
+/* The counter of the deleted key is odd while its slot is cleared. */
 static void del_op(hashtable_t * ht, node_t * node)
 {
+    unsigned int idx = versionIdx(node->key);
+
+    version_inc(ht, idx);
     set_node(node, (lkey_t) NULL, (val_t) NULL, DEL);
-    ht->setSize--;
+    version_inc(ht, idx);
+    counter_dec(&ht->setSize);
 }
 
 
@@ -140,7 +224,7 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
     bool_t ret = false;
     int i;
 
-    lock(ht->mtx);
+    lock(ht);
 
     for (i = 0; i <= 1; i++) {
 	node = get_node(ht, i, key);
@@ -152,13 +236,13 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 	}
     }
 
-    unlock(ht->mtx);
+    unlock(ht);
 
     return ret;
 }
 
 
-static bool_t find_op(hashtable_t * ht, const lkey_t key)
+static bool_t find_op(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
     node_t *node;
     bool_t ret = false;
@@ -167,6 +251,7 @@ static bool_t find_op(hashtable_t * ht, const lkey_t key)
     for (i = 0; i <= 1; i++) {
 	node = get_node(ht, i, key);
 	if (node->stat == OCC && node->key == key) {
+	    *getval = node->value;
 	    ret = true;
 	    break;
 	}
@@ -175,25 +260,181 @@ static bool_t find_op(hashtable_t * ht, const lkey_t key)
 }
 
 
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Find node '(key, val)' by the key from hashtable ht without locking, and write
+ * the val to *getval. Retry while the table is being resized or the key is being
+ * displaced.
+ * 
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int idx = versionIdx(key);
+    unsigned int seq, v;
+    bool_t ret;
+    int spin = 0;
+
+    while (1) {
+	seq = ht->seq;
+	v = ht->version[idx];
+	if (((seq | v) & 1) == 0) {
+	    RMB();
+	    ret = find_op(ht, key, getval);
+	    RMB();
+	    if (ht->version[idx] == v && ht->seq == seq)
+		return ret;
+	}
+	STATS_INC(STATS_RETRY);
+	if (++spin % SPIN_LIMIT == 0)
+	    sched_yield();
+    }
+}
+
 /*
  * bool_t find(hashtable_t * ht, const lkey_t key)
  *
- * Find node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ * Find node '(key, val)' by the key from hashtable ht without locking.
  * 
  * success : return true
  * failure(not found): return false
  */
 bool_t find(hashtable_t * ht, const lkey_t key)
 {
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht without locking. found[i] tells
+ * whether keys[i] is found, and if so, getval[i] is its value. Both candidate
+ * buckets of keys[i + BATCH_WIDTH] are prefetched while keys[i] is looked up, so
+ * that the misses of later keys overlap the current lookup. The old tables are
+ * kept until free_hashtable(), so prefetching during resize() is harmless.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    int i, ret = 0;
+
+    for (i = 0; i < n && i < BATCH_WIDTH; i++) {
+	PREFETCH(get_node(ht, 0, keys[i]));
+	PREFETCH(get_node(ht, 1, keys[i]));
+    }
+
+    for (i = 0; i < n; i++) {
+	if (i + BATCH_WIDTH < n) {
+	    PREFETCH(get_node(ht, 0, keys[i + BATCH_WIDTH]));
+	    PREFETCH(get_node(ht, 1, keys[i + BATCH_WIDTH]));
+	}
+	if ((found[i] = get(ht, keys[i], &getval[i])) == true)
+	    ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the node of 'key' under the lock. If the node exists, write its value
+ * before the update to *getval, and set it to 'val' (UPSERT), leave it
+ * (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD); the value is replaced by a
+ * single store, which the readers see either before or after. Otherwise add node
+ * '(key, val)', or '(key, fn(key))' for COMPUTE_IF_ABSENT, and write the new value
+ * to *getval.
+ *
+ * added : return true
+ * found, or the node could not be stored : return false
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    node_t *node;
     bool_t ret;
+    int i;
+
+    lock(ht);
+
+    for (i = 0; i <= 1; i++) {
+	node = get_node(ht, i, key);
+	if (node->stat == OCC && node->key == key) {
+	    *getval = node->value;
+	    if (op == UPSERT)
+		node->value = val;
+	    else if (op == FETCH_ADD)
+		node->value += val;
+	    unlock(ht);
+	    return false;
+	}
+    }
+
+    *getval = (op == COMPUTE_IF_ABSENT) ? fn(key) : val;
+    ret = insert_op(ht, key, *getval);
 
-    lock(ht->mtx);
-    ret = find_op(ht, key);
-    unlock(ht->mtx);
+    unlock(ht);
 
     return ret;
 }
 
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of the node of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() is called under
+ * the lock, so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
 
 /*
  * bool_t init_tables(hashtable_t * ht, const unsigned int table_size)
@@ -208,14 +449,14 @@ static bool_t init_tables(hashtable_t * ht, const unsigned int table_size)
     unsigned int i;
 
     if ((ht->table[0] =
-	 (node_t *) calloc(table_size, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+	 (node_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(node_t))) == NULL) {
+      elog("allocator_alloc_region error");
       return false;
     }
     if ((ht->table[1] =
-	 (node_t *) calloc(table_size, sizeof(node_t))) == NULL) {
-      elog("calloc error");
-	free(ht->table[0]);
+	 (node_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(node_t))) == NULL) {
+      elog("allocator_alloc_region error");
+	allocator_free_region(ht->allocator, ht->table[0]);
 	return false;
     }
 
@@ -224,16 +465,14 @@ static bool_t init_tables(hashtable_t * ht, const unsigned int table_size)
 	set_node(&ht->table[1][i], (lkey_t) NULL, (val_t) NULL, EMP);
     }
 
-    ht->setSize = 0;
-
     return true;
 }
 
 
-static void free_tables(node_t ** table)
+static void free_tables(allocator_t * a, node_t ** table)
 {
-    free(table[0]);
-    free(table[1]);
+    allocator_free_region(a, table[0]);
+    allocator_free_region(a, table[1]);
 }
 
 
@@ -262,10 +501,23 @@ hashtable_t *init_hashtable(const unsigned int size)
 	return NULL;
     }
     ht->table_size = table_size;
+    ht->allocator = get_allocator();
+    if (counter_init(&ht->setSize) != true) {
+	free(ht);
+	return NULL;
+    }
 
-    ht->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    ht->lock_kind = get_lock_kind();
+    if (lock_init(ht->lock_kind, &ht->lock) != true) {
+	counter_destroy(&ht->setSize);
+	free(ht);
+	return NULL;
+    }
+    ht->retired = NULL;
 
     if (init_tables(ht, table_size) != true) {
+	lock_destroy(ht->lock_kind, &ht->lock);
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
@@ -275,7 +527,17 @@ hashtable_t *init_hashtable(const unsigned int size)
 
 void free_hashtable(hashtable_t * ht)
 {
-    free_tables(ht->table);
+    retired_t *r;
+
+    while ((r = ht->retired) != NULL) {
+	ht->retired = r->next;
+	free_tables(ht->allocator, r->table);
+	free(r);
+    }
+    allocator_free_region(ht->allocator, ht->table[0]);
+    allocator_free_region(ht->allocator, ht->table[1]);
+    lock_destroy(ht->lock_kind, &ht->lock);
+    counter_destroy(&ht->setSize);
     free(ht);
 }
 
@@ -297,14 +559,32 @@ static void resize(hashtable_t * ht)
     node_t new_node;
     unsigned int i, j, k;
     node_t tmp;
+    retired_t *r;
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    if ((r = (retired_t *) calloc(1, sizeof(retired_t))) == NULL) {
+	elog("calloc error");
+	return;
+    }
+
+    ht->seq++;			/* odd: the readers wait */
+    WMB();
 
     ht->old_table_size = ht->table_size;
     ht->old_table[0] = ht->table[0];
     ht->old_table[1] = ht->table[1];
 
-    if (init_tables(ht, (ht->table_size * 2)) == false)
+    if (init_tables(ht, (ht->table_size * 2)) == false) {
+	ht->table[0] = ht->old_table[0];
+	ht->table[1] = ht->old_table[1];
+	free(r);
+	ht->seq++;
 	return;
+    }
 
+    /* table[] must be the new one before table_size grows. */
+    WMB();
     ht->table_size *= 2;
 
     for (i = 0; i <= 1; i++) {
@@ -313,19 +593,26 @@ static void resize(hashtable_t * ht)
 	    if (old_node->stat == OCC) {
 		set_node(&new_node, old_node->key, old_node->value, OCC);
 		for (k = 0; k < ht->table_size; k++) {
-		    if (swap_node(ht, 1, new_node, &tmp) == true) {
-			ht->setSize++;
+		    /* Moved, not added: setSize does not change. */
+		    if (swap_node(ht, 0, new_node, &tmp, false) == true)
 			break;
-		    } else if (swap_node(ht, 2, tmp, &new_node) == true) {
-			ht->setSize++;
+		    else if (swap_node(ht, 1, tmp, &new_node, true) == true)
 			break;
-		    }
 		}
 	    }
 	}
     }
 
-    free_tables(ht->old_table);
+    /* Keep the old tables until free_hashtable(), because find() may still be reading them. */
+    r->table[0] = ht->old_table[0];
+    r->table[1] = ht->old_table[1];
+    r->next = ht->retired;
+    ht->retired = r;
+
+    WMB();
+    ht->seq++;
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 
@@ -333,7 +620,7 @@ void show_hashtable(hashtable_t * ht)
 {
   unsigned int i, j;
 
-  lock(ht->mtx);
+  lock(ht);
   for (i = 0; i <= 1; i++) {
     printf("table[%d]\t", i);
     for (j = 0; j < ht->table_size; j++) {
@@ -346,9 +633,42 @@ void show_hashtable(hashtable_t * ht)
     }
     printf("\n");
   }
-  unlock(ht->mtx);
+  unlock(ht);
+}
+
+
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
 }
 
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t CuckooHash_ops = {"CuckooHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
 
 #ifdef _SINGLE_THREAD_
 
@@ -362,18 +682,25 @@ int main(int argc, char **argv)
     ht = init_hashtable(4);
 
     for (i = 0; i < 10; i++) {
-      printf("add i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
+    for (i = 0; i < 10; i++)
+      assert(find(ht, i) == true);
+    assert(find(ht, 10) == false);
+
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
     free_hashtable(ht);
 
     return 0;
@@ -3,6 +3,10 @@
  * 
  * "R.Pagh, F.F.Rodler, Cuchoo Hashing" http://cs.nyu.edu/courses/fall05/G22.3520-001/cuckoo-jour.pdf
  *
+ * Writers are serialized by ht->mtx. Readers take no lock (MemC3 style):
+ * a key being displaced keeps its version counter odd until it is stored
+ * again, so find() retries when the counter is odd or has changed.
+ *
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Nov.17
  * Copyright (C) 2009-2025  suzuki hironobu
  *
@@ -12,8 +16,12 @@
 #define _CUCKOO_HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 #define CH_DEFAULT_MAX_SIZE 10
+#define VERSION_SIZE 8192    /* number of version counters */
 
 typedef enum { EMP = 0, DEL = 1, OCC = 2 } node_stat;
 
@@ -24,24 +32,53 @@ typedef struct _node_t
   node_stat stat;       /* state */
 } node_t;
 
+typedef struct _retired_t {
+  node_t *table[2];                   /* tables replaced by resize() */
+  struct _retired_t *next;
+} retired_t;
+
 typedef struct _hashtable_t {
-    unsigned long int setSize;        /* number of nodes */
+  counter_t setSize;                  /* number of nodes */
+  allocator_t *allocator;             /* table allocator */
 
-  node_t *table[2];                   /* hashtable */
-  unsigned int table_size;            /* hashtable size(length) */
+  node_t * volatile table[2];         /* hashtable */
+  volatile unsigned int table_size;   /* hashtable size(length) */
 
   node_t *old_table[2];               /* temporary hashtable for keep the orijinal hashtable before resize */
   unsigned int old_table_size;        /* size of old_table[0] */
 
-  pthread_mutex_t mtx;                /* mutex lock */
+  lock_t lock;                        /* writers' lock */
+  lock_kind_t lock_kind;
+
+  volatile unsigned int seq;                   /* odd while resizing */
+  volatile unsigned int version[VERSION_SIZE]; /* odd while a key of this stripe is displaced */
+  retired_t *retired;                 /* old tables, kept until free_hashtable() */
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     CuckooHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     CuckooHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     CuckooHash_free_hashtable(__VA_ARGS__)
+#define add(...)                CuckooHash_add(__VA_ARGS__)
+#define delete(...)             CuckooHash_delete(__VA_ARGS__)
+#define find(...)               CuckooHash_find(__VA_ARGS__)
+#define get(...)                CuckooHash_get(__VA_ARGS__)
+#define upsert(...)             CuckooHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  CuckooHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          CuckooHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         CuckooHash_find_batch(__VA_ARGS__)
+
 void show_hashtable(hashtable_t *);
 hashtable_t *init_hashtable(const unsigned int);
 void free_hashtable(hashtable_t *);
 bool_t add(hashtable_t *, const lkey_t, const val_t);
 bool_t delete(hashtable_t *, const lkey_t, val_t *);
 bool_t find(hashtable_t *, const lkey_t);
+bool_t get(hashtable_t *, const lkey_t, val_t *);
+bool_t upsert(hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent(hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add(hashtable_t *, const lkey_t, const val_t);
+int find_batch(hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 
 #endif
@@ -1,5 +1,9 @@
 /* ---------------------------------------------------------------------------
  * (Chain) Hash Table 
+ *
+ * In RCU mode, find() takes no lock: writers still serialize on ht->lock, link
+ * nodes only after initializing them, copy the chains on resize(), and hand
+ * unlinked nodes and replaced tables to util/rcu for freeing after a grace period.
  * 
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Nov.17
  * Copyright (C) 2009-2025  suzuki hironobu
@@ -8,44 +12,54 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <inttypes.h>
 #include <pthread.h>
 
 #include "Hash.h"
+#include "registry.h"
+#include "stats.h"
 
 static bool_t add_node_op(list_t *, node_t *);
-static node_t *create_node(const lkey_t, const val_t);
-static void free_node(node_t *);
-static bool_t add_node(list_t *, const lkey_t, const val_t);
-static bool_t delete_node(list_t *, const lkey_t, val_t *);
-static bool_t find_node(list_t *, lkey_t);
-static bool_t init_list(list_t *);
-static bool_t init_bucket(hashtable_t *, const unsigned int);
-static void free_bucket(list_t *, const unsigned int);
+static node_t *create_node(allocator_t *, const lkey_t, const val_t);
+static void free_node(allocator_t *, node_t *);
+static bool_t add_node(allocator_t *, list_t *, const lkey_t, const val_t);
+static bool_t delete_node(hashtable_t *, list_t *, const lkey_t, val_t *);
+static bool_t find_node(list_t *, lkey_t, val_t *);
+static bool_t update_node(allocator_t *, list_t *, const lkey_t, const update_op_t,
+			  const val_t, compute_fn_t, val_t *);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static int find_batch_op(const table_t *, const lkey_t *, const int, val_t *, bool_t *);
+static bool_t init_list(allocator_t *, list_t *);
+static table_t *init_table(allocator_t *, const unsigned int);
+static void free_table(allocator_t *, table_t *);
+static void retire_node(void *, void *);
+static void retire_table(void *, void *);
 static bool_t policy(hashtable_t *);
 static void resize(hashtable_t *);
 static void show_list(const list_t *);
 static unsigned int hashCode(lkey_t, const hashtable_t *);
 
 
-#define lock(_mtx_)     pthread_mutex_lock(&(_mtx_))
-#define unlock(_mtx_)   pthread_mutex_unlock(&(_mtx_))
+#define lock(_ht_)     lock_acquire((_ht_)->lock_kind, &(_ht_)->lock)
+#define unlock(_ht_)   lock_release((_ht_)->lock_kind, &(_ht_)->lock)
 
 
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
     node_t *newNode;
-    if ((newNode = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((newNode = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
       return NULL;
     }
 
@@ -55,9 +69,9 @@ static node_t *create_node(const lkey_t key, const val_t val)
     return newNode;
 }
 
-static void free_node(node_t * node)
+static void free_node(allocator_t * a, node_t * node)
 {
-    free(node);
+    allocator_free(a, node);
 }
 
 /*
@@ -77,8 +91,9 @@ static bool_t add_node_op(list_t * l, node_t * newNode)
     curr = pred->next;
 
     if (curr == NULL) {
-	l->head->next = newNode;
 	newNode->next = NULL;
+	WMB();			/* publish the node only after it is initialized */
+	l->head->next = newNode;
     } else {
 
       while ((curr != NULL) && (curr->key < newNode->key)) {
@@ -88,6 +103,7 @@ static bool_t add_node_op(list_t * l, node_t * newNode)
 
 	if (curr == NULL || newNode->key != curr->key) {
 	    newNode->next = curr;
+	    WMB();
 	    pred->next = newNode;
 	} else
 	    ret = false;
@@ -97,22 +113,22 @@ static bool_t add_node_op(list_t * l, node_t * newNode)
 
 
 /*
- * bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+ * bool_t add_node(allocator_t * a, list_t * l, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)', and add to list 'l'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+static bool_t add_node(allocator_t * a, list_t * l, const lkey_t key, const val_t val)
 {
     node_t *newNode;
 
-    if ((newNode = create_node(key, val)) == NULL)
+    if ((newNode = create_node(a, key, val)) == NULL)
 	return false;
 
     if (add_node_op(l, newNode) != true) {
-	free_node(newNode);
+	free_node(a, newNode);
 	return false;
     }
     return true;
@@ -131,11 +147,11 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
   bool_t ret = true;
   unsigned int myBucket;
 
-  lock(ht->mtx);
+  lock(ht);
   myBucket = hashCode(key, ht);
   
-  if (add_node(&ht->bucket[myBucket], key, val) == true)
-    ht->setSize++;
+  if (add_node(ht->allocator, &ht->table->bucket[myBucket], key, val) == true)
+    counter_inc(&ht->setSize);
   else 
     ret = false;
   
@@ -144,21 +160,23 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
     fprintf (stdout, "Resized\n"); fflush(stdout);
   }
 
-  unlock(ht->mtx);
+  unlock(ht);
+  if (ht->rcu)
+    rcu_quiescent_state();
 
   return ret;
 }
 
 
 /*
- * bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+ * bool_t delete_node(hashtable_t * ht, list_t * l, const lkey_t key, val_t * getval)
  *
  * Delete node'(key, val)' by the key from list l, and write the val to *getval.
  *
  * success : return true
  * failure : return false
  */
-static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+static bool_t delete_node(hashtable_t * ht, list_t * l, const lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
 
@@ -173,10 +191,13 @@ static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
 	curr = curr->next;
     }
 
-    if ((key == curr->key) && (curr != NULL)) {
+    if ((curr != NULL) && (key == curr->key)) {
 	*getval = curr->value;
 	pred->next = curr->next;
-	free_node(curr);
+	if (ht->rcu)
+	    rcu_retire(&ht->retired, curr, retire_node);
+	else
+	    free_node(ht->allocator, curr);
     } else
 	return false;
 
@@ -197,83 +218,342 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
   bool_t ret = true;
   unsigned int  myBucket;
 
-  lock(ht->mtx);
+  lock(ht);
   myBucket = hashCode(key, ht);
 
-  if (delete_node(&ht->bucket[myBucket], key, getval) == true)
-    ht->setSize--;
+  if (delete_node(ht, &ht->table->bucket[myBucket], key, getval) == true)
+    counter_dec(&ht->setSize);
   else 
     ret = false;
 
-  unlock(ht->mtx);
+  unlock(ht);
+  if (ht->rcu)
+    rcu_quiescent_state();
   
   return ret;
 }
 
 /*
- * bool_t find_node(list_t * l, lkey_t key)
+ * bool_t find_node(list_t * l, lkey_t key, val_t * getval)
  *
- * Find node'(key, val)' by the key from list l.
+ * Find node'(key, val)' by the key from list l, and write the val to *getval.
  *
  * success(found) : return true
  * failure(not found) : return false
  */
-static bool_t find_node(list_t * l, lkey_t key)
+static bool_t find_node(list_t * l, lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
+    STATS_DECLARE(chain);
 
     pred = l->head;
     curr = pred->next;
 
     if (curr == NULL) {
+	STATS_RECORD(STATS_CHAIN, 0);
 	return false;
     } else {
       while ((curr != NULL) && (curr->key < key)) {
 	    pred = curr;
 	    curr = curr->next;
+	    STATS_COUNT(chain);
 	}
 
+      STATS_RECORD(STATS_CHAIN, chain);
       if ((curr == NULL) || (key != curr->key))
 	    return false;
     }
+    *getval = curr->value;
     return true;
 }
 
 
 /*
- * bool_t find(hashtable_t * ht, const lkey_t key)
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
  *
  * Find node'(key, val)' by the key from hashtable ht, and write the val to *getval.
+ * In RCU mode, load the table once and traverse it without the lock; a table
+ * replaced by resize() stays intact until this thread's next quiescent state.
  *
  * success : return true
  * failure(not found): return false
  */
-bool_t find(hashtable_t * ht, const lkey_t key)
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
   unsigned int myBucket;
+    table_t *t;
     bool_t ret;
 
-    lock(ht->mtx);
+    if (ht->rcu) {
+      rcu_read_lock();
+      t = ht->table;
+      ret = find_node(&t->bucket[key % t->size], key, getval);
+      rcu_read_unlock();
+      return ret;
+    }
+
+    lock(ht);
     myBucket = hashCode(key, ht);
-    ret = find_node(&ht->bucket[myBucket], key);
-    unlock(ht->mtx);
+    ret = find_node(&ht->table->bucket[myBucket], key, getval);
+    unlock(ht);
+
+    return ret;
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node'(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+
+/*
+ * bool_t update_node(allocator_t * a, list_t * l, const lkey_t key, const update_op_t op,
+ *                    const val_t val, compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the node of 'key' in list 'l' in one traversal. If the node exists,
+ * write its value before the update to *getval, and set it to 'val' (UPSERT), leave
+ * it (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD). Otherwise add node
+ * '(key, val)', or '(key, fn(key))' for COMPUTE_IF_ABSENT, and write the new value
+ * to *getval.
+ *
+ * added : return true
+ * found, or no memory : return false
+ */
+static bool_t update_node(allocator_t * a, list_t * l, const lkey_t key, const update_op_t op,
+			  const val_t val, compute_fn_t fn, val_t * getval)
+{
+    node_t *pred, *curr, *newNode;
+
+    pred = l->head;
+    curr = pred->next;
+
+    while ((curr != NULL) && (curr->key < key)) {
+	pred = curr;
+	curr = curr->next;
+    }
+
+    if ((curr != NULL) && (key == curr->key)) {
+	*getval = curr->value;
+	if (op == UPSERT)
+	    curr->value = val;	/* a single store; lock-free readers see either value */
+	else if (op == FETCH_ADD)
+	    curr->value += val;
+	return false;
+    }
+
+    *getval = (op == COMPUTE_IF_ABSENT) ? fn(key) : val;
+    if ((newNode = create_node(a, key, *getval)) == NULL)
+	return false;
+    newNode->next = curr;
+    WMB();			/* publish the node only after it is initialized */
+    pred->next = newNode;
+    return true;
+}
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * update_node() on the bucket of 'key', under the lock of the table.
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+  bool_t ret;
+
+  lock(ht);
+  if ((ret = update_node(ht->allocator, &ht->table->bucket[hashCode(key, ht)],
+			 key, op, val, fn, getval)) == true)
+    counter_inc(&ht->setSize);
+
+  if (policy(ht)) {
+    resize(ht);
+    fprintf (stdout, "Resized\n"); fflush(stdout);
+  }
+
+  unlock(ht);
+  if (ht->rcu)
+    rcu_quiescent_state();
+
+  return ret;
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of the node of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() is called under
+ * the lock, so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/* State of a lookup in flight in find_batch_op(). */
+typedef struct _lookup_t
+{
+  int no;              /* index of the key; -1 if this slot is idle */
+  node_t *curr;        /* prefetched node to examine next */
+  bool_t head;         /* 'curr' is the head of the chain, which holds no key */
+} lookup_t;
+
+/*
+ * int find_batch_op(const table_t * t, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Look up keys[0..n-1] in table 't', BATCH_WIDTH at a time. Each lookup in flight
+ * prefetches the next node of its chain and yields to the others, so that their
+ * cache misses overlap instead of being taken one by one.
+ */
+static int find_batch_op(const table_t * t, const lkey_t * keys, const int n,
+			 val_t * getval, bool_t * found)
+{
+    lookup_t s[BATCH_WIDTH];
+    lookup_t *l;
+    node_t *curr;
+    int i, next = 0, active = 0, ret = 0;
+
+    /* Hash all keys first, so that the bucket array is in cache when chains start. */
+    for (i = 0; i < n; i++)
+      PREFETCH(&t->bucket[keys[i] % t->size]);
+
+    for (i = 0; i < BATCH_WIDTH; i++) {
+      l = &s[i];
+      if (next < n) {
+	l->no = next++;
+	l->curr = t->bucket[keys[l->no] % t->size].head;
+	l->head = true;
+	PREFETCH(l->curr);
+	active++;
+      } else
+	l->no = -1;
+    }
+
+    while (0 < active) {
+      for (i = 0; i < BATCH_WIDTH; i++) {
+	l = &s[i];
+	if (l->no < 0)
+	  continue;
+
+	curr = l->curr;
+	if (l->head == true || curr->key < keys[l->no]) {
+	  if ((l->curr = curr->next) != NULL) {
+	    l->head = false;
+	    PREFETCH(l->curr);
+	    continue;
+	  }
+	  found[l->no] = false;
+	} else if (curr->key == keys[l->no]) {
+	  found[l->no] = true;
+	  getval[l->no] = curr->value;
+	  ret++;
+	} else
+	  found[l->no] = false;
+
+	/* This lookup is resolved; start the next one in its slot. */
+	if (next < n) {
+	  l->no = next++;
+	  l->curr = t->bucket[keys[l->no] % t->size].head;
+	  l->head = true;
+	  PREFETCH(l->curr);
+	} else {
+	  l->no = -1;
+	  active--;
+	}
+      }
+    }
+
+    return ret;
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value. The lock is taken once for the batch.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    int ret;
+
+    if (ht->rcu) {
+      rcu_read_lock();
+      ret = find_batch_op(ht->table, keys, n, getval, found);
+      rcu_read_unlock();
+      return ret;
+    }
+
+    lock(ht);
+    ret = find_batch_op(ht->table, keys, n, getval, found);
+    unlock(ht);
 
     return ret;
 }
 
 
 /*
- * bool_t *init_list(list_t *l)
+ * bool_t *init_list(allocator_t * a, list_t *l)
  *
  * Create node 'head', and add to list 'l'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t init_list(list_t * l)
+static bool_t init_list(allocator_t * a, list_t * l)
 {
-  if ((l->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((l->head = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return false;
   }
   l->head->next = NULL;
@@ -281,49 +561,72 @@ static bool_t init_list(list_t * l)
 }
 
 /*
- * bool_t init_bucket(hashtable_t * ht, const unsigned int table_size)
+ * table_t *init_table(allocator_t * a, const unsigned int table_size)
  *
- * Initialize all buckets of hashtable 'ht'.
+ * Create a table of 'table_size' empty buckets.
  *
- * success : return true
- * failure : return false
+ * success : return pointer to this table
+ * failure : return NULL
  */
-static bool_t init_bucket(hashtable_t * ht, const unsigned int table_size)
+static table_t *init_table(allocator_t * a, const unsigned int table_size)
 {
+    table_t *t;
     unsigned int i;
 
-    if ((ht->bucket =
-	 (list_t *) calloc(table_size, sizeof(list_t))) == NULL) {
-      elog("calloc error");
-      return false;
+    if ((t = (table_t *) allocator_alloc_region(a, sizeof(table_t)
+						 + table_size * sizeof(list_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      return NULL;
     }
+    t->size = table_size;
 
     for (i = 0; i < table_size; i++)
-      if (init_list(&ht->bucket[i]) == false)
-	return false;
+      if (init_list(a, &t->bucket[i]) == false) {
+	t->size = i;
+	free_table(a, t);
+	return NULL;
+      }
 
-    return true;
+    return t;
 }
 
+/* Free table 't' with all the nodes still linked to it. */
+static void free_table(allocator_t * a, table_t * t)
+{
+    node_t *curr, *next;
+    unsigned int i;
+
+    for (i = 0; i < t->size; i++) {
+	curr = t->bucket[i].head;
+	while (curr != NULL) {
+	    next = curr->next;
+	    allocator_free(a, curr);
+	    curr = next;
+	}
+    }
+    allocator_free_region(a, t);
+}
 
-static void free_bucket(list_t * bucket, const unsigned int table_size)
+/* Free functions called by util/rcu after a grace period. */
+static void retire_node(void *arg, void *node)
 {
-    int i;
-    for (i = 0; i < table_size; i++)
-	free(&(*bucket[i].head));
+    free_node(((hashtable_t *) arg)->allocator, (node_t *) node);
+}
 
-    free(bucket);
+static void retire_table(void *arg, void *table)
+{
+    free_table(((hashtable_t *) arg)->allocator, (table_t *) table);
 }
 
 /*
- * hashtable_t *init_hashtable(const unsigned int table_size)
+ * hashtable_t *init_hashtable(const unsigned int table_size, const bool_t rcu)
  *
- * Create hashtable size of 'table_size'.
+ * Create hashtable size of 'table_size'. If 'rcu' is true, find() runs without the lock.
  *
  * success : return pointer to this hashtable
  * failure : return NULL
  */
-hashtable_t *init_hashtable(const unsigned int table_size)
+hashtable_t *init_hashtable(const unsigned int table_size, const bool_t rcu)
 {
     hashtable_t *ht;
 
@@ -332,12 +635,24 @@ hashtable_t *init_hashtable(const unsigned int table_size)
       return NULL;
     }
 
-    ht->table_size = table_size;
-    ht->setSize = 0;
+    ht->allocator = get_allocator();
+    ht->rcu = rcu;
+    rcu_retire_init(&ht->retired, ht);
+    if (counter_init(&ht->setSize) != true) {
+	free(ht);
+	return NULL;
+    }
 
-    ht->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    ht->lock_kind = get_lock_kind();
+    if (lock_init(ht->lock_kind, &ht->lock) != true) {
+	counter_destroy(&ht->setSize);
+	free(ht);
+	return NULL;
+    }
 
-    if (init_bucket(ht, table_size) != true) {
+    if ((ht->table = init_table(ht->allocator, table_size)) == NULL) {
+	lock_destroy(ht->lock_kind, &ht->lock);
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
@@ -347,49 +662,68 @@ hashtable_t *init_hashtable(const unsigned int table_size)
 
 void free_hashtable(hashtable_t * ht)
 {
-    free_bucket(ht->bucket, ht->table_size);
+    rcu_retire_destroy(&ht->retired);
+    free_table(ht->allocator, ht->table);
+    lock_destroy(ht->lock_kind, &ht->lock);
+    counter_destroy(&ht->setSize);
     free(ht);
 }
 
 
 static bool_t policy(hashtable_t * ht)
 {
-    return ((int) (ht->setSize / ht->table_size) > 4 ? true : false);
+    return (counter_compare(&ht->setSize, (int64_t) ht->table->size * 4) > 0 ? true : false);
 }
 
 
+/*
+ * Double the table. In RCU mode, readers may still be traversing the old
+ * chains, so they are copied and left intact; the old table and its nodes are
+ * freed after a grace period. Otherwise the nodes are moved.
+ */
 static void resize(hashtable_t * ht)
 {
-    list_t *l;
-    node_t *pred, *curr;
-    unsigned int i, myBucket;
-
-
-    ht->old_table_size = ht->table_size;
-    ht->old_bucket = ht->bucket;
-
+    table_t *old = ht->table;
+    table_t *new;
+    node_t *pred, *curr, *node;
+    unsigned int i;
+    STATS_DECLARE(t0);
 
-    if (init_bucket(ht, ht->table_size * 2) == false)
+    STATS_TICKS(t0);
+    if ((new = init_table(ht->allocator, old->size * 2)) == NULL)
 	return;
 
-    ht->table_size *= 2;
-
-    for (i = 0; i < ht->old_table_size; i++) {
-	l = &ht->old_bucket[i];
-
-	pred = l->head;
+    for (i = 0; i < old->size; i++) {
+	pred = old->bucket[i].head;
 	curr = pred->next;
 	while (curr != NULL) {
-	  pred->next = curr->next;	/*    <==>  next = curr->next; pred->next = next; */
-	  
-	  myBucket = hashCode(curr->key, ht);
-	  add_node_op(&ht->bucket[myBucket], curr);
-	  
-	  curr = pred->next;
+	  if (ht->rcu) {
+	    if ((node = create_node(ht->allocator, curr->key, curr->value)) == NULL) {
+	      free_table(ht->allocator, new);
+	      return;
+	    }
+	    curr = curr->next;
+	  }
+	  else {
+	    node = curr;
+	    pred->next = curr->next;	/*    <==>  next = curr->next; pred->next = next; */
+	    curr = pred->next;
+	  }
+	  add_node_op(&new->bucket[node->key % new->size], node);
 	}
     }
 
-    free_bucket(ht->old_bucket, ht->old_table_size);
+    WMB();
+    ht->table = new;
+
+    if (ht->rcu) {
+      rcu_retire(&ht->retired, old, retire_table);
+      rcu_retire_flush(&ht->retired);
+    }
+    else
+      free_table(ht->allocator, old);
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 static void show_list(const list_t * l)
@@ -412,24 +746,57 @@ void show_hashtable(hashtable_t * ht)
 
     printf("hash_table:\n\t|\n");
 
-    lock(ht->mtx);
-    for (i = 0; i < ht->table_size; i++) {
+    lock(ht);
+    for (i = 0; i < ht->table->size; i++) {
 	printf("\t+[[%3u]]->", i);
-	show_list(&ht->bucket[i]);
+	show_list(&ht->table->bucket[i]);
     }
     printf("\n");
-    unlock(ht->mtx);
+    unlock(ht);
 }
 
 
 static unsigned int hashCode(lkey_t key, const hashtable_t * ht)
 {
-    return (key % ht->table_size);
+    return (key % ht->table->size);
 }
 
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4, false);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t Hash_ops = {"Hash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
 #ifdef _SINGLE_THREAD_
 
 hashtable_t *ht;
@@ -439,21 +806,24 @@ int main(int argc, char **argv)
     val_t getval;
     int i;
 
-    ht = init_hashtable(4);
+    ht = init_hashtable(4, false);
 
     for (i = 0; i < 10; i++) {
-      printf("add i = %d, setSize = %llu\n", i, ht->setSize);
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %llu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
     free_hashtable(ht);
 
     return 0;
@@ -10,6 +10,10 @@
 #define _HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
+#include "rcu.h"
 
 typedef struct _node_t
 {
@@ -24,25 +28,51 @@ typedef struct _list_t
   node_t *head;
 } list_t;
 
+/* Buckets and their number, published together so that readers see a consistent pair. */
+typedef struct _table_t
+{
+  unsigned int size;                /* number of buckets */
+  list_t bucket[];
+} table_t;
+
 typedef struct _hashtable_t
 {
-  unsigned long long int setSize;   /* number of nodes */
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* node allocator */
 
-  list_t *bucket;                   /* hashtable */
-  unsigned int table_size;          /* size of hashtable */
+  table_t * volatile table;         /* hashtable; resize() replaces it as a whole */
 
-  list_t *old_bucket;               /* temporary hashtable for keep the original hashtable before resize. */
-  unsigned int old_table_size;      /* size of old_bucket */
+  lock_t lock;                      /* lock of the whole table; only writers take it in RCU mode */
+  lock_kind_t lock_kind;
 
-  pthread_mutex_t mtx;
+  bool_t rcu;                       /* RCU mode: find() takes no lock */
+  rcu_retire_t retired;             /* RCU mode: nodes and tables waiting for a grace period */
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     Hash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     Hash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     Hash_free_hashtable(__VA_ARGS__)
+#define add(...)                Hash_add(__VA_ARGS__)
+#define delete(...)             Hash_delete(__VA_ARGS__)
+#define find(...)               Hash_find(__VA_ARGS__)
+#define get(...)                Hash_get(__VA_ARGS__)
+#define upsert(...)             Hash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  Hash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          Hash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         Hash_find_batch(__VA_ARGS__)
+
 void show_hashtable (hashtable_t *);
-hashtable_t * init_hashtable (const unsigned int);
+hashtable_t * init_hashtable (const unsigned int, const bool_t);
 void free_hashtable (hashtable_t *);
 bool_t add (hashtable_t *, const lkey_t, const val_t);
 bool_t delete (hashtable_t *, const lkey_t, val_t *);
 bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 
 #endif
@@ -0,0 +1,722 @@
+/* ---------------------------------------------------------------------------
+ * Concurrent Hopscotch Hash Table
+ *
+ * "Hopscotch Hashing" by M. Herlihy, N. Shavit, M. Tzafrir
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "HopscotchHash.h"
+#include "registry.h"
+#include "stats.h"
+
+static table_t *init_table(allocator_t *, const unsigned int);
+static void free_table(allocator_t *, table_t *);
+static int find_op(const table_t *, const unsigned int, const lkey_t);
+static bool_t find_closer_slot(hashtable_t *, table_t *, const unsigned int, unsigned int *);
+static bool_t add_op(hashtable_t *, table_t *, const unsigned int, const lkey_t, const val_t);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static void resize(hashtable_t *, table_t *);
+static unsigned int hashCode(lkey_t, const table_t *);
+
+
+#ifdef _X86_64_
+static inline bool_t cas(volatile lkey_t * addr, const lkey_t oldv, const lkey_t newv)
+{
+  lkey_t result;
+  __asm__ __volatile__("lock; cmpxchgq %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+#else
+static inline bool_t cas(volatile lkey_t * addr, const lkey_t oldv, const lkey_t newv)
+{
+  lkey_t result;
+  __asm__ __volatile__("lock; cmpxchgl %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+#endif
+
+
+#define lock(mtx)      pthread_mutex_lock(&(mtx))
+#define unlock(mtx)    pthread_mutex_unlock(&(mtx))
+#define trylock(mtx)   pthread_mutex_trylock(&(mtx))
+
+/* 'i' may run past the end of the table; the neighborhood wraps around. */
+#define getBucket(_t_, _i_)     (&(_t_)->bucket[(_i_) & ((_t_)->table_size - 1)])
+/* Each segment covers runs of HOP_RANGE consecutive buckets. */
+#define getSegment(_ht_, _t_, _i_)					\
+  (&(_ht_)->segment[(((_i_) & ((_t_)->table_size - 1)) / HOP_RANGE) & (NUM_SEGMENTS - 1)])
+
+
+/*
+ * int find_op(const table_t * t, const unsigned int home, const lkey_t key)
+ *
+ * Scan the neighborhood of 'home' for 'key'.
+ *
+ * found     : return the distance from 'home'
+ * not found : return -1
+ */
+static int find_op(const table_t * t, const unsigned int home, const lkey_t key)
+{
+    uint32_t hop = getBucket(t, home)->hop_info;
+    int i;
+
+    while (hop != 0) {
+      i = __builtin_ctz(hop);
+      if (getBucket(t, home + i)->key == key)
+	return i;
+      hop &= hop - 1;
+    }
+    return -1;
+}
+
+
+/*
+ * bool_t find_closer_slot(hashtable_t * ht, table_t * t, const unsigned int home, unsigned int *dist)
+ *
+ * The slot (home + *dist) is claimed by the caller. Move an entry whose home bucket
+ * lies within HOP_RANGE before that slot into it, and claim the slot it came from,
+ * which is closer to 'home'. If 'ht' is NULL, the table is not shared and no lock
+ * is taken.
+ *
+ * success : return true, and write the new distance to *dist
+ * failure : return false
+ */
+static bool_t find_closer_slot(hashtable_t * ht, table_t * t, const unsigned int home,
+			       unsigned int *dist)
+{
+    unsigned int free_idx = home + *dist;
+    unsigned int d, i, cand;
+    uint32_t hop;
+    bucket_t *cb, *from, *to;
+    segment_t *cseg = NULL;
+    bool_t locked;
+
+    to = getBucket(t, free_idx);
+
+    for (d = HOP_RANGE - 1; d > 0; d--) {
+      cand = free_idx - d;
+      cb = getBucket(t, cand);
+      if ((cb->hop_info & ((1U << d) - 1)) == 0)
+	continue;
+
+      locked = false;
+      if (ht != NULL) {
+	cseg = getSegment(ht, t, cand);
+	/*
+	 * The caller holds the segment of 'home'. Do not wait for another one,
+	 * to avoid deadlock with a writer that is doing the same thing.
+	 */
+	if (cseg != getSegment(ht, t, home)) {
+	  if (trylock(cseg->mtx) != 0)
+	    continue;
+	  locked = true;
+	}
+      }
+
+      if ((hop = cb->hop_info & ((1U << d) - 1)) != 0) {
+	i = __builtin_ctz(hop);
+	from = getBucket(t, cand + i);
+
+	to->value = from->value;
+	WMB();
+	to->key = from->key;
+	WMB();
+	cb->hop_info |= (1U << d);
+	if (ht != NULL) {
+	  cseg->timestamp++;
+	  WMB();
+	}
+	cb->hop_info &= ~(1U << i);
+	WMB();
+	from->key = BUSY_KEY;
+
+	*dist -= (d - i);
+
+	if (locked == true)
+	  unlock(cseg->mtx);
+	return true;
+      }
+
+      if (locked == true)
+	unlock(cseg->mtx);
+    }
+    return false;
+}
+
+
+/*
+ * bool_t add_op(hashtable_t * ht, table_t * t, const unsigned int home, const lkey_t key, const val_t val)
+ *
+ * Store '(key, val)' within the neighborhood of 'home'.
+ * The caller holds the segment of 'home' unless 'ht' is NULL.
+ *
+ * success : return true
+ * failure(no empty slot in reach; the table should grow) : return false
+ */
+static bool_t add_op(hashtable_t * ht, table_t * t, const unsigned int home,
+		     const lkey_t key, const val_t val)
+{
+    unsigned int dist;
+    bucket_t *b;
+
+    for (dist = 0; dist < ADD_RANGE && dist < t->table_size; dist++) {
+      b = getBucket(t, home + dist);
+      if (b->key == EMPTY_KEY && cas(&b->key, EMPTY_KEY, BUSY_KEY) == true)
+	break;
+    }
+    if (ht != NULL)
+      STATS_RECORD(STATS_PROBE, dist + 1);
+    if (dist == ADD_RANGE || dist == t->table_size)
+      return false;
+
+    while (HOP_RANGE <= dist) {
+      if (find_closer_slot(ht, t, home, &dist) != true) {
+	getBucket(t, home + dist)->key = EMPTY_KEY;
+	return false;
+      }
+    }
+
+    b = getBucket(t, home + dist);
+    b->value = val;
+    WMB();
+    b->key = key;
+    WMB();
+    getBucket(t, home)->hop_info |= (1U << dist);
+
+    return true;
+}
+
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the entry of 'key' with the segment of its home bucket locked.
+ * If the entry exists, write its value to *getval, and replace it with 'val' (UPSERT),
+ * leave it (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD); readers see the old or
+ * the new value. Otherwise store 'val', or fn(key) for COMPUTE_IF_ABSENT if fn is not
+ * NULL, and write it to *getval. fn() is called at most once, under the segment lock,
+ * so it must not access the table.
+ *
+ * added : return true
+ * found, or reserved key : return false
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    table_t *t;
+    segment_t *seg;
+    unsigned int home;
+    bucket_t *b;
+    val_t newval = val;
+    bool_t computed = false;
+    bool_t ret;
+    int i;
+
+    if (key == EMPTY_KEY || key == BUSY_KEY) {
+      elog("reserved key");
+      return false;
+    }
+
+    while (1) {
+      t = ht->table;
+      home = hashCode(key, t);
+      seg = getSegment(ht, t, home);
+
+      lock(seg->mtx);
+      if (t != ht->table) {
+	/* resize() executed meanwhile. */
+	unlock(seg->mtx);
+	STATS_INC(STATS_RETRY);
+	continue;
+      }
+
+      if ((i = find_op(t, home, key)) != -1) {
+	b = getBucket(t, home + i);
+	*getval = b->value;
+	if (op == UPSERT)
+	  b->value = val;
+	else if (op == FETCH_ADD)
+	  b->value += val;
+	unlock(seg->mtx);
+	return false;
+      }
+
+      if (op == COMPUTE_IF_ABSENT && fn != NULL && computed == false) {
+	newval = fn(key);
+	computed = true;
+      }
+      ret = add_op(ht, t, home, key, newval);
+      unlock(seg->mtx);
+
+      if (ret == true) {
+	*getval = newval;
+	counter_inc(&ht->setSize);
+	return true;
+      }
+      resize(ht, t);
+    }
+}
+
+/*
+ * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable 'ht'.
+ *
+ * success : return true
+ * failure(key already exists) : return false
+ */
+bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, COMPUTE_IF_ABSENT, val, NULL, &getval);
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval = 0;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval = 0;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/*
+ * bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Delete node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ *
+ * success : return true
+ * failure(key not found): return false
+ */
+bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    table_t *t;
+    segment_t *seg;
+    unsigned int home;
+    bucket_t *b;
+    int i;
+
+    while (1) {
+      t = ht->table;
+      home = hashCode(key, t);
+      seg = getSegment(ht, t, home);
+
+      lock(seg->mtx);
+      if (t == ht->table)
+	break;
+      unlock(seg->mtx);
+      STATS_INC(STATS_RETRY);
+    }
+
+    if ((i = find_op(t, home, key)) == -1) {
+      unlock(seg->mtx);
+      return false;
+    }
+
+    b = getBucket(t, home + i);
+    *getval = b->value;
+    getBucket(t, home)->hop_info &= ~(1U << i);
+    WMB();
+    b->key = EMPTY_KEY;
+
+    unlock(seg->mtx);
+    counter_dec(&ht->setSize);
+
+    return true;
+}
+
+
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Find node '(key, val)' by the key from hashtable ht without locking, and write
+ * the val to *getval. A hit is trusted if the slot still holds the key after its
+ * value was read; a miss only if no entry of the segment was moved and the table
+ * was not replaced while scanning.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    table_t *t;
+    segment_t *seg;
+    bucket_t *b;
+    unsigned int home, ts;
+    val_t val;
+    int i;
+
+    while (1) {
+      t = ht->table;
+      home = hashCode(key, t);
+      seg = getSegment(ht, t, home);
+
+      ts = seg->timestamp;
+      RMB();
+      if ((i = find_op(t, home, key)) != -1) {
+	b = getBucket(t, home + i);
+	val = b->value;
+	RMB();
+	if (b->key == key) {
+	  *getval = val;
+	  return true;
+	}
+	STATS_INC(STATS_RETRY);
+	continue;
+      }
+      RMB();
+      if (seg->timestamp == ts && t == ht->table)
+	return false;
+      STATS_INC(STATS_RETRY);
+    }
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node '(key, val)' by the key from hashtable ht without locking.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value. The home bucket of keys[i + BATCH_WIDTH]
+ * and its segment are prefetched while keys[i] is looked up, so that the misses of
+ * later keys overlap the current lookup.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    table_t *t = ht->table;
+    unsigned int home;
+    int i, ret = 0;
+
+    for (i = 0; i < n && i < BATCH_WIDTH; i++) {
+      home = hashCode(keys[i], t);
+      PREFETCH(getBucket(t, home));
+      PREFETCH(getSegment(ht, t, home));
+    }
+
+    for (i = 0; i < n; i++) {
+      if (i + BATCH_WIDTH < n) {
+	home = hashCode(keys[i + BATCH_WIDTH], t);
+	PREFETCH(getBucket(t, home));
+	PREFETCH(getSegment(ht, t, home));
+      }
+      if ((found[i] = get(ht, keys[i], &getval[i])) == true)
+	ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * void resize(hashtable_t * ht, table_t * t)
+ *
+ * Replace table 't' with a table twice as large, unless another thread has already
+ * done it. Hold all segment locks while rehashing.
+ */
+static void resize(hashtable_t * ht, table_t * t)
+{
+    table_t *newt;
+    bucket_t *b;
+    unsigned int i, size;
+    bool_t ok;
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    for (i = 0; i < NUM_SEGMENTS; i++)
+      lock(ht->segment[i].mtx);
+
+    if (ht->table != t) {
+      for (i = 0; i < NUM_SEGMENTS; i++)
+	unlock(ht->segment[i].mtx);
+      return;
+    }
+
+    size = t->table_size;
+    do {
+      size *= 2;
+      if ((newt = init_table(ht->allocator, size)) == NULL)
+	abort();
+
+      ok = true;
+      for (i = 0; ok == true && i < t->table_size; i++) {
+	b = &t->bucket[i];
+	if (b->key != EMPTY_KEY)
+	  ok = add_op(NULL, newt, hashCode(b->key, newt), b->key, b->value);
+      }
+      if (ok != true)
+	free_table(ht->allocator, newt);
+    } while (ok != true);
+
+    /* Keep the old table until free_hashtable(), because find() may still be reading it. */
+    newt->retired = t;
+    WMB();
+    ht->table = newt;
+
+    for (i = 0; i < NUM_SEGMENTS; i++)
+      unlock(ht->segment[i].mtx);
+
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
+    fprintf (stderr, "Resized\n");
+}
+
+
+static table_t *init_table(allocator_t * a, const unsigned int table_size)
+{
+    table_t *t;
+
+    if ((t = (table_t *) calloc(1, sizeof(table_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+    /* EMPTY_KEY and empty hop_info are all zero. */
+    if ((t->bucket = (bucket_t *) allocator_alloc_region(a, table_size * sizeof(bucket_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      free(t);
+      return NULL;
+    }
+    t->table_size = table_size;
+    t->retired = NULL;
+
+    return t;
+}
+
+static void free_table(allocator_t * a, table_t * t)
+{
+    allocator_free_region(a, t->bucket);
+    free(t);
+}
+
+
+/*
+ * hashtable_t *init_hashtable(const unsigned int size)
+ *
+ * Create hashtable of size (2^size).
+ *
+ * success : return pointer to this hashtable
+ * failure : return NULL
+ */
+hashtable_t *init_hashtable(const unsigned int size)
+{
+    hashtable_t *ht;
+    unsigned int i;
+
+    if ((ht = (hashtable_t *) calloc(1, sizeof(hashtable_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+
+    ht->allocator = get_allocator();
+    if ((ht->segment = (segment_t *) allocator_alloc_region(ht->allocator,
+							     NUM_SEGMENTS * sizeof(segment_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      free(ht);
+      return NULL;
+    }
+    for (i = 0; i < NUM_SEGMENTS; i++) {
+      ht->segment[i].mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+      ht->segment[i].timestamp = 0;
+    }
+
+    if ((ht->table = init_table(ht->allocator, 0x00000001 << size)) == NULL) {
+      allocator_free_region(ht->allocator, ht->segment);
+      free(ht);
+      return NULL;
+    }
+    if (counter_init(&ht->setSize) != true) {
+      free_table(ht->allocator, ht->table);
+      allocator_free_region(ht->allocator, ht->segment);
+      free(ht);
+      return NULL;
+    }
+
+    return ht;
+}
+
+void free_hashtable(hashtable_t * ht)
+{
+    table_t *t, *next;
+
+    for (t = ht->table; t != NULL; t = next) {
+      next = t->retired;
+      free_table(ht->allocator, t);
+    }
+    allocator_free_region(ht->allocator, ht->segment);
+    counter_destroy(&ht->setSize);
+    free(ht);
+}
+
+
+static unsigned int hashCode(lkey_t key, const table_t * t)
+{
+    uint64_t h = (uint64_t) key;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (unsigned int) (h & (t->table_size - 1));
+}
+
+
+void show_hashtable(hashtable_t * ht)
+{
+    table_t *t = ht->table;
+    unsigned int i;
+
+    for (i = 0; i < t->table_size; i++) {
+      if (t->bucket[i].key == EMPTY_KEY)
+	printf("[NiL]");
+      else
+	printf("[%3d]", (int) t->bucket[i].value);
+    }
+    printf("\n");
+}
+
+
+
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t HopscotchHash_ops = {"HopscotchHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
+#ifdef _SINGLE_THREAD_
+
+hashtable_t *ht;
+
+int main(int argc, char **argv)
+{
+    val_t getval;
+    int i;
+    int n = 40;
+
+    ht = init_hashtable(3);
+
+    for (i = 1; i <= n; i++) {
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      add(ht, i, i);
+      show_hashtable(ht);
+    }
+
+    for (i = 1; i <= n; i++)
+      assert(find(ht, i) == true);
+    assert(find(ht, n + 1) == false);
+
+    for (i = 1; i <= n; i++) {
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      delete(ht, i, &getval);
+      assert(getval == i);
+      show_hashtable(ht);
+    }
+
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
+    free_hashtable(ht);
+
+    return 0;
+}
+
+#endif
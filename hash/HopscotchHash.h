@@ -0,0 +1,94 @@
+/* ---------------------------------------------------------------------------
+ * Concurrent Hopscotch Hash Table
+ *
+ * "Hopscotch Hashing" by M. Herlihy, N. Shavit, M. Tzafrir
+ *
+ * Every entry is kept within HOP_RANGE slots of its home bucket, and the home
+ * bucket records which of those slots hold its entries in a hop bitmap. Writers
+ * lock the segment of the home bucket, and bring a far empty slot closer by
+ * moving entries within their own neighborhoods. Readers take no lock: they
+ * scan the hop bitmap, and retry a miss if the timestamp of the segment has
+ * changed, i.e. an entry of the segment has been moved in the meantime.
+ *
+ * Reserved words:
+ *   key : EMPTY_KEY (0) and BUSY_KEY (INTPTR_MIN) can not be stored.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _HOPSCOTCH_HASH_H_
+#define _HOPSCOTCH_HASH_H_
+
+#include "common.h"
+#include "counter.h"
+#include "alloc.h"
+
+#define EMPTY_KEY      ((lkey_t) 0)
+#define BUSY_KEY       ((lkey_t) INTPTR_MIN)   /* slot claimed by a writer */
+
+#define HOP_RANGE      32      /* neighborhood size, bits of hop_info */
+#define ADD_RANGE      512     /* maximum distance searched for an empty slot */
+#define NUM_SEGMENTS   1024    /* number of segment locks, independent of the table size */
+
+
+typedef struct _bucket_t
+{
+  volatile uint32_t hop_info;          /* bit i: slot (this + i) holds an entry of this bucket */
+  volatile lkey_t key;                 /* key */
+  volatile val_t value;                /* value */
+} bucket_t;
+
+
+typedef struct _segment_t
+{
+  pthread_mutex_t mtx;                 /* mutex lock */
+  volatile unsigned int timestamp;     /* incremented when an entry of this segment is moved */
+} __attribute__((aligned(CACHE_LINE_SIZE))) segment_t;
+
+
+typedef struct _table_t
+{
+  bucket_t *bucket;                    /* hashtable */
+  unsigned int table_size;             /* hashtable size(length), power of 2 */
+
+  struct _table_t *retired;            /* previous table, kept until free_hashtable() */
+} table_t;
+
+
+typedef struct _hashtable_t
+{
+  counter_t setSize;                   /* number of nodes */
+  allocator_t *allocator;              /* table allocator */
+
+  table_t * volatile table;            /* current table */
+  segment_t *segment;                  /* segment array (length = NUM_SEGMENTS) */
+} hashtable_t;
+
+
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     HopscotchHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     HopscotchHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     HopscotchHash_free_hashtable(__VA_ARGS__)
+#define add(...)                HopscotchHash_add(__VA_ARGS__)
+#define delete(...)             HopscotchHash_delete(__VA_ARGS__)
+#define find(...)               HopscotchHash_find(__VA_ARGS__)
+#define get(...)                HopscotchHash_get(__VA_ARGS__)
+#define upsert(...)             HopscotchHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  HopscotchHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          HopscotchHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         HopscotchHash_find_batch(__VA_ARGS__)
+
+void show_hashtable (hashtable_t *);
+hashtable_t * init_hashtable (const unsigned int);
+void free_hashtable (hashtable_t *);
+bool_t add (hashtable_t *, const lkey_t, const val_t);
+bool_t delete (hashtable_t *, const lkey_t, val_t *);
+bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
+
+#endif
@@ -0,0 +1,793 @@
+/* ---------------------------------------------------------------------------
+ * Lock-Free Open-Addressed Hash Table (linear probing)
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <assert.h>
+
+#include "LockFreeOpenAddressHash.h"
+#include "registry.h"
+#include "stats.h"
+
+static table_t *init_table(allocator_t *, const unsigned int);
+static void free_table(allocator_t *, table_t *);
+static bool_t policy(const table_t *);
+static void start_resize(hashtable_t *, table_t *);
+static table_t *help_resize(hashtable_t *, table_t *);
+static void copy_node(table_t *, const unsigned int);
+static node_t *claim_node(table_t *, const lkey_t);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static bool_t update_op(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+			compute_fn_t, val_t *);
+static bool_t delete_op(hashtable_t *, const lkey_t, val_t *);
+static bool_t get_op(hashtable_t *, const lkey_t, val_t *);
+static unsigned int hashCode(lkey_t, const table_t *);
+
+#define COPY_CHUNK  1024    /* number of slots a helper copies at a time */
+
+static volatile intptr_t live_tables = 0;   /* tables allocated and not freed yet, of all hashtables */
+
+
+#ifdef _X86_64_
+static inline bool_t cas(volatile intptr_t * addr, const intptr_t oldv, const intptr_t newv)
+{
+  intptr_t result;
+  __asm__ __volatile__("lock; cmpxchgq %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+
+static inline intptr_t fetch_and_add(volatile intptr_t * addr, intptr_t val)
+{
+  __asm__ __volatile__("lock; xaddq %0,%1"
+                       : "+r" (val), "+m" (*addr)
+                       :
+                       : "memory");
+  return val;
+}
+#else
+static inline bool_t cas(volatile intptr_t * addr, const intptr_t oldv, const intptr_t newv)
+{
+  intptr_t result;
+  __asm__ __volatile__("lock; cmpxchgl %1,%2"
+                       : "=a" (result)
+                       : "q" (newv), "m" (*addr), "0" (oldv)
+                       : "memory");
+  STATS_CAS_RESULT(result == oldv);
+  return ((result == oldv) ? true : false);
+}
+
+static inline intptr_t fetch_and_add(volatile intptr_t * addr, intptr_t val)
+{
+  __asm__ __volatile__("lock; xaddl %0,%1"
+                       : "+r" (val), "+m" (*addr)
+                       :
+                       : "memory");
+  return val;
+}
+#endif
+
+#define cas_ptr(_addr_, _old_, _new_)					\
+  cas((volatile intptr_t *)(_addr_), (intptr_t)(_old_), (intptr_t)(_new_))
+
+
+/*
+ * table_t *init_table(allocator_t * a, const unsigned int table_size)
+ *
+ * Create table size of 'table_size'. All key slots are EMPTY_KEY and all value slots are NOVALUE.
+ *
+ * success : return pointer to this table
+ * failure : return NULL
+ */
+static table_t *init_table(allocator_t * a, const unsigned int table_size)
+{
+    table_t *t;
+    unsigned int i;
+
+    if ((t = (table_t *) calloc(1, sizeof(table_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+
+    if ((t->bucket = (node_t *) allocator_alloc_region(a, table_size * sizeof(node_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      free(t);
+      return NULL;
+    }
+
+    for (i = 0; i < table_size; i++) {
+      t->bucket[i].key = EMPTY_KEY;
+      t->bucket[i].value = NOVALUE;
+    }
+
+    fetch_and_add(&live_tables, 1);
+    t->table_size = table_size;
+    t->used = 0;
+    t->next = NULL;
+    t->copy_idx = 0;
+    t->copy_done = 0;
+
+    return t;
+}
+
+static void free_table(allocator_t * a, table_t * t)
+{
+    allocator_free_region(a, t->bucket);
+    free(t);
+    fetch_and_add(&live_tables, -1);
+}
+
+static void retire_table(void *ht, void *t)
+{
+    free_table(((hashtable_t *) ht)->allocator, (table_t *) t);
+}
+
+
+static bool_t policy(const table_t * t)
+{
+    return ((t->table_size * 3 / 4) <= t->used ? true : false);
+}
+
+
+/*
+ * void start_resize(hashtable_t * ht, table_t * t)
+ *
+ * Install a new table as t->next. If another thread has already installed one, do nothing.
+ */
+static void start_resize(hashtable_t * ht, table_t * t)
+{
+    table_t *newt;
+    unsigned int table_size = t->table_size;
+
+    if (t->next != NULL)
+      return;
+
+    /* If most of the claimed slots are tombstones, only sweep them out. */
+    if (counter_compare(&ht->setSize, t->table_size / 4) >= 0)
+      table_size *= 2;
+
+    if ((newt = init_table(ht->allocator, table_size)) == NULL) {
+      elog("init_table() error");
+      abort();
+    }
+    if (cas_ptr(&t->next, NULL, newt) != true)
+      free_table(ht->allocator, newt);
+}
+
+
+/*
+ * node_t *claim_node(table_t * t, const lkey_t key)
+ *
+ * Return the slot of 'key' in table t, claiming an empty slot if 'key' is not in t.
+ * Only used while copying, so t never needs to resize here.
+ */
+static node_t *claim_node(table_t * t, const lkey_t key)
+{
+    unsigned int i, myBucket;
+    node_t *node;
+    lkey_t k;
+
+    myBucket = hashCode(key, t);
+    for (i = 0; i < t->table_size; i++) {
+      node = &t->bucket[myBucket];
+      if ((k = node->key) == EMPTY_KEY) {
+	if (cas(&node->key, EMPTY_KEY, key) == true) {
+	  fetch_and_add(&t->used, 1);
+	  return node;
+	}
+	k = node->key;
+      }
+      if (k == key)
+	return node;
+      myBucket = (myBucket + 1) & (t->table_size - 1);
+    }
+
+    elog("table overflow");
+    abort();
+}
+
+
+/*
+ * void copy_node(table_t * t, const unsigned int i)
+ *
+ * Copy the i-th slot of table t to t->next, and mark it MOVED.
+ * Each slot is copied by exactly one helper (see help_resize()), but a writer
+ * which has not noticed the resize yet may still update the slot; in that case
+ * copy the new value again.
+ */
+static void copy_node(table_t * t, const unsigned int i)
+{
+    node_t *node = &t->bucket[i];
+    node_t *newNode = NULL;
+    val_t v;
+
+    while (1) {
+      v = node->value;
+      assert(v != MOVED);
+
+      if (is_value(v)) {
+	if (newNode == NULL)
+	  newNode = claim_node(t->next, node->key);
+	newNode->value = v;
+      } else if (newNode != NULL)
+	newNode->value = TOMBSTONE;
+
+      if (cas(&node->value, v, MOVED) == true)
+	break;
+    }
+}
+
+
+/*
+ * table_t *help_resize(hashtable_t * ht, table_t * t)
+ *
+ * Copy slots of table t to t->next together with other threads,
+ * wait until the whole table has been copied, and return the new table.
+ */
+static table_t *help_resize(hashtable_t * ht, table_t * t)
+{
+    intptr_t i, begin, end;
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    while ((begin = fetch_and_add(&t->copy_idx, COPY_CHUNK)) < t->table_size) {
+      end = begin + COPY_CHUNK;
+      if (t->table_size < end)
+	end = t->table_size;
+      for (i = begin; i < end; i++)
+	copy_node(t, i);
+      fetch_and_add(&t->copy_done, end - begin);
+    }
+
+    while (t->copy_done < t->table_size)
+      sched_yield();
+
+    if (cas_ptr(&ht->table, t, t->next) == true) {
+      /* New operations start from t->next; those still in t hold up the grace period. */
+      pthread_mutex_lock(&ht->retire_mtx);
+      rcu_retire(&ht->retired, t, retire_table);
+      rcu_retire_flush(&ht->retired);
+      pthread_mutex_unlock(&ht->retire_mtx);
+      STATS_INC(STATS_RESIZE);
+      STATS_SINCE(STATS_RESIZE_TIME, t0);
+      fprintf (stderr, "Resized\n");
+    }
+
+    return t->next;
+}
+
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the slot of 'key' with a single CAS on its value. If 'key' has a
+ * value, write it to *getval, and replace it with 'val' (UPSERT), leave it
+ * (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD). Otherwise publish 'val', or
+ * fn(key) for COMPUTE_IF_ABSENT if fn is not NULL, and write it to *getval. Without
+ * fn, 'val' must be a value: publishing NOVALUE would add nothing.
+ *
+ * fn() may run even if another thread publishes a value for 'key' first; its
+ * result is then discarded.
+ *
+ * added : return true
+ * found, or reserved key or value : return false
+ */
+static bool_t update_op(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+			compute_fn_t fn, val_t * getval)
+{
+    unsigned int i, myBucket;
+    table_t *t;
+    node_t *node;
+    lkey_t k;
+    val_t v, newval = val;
+    bool_t computed = false;
+
+    if (key == EMPTY_KEY || (fn == NULL && is_value(val) != true)) {
+      elog("reserved key or value");
+      return false;
+    }
+
+    t = ht->table;
+
+ retry:
+    if (t->next != NULL) {
+      t = help_resize(ht, t);
+      goto retry;
+    }
+
+    myBucket = hashCode(key, t);
+    for (i = 0; i < t->table_size; i++) {
+      node = &t->bucket[myBucket];
+
+      if ((k = node->key) == EMPTY_KEY) {
+	if (policy(t) == true)
+	  break;
+	if (cas(&node->key, EMPTY_KEY, key) == true) {
+	  fetch_and_add(&t->used, 1);
+	  k = key;
+	}
+	else
+	  k = node->key;
+      }
+
+      if (k == key) {
+	STATS_RECORD(STATS_PROBE, i + 1);
+	while (1) {
+	  v = node->value;
+	  if (v == MOVED) {
+	    STATS_INC(STATS_RETRY);
+	    t = help_resize(ht, t);
+	    goto retry;
+	  }
+	  if (is_value(v)) {
+	    *getval = v;
+	    if (op == COMPUTE_IF_ABSENT
+		|| cas(&node->value, v, (op == UPSERT) ? val : v + val) == true)
+	      return false;
+	    continue;
+	  }
+	  if (op == COMPUTE_IF_ABSENT && fn != NULL && computed == false) {
+	    if (is_value(newval = fn(key)) != true) {
+	      elog("reserved value");
+	      return false;
+	    }
+	    computed = true;
+	  }
+	  if (cas(&node->value, v, newval) == true) {
+	    *getval = newval;
+	    counter_inc(&ht->setSize);
+	    return true;
+	  }
+	}
+      }
+
+      myBucket = (myBucket + 1) & (t->table_size - 1);
+    }
+
+    /* The table is (almost) full. */
+    STATS_INC(STATS_RETRY);
+    start_resize(ht, t);
+    t = help_resize(ht, t);
+    goto retry;
+}
+
+/* update_op() as an RCU read-side section; the tables it reaches stay allocated. */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    bool_t ret;
+
+    rcu_read_lock();
+    ret = update_op(ht, key, op, val, fn, getval);
+    rcu_read_unlock();
+    return ret;
+}
+
+/*
+ * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable 'ht'.
+ *
+ * success : return true
+ * failure(key already exists) : return false
+ */
+bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    if (is_value(val) != true) {
+      elog("reserved key or value");
+      return false;
+    }
+    return update(ht, key, COMPUTE_IF_ABSENT, val, NULL, &getval);
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval = NOVALUE;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, NOVALUE, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ * The sum must not be a reserved value.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval = 0;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/*
+ * bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Delete node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ * delete_op() does the work; delete() runs it as an RCU read-side section.
+ *
+ * success : return true
+ * failure(key not found): return false
+ */
+static bool_t delete_op(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int i, myBucket;
+    table_t *t;
+    node_t *node;
+    lkey_t k;
+    val_t v;
+
+    t = ht->table;
+
+ retry:
+    if (t->next != NULL) {
+      t = help_resize(ht, t);
+      goto retry;
+    }
+
+    myBucket = hashCode(key, t);
+    for (i = 0; i < t->table_size; i++) {
+      node = &t->bucket[myBucket];
+
+      if ((k = node->key) == EMPTY_KEY) {
+	if (node->value == MOVED) {
+	  STATS_INC(STATS_RETRY);
+	  t = help_resize(ht, t);
+	  goto retry;
+	}
+	STATS_RECORD(STATS_PROBE, i + 1);
+	return false;
+      }
+
+      if (k == key) {
+	STATS_RECORD(STATS_PROBE, i + 1);
+	while (1) {
+	  v = node->value;
+	  if (v == MOVED) {
+	    STATS_INC(STATS_RETRY);
+	    t = help_resize(ht, t);
+	    goto retry;
+	  }
+	  if (is_value(v) != true)
+	    return false;
+	  if (cas(&node->value, v, TOMBSTONE) == true) {
+	    *getval = v;
+	    counter_dec(&ht->setSize);
+	    return true;
+	  }
+	}
+      }
+
+      myBucket = (myBucket + 1) & (t->table_size - 1);
+    }
+
+    return false;
+}
+
+
+bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    bool_t ret;
+
+    rcu_read_lock();
+    ret = delete_op(ht, key, getval);
+    rcu_read_unlock();
+    return ret;
+}
+
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Find node '(key, val)' by the key from hashtable ht, and write the val to *getval.
+ * Never locks nor writes to the table; a slot marked MOVED is looked up again in the
+ * next table. get_op() does the lookup; get() runs it as an RCU read-side section.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+static bool_t get_op(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int i, myBucket;
+    table_t *t;
+    node_t *node;
+    lkey_t k;
+    val_t v;
+
+    t = ht->table;
+
+    while (t != NULL) {
+      myBucket = hashCode(key, t);
+      for (i = 0; i < t->table_size; i++) {
+	node = &t->bucket[myBucket];
+
+	if ((k = node->key) == EMPTY_KEY) {
+	  if (node->value == MOVED)
+	    break;
+	  STATS_RECORD(STATS_PROBE, i + 1);
+	  return false;
+	}
+
+	if (k == key) {
+	  if ((v = node->value) == MOVED)
+	    break;
+	  STATS_RECORD(STATS_PROBE, i + 1);
+	  if (is_value(v) != true)
+	    return false;
+	  *getval = v;
+	  return true;
+	}
+
+	myBucket = (myBucket + 1) & (t->table_size - 1);
+      }
+      t = t->next;
+    }
+
+    return false;
+}
+
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    bool_t ret;
+
+    rcu_read_lock();
+    ret = get_op(ht, key, getval);
+    rcu_read_unlock();
+    return ret;
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node '(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value. The home slot of keys[i + BATCH_WIDTH]
+ * in the current table is prefetched while keys[i] is probed, so that the misses
+ * of later keys overlap the current probe.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    table_t *t;
+    int i, ret = 0;
+
+    rcu_read_lock();
+    t = ht->table;
+    for (i = 0; i < n && i < BATCH_WIDTH; i++)
+      PREFETCH(&t->bucket[hashCode(keys[i], t)]);
+
+    for (i = 0; i < n; i++) {
+      if (i + BATCH_WIDTH < n)
+	PREFETCH(&t->bucket[hashCode(keys[i + BATCH_WIDTH], t)]);
+      if ((found[i] = get_op(ht, keys[i], &getval[i])) == true)
+	ret++;
+    }
+    rcu_read_unlock();
+
+    return ret;
+}
+
+
+/*
+ * hashtable_t *init_hashtable(const unsigned int size)
+ *
+ * Create hashtable size of (2^size).
+ *
+ * success : return pointer to this hashtable
+ * failure : return NULL
+ */
+hashtable_t *init_hashtable(const unsigned int size)
+{
+    hashtable_t *ht;
+
+    if ((ht = (hashtable_t *) calloc(1, sizeof(hashtable_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+
+    ht->allocator = get_allocator();
+    rcu_retire_init(&ht->retired, ht);
+    pthread_mutex_init(&ht->retire_mtx, NULL);
+    if (counter_init(&ht->setSize) != true) {
+      free(ht);
+      return NULL;
+    }
+    if ((ht->table = init_table(ht->allocator, 0x0001 << size)) == NULL) {
+      counter_destroy(&ht->setSize);
+      free(ht);
+      return NULL;
+    }
+
+    return ht;
+}
+
+void free_hashtable(hashtable_t * ht)
+{
+    rcu_retire_destroy(&ht->retired);
+    pthread_mutex_destroy(&ht->retire_mtx);
+    free_table(ht->allocator, ht->table);
+    counter_destroy(&ht->setSize);
+    free(ht);
+}
+
+
+static unsigned int hashCode(lkey_t key, const table_t * t)
+{
+    uintptr_t h = (uintptr_t) key;
+
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return (unsigned int) (h & (t->table_size - 1));
+}
+
+
+void show_hashtable(hashtable_t * ht)
+{
+    unsigned int i;
+    table_t *t = ht->table;
+    val_t v;
+
+    for (i = 0; i < t->table_size; i++) {
+      v = t->bucket[i].value;
+      if (t->bucket[i].key == EMPTY_KEY)
+	printf("[NiL]");
+      else if (v == TOMBSTONE || v == NOVALUE)
+	printf("[DeL]");
+      else if (v == MOVED)
+	printf("[MoV]");
+      else
+	printf("[%3d]", (int) v);
+    }
+    printf("\n");
+}
+
+
+
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t LockFreeOpenAddressHash_ops = {"LockFreeOpenAddressHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
+#ifdef _SINGLE_THREAD_
+
+hashtable_t *ht;
+
+int main(int argc, char **argv)
+{
+    val_t getval;
+    int i;
+
+    ht = init_hashtable(2);
+
+    for (i = 1; i <= 10; i++) {
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      add(ht, i, i);
+      show_hashtable(ht);
+    }
+
+    for (i = 1; i <= 10; i++)
+      assert(find(ht, i) == true);
+    assert(find(ht, 11) == false);
+
+    /* No value to publish: nothing is added. */
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+    assert(counter_read_exact(&ht->setSize) == 10);
+
+    for (i = 1; i <= 10; i++) {
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
+      delete(ht, i, &getval);
+      assert(getval == i);
+      show_hashtable(ht);
+    }
+
+    free_hashtable(ht);
+
+    /*
+     * Churn: distinct keys added and deleted fill a table with tombstones, and
+     * each sweep replaces it with a table of the same size. The replaced tables
+     * must be freed, not accumulated.
+     */
+    ht = init_hashtable(10);
+    for (i = 1; i <= 200000; i++) {
+      assert(add(ht, i, i) == true);
+      assert(delete(ht, i, &getval) == true);
+    }
+    printf("churn: table_size = %u, live tables = %ld\n", ht->table->table_size, (long) live_tables);
+    assert(ht->table->table_size == 1024);
+    assert(live_tables <= 3);
+    free_hashtable(ht);
+    assert(live_tables == 0);
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,94 @@
+/* ---------------------------------------------------------------------------
+ * Lock-Free Open-Addressed Hash Table (linear probing)
+ *
+ * Word-sized keys and values. A slot is claimed by CAS on its key word,
+ * and the value is published by CAS on its value word. Lookups never
+ * lock and never write. When the table fills up, all writers cooperate
+ * to copy the live entries into a table twice as large.
+ *
+ * Every operation runs as an RCU read-side section (see util/rcu.h), so a
+ * replaced table is freed after a grace period rather than kept until
+ * free_hashtable(): tables swept of tombstones by add/delete churn do not
+ * accumulate.
+ *
+ * Reserved words:
+ *   key   : EMPTY_KEY (0) can not be stored.
+ *   value : NOVALUE, TOMBSTONE and MOVED (INTPTR_MIN .. INTPTR_MIN+2) can not be stored.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _LOCKFREE_OPEN_ADDRESS_HASH_H_
+#define _LOCKFREE_OPEN_ADDRESS_HASH_H_
+
+#include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "rcu.h"
+
+#define EMPTY_KEY   ((lkey_t) 0)
+
+#define NOVALUE     ((val_t) INTPTR_MIN)        /* key claimed, value not published yet */
+#define TOMBSTONE   ((val_t) (INTPTR_MIN + 1))  /* deleted */
+#define MOVED       ((val_t) (INTPTR_MIN + 2))  /* copied to the next table */
+
+#define is_value(_v_)  ((_v_) > MOVED)
+
+typedef struct _node_t
+{
+  volatile lkey_t key;         /* key */
+  volatile val_t value;        /* value */
+} node_t;
+
+
+typedef struct _table_t
+{
+  node_t *bucket;                   /* hashtable */
+  unsigned int table_size;          /* hashtable size(length), power of 2 */
+
+  volatile intptr_t used;           /* number of claimed key slots */
+
+  struct _table_t * volatile next;  /* table being migrated to, or NULL */
+  volatile intptr_t copy_idx;       /* next slot to be copied by a helper */
+  volatile intptr_t copy_done;      /* number of copied slots */
+} table_t;
+
+
+typedef struct _hashtable_t
+{
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* table allocator */
+
+  table_t * volatile table;         /* current table */
+
+  rcu_retire_t retired;             /* replaced tables */
+  pthread_mutex_t retire_mtx;       /* serializes rcu_retire() */
+} hashtable_t;
+
+
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     LockFreeOpenAddressHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     LockFreeOpenAddressHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     LockFreeOpenAddressHash_free_hashtable(__VA_ARGS__)
+#define add(...)                LockFreeOpenAddressHash_add(__VA_ARGS__)
+#define delete(...)             LockFreeOpenAddressHash_delete(__VA_ARGS__)
+#define find(...)               LockFreeOpenAddressHash_find(__VA_ARGS__)
+#define get(...)                LockFreeOpenAddressHash_get(__VA_ARGS__)
+#define upsert(...)             LockFreeOpenAddressHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  LockFreeOpenAddressHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          LockFreeOpenAddressHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         LockFreeOpenAddressHash_find_batch(__VA_ARGS__)
+
+void show_hashtable (hashtable_t *);
+hashtable_t * init_hashtable (const unsigned int);
+void free_hashtable (hashtable_t *);
+bool_t add (hashtable_t *, const lkey_t, const val_t);
+bool_t delete (hashtable_t *, const lkey_t, val_t *);
+bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
+#endif
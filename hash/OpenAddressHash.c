@@ -12,15 +12,19 @@
 #include <assert.h>
 
 #include "OpenAddressHash.h"
+#include "registry.h"
+#include "stats.h"
 
 static bool_t init_bucket(hashtable_t *, const unsigned int);
-static void free_bucket(node_t *);
+static void free_bucket(allocator_t *, node_t *);
 static bool_t policy(hashtable_t *);
 static void resize(hashtable_t *);
 static void add_op(hashtable_t *, node_t *, const lkey_t, const val_t);
 static void del_op(hashtable_t *, node_t *);
 static void set_node(node_t *, const lkey_t, const val_t,
 		     const node_stat);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
 static unsigned int hashCode(lkey_t, unsigned int, const hashtable_t *);
 
 
@@ -44,7 +48,7 @@ add_op(hashtable_t * ht, node_t * node, const lkey_t key,
        const val_t val)
 {
     set_node(node, key, val, OCC);
-    ht->setSize++;
+    counter_inc(&ht->setSize);
 }
 
 
@@ -54,40 +58,19 @@ add_op(hashtable_t * ht, node_t * node, const lkey_t key,
  * Add node '(key, val)' to hashtable 'ht'.
  *
  * success : return true
- * failure : return false
+ * failure(key already exists, or table full) : return false
  */
 bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 {
-    unsigned int i, myBucket;
-    node_t *node;
-    bool_t ret = false;
-
-    lock(ht->mtx);
-
-    for (i = 0; i < ht->table_size; i++) {
-	myBucket = hashCode(key, i, ht);
-	node = &ht->bucket[myBucket];
-
-	if (node->stat != OCC) {
-	    add_op(ht, node, key, val);
-	    ret = true;
-	    break;
-	}
-    }
-
-    if (policy(ht)) {
-      resize(ht);
-      fprintf (stderr, "Resized\n");
-    }
-    unlock(ht->mtx);
+    val_t getval;
 
-    return ret;
+    return update(ht, key, COMPUTE_IF_ABSENT, val, NULL, &getval);
 }
 
 static void del_op(hashtable_t * ht, node_t * node)
 {
     set_node(node, (lkey_t) NULL, (lkey_t) NULL, DEL);
-    ht->setSize--;
+    counter_dec(&ht->setSize);
 }
 
 
@@ -120,6 +103,7 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 	    break;
 	}
     }
+    STATS_RECORD(STATS_PROBE, (i < ht->table_size) ? i + 1 : i);
 
     unlock(ht->mtx);
 
@@ -127,14 +111,14 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 }
 
 /*
- * bool_t find(hashtable_t * ht, const lkey_t key)
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
  *
  * Find node'(key, val)' by the key from hashtable ht, and write the val to *getval.
  *
  * success : return true
  * failure(not found): return false
  */
-bool_t find(hashtable_t * ht, const lkey_t key)
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
     unsigned int i, myBucket;
     node_t *node;
@@ -150,9 +134,180 @@ bool_t find(hashtable_t * ht, const lkey_t key)
 	    break;
 	} else if (node->stat != DEL && node->key == key) {
 	    ret = true;
+	    *getval = node->value;
 	    break;
 	}
     }
+    STATS_RECORD(STATS_PROBE, (i < ht->table_size) ? i + 1 : i);
+
+    unlock(ht->mtx);
+
+    return ret;
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node'(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the node of 'key' in one probe sequence, under the lock. If the node
+ * exists, write its value before the update to *getval, and set it to 'val' (UPSERT),
+ * leave it (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD). Otherwise store
+ * '(key, val)', or '(key, fn(key))' for COMPUTE_IF_ABSENT if fn is not NULL, in the
+ * first free slot of the sequence, and write the new value to *getval.
+ *
+ * added : return true
+ * found, or table full : return false
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    unsigned int i;
+    node_t *node, *slot = NULL;
+    bool_t ret = false;
+
+    lock(ht->mtx);
+
+    for (i = 0; i < ht->table_size; i++) {
+	node = &ht->bucket[hashCode(key, i, ht)];
+	if (node->stat == EMP) {
+	    if (slot == NULL)
+		slot = node;
+	    break;
+	} else if (node->stat == DEL) {
+	    if (slot == NULL)
+		slot = node;
+	} else if (node->key == key) {
+	    *getval = node->value;
+	    if (op == UPSERT)
+		node->value = val;
+	    else if (op == FETCH_ADD)
+		node->value += val;
+	    STATS_RECORD(STATS_PROBE, i + 1);
+	    unlock(ht->mtx);
+	    return false;
+	}
+    }
+    STATS_RECORD(STATS_PROBE, (i < ht->table_size) ? i + 1 : i);
+
+    if (slot != NULL) {
+	*getval = (op == COMPUTE_IF_ABSENT && fn != NULL) ? fn(key) : val;
+	add_op(ht, slot, key, *getval);
+	ret = true;
+    } else
+	elog("table full");
+
+    if (policy(ht)) {
+      resize(ht);
+      fprintf (stderr, "Resized\n");
+    }
+    unlock(ht->mtx);
+
+    return ret;
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of the node of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() is called under
+ * the lock, so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval = 0;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval = 0;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value. The lock is taken once for the
+ * batch, and the home slot of keys[i + BATCH_WIDTH] is prefetched while keys[i] is
+ * probed, so that the misses of later keys overlap the current probe.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    unsigned int i;
+    node_t *node;
+    int k, ret = 0;
+
+    lock(ht->mtx);
+
+    for (k = 0; k < n && k < BATCH_WIDTH; k++)
+	PREFETCH(&ht->bucket[hashCode(keys[k], 0, ht)]);
+
+    for (k = 0; k < n; k++) {
+	if (k + BATCH_WIDTH < n)
+	    PREFETCH(&ht->bucket[hashCode(keys[k + BATCH_WIDTH], 0, ht)]);
+	found[k] = false;
+	for (i = 0; i < ht->table_size; i++) {
+	    node = &ht->bucket[hashCode(keys[k], i, ht)];
+	    if (node->stat == EMP)
+		break;
+	    else if (node->stat != DEL && node->key == keys[k]) {
+		found[k] = true;
+		getval[k] = node->value;
+		ret++;
+		break;
+	    }
+	}
+    }
 
     unlock(ht->mtx);
 
@@ -173,22 +328,20 @@ static bool_t init_bucket(hashtable_t * ht, const unsigned int table_size)
     unsigned int i;
 
     if ((ht->bucket =
-	 (node_t *) calloc(table_size, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+	 (node_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(node_t))) == NULL) {
+      elog("allocator_alloc_region error");
       return false;
     }
 
     for (i = 0; i < table_size; i++)
 	set_node(&ht->bucket[i], (lkey_t) NULL, (val_t) NULL, EMP);
 
-    ht->setSize = 0;
-
     return true;
 }
 
-static void free_bucket(node_t * bucket)
+static void free_bucket(allocator_t * a, node_t * bucket)
 {
-    free(bucket);
+    allocator_free_region(a, bucket);
 }
 
 
@@ -211,10 +364,16 @@ hashtable_t *init_hashtable(const unsigned int size)
     }
 
     ht->table_size = table_size;
+    ht->allocator = get_allocator();
+    if (counter_init(&ht->setSize) != true) {
+	free(ht);
+	return NULL;
+    }
 
     ht->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
 
     if (init_bucket(ht, table_size) != true) {
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
@@ -224,22 +383,25 @@ hashtable_t *init_hashtable(const unsigned int size)
 
 void free_hashtable(hashtable_t * ht)
 {
-    free_bucket(ht->bucket);
+    free_bucket(ht->allocator, ht->bucket);
+    counter_destroy(&ht->setSize);
     free(ht);
 }
 
 
 static bool_t policy(hashtable_t * ht)
 {
-    //  return ((ht->table_size * 3 / 4) < ht->setSize ? true : false);
-    return ((ht->table_size * 4 / 5) < ht->setSize ? true : false);
+    //  return (counter_compare(&ht->setSize, ht->table_size * 3 / 4) > 0 ? true : false);
+    return (counter_compare(&ht->setSize, ht->table_size * 4 / 5) > 0 ? true : false);
 }
 
 static void resize(hashtable_t * ht)
 {
     node_t *old_node, *new_node;
     unsigned int i, j, myBucket;
+    STATS_DECLARE(t0);
 
+    STATS_TICKS(t0);
     ht->old_table_size = ht->table_size;
     ht->old_bucket = ht->bucket;
 
@@ -256,13 +418,16 @@ static void resize(hashtable_t * ht)
 		myBucket = hashCode(old_node->key, j, ht);
 		new_node = &ht->bucket[myBucket];
 		if (new_node->stat != OCC) {
-		    add_op(ht, new_node, old_node->key, old_node->value);
+		    /* Moved, not added: setSize does not change. */
+		    set_node(new_node, old_node->key, old_node->value, OCC);
 		    break;
 		}
 	    }
 	}
     }
-    free_bucket(ht->old_bucket);
+    free_bucket(ht->allocator, ht->old_bucket);
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 
@@ -292,6 +457,39 @@ void show_hashtable(hashtable_t * ht)
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t OpenAddressHash_ops = {"OpenAddressHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
 #ifdef _SINGLE_THREAD_
 
 hashtable_t *ht;
@@ -304,18 +502,21 @@ int main(int argc, char **argv)
     ht = init_hashtable(4);
 
     for (i = 0; i < 10; i++) {
-      printf("add i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
     free_hashtable(ht);
 
     return 0;
@@ -10,6 +10,8 @@
 #define _OPEN_ADDRESS_HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 typedef enum {EMP = 0, DEL = 1, OCC = 2} node_stat;
 
@@ -23,7 +25,8 @@ typedef struct _node_t
 
 typedef struct _hashtable_t
 {
-  unsigned long int setSize;        /* number of nodes */
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* table allocator */
 
   node_t *bucket;                   /* hashtable */
   unsigned int table_size;          /* hashtable size(length) */
@@ -35,10 +38,28 @@ typedef struct _hashtable_t
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     OpenAddressHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     OpenAddressHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     OpenAddressHash_free_hashtable(__VA_ARGS__)
+#define add(...)                OpenAddressHash_add(__VA_ARGS__)
+#define delete(...)             OpenAddressHash_delete(__VA_ARGS__)
+#define find(...)               OpenAddressHash_find(__VA_ARGS__)
+#define get(...)                OpenAddressHash_get(__VA_ARGS__)
+#define upsert(...)             OpenAddressHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  OpenAddressHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          OpenAddressHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         OpenAddressHash_find_batch(__VA_ARGS__)
+
 void show_hashtable (hashtable_t *);
 hashtable_t * init_hashtable (const unsigned int);
 void free_hashtable (hashtable_t *);
 bool_t add (hashtable_t *, const lkey_t, const val_t);
 bool_t delete (hashtable_t *, const lkey_t, val_t *);
 bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 #endif
@@ -0,0 +1,611 @@
+/* ---------------------------------------------------------------------------
+ * Partitioned Hash Table
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * The partitions are tables of Hash.c, called by their prefixed names. Hash.h is
+ * included first, with its hashtable_t renamed and its short names undefined, so
+ * that they do not clash with those of this table.
+ */
+#define hashtable_t Hash_hashtable_t
+#include "Hash.h"
+#undef hashtable_t
+#undef show_hashtable
+#undef init_hashtable
+#undef free_hashtable
+#undef add
+#undef delete
+#undef find
+#undef get
+#undef upsert
+#undef compute_if_absent
+#undef fetch_add
+#undef find_batch
+
+#include "PartitionedHash.h"
+#include "registry.h"
+
+static unsigned int serve(owner_t *, ring_t *, ring_t *);
+static void *owner_thread(void *);
+static client_t *get_client(hashtable_t *);
+static void release_client(void *);
+static void send_request(ring_t *, const op_t, const lkey_t, const val_t, compute_fn_t);
+static bool_t recv_response(ring_t *, val_t *);
+static bool_t call(hashtable_t *, const op_t, const lkey_t, val_t *, compute_fn_t);
+
+
+#ifdef _X86_64_
+#define cpu_relax()    __asm__ __volatile__("pause" ::: "memory")
+#else
+#define cpu_relax()    __asm__ __volatile__("" ::: "memory")
+#endif
+
+/* The client of the table the thread used last; those of the others are kept by their client_key. */
+static __thread hashtable_t *my_ht = NULL;
+static __thread client_t *my_client = NULL;
+
+
+/* Keys are mixed once; the upper half selects the partition. */
+static inline uint64_t mix(lkey_t key)
+{
+    uint64_t h = (uint64_t) key;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#define getPartition(_ht_, _key_)  ((unsigned int) ((mix(_key_) >> 32) % (_ht_)->owner_num))
+
+
+/*
+ * unsigned int serve(owner_t * o, ring_t * req, ring_t * resp)
+ *
+ * Execute all the requests in 'req' that fit in 'resp', and publish their
+ * responses at once. Return the number of requests executed.
+ */
+static unsigned int serve(owner_t * o, ring_t * req, ring_t * resp)
+{
+    unsigned int head, tail, n, i;
+    message_t *m, *r;
+
+    head = req->head;
+    if (req->cached_tail == head && (req->cached_tail = req->tail) == head)
+      return 0;
+    tail = req->cached_tail;
+    RMB();
+
+    /* A client never has more than RING_SIZE requests and responses in flight, so this rarely cuts. */
+    n = tail - head;
+    if (RING_SIZE - (resp->tail - resp->cached_head) < n) {
+      resp->cached_head = resp->head;
+      if (RING_SIZE - (resp->tail - resp->cached_head) < n)
+	n = RING_SIZE - (resp->tail - resp->cached_head);
+    }
+
+    for (i = 0; i < n; i++) {
+      m = &req->msg[(head + i) & (RING_SIZE - 1)];
+      r = &resp->msg[(resp->tail + i) & (RING_SIZE - 1)];
+      r->op = m->op;
+      r->key = m->key;
+      switch (m->op) {
+      case OP_ADD:
+	r->ret = Hash_add(o->table, m->key, m->value);
+	break;
+      case OP_DELETE:
+	r->ret = Hash_delete(o->table, m->key, &r->value);
+	break;
+      case OP_FIND:
+	r->ret = Hash_get(o->table, m->key, &r->value);
+	break;
+      case OP_UPSERT:
+	r->ret = Hash_upsert(o->table, m->key, m->value);
+	break;
+      case OP_COMPUTE_IF_ABSENT:
+	r->value = Hash_compute_if_absent(o->table, m->key, m->fn);
+	r->ret = true;
+	break;
+      case OP_FETCH_ADD:
+	r->value = Hash_fetch_add(o->table, m->key, m->value);
+	r->ret = true;
+	break;
+      }
+    }
+
+    WMB();
+    resp->tail += n;
+    req->head = head + n;
+    return n;
+}
+
+static void *owner_thread(void *arg)
+{
+    owner_t *o = (owner_t *) arg;
+    hashtable_t *ht = o->ht;
+    client_t *c;
+    unsigned int i, n, spin = 0;
+
+    while (ht->stop != true) {
+      n = 0;
+      for (i = 0; i < ht->client_num && i < MAX_CLIENTS; i++)
+	if ((c = ht->client[i]) != NULL)
+	  n += serve(o, &c->request[o->no], &c->response[o->no]);
+
+      if (n != 0)
+	spin = 0;
+      else if (++spin % SPIN_LIMIT == 0)
+	sched_yield();
+      else
+	cpu_relax();
+    }
+    return NULL;
+}
+
+
+/*
+ * client_t *get_client(hashtable_t * ht)
+ *
+ * Return the rings of the calling thread, registering it on its first call:
+ * it takes over the client of a thread that has exited if there is one, or
+ * a new slot otherwise.
+ */
+static client_t *get_client(hashtable_t * ht)
+{
+    client_t *c;
+    unsigned int no;
+
+    if (my_ht == ht)
+      return my_client;
+    if ((c = (client_t *) pthread_getspecific(ht->client_key)) != NULL)
+      goto end;
+
+    /* Every request of a released client has been answered, so its rings are idle. */
+    for (no = 0; no < ht->client_num && no < MAX_CLIENTS; no++)
+      if ((c = ht->client[no]) != NULL && c->used == false
+	  && __sync_bool_compare_and_swap(&c->used, false, true))
+	goto end;
+
+    if ((no = __sync_fetch_and_add(&ht->client_num, 1)) >= MAX_CLIENTS) {
+      elog("too many clients");
+      abort();
+    }
+    if ((c = (client_t *) calloc(1, sizeof(client_t))) == NULL) {
+      elog("calloc error");
+      abort();
+    }
+    /* Regions are zero-filled and aligned to CACHE_LINE_SIZE. */
+    if ((c->request = (ring_t *) allocator_alloc_region(ht->allocator, ht->owner_num * sizeof(ring_t))) == NULL
+	|| (c->response = (ring_t *) allocator_alloc_region(ht->allocator, ht->owner_num * sizeof(ring_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      abort();
+    }
+    c->used = true;
+
+    WMB();
+    ht->client[no] = c;
+
+ end:
+    pthread_setspecific(ht->client_key, c);
+    my_ht = ht;
+    my_client = c;
+    return c;
+}
+
+/* Destructor of client_key: release the client of an exiting thread for reuse. */
+static void release_client(void *arg)
+{
+    client_t *c = (client_t *) arg;
+
+    WMB();
+    c->used = false;
+}
+
+/* Put request '(op, key, value, fn)' on ring 'req'; the caller makes sure there is room. */
+static void send_request(ring_t * req, const op_t op, const lkey_t key, const val_t value,
+			 compute_fn_t fn)
+{
+    message_t *m;
+
+    m = &req->msg[req->tail & (RING_SIZE - 1)];
+    m->op = op;
+    m->key = key;
+    m->value = value;
+    m->fn = fn;
+    WMB();
+    req->tail++;
+}
+
+/* Wait for the next response on ring 'resp', and take it. */
+static bool_t recv_response(ring_t * resp, val_t * value)
+{
+    message_t *m;
+    unsigned int spin = 0;
+    bool_t ret;
+
+    while (resp->head == resp->tail) {
+      if (++spin % SPIN_LIMIT == 0)
+	sched_yield();
+      else
+	cpu_relax();
+    }
+    RMB();
+    m = &resp->msg[resp->head & (RING_SIZE - 1)];
+    ret = m->ret;
+    *value = m->value;
+    resp->head++;
+
+    return ret;
+}
+
+/*
+ * bool_t call(hashtable_t * ht, const op_t op, const lkey_t key, val_t * value, compute_fn_t fn)
+ *
+ * Send request '(op, key, *value, fn)' to the owner of 'key', and wait for the response.
+ */
+static bool_t call(hashtable_t * ht, const op_t op, const lkey_t key, val_t * value,
+		   compute_fn_t fn)
+{
+    client_t *c = get_client(ht);
+    unsigned int p = getPartition(ht, key);
+
+    /* The only outstanding request of this client to 'p' is this one, so there is room. */
+    send_request(&c->request[p], op, key, *value, fn);
+    return recv_response(&c->response[p], value);
+}
+
+
+/*
+ * bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable 'ht'.
+ *
+ * success : return true
+ * failure(key already exists) : return false
+ */
+bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t v = val;
+    return call(ht, OP_ADD, key, &v, NULL);
+}
+
+/*
+ * bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Delete node'(key, val)' by the key from hashtable ht, and write the val to *getval.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    *getval = 0;
+    return call(ht, OP_DELETE, key, getval, NULL);
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node'(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t find(hashtable_t * ht, const lkey_t key)
+{
+    val_t v = 0;
+    return call(ht, OP_FIND, key, &v, NULL);
+}
+
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+ *
+ * Find node'(key, val)' by the key from hashtable ht, and write the val to *getval.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    *getval = 0;
+    return call(ht, OP_FIND, key, getval, NULL);
+}
+
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t v = val;
+    return call(ht, OP_UPSERT, key, &v, NULL);
+}
+
+/*
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() runs on the
+ * owner thread of 'key', so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t v = 0;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    call(ht, OP_COMPUTE_IF_ABSENT, key, &v, fn);
+    return v;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t v = delta;
+
+    call(ht, OP_FETCH_ADD, key, &v, NULL);
+    return v;
+}
+
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value.
+ *
+ * Requests are sent until the ring to some owner is full, before any response is
+ * awaited, so that all owners work on the batch at once and each serves many
+ * requests per pass. Each owner answers in order, so the responses are taken in
+ * the order the requests were sent.
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    client_t *c = get_client(ht);
+    unsigned int p;
+    int i, j, k, ret = 0;
+
+    for (i = 0; i < n; i = j) {
+      for (j = i; j < n; j++) {
+	p = getPartition(ht, keys[j]);
+	if (c->request[p].tail - c->response[p].head == RING_SIZE)
+	  break;
+	send_request(&c->request[p], OP_FIND, keys[j], 0, NULL);
+      }
+      for (k = i; k < j; k++)
+	if ((found[k] = recv_response(&c->response[getPartition(ht, keys[k])], &getval[k])) == true)
+	  ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * hashtable_t *init_hashtable(const unsigned int size, const unsigned int owner_num)
+ *
+ * Create hashtable of 'owner_num' partitions, each of size 2^'size', and start
+ * their owner threads.
+ *
+ * success : return pointer to this hashtable
+ * failure : return NULL
+ */
+hashtable_t *init_hashtable(const unsigned int size, const unsigned int owner_num)
+{
+    hashtable_t *ht;
+    unsigned int i;
+
+    if ((ht = (hashtable_t *) calloc(1, sizeof(hashtable_t))) == NULL) {
+      elog("calloc error");
+      return NULL;
+    }
+
+    ht->allocator = get_allocator();
+    ht->owner_num = owner_num;
+    ht->stop = false;
+
+    if (pthread_key_create(&ht->client_key, release_client) != 0) {
+      elog("pthread_key_create error");
+      free(ht);
+      return NULL;
+    }
+
+    if ((ht->owner = (owner_t *) allocator_alloc_region(ht->allocator, owner_num * sizeof(owner_t))) == NULL) {
+      elog("allocator_alloc_region error");
+      pthread_key_delete(ht->client_key);
+      free(ht);
+      return NULL;
+    }
+
+    for (i = 0; i < owner_num; i++) {
+      ht->owner[i].ht = ht;
+      ht->owner[i].no = i;
+      if ((ht->owner[i].table = Hash_init_hashtable(0x0001 << size, false)) == NULL)
+	goto end;
+    }
+
+    for (i = 0; i < owner_num; i++)
+      if (pthread_create(&ht->owner[i].tid, NULL, owner_thread, (void *) &ht->owner[i]) != 0) {
+	elog("pthread_create error");
+	ht->stop = true;
+	while (0 < i--)
+	  pthread_join(ht->owner[i].tid, NULL);
+	goto end;
+      }
+
+    return ht;
+
+ end:
+    for (i = 0; i < owner_num; i++)
+      if (ht->owner[i].table != NULL)
+	Hash_free_hashtable(ht->owner[i].table);
+    allocator_free_region(ht->allocator, ht->owner);
+    pthread_key_delete(ht->client_key);
+    free(ht);
+    return NULL;
+}
+
+void free_hashtable(hashtable_t * ht)
+{
+    client_t *c;
+    unsigned int i;
+
+    /* No destructor runs for the threads that exit after this. */
+    pthread_key_delete(ht->client_key);
+
+    ht->stop = true;
+    for (i = 0; i < ht->owner_num; i++) {
+      pthread_join(ht->owner[i].tid, NULL);
+      Hash_free_hashtable(ht->owner[i].table);
+    }
+
+    for (i = 0; i < ht->client_num && i < MAX_CLIENTS; i++)
+      if ((c = ht->client[i]) != NULL) {
+	allocator_free_region(ht->allocator, c->request);
+	allocator_free_region(ht->allocator, c->response);
+	free(c);
+      }
+
+    if (my_ht == ht) {
+      my_ht = NULL;
+      my_client = NULL;
+    }
+    allocator_free_region(ht->allocator, ht->owner);
+    free(ht);
+}
+
+
+/* Without a request to the owners, the contents may be stale while clients run. */
+void show_hashtable(hashtable_t * ht)
+{
+    unsigned int i;
+
+    for (i = 0; i < ht->owner_num; i++) {
+      printf("partition %u (%lld keys):\n", i,
+	     (long long int) counter_read_exact(&ht->owner[i].table->setSize));
+      Hash_show_hashtable(ht->owner[i].table);
+    }
+}
+
+
+
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4, DEFAULT_OWNERS);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t PartitionedHash_ops = {"PartitionedHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
+#ifdef _SINGLE_THREAD_
+
+hashtable_t *ht;
+
+/* A short-lived client: registers, adds and deletes its key, and exits. */
+static void *client_thread(void *arg)
+{
+    lkey_t key = (lkey_t) (intptr_t) arg;
+    val_t getval;
+
+    if (add(ht, key, key) != true || delete(ht, key, &getval) != true || getval != key)
+      printf("ERROR: client %d\n", (int) key);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    val_t getval;
+    pthread_t tid;
+    int i;
+
+    ht = init_hashtable(2, 2);
+
+    for (i = 1; i < 20; i++) {
+      add(ht, i, i);
+      show_hashtable(ht);
+    }
+
+    for (i = 1; i < 20; i++)
+      if (find(ht, i) != true)
+	printf("ERROR: find %d\n", i);
+
+    for (i = 1; i < 20; i++) {
+      if (delete(ht, i, &getval) != true || getval != i)
+	printf("ERROR: delete %d\n", i);
+      show_hashtable(ht);
+    }
+
+    if (compute_if_absent(ht, 11, NULL) != 0 || find(ht, 11) != false)
+	printf("ERROR: compute_if_absent without fn\n");
+
+    /* No key is reserved. */
+    if (add(ht, 0, 1) != true || get(ht, 0, &getval) != true || getval != 1
+	|| delete(ht, 0, &getval) != true || find(ht, 0) != false)
+	printf("ERROR: key 0\n");
+
+    /* Exited clients release their slots: more threads than MAX_CLIENTS, one at a time. */
+    for (i = 1; i <= 2 * MAX_CLIENTS; i++) {
+      pthread_create(&tid, NULL, client_thread, (void *) (intptr_t) i);
+      pthread_join(tid, NULL);
+    }
+    if (ht->client_num != 2)
+	printf("ERROR: %u client slots for 2 clients at a time\n", ht->client_num);
+
+    free_hashtable(ht);
+
+    return 0;
+}
+
+#endif
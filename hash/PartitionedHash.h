@@ -0,0 +1,116 @@
+/* ---------------------------------------------------------------------------
+ * Partitioned Hash Table
+ *
+ * A shared-nothing, delegation-style hash table (cf. ffwd). The key space is
+ * partitioned across owner threads, and each partition is a chained hash
+ * table of Hash.c that only its owner touches, so its lock is never contended.
+ *
+ * add(), delete(), find() and the value operations do not touch the data: the calling thread (a
+ * client) writes a request to the ring from itself to the owner of the key,
+ * and waits for the response on the ring in the opposite direction. Every
+ * ring has exactly one producer and one consumer, so it needs no lock and no
+ * atomic instruction. An owner serves all pending requests of a client in one
+ * batch, and publishes the responses with a single index update.
+ *
+ * Clients register themselves on their first call; at most MAX_CLIENTS
+ * threads can use one table at a time. A thread's slot is released when it
+ * exits (by the destructor of a pthread key of the table) and is reused with
+ * its rings by the next thread that registers; the rings are never freed
+ * before the table, because an owner may be polling them.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _PARTITIONED_HASH_H_
+#define _PARTITIONED_HASH_H_
+
+#include <pthread.h>
+
+#include "common.h"
+#include "alloc.h"
+
+#define DEFAULT_OWNERS 2       /* number of partitions and owner threads */
+#define MAX_CLIENTS    256
+#define RING_SIZE      64      /* messages per ring; power of 2 */
+#define SPIN_LIMIT     64      /* idle spins before sched_yield() */
+
+typedef enum {OP_ADD = 0, OP_DELETE, OP_FIND, OP_UPSERT, OP_COMPUTE_IF_ABSENT, OP_FETCH_ADD} op_t;
+
+typedef struct _message_t
+{
+  op_t op;
+  bool_t ret;                          /* response */
+  lkey_t key;
+  val_t value;
+  compute_fn_t fn;                     /* OP_COMPUTE_IF_ABSENT only */
+} message_t;
+
+/* Single-producer/single-consumer ring. Each side caches the other's index. */
+typedef struct _ring_t
+{
+  volatile unsigned int tail;          /* written by the producer */
+  unsigned int cached_head;
+  char pad0[CACHE_LINE_SIZE - 2 * sizeof(unsigned int)];
+  volatile unsigned int head;          /* written by the consumer */
+  unsigned int cached_tail;
+  char pad1[CACHE_LINE_SIZE - 2 * sizeof(unsigned int)];
+  message_t msg[RING_SIZE];
+} __attribute__((aligned(CACHE_LINE_SIZE))) ring_t;
+
+typedef struct _client_t
+{
+  ring_t *request;                     /* one ring per owner: client -> owner */
+  ring_t *response;                    /* one ring per owner: owner -> client */
+  volatile bool_t used;                /* false once its thread has exited */
+} client_t;
+
+typedef struct _owner_t
+{
+  pthread_t tid;
+  struct _partitioned_hashtable_t *ht;
+  unsigned int no;                     /* partition number */
+  struct _hashtable_t *table;          /* the partition, a table of Hash.c (see Hash.h) */
+} __attribute__((aligned(CACHE_LINE_SIZE))) owner_t;
+
+typedef struct _partitioned_hashtable_t
+{
+  allocator_t *allocator;              /* rings allocator */
+
+  owner_t *owner;
+  unsigned int owner_num;
+
+  client_t * volatile client[MAX_CLIENTS];
+  volatile unsigned int client_num;    /* clients registered, or being registered */
+  pthread_key_t client_key;            /* client of each thread; releases it at exit */
+
+  volatile bool_t stop;                /* owners exit when true */
+} hashtable_t;
+
+
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_hashtable(...)     PartitionedHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     PartitionedHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     PartitionedHash_free_hashtable(__VA_ARGS__)
+#define add(...)                PartitionedHash_add(__VA_ARGS__)
+#define delete(...)             PartitionedHash_delete(__VA_ARGS__)
+#define find(...)               PartitionedHash_find(__VA_ARGS__)
+#define get(...)                PartitionedHash_get(__VA_ARGS__)
+#define upsert(...)             PartitionedHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  PartitionedHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          PartitionedHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         PartitionedHash_find_batch(__VA_ARGS__)
+
+void show_hashtable (hashtable_t *);
+hashtable_t * init_hashtable (const unsigned int, const unsigned int);
+void free_hashtable (hashtable_t *);
+bool_t add (hashtable_t *, const lkey_t, const val_t);
+bool_t delete (hashtable_t *, const lkey_t, val_t *);
+bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
+
+#endif
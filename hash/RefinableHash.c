@@ -13,35 +13,45 @@
 #include <assert.h>
 
 #include "RefinableHash.h"
+#include "registry.h"
+#include "stats.h"
 
 static bool_t add_node_op(list_t *, node_t *);
-static bool_t add_node(list_t *, const lkey_t, const val_t);
-static bool_t delete_node(list_t *, const lkey_t, val_t *);
-static bool_t find_node(list_t *, lkey_t);
-static bool list_init(list_t *);
+static bool_t add_node(allocator_t *, list_t *, const lkey_t, const val_t);
+static bool_t delete_node(allocator_t *, list_t *, const lkey_t, val_t *);
+static bool_t find_node(list_t *, lkey_t, val_t *);
+static bool_t update_node(allocator_t *, list_t *, const lkey_t, const update_op_t,
+			  const val_t, compute_fn_t, val_t *);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static bool list_init(allocator_t *, list_t *);
+static void free_bucket(hashtable_t *, list_t *, const unsigned int, const bool_t);
+static void retire_bucket(hashtable_t *, list_t *, const unsigned int);
 static bool_t init_bucket(hashtable_t *, const unsigned int,
 			const unsigned int);
 static bool_t policy(hashtable_t *);
 static void resize(hashtable_t *);
 
 
-#define lock(mtx)      pthread_mutex_lock((mtx))
-#define unlock(mtx)    pthread_mutex_unlock((mtx))
+#define lock(_ht_, _lock_)      rwlock_write_lock((_ht_)->lock_kind, (_lock_))
+#define unlock(_ht_, _lock_)    rwlock_write_unlock((_ht_)->lock_kind, (_lock_))
+#define read_lock(_lock_)       rwlock_read_lock((_lock_))
+#define read_unlock(_lock_)     rwlock_read_unlock((_lock_))
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
     node_t *newNode;
 
-    if ((newNode = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((newNode = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
 	return NULL;
     }
 
@@ -50,9 +60,9 @@ static node_t *create_node(const lkey_t key, const val_t val)
     return newNode;
 }
 
-static void free_node(node_t * node)
+static void free_node(allocator_t * a, node_t * node)
 {
-    free(node);
+    allocator_free(a, node);
 }
 
 /*
@@ -94,22 +104,22 @@ static bool_t add_node_op(list_t * l, node_t * newNode)
 
 
 /*
- * bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+ * bool_t add_node(allocator_t * a, list_t * l, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)', and add to list 'l'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+static bool_t add_node(allocator_t * a, list_t * l, const lkey_t key, const val_t val)
 {
     node_t *newNode;
 
-    if ((newNode = create_node(key, val)) == 0)
+    if ((newNode = create_node(a, key, val)) == 0)
 	return false;
 
     if (add_node_op(l, newNode) != true) {
-	free_node(newNode);
+	free_node(a, newNode);
 	return false;
     }
 
@@ -128,28 +138,25 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 {
     unsigned int myBucket, table_size;
     bool_t ret = false;
-    int retry = 2;
-
 
     do {
 	table_size = ht->table_size;
 	myBucket = hashCode(key, ht);	/* T1: */
-	lock(ht->bucket[myBucket].mtx);	/* T2: */
-
+	lock(ht, ht->bucket[myBucket].lock);	/* T2: */
+	STATS_STRIPE(myBucket);
 	if (table_size == ht->table_size)
-	{
-	  /* resize() executed between T1: and T2:. */
-	    if (add_node(&ht->bucket[myBucket], key, val) == true) {
-		ht->setSize++;
-		ret = true;
-		unlock(ht->bucket[myBucket].mtx);
-		break;
-	    }
-	}
+	    break;
+	/* resize() executed between T1: and T2:. */
+	unlock(ht, ht->bucket[myBucket].lock);
+	STATS_INC(STATS_RETRY);
+    }
+    while (1);
 
-	unlock(ht->bucket[myBucket].mtx);
+    if (add_node(ht->allocator, &ht->bucket[myBucket], key, val) == true) {
+	counter_inc(&ht->setSize);
+	ret = true;
     }
-    while (retry-- > 0);
+    unlock(ht, ht->bucket[myBucket].lock);
 
     if (policy(ht)) {
       resize(ht);
@@ -160,14 +167,14 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 
 
 /*
- * bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+ * bool_t delete_node(allocator_t * a, list_t * l, const lkey_t key, val_t * getval)
  *
  * Delete node'(key, val)' by the key from list l, and write the val to *getval.
  *
  * success : return true
  * failure : return false
  */
-static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+static bool_t delete_node(allocator_t * a, list_t * l, const lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
 
@@ -182,10 +189,10 @@ static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
 	curr = curr->next;
     }
 
-    if (key == curr->key && curr != NULL) {
+    if (curr != NULL && key == curr->key) {
 	*getval = curr->value;
 	pred->next = curr->next;
-	free_node(curr);
+	free_node(a, curr);
     } else
 	return false;
 
@@ -204,104 +211,295 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 {
     unsigned int myBucket, table_size;
     bool_t ret = false;
-    int retry = 2;
 
     do {
 	table_size = ht->table_size;
 	myBucket = hashCode(key, ht);	/* T1: */
-	lock(ht->bucket[myBucket].mtx);	/* T2: */
-
+	lock(ht, ht->bucket[myBucket].lock);	/* T2: */
+	STATS_STRIPE(myBucket);
 	if (table_size == ht->table_size)
-	{
-	  /* resize() executed between T1: and T2:. */
-	    if (delete_node(&ht->bucket[myBucket], key, getval) == true) {
-		ht->setSize--;
-		ret = true;
-		unlock(ht->bucket[myBucket].mtx);
-		break;
-	    }
-	}
-	unlock(ht->bucket[myBucket].mtx);
+	    break;
+	/* resize() executed between T1: and T2:. */
+	unlock(ht, ht->bucket[myBucket].lock);
+	STATS_INC(STATS_RETRY);
+    }
+    while (1);
+
+    if (delete_node(ht->allocator, &ht->bucket[myBucket], key, getval) == true) {
+	counter_dec(&ht->setSize);
+	ret = true;
     }
-    while (retry-- > 0);
+    unlock(ht, ht->bucket[myBucket].lock);
 
     return ret;
 }
 
 /*
- * bool_t find_node(list_t * l, lkey_t key)
+ * bool_t find_node(list_t * l, lkey_t key, val_t * getval)
  *
- * Find node'(key, val)' by the key from list l.
+ * Find node'(key, val)' by the key from list l, and write the val to *getval.
  *
  * success(found) : return true
  * failure(not found) : return false
  */
-static bool_t find_node(list_t * l, lkey_t key)
+static bool_t find_node(list_t * l, lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
+    STATS_DECLARE(chain);
 
     pred = l->head;
     curr = pred->next;
 
     if (curr == NULL) {
+	STATS_RECORD(STATS_CHAIN, 0);
 	return false;
     } else {
 
 	while (curr != NULL && curr->key < key) {
 	    pred = curr;
 	    curr = curr->next;
+	    STATS_COUNT(chain);
 	}
 
+	STATS_RECORD(STATS_CHAIN, chain);
 	if (curr == NULL || key != curr->key)
 	    return false;
     }
+    *getval = curr->value;
     return true;
 }
 
 /*
- * bool_t find(hashtable_t * ht, const lkey_t key)
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
  *
  * Find node'(key, val)' by the key from hashtable ht, and write the val to *getval.
  *
  * success : return true
  * failure(not found): return false
  */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int myBucket, table_size;
+    bool_t ret;
+
+    do {
+	table_size = ht->table_size;
+	myBucket = hashCode(key, ht);
+	read_lock(ht->bucket[myBucket].lock);
+	if (table_size == ht->table_size)
+	    break;
+	/* resize() executed while taking the lock. */
+	read_unlock(ht->bucket[myBucket].lock);
+    }
+    while (1);
+
+    ret = find_node(&ht->bucket[myBucket], key, getval);
+    read_unlock(ht->bucket[myBucket].lock);
+
+    return ret;
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node'(key, val)' by the key from hashtable ht.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
 bool_t find(hashtable_t * ht, const lkey_t key)
 {
-    unsigned int myBucket = hashCode(key, ht);
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value.
+ *
+ * The buckets of all keys are prefetched first; then, while keys[i] is looked up,
+ * the head of the chain of keys[i + BATCH_WIDTH] is prefetched. Prefetching reads
+ * the table without any lock: table_size is read before bucket, and never exceeds
+ * the size of the published bucket array, whose old versions are kept until
+ * free_hashtable().
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    unsigned int table_size = ht->table_size;
+    list_t *bucket;
+    int i, ret = 0;
+
+    RMB();
+    bucket = ht->bucket;
+
+    for (i = 0; i < n; i++)
+	PREFETCH(&bucket[keys[i] % table_size]);
+    for (i = 0; i < n && i < BATCH_WIDTH; i++)
+	PREFETCH(bucket[keys[i] % table_size].head);
+
+    for (i = 0; i < n; i++) {
+	if (i + BATCH_WIDTH < n)
+	    PREFETCH(bucket[keys[i + BATCH_WIDTH] % table_size].head);
+	if ((found[i] = get(ht, keys[i], &getval[i])) == true)
+	    ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * bool_t update_node(allocator_t * a, list_t * l, const lkey_t key, const update_op_t op,
+ *                    const val_t val, compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the node of 'key' in list 'l' in one traversal. If the node exists,
+ * write its value before the update to *getval, and set it to 'val' (UPSERT), leave
+ * it (COMPUTE_IF_ABSENT) or add 'val' to it (FETCH_ADD). Otherwise add node
+ * '(key, val)', or '(key, fn(key))' for COMPUTE_IF_ABSENT, and write the new value
+ * to *getval.
+ *
+ * added : return true
+ * found, or no memory : return false
+ */
+static bool_t update_node(allocator_t * a, list_t * l, const lkey_t key, const update_op_t op,
+			  const val_t val, compute_fn_t fn, val_t * getval)
+{
+    node_t *pred, *curr, *newNode;
+
+    pred = l->head;
+    curr = pred->next;
+
+    while (curr != NULL && curr->key < key) {
+	pred = curr;
+	curr = curr->next;
+    }
+
+    if (curr != NULL && key == curr->key) {
+	*getval = curr->value;
+	if (op == UPSERT)
+	    curr->value = val;
+	else if (op == FETCH_ADD)
+	    curr->value += val;
+	return false;
+    }
+
+    *getval = (op == COMPUTE_IF_ABSENT) ? fn(key) : val;
+    if ((newNode = create_node(a, key, *getval)) == NULL)
+	return false;
+    newNode->next = curr;
+    pred->next = newNode;
+    return true;
+}
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * update_node() on the bucket of 'key', under the lock of the bucket.
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    unsigned int myBucket, table_size;
     bool_t ret;
 
-    lock(ht->bucket[myBucket].mtx);
-    ret = find_node(&ht->bucket[myBucket], key);
-    unlock(ht->bucket[myBucket].mtx);
+    do {
+	table_size = ht->table_size;
+	myBucket = hashCode(key, ht);	/* T1: */
+	lock(ht, ht->bucket[myBucket].lock);	/* T2: */
+	STATS_STRIPE(myBucket);
+	if (table_size == ht->table_size)
+	    break;
+	/* resize() executed between T1: and T2:. */
+	unlock(ht, ht->bucket[myBucket].lock);
+	STATS_INC(STATS_RETRY);
+    }
+    while (1);
+
+    if ((ret = update_node(ht->allocator, &ht->bucket[myBucket], key, op, val, fn, getval)) == true)
+	counter_inc(&ht->setSize);
+    unlock(ht, ht->bucket[myBucket].lock);
 
+    if (ret == true && policy(ht)) {
+      resize(ht);
+      fprintf (stderr, "Resized\n");
+    }
     return ret;
 }
 
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of the node of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
 
 /*
- * bool_t *init_list(list_t *l)
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() is called under
+ * the bucket lock, so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/*
+ * bool_t *init_list(allocator_t * a, list_t *l)
  *
  * Create node 'head', and add to list 'l'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t list_init(list_t * l)
+static bool_t list_init(allocator_t * a, list_t * l)
 {
 
-  if ((l->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((l->head = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return false;
   }
   l->head->next = NULL;
-
-  /* Create l->mtx. Set l->mtx's value in init_bucket() */
-  if ((l->mtx = (pthread_mutex_t *) calloc(1, sizeof(pthread_mutex_t))) == NULL) {
-    elog("calloc error");
-    free (l->head);
-    return false;
-  }
+  /* l->lock is set in init_bucket(). */
 
   return true;
 }
@@ -320,46 +518,77 @@ init_bucket(hashtable_t * ht, const unsigned int init_table_size,
 	    const unsigned int new_table_size)
 {
     unsigned int i;
-#ifdef PTHREAD_MUTEX_FAST_NP
-    pthread_mutexattr_t mtx_attr;
-#endif
+    list_t *bucket;
 
-    if ((ht->bucket =
-	 (list_t *) calloc(new_table_size, sizeof(list_t))) == NULL) {
-      elog("calloc error");
+    if ((bucket =
+	 (list_t *) allocator_alloc_region(ht->allocator, new_table_size * sizeof(list_t))) == NULL) {
+      elog("allocator_alloc_region error");
       return false;
     }
 
     for (i = 0; i < new_table_size; i++) {
-      if (list_init(&ht->bucket[i]) != true)
+      if (list_init(ht->allocator, &bucket[i]) != true)
 	return false;
 
+      /* The buckets of the old table keep their locks, which threads may be waiting on. */
       if (i < init_table_size) {
-	ht->bucket[i].mtx = ht->old_bucket[i].mtx;
+	bucket[i].lock = ht->old_bucket[i].lock;
       }
       else {
-#ifdef PTHREAD_MUTEX_FAST_NP
-	pthread_mutexattr_init(&mtx_attr);
-	pthread_mutexattr_settype(&mtx_attr, PTHREAD_MUTEX_FAST_NP);
-	pthread_mutex_init(ht->bucket[i].mtx, mtx_attr);
-	pthread_mutexattr_destroy(&mtx_attr);
-#else
-	pthread_mutex_init(ht->bucket[i].mtx, NULL);
-#endif
+	if ((bucket[i].lock = (rwlock_t *) allocator_alloc(ht->allocator, sizeof(rwlock_t))) == NULL) {
+	  elog("allocator_alloc error");
+	  return false;
+	}
+	if (rwlock_init(ht->lock_kind, bucket[i].lock) != true)
+	  return false;
       }
     }
 
+    /* Publish the array only after it is filled; find() reads the locks without any lock. */
+    WMB();
+    ht->bucket = bucket;
+
     return true;
 }
 
-static void free_bucket(list_t * bucket, const unsigned int table_size)
+/*
+ * void free_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size, const bool_t with_lock)
+ *
+ * Free bucket array 'bucket'. Its locks are freed only if 'with_lock' is true,
+ * because the bucket array replaced by resize() shares them with the new one.
+ */
+static void free_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size,
+			const bool_t with_lock)
 {
     int i;
     for (i = 0; i < table_size; i++) {
-      pthread_mutex_destroy(bucket[i].mtx);
-      free(&(*bucket[i].head));
+      if (with_lock == true) {
+	rwlock_destroy(ht->lock_kind, bucket[i].lock);
+	allocator_free(ht->allocator, bucket[i].lock);
+      }
+      allocator_free(ht->allocator, bucket[i].head);
+    }
+    allocator_free_region(ht->allocator, bucket);
+}
+
+/*
+ * void retire_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size)
+ *
+ * Keep the bucket array replaced by resize() until free_hashtable(),
+ * because other threads may still be reading the locks through it.
+ */
+static void retire_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size)
+{
+    retired_t *r;
+
+    if ((r = (retired_t *) calloc(1, sizeof(retired_t))) == NULL) {
+      elog("calloc error");
+      abort();
     }
-    free(bucket);
+    r->bucket = bucket;
+    r->table_size = table_size;
+    r->next = ht->retired;
+    ht->retired = r;
 }
 
 
@@ -382,9 +611,15 @@ hashtable_t *init_hashtable(const unsigned int table_size)
     }
 
     ht->table_size = table_size;
-    ht->setSize = 0;
+    ht->allocator = get_allocator();
+    ht->lock_kind = get_lock_kind();
+    if (counter_init(&ht->setSize) != true) {
+	free(ht);
+	return NULL;
+    }
 
     if (init_bucket(ht, 0, table_size) != true) {
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
@@ -394,14 +629,22 @@ hashtable_t *init_hashtable(const unsigned int table_size)
 
 void free_hashtable(hashtable_t * ht)
 {
-    free_bucket(ht->bucket, ht->table_size);
+    retired_t *r;
+
+    while ((r = ht->retired) != NULL) {
+	ht->retired = r->next;
+	free_bucket(ht, r->bucket, r->table_size, false);
+	free(r);
+    }
+    free_bucket(ht, ht->bucket, ht->table_size, true);
+    counter_destroy(&ht->setSize);
     free(ht);
 }
 
 
 static bool_t policy(hashtable_t * ht)
 {
-    return ((int) (ht->setSize / ht->table_size) > 4 ? true : false);
+    return (counter_compare(&ht->setSize, (int64_t) ht->table_size * 4) > 0 ? true : false);
 }
 
 static void resize(hashtable_t * ht)
@@ -409,24 +652,27 @@ static void resize(hashtable_t * ht)
     list_t *l;
     node_t *pred, *curr;
     unsigned int i, myBucket, table_size;
+    STATS_DECLARE(t0);
 
+    STATS_TICKS(t0);
     table_size = ht->table_size;
     for (i = 0; i < table_size; i++)
-	lock(ht->bucket[i].mtx);
+	lock(ht, ht->bucket[i].lock);
 
     if (table_size != ht->table_size) {
-	for (i = 0; i < table_size; i++)
-	    unlock(ht->bucket[i].mtx);
+	for (i = table_size; 0 < i--; )
+	    unlock(ht, ht->bucket[i].lock);
 	return;
     }
 
     ht->old_table_size = ht->table_size;
     ht->old_bucket = ht->bucket;
 
-    if (init_bucket(ht, ht->table_size, ht->table_size * 2) == false)
+    if (init_bucket(ht, ht->table_size, ht->table_size * 2) == false) {
+	for (i = table_size; 0 < i--; )
+	    unlock(ht, ht->bucket[i].lock);
 	return;
-
-    ht->table_size *= 2;
+    }
 
     for (i = 0; i < ht->old_table_size; i++) {
 	l = &ht->old_bucket[i];
@@ -436,18 +682,26 @@ static void resize(hashtable_t * ht)
 	while (curr != NULL) {
 	  pred->next = curr->next;	/*      next = curr->next;      pred->next = next; */
 	  
-	  myBucket = hashCode(curr->key, ht);
+	  myBucket = (unsigned int) (curr->key % (table_size * 2));
 	  add_node_op(&ht->bucket[myBucket], curr);
 	  
 	  curr = pred->next;
 	}
     }
 
-    for (i = 0; i < ht->old_table_size; i++)
-	unlock(ht->bucket[i].mtx);
+    /*
+     * Only now, or threads could take the unheld locks of the new buckets
+     * and modify them while the nodes are moved.
+     */
+    ht->table_size *= 2;
 
-    free_bucket(ht->old_bucket, ht->old_table_size);
+    /* Before unlocking, or the next resize() may overwrite ht->old_bucket. */
+    retire_bucket(ht, ht->old_bucket, ht->old_table_size);
 
+    for (i = ht->old_table_size; 0 < i--; )
+	unlock(ht, ht->bucket[i].lock);
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 void show_list(const list_t * l)
@@ -487,6 +741,39 @@ unsigned int hashCode(lkey_t key, const hashtable_t * ht)
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t RefinableHash_ops = {"RefinableHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
 #ifdef _SINGLE_THREAD_
 
 hashtable_t *ht;
@@ -499,18 +786,21 @@ int main(int argc, char **argv)
     ht = init_hashtable(4);
 
     for (i = 0; i < 10; i++) {
-      printf("add i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
     free_hashtable(ht);
 
     return 0;
@@ -10,6 +10,9 @@
 #define _REFINABLE_HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _node_t
 {
@@ -22,12 +25,21 @@ typedef struct _node_t
 typedef struct _list_t
 {
   node_t *head;
-  pthread_mutex_t *mtx;
+  rwlock_t *lock;                   /* shared with the bucket of the same index after resize() */
 } list_t;
 
+typedef struct _retired_t
+{
+  list_t *bucket;                   /* bucket array replaced by resize() */
+  unsigned int table_size;
+  struct _retired_t *next;
+} retired_t;
+
 typedef struct _hashtable_t
 {
-  unsigned long int setSize;        /* number of nodes */
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* node allocator */
+  lock_kind_t lock_kind;            /* kind of the bucket locks */
 
   list_t *bucket;                   /* hashtable */
   unsigned int table_size;          /* hashtable size(length) */
@@ -35,9 +47,25 @@ typedef struct _hashtable_t
   list_t *old_bucket;               /* temporary hashtable for keep the original hashtable before resize */
   unsigned int old_table_size;      /* size of old_bucket */
 
+  retired_t *retired;               /* old bucket arrays, kept until free_hashtable() */
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_list(...)          RefinableHash_show_list(__VA_ARGS__)
+#define show_hashtable(...)     RefinableHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     RefinableHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     RefinableHash_free_hashtable(__VA_ARGS__)
+#define hashCode(...)           RefinableHash_hashCode(__VA_ARGS__)
+#define add(...)                RefinableHash_add(__VA_ARGS__)
+#define delete(...)             RefinableHash_delete(__VA_ARGS__)
+#define find(...)               RefinableHash_find(__VA_ARGS__)
+#define get(...)                RefinableHash_get(__VA_ARGS__)
+#define upsert(...)             RefinableHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  RefinableHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          RefinableHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         RefinableHash_find_batch(__VA_ARGS__)
+
 void show_list (const list_t *);
 void show_hashtable (hashtable_t *);
 hashtable_t * init_hashtable (const unsigned int);
@@ -45,7 +73,12 @@ void free_hashtable (hashtable_t *);
 unsigned int  hashCode (lkey_t, const hashtable_t *);
 bool_t add (hashtable_t *, const lkey_t, const val_t);
 bool_t delete (hashtable_t *, const lkey_t, val_t *);
-bool_t contains (hashtable_t *, const lkey_t);
+bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 
 
 #endif
@@ -8,18 +8,32 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <assert.h>
 #include <inttypes.h>
 #include <pthread.h>
 
 #include "StripedHash.h"
+#include "registry.h"
+#include "stats.h"
 
 static void lock(hashtable_t *, const unsigned int);
 static void unlock(hashtable_t *, const unsigned int);
+static void read_lock(hashtable_t *, const unsigned int);
+static void read_unlock(hashtable_t *, const unsigned int);
+static void write_begin(stripe_t *);
+static void write_end(stripe_t *);
+static node_t *create_node(allocator_t *, stripe_t *, const lkey_t, const val_t);
+static void free_node(stripe_t *, node_t *);
 static bool_t add_node_op(list_t *, node_t *);
-static bool_t add_node(list_t *, const lkey_t, const val_t);
-static bool_t delete_node(list_t *, const lkey_t, val_t *);
-static bool_t find_node(list_t *, lkey_t);
-static bool_t list_init(list_t *);
+static bool_t add_node(allocator_t *, stripe_t *, list_t *, const lkey_t, const val_t);
+static bool_t delete_node(stripe_t *, list_t *, const lkey_t, val_t *);
+static bool_t find_node(list_t *, lkey_t, val_t *);
+static bool_t find_node_optimistic(list_t *, lkey_t, val_t *, const stripe_t *, const unsigned int);
+static bool_t update_node(allocator_t *, stripe_t *, list_t *, const lkey_t, const update_op_t,
+			  const val_t, compute_fn_t, val_t *);
+static bool_t update(hashtable_t *, const lkey_t, const update_op_t, const val_t,
+		     compute_fn_t, val_t *);
+static bool_t list_init(allocator_t *, list_t *);
 static bool_t init_bucket(hashtable_t *, const unsigned int);
 static bool_t policy(hashtable_t *);
 static void resize(hashtable_t *);
@@ -27,43 +41,85 @@ static void resize(hashtable_t *);
 
 
 #define lockKey(ht, hashkey)   (hashkey % ht->lock_size)
+#define getStripe(ht, hashkey) (&ht->stripe[lockKey(ht, hashkey)])
+
+#define SEQ_RETRY     8    /* optimistic attempts before find() falls back to the stripe lock */
+#define SEQ_CHECK    32    /* chain steps between sequence checks in find_node_optimistic() */
 
 static void lock(hashtable_t * ht, const unsigned int hashkey)
 {
-    unsigned int key = lockKey(ht, hashkey);
-    pthread_mutex_lock(&ht->mtx[key]);
+    rwlock_write_lock(ht->lock_kind, &getStripe(ht, hashkey)->lock);
+    STATS_STRIPE(lockKey(ht, hashkey));
 }
 
 static void unlock(hashtable_t * ht, const unsigned int hashkey)
 {
-    unsigned int key = lockKey(ht, hashkey);
-    pthread_mutex_unlock(&ht->mtx[key]);
+    rwlock_write_unlock(ht->lock_kind, &getStripe(ht, hashkey)->lock);
+}
+
+static void read_lock(hashtable_t * ht, const unsigned int hashkey)
+{
+    rwlock_read_lock(&getStripe(ht, hashkey)->lock);
+}
+
+static void read_unlock(hashtable_t * ht, const unsigned int hashkey)
+{
+    rwlock_read_unlock(&getStripe(ht, hashkey)->lock);
+}
+
+/*
+ * Writers make the sequence counter of the stripe odd while they modify any bucket
+ * of it, so that find() can detect that a lock-free traversal overlapped a change.
+ */
+static void write_begin(stripe_t * st)
+{
+    st->seq++;
+    WMB();
+}
+
+static void write_end(stripe_t * st)
+{
+    WMB();
+    st->seq++;
 }
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, stripe_t * st, const lkey_t key, const val_t val)
  *
- * Create node '(key, val)'
+ * Create node '(key, val)', reusing a node deleted from stripe 'st' if any.
+ * Must be called with the lock of 'st' held.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, stripe_t * st, const lkey_t key, const val_t val)
 {
     node_t *newNode;
-    if ((newNode = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error")
+
+    if ((newNode = st->free_list) != NULL)
+      st->free_list = newNode->next;
+    else if ((newNode = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error")
       return NULL;
     }
 
     newNode->key = key;
     newNode->value = val;
+    newNode->next = NULL;
     return newNode;
 }
 
-static void free_node(node_t * node)
+/*
+ * void free_node(stripe_t * st, node_t * node)
+ *
+ * Nodes are never returned to the allocator while the table is alive, because find() may
+ * still be reading them without a lock. They are kept on the free list of the stripe
+ * instead, so a stale pointer always refers to a node; free_hashtable() frees them.
+ */
+static void free_node(stripe_t * st, node_t * node)
 {
-    free(node);
+    node->next = st->free_list;
+    st->free_list = node;
 }
 
 
@@ -105,22 +161,27 @@ static bool_t add_node_op(list_t * l, node_t * newNode)
 
 
 /*
- * bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+ * bool_t add_node(allocator_t * a, stripe_t * st, list_t * l, const lkey_t key, const val_t val)
  *
- * Create node '(key, val)', and add to list 'l'.
+ * Create node '(key, val)', and add to list 'l' which belongs to stripe 'st'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t add_node(list_t * l, const lkey_t key, const val_t val)
+static bool_t add_node(allocator_t * a, stripe_t * st, list_t * l, const lkey_t key, const val_t val)
 {
     node_t *newNode;
+    bool_t ret;
 
-    if ((newNode = create_node(key, val)) == 0)
+    if ((newNode = create_node(a, st, key, val)) == 0)
 	return false;
 
-    if (add_node_op(l, newNode) != true) {
-	free_node(newNode);
+    write_begin(st);
+    ret = add_node_op(l, newNode);
+    write_end(st);
+
+    if (ret != true) {
+	free_node(st, newNode);
 	return false;
     }
 
@@ -152,8 +213,8 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 	if (table_size == ht->table_size)
 	{
 	  /* resize() executed between T1: and T2:. */
-	    if (add_node(&ht->bucket[myBucket], key, val) == true) {
-		ht->setSize++;
+	    if (add_node(ht->allocator, getStripe(ht, myBucket), &ht->bucket[myBucket], key, val) == true) {
+		counter_inc(&ht->setSize);
 		ret = true;
 		unlock(ht, myBucket);
 		break;
@@ -173,14 +234,15 @@ bool_t add(hashtable_t * ht, const lkey_t key, const val_t val)
 
 
 /*
- * bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+ * bool_t delete_node(stripe_t * st, list_t * l, const lkey_t key, val_t * getval)
  *
- * Delete node '(key, val)' by the key from list l, and write the val to *getval.
+ * Delete node '(key, val)' by the key from list l which belongs to stripe 'st',
+ * and write the val to *getval.
  *
  * success : return true
  * failure : return false
  */
-static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
+static bool_t delete_node(stripe_t * st, list_t * l, const lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
 
@@ -195,10 +257,12 @@ static bool_t delete_node(list_t * l, const lkey_t key, val_t * getval)
 	curr = curr->next;
     }
 
-    if (key == curr->key && curr != NULL) {
+    if (curr != NULL && key == curr->key) {
 	*getval = curr->value;
+	write_begin(st);
 	pred->next = curr->next;
-	free_node(curr);
+	write_end(st);
+	free_node(st, curr);
     } else
 	return false;
 
@@ -229,8 +293,8 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 	if (table_size == ht->table_size)
 	{
 	  /* resize() executed between T1: and T2:. */
-	    if (delete_node(&ht->bucket[myBucket], key, getval) == true) {
-		ht->setSize--;
+	    if (delete_node(getStripe(ht, myBucket), &ht->bucket[myBucket], key, getval) == true) {
+		counter_dec(&ht->setSize);
 		ret = true;
 		unlock(ht, myBucket);
 		break;
@@ -245,69 +309,325 @@ bool_t delete(hashtable_t * ht, const lkey_t key, val_t * getval)
 
 
 /*
- * bool_t find_node(list_t * l, lkey_t key)
+ * bool_t find_node(list_t * l, lkey_t key, val_t * getval)
  *
- * Find node '(key, val)' by the key from list l.
+ * Find node '(key, val)' by the key from list l, and write the val to *getval.
  *
  * success(found) : return true
  * failure(not found) : return false
  */
-static bool_t find_node(list_t * l, lkey_t key)
+static bool_t find_node(list_t * l, lkey_t key, val_t * getval)
 {
     node_t *pred, *curr;
+    STATS_DECLARE(chain);
 
     pred = l->head;
     curr = pred->next;
 
     if (curr == NULL) {
+	STATS_RECORD(STATS_CHAIN, 0);
 	return false;
     } else {
 
 	while (curr != NULL && curr->key < key) {
 	    pred = curr;
 	    curr = curr->next;
+	    STATS_COUNT(chain);
 	}
 
+	STATS_RECORD(STATS_CHAIN, chain);
 	if (curr == NULL || key != curr->key)
 	    return false;
     }
+    *getval = curr->value;
     return true;
 }
 
 
 /*
- * bool_t find(hashtable_t * ht, const lkey_t key)
+ * bool_t find_node_optimistic(list_t * l, lkey_t key, val_t * getval,
+ *                             const stripe_t * st, const unsigned int seq)
+ *
+ * Same as find_node(), but without the lock of stripe 'st'. Nodes may be unlinked and
+ * reused under us, so give up as soon as the sequence counter of 'st' is not 'seq'
+ * any more; the caller validates the result against the counter anyway.
+ */
+static bool_t find_node_optimistic(list_t * l, lkey_t key, val_t * getval,
+				   const stripe_t * st, const unsigned int seq)
+{
+    node_t *curr;
+    int step = 0;
+
+    curr = l->head->next;
+
+    while (curr != NULL && curr->key < key) {
+	curr = curr->next;
+	if (++step % SEQ_CHECK == 0 && st->seq != seq)
+	    return false;
+    }
+    STATS_RECORD(STATS_CHAIN, step);
+
+    if (curr == NULL || key != curr->key)
+	return false;
+    *getval = curr->value;
+    return true;
+}
+
+
+/*
+ * bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
  *
  * Find node'(key, val)' by the key from hashtable ht, and write the val to *getval.
  *
+ * Readers do not take the stripe lock: they read the sequence counter of the stripe,
+ * traverse the chain, and retry if the counter has changed in the meantime.
+ * After SEQ_RETRY failures, fall back to the stripe lock in shared mode.
+ *
+ * success : return true
+ * failure(not found): return false
+ */
+bool_t get(hashtable_t * ht, const lkey_t key, val_t * getval)
+{
+    unsigned int myBucket, table_size, seq;
+    list_t *bucket;
+    stripe_t *st;
+    bool_t ret;
+    int retry;
+
+    for (retry = 0; retry < SEQ_RETRY; retry++) {
+	table_size = ht->table_size;
+	bucket = ht->bucket;
+	myBucket = (unsigned int) (key % table_size);
+	st = getStripe(ht, myBucket);
+
+	if (((seq = st->seq) & 1) != 0)
+	    continue;
+	RMB();
+	if (table_size != ht->table_size || bucket != ht->bucket)
+	    continue;	/* resize() executed while reading the table. */
+
+	ret = find_node_optimistic(&bucket[myBucket], key, getval, st, seq);
+	RMB();
+	if (st->seq == seq)
+	    return ret;
+	STATS_INC(STATS_RETRY);
+    }
+
+    do {
+	table_size = ht->table_size;
+	myBucket = hashCode(key, ht);
+	read_lock(ht, myBucket);
+	if (table_size == ht->table_size)
+	    break;
+	read_unlock(ht, myBucket);
+    }
+    while (1);
+
+    ret = find_node(&ht->bucket[myBucket], key, getval);
+    read_unlock(ht, myBucket);
+
+    return ret;
+}
+
+/*
+ * bool_t find(hashtable_t * ht, const lkey_t key)
+ *
+ * Find node'(key, val)' by the key from hashtable ht.
+ *
  * success : return true
  * failure(not found): return false
  */
 bool_t find(hashtable_t * ht, const lkey_t key)
 {
-    unsigned int myBucket = hashCode(key, ht);
+    val_t getval;
+
+    return get(ht, key, &getval);
+}
+
+/*
+ * int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from hashtable ht. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value.
+ *
+ * The buckets of all keys are prefetched first; then, while keys[i] is looked up,
+ * the head of the chain of keys[i + BATCH_WIDTH] is prefetched, so that the misses
+ * of later keys overlap the current lookup. Prefetching reads the table without
+ * any lock, which is harmless: old bucket arrays are kept until free_hashtable().
+ *
+ * return the number of keys found
+ */
+int find_batch(hashtable_t * ht, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    list_t *bucket = ht->bucket;
+    unsigned int table_size = ht->table_size;
+    int i, ret = 0;
+
+    for (i = 0; i < n; i++)
+	PREFETCH(&bucket[keys[i] % table_size]);
+    for (i = 0; i < n && i < BATCH_WIDTH; i++)
+	PREFETCH(bucket[keys[i] % table_size].head);
+
+    for (i = 0; i < n; i++) {
+	if (i + BATCH_WIDTH < n)
+	    PREFETCH(bucket[keys[i + BATCH_WIDTH] % table_size].head);
+	if ((found[i] = get(ht, keys[i], &getval[i])) == true)
+	    ret++;
+    }
+
+    return ret;
+}
+
+
+/*
+ * bool_t update_node(allocator_t * a, stripe_t * st, list_t * l, const lkey_t key,
+ *                    const update_op_t op, const val_t val, compute_fn_t fn, val_t * getval)
+ *
+ * Apply 'op' to the node of 'key' in list 'l', which belongs to stripe 'st', in one
+ * traversal. If the node exists, write its value before the update to *getval, and
+ * set it to 'val' (UPSERT), leave it (COMPUTE_IF_ABSENT) or add 'val' to it
+ * (FETCH_ADD). Otherwise add node '(key, val)', or '(key, fn(key))' for
+ * COMPUTE_IF_ABSENT, and write the new value to *getval.
+ *
+ * A value is replaced by a single store, which lock-free readers see either before
+ * or after, so only linking a node changes the sequence counter.
+ *
+ * added : return true
+ * found, or no memory : return false
+ */
+static bool_t update_node(allocator_t * a, stripe_t * st, list_t * l, const lkey_t key,
+			  const update_op_t op, const val_t val, compute_fn_t fn, val_t * getval)
+{
+    node_t *pred, *curr, *newNode;
+
+    pred = l->head;
+    curr = pred->next;
+
+    while (curr != NULL && curr->key < key) {
+	pred = curr;
+	curr = curr->next;
+    }
+
+    if (curr != NULL && key == curr->key) {
+	*getval = curr->value;
+	if (op == UPSERT)
+	    curr->value = val;
+	else if (op == FETCH_ADD)
+	    curr->value += val;
+	return false;
+    }
+
+    *getval = (op == COMPUTE_IF_ABSENT) ? fn(key) : val;
+    if ((newNode = create_node(a, st, key, *getval)) == NULL)
+	return false;
+
+    write_begin(st);
+    newNode->next = curr;
+    pred->next = newNode;
+    write_end(st);
+    return true;
+}
+
+/*
+ * bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+ *               compute_fn_t fn, val_t * getval)
+ *
+ * update_node() on the bucket of 'key', under the lock of its stripe.
+ */
+static bool_t update(hashtable_t * ht, const lkey_t key, const update_op_t op, const val_t val,
+		     compute_fn_t fn, val_t * getval)
+{
+    unsigned int myBucket, table_size;
     bool_t ret;
 
-    lock(ht, myBucket);
-    ret = find_node(&ht->bucket[myBucket], key);
+    do {
+	table_size = ht->table_size;
+	myBucket = hashCode(key, ht);	/* T1: */
+
+	lock(ht, myBucket);	/* T2: */
+	if (table_size == ht->table_size)
+	    break;
+	/* resize() executed between T1: and T2:. */
+	unlock(ht, myBucket);
+	STATS_INC(STATS_RETRY);
+    }
+    while (1);
+
+    if ((ret = update_node(ht->allocator, getStripe(ht, myBucket), &ht->bucket[myBucket],
+			   key, op, val, fn, getval)) == true)
+	counter_inc(&ht->setSize);
     unlock(ht, myBucket);
 
+    if (ret == true && policy(ht)) {
+      resize(ht);
+      fprintf (stderr, "Resized\n");
+    }
     return ret;
 }
 
+/*
+ * bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+ *
+ * Add node '(key, val)' to hashtable ht, or set the value of the node of 'key' to 'val'.
+ *
+ * added : return true
+ * replaced : return false
+ */
+bool_t upsert(hashtable_t * ht, const lkey_t key, const val_t val)
+{
+    val_t getval;
+
+    return update(ht, key, UPSERT, val, NULL, &getval);
+}
 
 /*
- * bool_t *init_list(list_t *l)
+ * val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+ *
+ * If 'key' is not in hashtable ht, add node '(key, fn(key))'. fn() is called under
+ * the stripe lock, so it must not access the table.
+ *
+ * return the value of 'key', 0 if fn is NULL
+ */
+val_t compute_if_absent(hashtable_t * ht, const lkey_t key, compute_fn_t fn)
+{
+    val_t getval;
+
+    if (fn == NULL) {
+      elog("compute_if_absent without fn");
+      return 0;
+    }
+
+    update(ht, key, COMPUTE_IF_ABSENT, 0, fn, &getval);
+    return getval;
+}
+
+/*
+ * val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+ *
+ * Add 'delta' to the value of 'key' in hashtable ht, or add node '(key, delta)'.
+ *
+ * return the value before the addition, 0 if 'key' was added
+ */
+val_t fetch_add(hashtable_t * ht, const lkey_t key, const val_t delta)
+{
+    val_t getval;
+
+    return (update(ht, key, FETCH_ADD, delta, NULL, &getval) == true) ? 0 : getval;
+}
+
+
+/*
+ * bool_t *init_list(allocator_t * a, list_t *l)
  *
  * Create node 'head', and add to list 'l'.
  *
  * success : return true
  * failure : return false
  */
-static bool_t list_init(list_t * l)
+static bool_t list_init(allocator_t * a, list_t * l)
 {
-  if ((l->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((l->head = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return false;
   }
   l->head->next = NULL;
@@ -327,26 +647,46 @@ static bool_t init_bucket(hashtable_t * ht, const unsigned int table_size)
     unsigned int i;
 
     if ((ht->bucket =
-	 (list_t *) calloc(table_size, sizeof(list_t))) == NULL) {
-      elog("calloc error");
+	 (list_t *) allocator_alloc_region(ht->allocator, table_size * sizeof(list_t))) == NULL) {
+      elog("allocator_alloc_region error");
       return false;
     }
 
     for (i = 0; i < table_size; i++)
-      if (list_init(&ht->bucket[i]) == false) {
+      if (list_init(ht->allocator, &ht->bucket[i]) == false) {
 	return false;
       }
     return true;
 }
 
 
-static void free_bucket(list_t * bucket, const unsigned int table_size)
+static void free_bucket(allocator_t * a, list_t * bucket, const unsigned int table_size)
 {
     int i;
     for (i = 0; i < table_size; i++)
-	free(&(*bucket[i].head));
+	allocator_free(a, bucket[i].head);
 
-    free(bucket);
+    allocator_free_region(a, bucket);
+}
+
+/*
+ * void retire_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size)
+ *
+ * Keep the bucket array replaced by resize() until free_hashtable(),
+ * because find() may still be traversing it.
+ */
+static void retire_bucket(hashtable_t * ht, list_t * bucket, const unsigned int table_size)
+{
+    retired_t *r;
+
+    if ((r = (retired_t *) calloc(1, sizeof(retired_t))) == NULL) {
+      elog("calloc error");
+      abort();
+    }
+    r->bucket = bucket;
+    r->table_size = table_size;
+    r->next = ht->retired;
+    ht->retired = r;
 }
 
 
@@ -370,38 +710,78 @@ hashtable_t *init_hashtable(const unsigned int table_size)
 
     ht->table_size = table_size;
     ht->lock_size = table_size;
-    ht->setSize = 0;
+    ht->allocator = get_allocator();
+    if (counter_init(&ht->setSize) != true) {
+	free(ht);
+	return NULL;
+    }
 
     if (init_bucket(ht, ht->table_size) != true) {
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
 
-    if ((ht->mtx =
-	 (pthread_mutex_t *) calloc(ht->lock_size, sizeof(pthread_mutex_t))) == NULL) {
-      elog("calloc error");
-	free_bucket(ht->bucket, ht->lock_size);
+    /* Regions are aligned to CACHE_LINE_SIZE. */
+    if ((ht->stripe = (stripe_t *) allocator_alloc_region(ht->allocator,
+							   ht->lock_size * sizeof(stripe_t))) == NULL) {
+      elog("allocator_alloc_region error");
+	free_bucket(ht->allocator, ht->bucket, ht->table_size);
+	counter_destroy(&ht->setSize);
 	free(ht);
 	return NULL;
     }
 
-    for (i = 0; i < ht->lock_size; i++)
-	ht->mtx[i] = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+    ht->lock_kind = get_lock_kind();
+    for (i = 0; i < ht->lock_size; i++) {
+	if (rwlock_init(ht->lock_kind, &ht->stripe[i].lock) != true) {
+	    while (0 < i--)
+		rwlock_destroy(ht->lock_kind, &ht->stripe[i].lock);
+	    free_bucket(ht->allocator, ht->bucket, ht->table_size);
+	    allocator_free_region(ht->allocator, ht->stripe);
+	    counter_destroy(&ht->setSize);
+	    free(ht);
+	    return NULL;
+	}
+	ht->stripe[i].seq = 0;
+	ht->stripe[i].free_list = NULL;
+    }
+    ht->retired = NULL;
 
     return ht;
 }
 
 void free_hashtable(hashtable_t * ht)
 {
-    free_bucket(ht->bucket, ht->table_size);
-    free(ht->mtx);
+    retired_t *r;
+    node_t *node;
+    int i;
+
+    free_bucket(ht->allocator, ht->bucket, ht->table_size);
+
+    while ((r = ht->retired) != NULL) {
+	ht->retired = r->next;
+	free_bucket(ht->allocator, r->bucket, r->table_size);
+	free(r);
+    }
+
+    for (i = 0; i < ht->lock_size; i++) {
+	while ((node = ht->stripe[i].free_list) != NULL) {
+	    ht->stripe[i].free_list = node->next;
+	    allocator_free(ht->allocator, node);
+	}
+	rwlock_destroy(ht->lock_kind, &ht->stripe[i].lock);
+    }
+
+    allocator_free_region(ht->allocator, ht->stripe);
+    counter_destroy(&ht->setSize);
     free(ht);
 }
 
 
 static bool_t policy(hashtable_t * ht)
 {
-    return ((int) (ht->setSize / ht->table_size) > 4 ? true : false);
+    return (counter_compare(&ht->setSize, (int64_t) ht->table_size * 4) > 0 ? true : false);
 }
 
 static void resize(hashtable_t * ht)
@@ -409,7 +789,9 @@ static void resize(hashtable_t * ht)
     list_t *l;
     node_t *pred, *curr;
     unsigned int i, myBucket, table_size;
+    STATS_DECLARE(t0);
 
+    STATS_TICKS(t0);
     table_size = ht->table_size;
     for (i = 0; i < ht->lock_size; i++)
 	lock(ht, i);
@@ -420,11 +802,20 @@ static void resize(hashtable_t * ht)
 	return;
     }
 
+    for (i = 0; i < ht->lock_size; i++)
+	write_begin(&ht->stripe[i]);
+
     ht->old_table_size = ht->table_size;
     ht->old_bucket = ht->bucket;
 
-    if (init_bucket(ht, ht->table_size * 2) == false)
+    if (init_bucket(ht, ht->table_size * 2) == false) {
+	ht->bucket = ht->old_bucket;
+	for (i = 0; i < ht->lock_size; i++) {
+	    write_end(&ht->stripe[i]);
+	    unlock(ht, i);
+	}
 	return;
+    }
 
     ht->table_size *= 2;
 
@@ -443,11 +834,16 @@ static void resize(hashtable_t * ht)
 	}
     }
 
-    for (i = 0; i < ht->lock_size; i++)
-	unlock(ht, i);
+    /* Before unlocking, or the next resize() may overwrite ht->old_bucket. */
+    retire_bucket(ht, ht->old_bucket, ht->old_table_size);
 
-    free_bucket(ht->old_bucket, ht->old_table_size);
+    for (i = 0; i < ht->lock_size; i++)
+	write_end(&ht->stripe[i]);
 
+    for (i = ht->lock_size; 0 < i--; )
+	unlock(ht, i);
+    STATS_INC(STATS_RESIZE);
+    STATS_SINCE(STATS_RESIZE_TIME, t0);
 }
 
 void show_list(const list_t * l)
@@ -487,6 +883,39 @@ unsigned int hashCode(lkey_t key, const hashtable_t * ht)
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_hashtable(4);
+}
+
+static void ops_free(void *ht)
+{
+    free_hashtable((hashtable_t *) ht);
+}
+
+static int ops_add(void *ht, const uint64_t key)
+{
+    return (add((hashtable_t *) ht, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *ht, const uint64_t key)
+{
+    val_t getval;
+    return (delete((hashtable_t *) ht, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *ht, const uint64_t key)
+{
+    return (find((hashtable_t *) ht, (lkey_t) key) == true) ? 1 : 0;
+}
+
+const ds_ops_t StripedHash_ops = {"StripedHash", REGISTRY_HASH, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, NULL};
+
+
 #ifdef _SINGLE_THREAD_
 
 hashtable_t *ht;
@@ -499,18 +928,21 @@ int main(int argc, char **argv)
     ht = init_hashtable(4);
 
     for (i = 0; i < 10; i++) {
-      printf("add i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("add i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       add(ht, i, i);
       show_hashtable(ht);
     }
 
 
     for (i = 0; i < 10; i++) {
-      printf("del i = %d, setSize = %lu\n", i, ht->setSize);
+      printf("del i = %d, setSize = %lld\n", i, (long long int) counter_read_exact(&ht->setSize));
       delete(ht, i, &getval);
       show_hashtable(ht);
     }
 
+    assert(compute_if_absent(ht, 11, NULL) == 0);
+    assert(find(ht, 11) == false);
+
     free_hashtable(ht);
 
     return 0;
@@ -10,6 +10,9 @@
 #define _STRIPED_HASH_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _node_t
 {
@@ -24,9 +27,24 @@ typedef struct _list_t
   node_t *head;
 } list_t;
 
+typedef struct _stripe_t
+{
+  rwlock_t lock;                    /* lock of this stripe; find() takes it in shared mode */
+  volatile unsigned int seq;        /* sequence counter; odd while a writer modifies this stripe */
+  node_t *free_list;                /* deleted nodes, reused by create_node() */
+} __attribute__((aligned(CACHE_LINE_SIZE))) stripe_t;
+
+typedef struct _retired_t
+{
+  list_t *bucket;                   /* bucket array replaced by resize() */
+  unsigned int table_size;
+  struct _retired_t *next;
+} retired_t;
+
 typedef struct _hashtable_t
 {
-  unsigned long int setSize;        /* number of nodes */
+  counter_t setSize;                /* number of nodes */
+  allocator_t *allocator;           /* node allocator */
 
   list_t *bucket;                   /* hashtable */
   unsigned int table_size;          /* hashtable size(length) */
@@ -34,11 +52,29 @@ typedef struct _hashtable_t
   list_t *old_bucket;               /* temporary hashtable for keep the original hashtable before resize */
   unsigned int old_table_size;      /* size of old_bucket */
 
-  pthread_mutex_t *mtx;             /* mutex lock arrey */
-  unsigned int lock_size;           /* mtx size */
+  stripe_t *stripe;                 /* locks, sequence counters and free lists */
+  unsigned int lock_size;           /* number of stripes */
+  lock_kind_t lock_kind;
+
+  retired_t *retired;               /* old bucket arrays, kept until free_hashtable() */
 } hashtable_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define show_list(...)          StripedHash_show_list(__VA_ARGS__)
+#define show_hashtable(...)     StripedHash_show_hashtable(__VA_ARGS__)
+#define init_hashtable(...)     StripedHash_init_hashtable(__VA_ARGS__)
+#define free_hashtable(...)     StripedHash_free_hashtable(__VA_ARGS__)
+#define hashCode(...)           StripedHash_hashCode(__VA_ARGS__)
+#define add(...)                StripedHash_add(__VA_ARGS__)
+#define delete(...)             StripedHash_delete(__VA_ARGS__)
+#define find(...)               StripedHash_find(__VA_ARGS__)
+#define get(...)                StripedHash_get(__VA_ARGS__)
+#define upsert(...)             StripedHash_upsert(__VA_ARGS__)
+#define compute_if_absent(...)  StripedHash_compute_if_absent(__VA_ARGS__)
+#define fetch_add(...)          StripedHash_fetch_add(__VA_ARGS__)
+#define find_batch(...)         StripedHash_find_batch(__VA_ARGS__)
+
 void show_list (const list_t *);
 void show_hashtable (hashtable_t *);
 hashtable_t * init_hashtable (const unsigned int);
@@ -47,6 +83,11 @@ unsigned int  hashCode (lkey_t, const hashtable_t *);
 bool_t add (hashtable_t *, const lkey_t, const val_t);
 bool_t delete (hashtable_t *, const lkey_t, val_t *);
 bool_t find (hashtable_t *, const lkey_t);
+bool_t get (hashtable_t *, const lkey_t, val_t *);
+bool_t upsert (hashtable_t *, const lkey_t, const val_t);
+val_t compute_if_absent (hashtable_t *, const lkey_t, compute_fn_t);
+val_t fetch_add (hashtable_t *, const lkey_t, const val_t);
+int find_batch (hashtable_t *, const lkey_t *, const int, val_t *, bool_t *);
 
 
 #endif
@@ -30,14 +30,26 @@ typedef bool bool_t;
 typedef intptr_t lkey_t;
 typedef intptr_t  val_t;
 
+typedef val_t (*compute_fn_t) (const lkey_t);   /* value of an absent key, for compute_if_absent() */
+typedef enum {UPSERT = 0, COMPUTE_IF_ABSENT, FETCH_ADD} update_op_t;
+
 
 #define elog(_message_)  do {fprintf(stderr,			        \
 				     "%s():%s:%u: %s\n",		\
 				     __FUNCTION__, __FILE__, __LINE__,	\
 				     _message_); fflush(stderr);}while(0);
 
+#ifdef _X86_64_
+#define MB()  __asm__ __volatile__ ("lock; addl $0,0(%%rsp)" : : : "memory")
+#else
 #define MB()  __asm__ __volatile__ ("lock; addl $0,0(%%esp)" : : : "memory")
-#define WMB() __asm__ __volatile__ ("" : : : "memory")
-#define RMB() MB()
+#endif
+#define WMB() __asm__ __volatile__ ("" : : : "memory")   /* x86 does not reorder stores with other stores */
+#define RMB() __asm__ __volatile__ ("" : : : "memory")   /* nor loads with other loads */
+
+#define CACHE_LINE_SIZE 64
+
+#define PREFETCH(_addr_)  __builtin_prefetch((const void *) (_addr_), 0, 3)
+#define BATCH_WIDTH 8     /* lookups in flight in find_batch() */
 
 #endif
@@ -8,45 +8,102 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include <limits.h>
 #include <assert.h>
+#include <math.h>
 
 #include "common.h"
+#include "alloc.h"
+#include "perf.h"
+#include "lock.h"
+#include "filter.h"
+#include "registry.h"
+#include "bench.h"
+#include "checksum.h"
+#include "affinity.h"
+#include "stats.h"
 
 #ifdef   _Hash_
 #include "Hash.h"
+#define STRUCTURE_NAME "Hash"
 #elif    _CuckooHash_
 #include "CuckooHash.h"
+#define STRUCTURE_NAME "CuckooHash"
 #elif    _StripedHash_
 #include "StripedHash.h"
+#define STRUCTURE_NAME "StripedHash"
 #elif    _RefinableHash_
 #include "RefinableHash.h"
+#define STRUCTURE_NAME "RefinableHash"
 #elif    _OpenAddressHash_
 #include "OpenAddressHash.h"
+#define STRUCTURE_NAME "OpenAddressHash"
 #elif    _ConcurrentCuckooHash_
 #include "ConcurrentCuckooHash.h"
+#define STRUCTURE_NAME "ConcurrentCuckooHash"
+#elif    _LockFreeOpenAddressHash_
+#include "LockFreeOpenAddressHash.h"
+#define STRUCTURE_NAME "LockFreeOpenAddressHash"
+#elif    _BucketizedCuckooHash_
+#include "BucketizedCuckooHash.h"
+#define STRUCTURE_NAME "BucketizedCuckooHash"
+#elif    _HopscotchHash_
+#include "HopscotchHash.h"
+#define STRUCTURE_NAME "HopscotchHash"
+#elif    _PartitionedHash_
+#include "PartitionedHash.h"
+#define STRUCTURE_NAME "PartitionedHash"
 #endif
 
 
 #define PIPE_MAXLINE 32
-#define MAX_THREADS 200
-#define MAX_ITEMS 30000
 #define MAX_BUCKET_SIZE 16
 #define MAX_TABLE_SIZE 16
 
 #define DEFAULT_THREADS 10
 #define DEFAULT_ITEMS 1000
+#define DEFAULT_ALLOCATOR "slab"
+#define DEFAULT_AFFINITY "none"
+#define DEFAULT_LOCK "ttas"
 #define DEFAULT_BUCKET_SIZE 4
 #define DEFAULT_TABLE_SIZE 4
+#define DEFAULT_READ_RATIO 0
+#define MAX_READ_RATIO 99
+#define HOT_KEYS 1024                   /* keys looked up under -z */
+#define DEFAULT_BATCH_SIZE 1
+#define MAX_BATCH_SIZE 256
+#define DEFAULT_MISS_RATIO 0
+#define ABSENT_KEYS 1000000             /* range of the keys looked up under -M */
+#define MAX_COUNTERS 65536
+
+#ifdef _ConcurrentCuckooHash_
+#define lookup(_ht_, _key_)   contains((_ht_), (_key_))
+#else
+#define lookup(_ht_, _key_)   find((_ht_), (_key_))
+#endif
 
 static hashtable_t *ht;
+static filtered_t filtered;             /* ht behind the filter of -F, if any */
 
 
-static unsigned long long int sum[MAX_THREADS];
-static val_t check[MAX_THREADS * MAX_ITEMS];
+/*
+ * Results of each thread, on their own cache lines. The added keys and the
+ * deleted values are checked by streamed checksums (see util/checksum.h), so
+ * no memory grows with the number of items.
+ */
+typedef struct {
+    checksum_t added;
+    checksum_t deleted;
+    unsigned long long int lookups;
+    unsigned long long int absent_lookups;
+    unsigned long long int false_positives;
+} __attribute__((aligned(CACHE_LINE_SIZE))) thread_result_t;
+
+static thread_result_t *result;
 
 static pthread_mutex_t begin_mtx;
 static pthread_cond_t begin_cond;
@@ -57,10 +114,23 @@ static unsigned int end_thread_num;
 
 typedef struct {
     int thread_num;
-    int item_num;
+    long long int item_num;
     int verbose;
+    char *allocator;
+    int hugepage;
+    char *affinity;
+    char *lock;
     int bucket_size;
     int table_size;
+    int read_ratio;
+    int rcu;
+    int owners;
+    double zipf_theta;
+    int batch_size;
+    char *filter;
+    int miss_ratio;
+    int counters;
+    char *workload;
 } system_variables_t;
 
 struct stat_time {
@@ -75,7 +145,18 @@ typedef struct stat_time stat_data_t;
 static double get_interval(struct timeval, struct timeval);
 static void master_thread(void);
 static void worker_thread(void *);
+static void lookup_keys(const uintptr_t, unsigned int *, unsigned int *, const lkey_t, const lkey_t);
+static int init_hot_keys(void);
+static void free_hot_keys(void);
+static lkey_t hot_key(unsigned int *);
+static int init_counters(void);
+static int free_counters(void);
+static hashtable_t *create_hashtable(void);
+static void destroy_hashtable(void);
 static int workbench(void);
+static int workload(void);
+static void create_filter(const uint64_t);
+static void report_filter(void);
 static void usage(char **);
 static void init_system_variables(void);
 
@@ -83,6 +164,10 @@ static void init_system_variables(void);
  * global variables
  */
 static system_variables_t system_variables;
+static bench_config_t bench_config;
+static allocator_t *allocator;
+static affinity_t *affinity;
+static perf_counter_t dtlb_misses;
 static pthread_t *work_thread_tptr;
 static pthread_t tid;
 static stat_data_t *stat_data;
@@ -90,6 +175,8 @@ static stat_data_t *stat_data;
 static struct timeval stat_data_begin;
 static struct timeval stat_data_end;
 
+static double *zipf_cdf;                /* cumulative probability of the hot keys */
+
 /*
  * local functions
  */
@@ -117,11 +204,12 @@ static void master_thread(void)
 	pthread_cond_wait(&end_cond, &end_mtx);
     pthread_mutex_unlock(&end_mtx);
 
-#ifdef _ConcurrentCuckooHash_
-    free_hashtable (ht, ht->table_size);
-#else
-    free_hashtable (ht);
-#endif
+    free_hot_keys();
+    if (0 < system_variables.counters && free_counters() != 0)
+      fprintf (stderr, "RESULT: counters FAILED!\n");
+
+    destroy_hashtable();
+    allocator_destroy(allocator);
 
     /* display result */
     double tmp_itvl;
@@ -130,13 +218,21 @@ static void master_thread(void)
     double max_itvl = 0.0;
     long double itvl = 0.0;
 
-    unsigned long long int total = 0;
+    checksum_t added, deleted;
+    unsigned long long int total_lookups = 0;
+    unsigned long long int total_absent = 0;
+    unsigned long long int total_fp = 0;
 
     gettimeofday(&stat_data_end, NULL);
 
-    total = 0;
+    checksum_init(&added);
+    checksum_init(&deleted);
     for (i = 0; i < system_variables.thread_num; i++) {
-      total += sum[i];
+      checksum_merge(&added, &result[i].added);
+      checksum_merge(&deleted, &result[i].deleted);
+      total_lookups += result[i].lookups;
+      total_absent += result[i].absent_lookups;
+      total_fp += result[i].false_positives;
 
       tmp_itvl = get_interval(stat_data[i].begin, stat_data[i].end);
       
@@ -149,17 +245,50 @@ static void master_thread(void)
 	fprintf(stderr, "thread(%d) end %f[sec]\n", i, tmp_itvl);
     }
 
-    if (total != (((system_variables.item_num * system_variables.thread_num) *
-		 ((system_variables.item_num * system_variables.thread_num) + 1)) / 2))
+    /* Every key is added and deleted exactly once, and deleted with its value. */
+    if (added.count != (uint64_t) system_variables.thread_num * system_variables.item_num
+	|| checksum_equal(&added, &deleted) != 1)
       fprintf (stderr, "RESULT: test FAILED!\n");
     else
       fprintf (stderr, "RESULT: test OK\n");
 
     fprintf (stderr, "condition =>\n");
     printf ("\t%d threads run\n", system_variables.thread_num);
-    printf ("\t%d items inserted and deleted / thread, total %d items\n",
+    affinity_report(affinity, system_variables.thread_num);
+    printf ("\tallocator: %s%s\n", system_variables.allocator,
+	    (system_variables.hugepage == 1) ? " (huge pages)" : "");
+    printf ("\tlock: %s\n", system_variables.lock);
+#ifdef _Hash_
+    if (system_variables.rcu == 1)
+      printf ("\tRCU readers\n");
+#endif
+#ifdef _PartitionedHash_
+    printf ("\t%d owner threads\n", system_variables.owners);
+#endif
+    printf ("\t%lld items inserted and deleted / thread, total %lld items\n",
 	    system_variables.item_num,
 	    system_variables.item_num * system_variables.thread_num);
+    if (0 < system_variables.read_ratio)
+      printf ("\t%llu lookups (read ratio %d%%)\n",
+	      total_lookups, system_variables.read_ratio);
+    if (1 < system_variables.batch_size)
+      printf ("\tlookups in batches of %d\n", system_variables.batch_size);
+    if (zipf_cdf != NULL)
+      printf ("\tlookups of %d hot keys, zipf theta %.2f\n",
+	      HOT_KEYS, system_variables.zipf_theta);
+    if (0 < system_variables.miss_ratio)
+      printf ("\t%llu lookups of absent keys (miss ratio %d%%)\n",
+	      total_absent, system_variables.miss_ratio);
+    if (0 < system_variables.counters)
+      printf ("\t%d counters incremented by fetch_add() after every add\n",
+	      system_variables.counters);
+    if (filtered.filter != NULL) {
+      report_filter();
+      if (0 < total_absent)
+	printf ("\t  false positive rate: %.4f%% (%llu of %llu absent keys passed)\n",
+		100.0 * total_fp / total_absent, total_fp, total_absent);
+    }
+    STATS_REPORT();
 
     assert(0 < system_variables.thread_num);
     ave_itvl = (double) (itvl / system_variables.thread_num);
@@ -175,12 +304,245 @@ static void master_thread(void)
 
 
 
+/*
+ * The table as a ds_ops_t, which the tests and the workload bench drive through
+ * the filter of -F (see filter.h): filtered_add() and filtered_delete() keep the
+ * filter in step with the table. Every key is added with itself as the value, and
+ * a delete leaves the value it took in deleted_value.
+ */
+static __thread val_t deleted_value;
+
+static int stub_add(void *t, const uint64_t key)
+{
+    return (add((hashtable_t *) t, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int stub_delete(void *t, const uint64_t key)
+{
+    return (delete((hashtable_t *) t, (lkey_t) key, &deleted_value) == true) ? 1 : 0;
+}
+
+static int stub_find(void *t, const uint64_t key)
+{
+    return (lookup((hashtable_t *) t, (lkey_t) key) == true) ? 1 : 0;
+}
+
+static const ds_ops_t stub_ops = {STRUCTURE_NAME, REGISTRY_HASH, INTPTR_MAX,
+    NULL, NULL, stub_add, stub_delete, stub_find, NULL};
+
+/* Create the filter of -F for 'capacity' keys in front of ht. */
+static void create_filter(const uint64_t capacity)
+{
+    filter_t *filter = NULL;
+
+    if (system_variables.filter != NULL
+	&& (filter = filter_create(system_variables.filter, capacity)) == NULL) {
+      fprintf(stderr, "Error: filter %s is not valid\n", system_variables.filter);
+      abort();
+    }
+    filtered_init(&filtered, &stub_ops, ht, filter);
+}
+
+/* Report the filter of -F, and destroy it. */
+static void report_filter(void)
+{
+    filter_t *filter = filtered.filter;
+
+    printf ("\tfilter: %s, %lu bytes, %.1f bits/key%s\n", filter_name(filter),
+	    (unsigned long) filter->size, 8.0 * filter->size / filter->capacity,
+	    (filter->overflow == 1) ? " (overflowed)" : "");
+    filter_destroy(filter);
+    filtered.filter = NULL;
+}
+
+/*
+ * void lookup_keys(const uintptr_t no, unsigned int *seed, unsigned int *credit,
+ *                                      const lkey_t first, const lkey_t last)
+ *
+ * Issue enough lookups after one add or delete to keep the ratio of lookups to all
+ * operations at read_ratio percent. Keys are picked from [first, last], which this
+ * thread has inserted and not deleted yet, or from the hot keys under -z, so every
+ * lookup must succeed. Under -M, miss_ratio percent of the keys are picked from
+ * ABSENT_KEYS keys above all others instead, and must not be found.
+ *
+ * With -B, lookups are issued batch_size at a time through find_batch(), once
+ * enough credit for a whole batch has accumulated.
+ *
+ * With -F, keys the filter rejects are not looked up in the table; absent keys
+ * that pass the filter are counted as false positives.
+ */
+static void lookup_keys(const uintptr_t no, unsigned int *seed, unsigned int *credit,
+			const lkey_t first, const lkey_t last)
+{
+    lkey_t key[MAX_BATCH_SIZE];
+    val_t getval[MAX_BATCH_SIZE];
+    bool_t found[MAX_BATCH_SIZE];
+    bool_t absent[MAX_BATCH_SIZE];
+    const lkey_t absent_base = (lkey_t) system_variables.thread_num * system_variables.item_num + HOT_KEYS + 1;
+    const int n = system_variables.batch_size;
+    int i, m;
+
+    *credit += system_variables.read_ratio;
+    while ((100 - system_variables.read_ratio) * n <= *credit) {
+      *credit -= (100 - system_variables.read_ratio) * n;
+      if (zipf_cdf == NULL && last < first)
+	continue;
+      for (i = 0; i < n; i++) {
+	absent[i] = (0 < system_variables.miss_ratio
+		     && rand_r(seed) % 100 < system_variables.miss_ratio) ? true : false;
+	if (absent[i] == true) {
+	  key[i] = absent_base + (rand_r(seed) % ABSENT_KEYS);
+	  result[no].absent_lookups++;
+	} else
+	  key[i] = (zipf_cdf != NULL) ? hot_key(seed) : first + (rand_r(seed) % (last - first + 1));
+      }
+
+      /* Keep the keys the filter passes. */
+      for (i = m = 0; i < n; i++) {
+	if (filtered.filter != NULL) {
+	  if (filter_contains(filtered.filter, (uint64_t) key[i]) == 0) {
+	    if (absent[i] != true)
+	      fprintf (stderr, "ERROR[%ld]: filter rejected %ld\n", (uintptr_t)no, (uintptr_t)key[i]);
+	    continue;
+	  }
+	  if (absent[i] == true)
+	    result[no].false_positives++;
+	}
+	key[m] = key[i];
+	absent[m++] = absent[i];
+      }
+
+      if (n == 1) {
+	if (m == 1 && lookup(ht, key[0]) != ((absent[0] == true) ? false : true))
+	  fprintf (stderr, "ERROR[%ld]: find %ld\n", (uintptr_t)no, (uintptr_t)key[0]);
+      } else if (0 < m) {
+	find_batch(ht, key, m, getval, found);
+	for (i = 0; i < m; i++)
+	  if ((absent[i] == true) ? (found[i] != false)
+	      : (found[i] != true || getval[i] != key[i]))
+	    fprintf (stderr, "ERROR[%ld]: find %ld\n", (uintptr_t)no, (uintptr_t)key[i]);
+      }
+      result[no].lookups += n;
+    }
+}
+
+/*
+ * int init_hot_keys(void)
+ *
+ * Insert HOT_KEYS keys above the keys of the workers, and build the zipf
+ * distribution with which all threads look them up; key 0 of them is the hottest.
+ *
+ * success : return 0
+ * failure : return -1
+ */
+static int init_hot_keys(void)
+{
+    lkey_t base = (lkey_t) system_variables.thread_num * system_variables.item_num + 1;
+    double sum = 0.0;
+    int i;
+
+    if ((zipf_cdf = (double *) calloc(HOT_KEYS, sizeof(double))) == NULL) {
+      elog("calloc error");
+      return -1;
+    }
+    for (i = 0; i < HOT_KEYS; i++)
+      zipf_cdf[i] = (sum += 1.0 / pow(i + 1, system_variables.zipf_theta));
+    for (i = 0; i < HOT_KEYS; i++)
+      zipf_cdf[i] /= sum;
+
+    for (i = 0; i < HOT_KEYS; i++)
+      if (filtered_add(&filtered, (uint64_t) (base + i)) != 1) {
+	elog("add error");
+	return -1;
+      }
+    return 0;
+}
+
+static void free_hot_keys(void)
+{
+    lkey_t base = (lkey_t) system_variables.thread_num * system_variables.item_num + 1;
+    int i;
+
+    if (zipf_cdf == NULL)
+      return;
+    for (i = 0; i < HOT_KEYS; i++)
+      filtered_delete(&filtered, (uint64_t) (base + i));
+    free(zipf_cdf);
+    zipf_cdf = NULL;
+}
+
+static lkey_t hot_key(unsigned int *seed)
+{
+    double u = (double) rand_r(seed) / ((double) RAND_MAX + 1.0);
+    int l = 0, h = HOT_KEYS - 1, m;
+
+    while (l < h) {
+      m = (l + h) / 2;
+      if (u < zipf_cdf[m])
+	h = m;
+      else
+	l = m + 1;
+    }
+    return (lkey_t) system_variables.thread_num * system_variables.item_num + 1 + l;
+}
+
+/*
+ * With -C, every add is counted in one of 'counters' entries, keyed above the
+ * absent keys, by fetch_add(). The counters are created by upsert(), and summed
+ * by get() at the end, which must give the number of adds.
+ */
+#define counter_key(_i_)  ((lkey_t) system_variables.thread_num * system_variables.item_num \
+			   + HOT_KEYS + ABSENT_KEYS + 1 + (_i_))
+
+static val_t zero(const lkey_t key)
+{
+    return 0;
+}
+
+static int init_counters(void)
+{
+    int i;
+
+    for (i = 0; i < system_variables.counters; i++)
+      if (upsert(ht, counter_key(i), 0) != true) {
+	elog("upsert error");
+	return -1;
+      }
+    return 0;
+}
+
+static int free_counters(void)
+{
+    unsigned long long int total = 0;
+    val_t val, getval;
+    int i, ret = 0;
+
+    for (i = 0; i < system_variables.counters; i++) {
+      if (get(ht, counter_key(i), &val) != true
+	  || compute_if_absent(ht, counter_key(i), zero) != val
+	  || delete(ht, counter_key(i), &getval) != true || getval != val) {
+	fprintf (stderr, "ERROR: counter %d\n", i);
+	ret = -1;
+      }
+      total += val;
+    }
+    if (total != (unsigned long long int) system_variables.thread_num * system_variables.item_num) {
+      fprintf (stderr, "ERROR: counters total %llu\n", total);
+      ret = -1;
+    }
+    return ret;
+}
+
 static void worker_thread(void *arg)
 {
     uintptr_t no = (uintptr_t) arg;
-    unsigned int i;
+    long long int i;
     lkey_t key;
     val_t getval;
+    unsigned int seed = (unsigned int) no;
+    unsigned int credit = 0;
+
+    affinity_pin(affinity, no);
 
     /*
      * increment begin_thread_num, and wait for broadcast signal from last created thread
@@ -198,7 +560,6 @@ static void worker_thread(void *arg)
     }
 
     gettimeofday(&stat_data[no].begin, NULL);
-    sum[no] = 0;
 
     /*  main loop */
     key = no * system_variables.item_num;
@@ -208,11 +569,18 @@ static void worker_thread(void *arg)
 	fprintf(stderr, "thread[%u] add: %u\n", (unsigned int)no,
 		(unsigned int) key);
       
-      if (add(ht, (lkey_t) key, (val_t)key) != true)
+      if (filtered_add(&filtered, (uint64_t) key) != 1)
 	fprintf (stderr, "ERROR[%ld]: add %ld\n", (uintptr_t)no, (uintptr_t)key);
+      else
+	checksum_add(&result[no].added, (uint64_t) key);
+
+      if (0 < system_variables.counters)
+	fetch_add(ht, counter_key(key % system_variables.counters), 1);
       
       if (1 < system_variables.verbose)
 	show_hashtable(ht);
+
+      lookup_keys(no, &seed, &credit, no * system_variables.item_num + 1, key);
       
       //      usleep(no);
       //      pthread_yield(NULL);
@@ -223,19 +591,18 @@ static void worker_thread(void *arg)
     key = no * system_variables.item_num;
     for (i = 0; i < system_variables.item_num; i++) {
       ++key;
-      if (delete(ht, (lkey_t) key, &getval) != true) {
+      if (filtered_delete(&filtered, (uint64_t) key) != 1)
 	printf ("ERROR[%ld]: del %ld\n", (uintptr_t)no, (uintptr_t)key);
-      }
+      else
+	checksum_add(&result[no].deleted, (uint64_t) (getval = deleted_value));
       
       if (1 < system_variables.verbose)
 	show_hashtable(ht);
       
       if (0 < system_variables.verbose)
 	fprintf(stderr, "delete: val = %ld\n", (lkey_t) getval);
-      
-      sum[no] += getval;
-      
-      check[getval]++;
+
+      lookup_keys(no, &seed, &credit, key + 1, (no + 1) * system_variables.item_num);
       //      usleep(no);
       //      pthread_yield(NULL);  
     }
@@ -248,6 +615,31 @@ static void worker_thread(void *arg)
     pthread_mutex_unlock(&end_mtx);
 }
 
+static hashtable_t *create_hashtable(void)
+{
+#ifdef _ConcurrentCuckooHash_
+    return init_hashtable(4, 4, 2);
+#elif defined(_Hash_)
+    return init_hashtable(system_variables.bucket_size,
+			  (system_variables.rcu == 1) ? true : false);
+#elif defined(_RefinableHash_) || (_StripedHash_)
+    return init_hashtable(system_variables.bucket_size);
+#elif defined(_PartitionedHash_)
+    return init_hashtable(system_variables.table_size, system_variables.owners);
+#else
+    return init_hashtable(system_variables.table_size);
+#endif
+}
+
+static void destroy_hashtable(void)
+{
+#ifdef _ConcurrentCuckooHash_
+    free_hashtable (ht, ht->table_size);
+#else
+    free_hashtable (ht);
+#endif
+}
+
 static int workbench(void)
 {
     void *ret = NULL;
@@ -255,21 +647,25 @@ static int workbench(void)
 
     fprintf(stderr, "<<simple algorithm test bench>>\n");
 
-#ifdef _ConcurrentCuckooHash_
-    if ((ht = init_hashtable(4, 4, 2)) == NULL) {
-#else
-#if defined(_Hash_) || (_RefinableHash_) || (_StripedHash_)
-    if ((ht = init_hashtable(system_variables.bucket_size)) == NULL) {
-#else
-    if ((ht = init_hashtable(system_variables.table_size)) == NULL) {
-#endif
-#endif
-      elog("init_list() error");
+    if ((ht = create_hashtable()) == NULL) {
+      elog("init_hashtable() error");
       abort();
     }
 
-    for (i = 0; i < system_variables.thread_num * system_variables.item_num; i++)
-      check[i] = 0;
+    create_filter((uint64_t) system_variables.thread_num * system_variables.item_num
+		  + ((0.0 < system_variables.zipf_theta) ? HOT_KEYS : 0));
+
+    if ((result = (thread_result_t *) aligned_alloc(CACHE_LINE_SIZE, system_variables.thread_num
+						    * sizeof(thread_result_t))) == NULL) {
+      elog("aligned_alloc error");
+      goto end;
+    }
+    memset(result, 0, system_variables.thread_num * sizeof(thread_result_t));
+
+    if (0.0 < system_variables.zipf_theta && init_hot_keys() != 0)
+      abort();
+    if (0 < system_variables.counters && init_counters() != 0)
+      abort();
 
 
     if ((stat_data =
@@ -312,11 +708,47 @@ static int workbench(void)
 
  end:
     free(stat_data);
+    free(result);
     free(work_thread_tptr);
     return -1;
 }
 
 
+/*
+ * With -W, the table is driven by the workload bench (see util/bench.h)
+ * instead of the insert-then-delete test, behind the filter of -F if any.
+ */
+static int workload(void)
+{
+    bench_ops_t ops;
+    int ret;
+
+    if ((ht = create_hashtable()) == NULL) {
+      elog("init_hashtable() error");
+      abort();
+    }
+
+    create_filter(bench_config.key_range);
+
+    ops.name = STRUCTURE_NAME;
+    ops.ds = &filtered;
+    ops.insert = filtered_add;
+    ops.delete = filtered_delete;
+    ops.lookup = filtered_find;
+    ops.size = NULL;
+
+    bench_config.thread_num = system_variables.thread_num;
+    bench_config.ops = system_variables.item_num;
+    ret = bench_run(&ops, &bench_config, NULL);
+    if (filtered.filter != NULL)
+      report_filter();
+
+    destroy_hashtable();
+    allocator_destroy(allocator);
+    return (ret == 1) ? 0 : -1;
+}
+
+
 static void usage(char **argv)
 {
     fprintf(stderr, "simple algorithm test bench\n");
@@ -326,8 +758,32 @@ static void usage(char **argv)
 #if defined(_Hash_) || (_RefinableHash_) || (_StripedHash_)
     fprintf(stderr, "\t\t-b initial_bucket_size<%d>\n", DEFAULT_BUCKET_SIZE);
 #endif
-#if defined(_OpenAddressHash_) || (_CuckooHash_)
+#if defined(_OpenAddressHash_) || (_CuckooHash_) || (_LockFreeOpenAddressHash_) || (_BucketizedCuckooHash_) || (_HopscotchHash_) || (_PartitionedHash_)
     fprintf(stderr, "\t\t-s n (initial_table_size = 2^n)<%d>\n", DEFAULT_TABLE_SIZE);
+#endif
+#ifdef _PartitionedHash_
+    fprintf(stderr, "\t\t-P number_of_owner_threads<%d>\n", DEFAULT_OWNERS);
+#endif
+    fprintf(stderr, "\t\t-r read_ratio(%%)<%d>\n", DEFAULT_READ_RATIO);
+    fprintf(stderr, "\t\t-z theta         :look up %d hot keys with zipf(theta) skew\n", HOT_KEYS);
+    fprintf(stderr, "\t\t-B batch_size     :look up keys batch_size at a time (find_batch)<%d>\n", DEFAULT_BATCH_SIZE);
+    fprintf(stderr, "\t\t-M miss_ratio(%%)  :look up absent keys in miss_ratio%% of the lookups<%d>\n", DEFAULT_MISS_RATIO);
+    fprintf(stderr, "\t\t-F filter(bloom|cuckoo) :reject absent keys with a filter in front of the table\n");
+    fprintf(stderr, "\t\t-C number_of_counters :count the adds with fetch_add()\n");
+    fprintf(stderr, "\t\t-W mix(e.g. r90,i5,d5,s0) :run the workload bench with this mix of read, insert, delete and scan\n");
+    fprintf(stderr, "\t\t   -K dist(uniform|zipf[:theta]|latest[:theta]|hotspot[:keys:ops])<uniform>\n");
+    fprintf(stderr, "\t\t   -k key_range<%llu>  -p prefill<%llu>\n",
+	    (unsigned long long int) bench_config.key_range, (unsigned long long int) bench_config.prefill);
+    fprintf(stderr, "\t\t   -d seconds       :run for this long instead of number_of_items operations / thread\n");
+    fprintf(stderr, "\t\t   -T               :report per-operation latency percentiles\n");
+    fprintf(stderr, "\t\t   -E               :report hardware counters (cycles, LLC misses, ...) per operation\n");
+    fprintf(stderr, "\t\t   -O rate[:fixed|poisson] :open loop at this many operations / second of all threads\n");
+    fprintf(stderr, "\t\t-a allocator(malloc|slab)<%s>\n", DEFAULT_ALLOCATOR);
+    fprintf(stderr, "\t\t-H               :back tables and node pools with huge pages\n");
+    fprintf(stderr, "\t\t-c affinity(none|compact|scatter|smt|cpu_list e.g. 0,2,4-7)<%s>\n", DEFAULT_AFFINITY);
+    fprintf(stderr, "\t\t-L lock(pthread|ttas|ticket|mcs|clh)<%s>\n", DEFAULT_LOCK);
+#ifdef _Hash_
+    fprintf(stderr, "\t\t-R               :readers take no lock (RCU)\n");
 #endif
     fprintf(stderr, "\t\t-v               :verbose\n");
     fprintf(stderr, "\t\t-V               :debug mode\n");
@@ -340,14 +796,33 @@ static void init_system_variables(void)
     system_variables.thread_num = DEFAULT_THREADS;
     system_variables.item_num = DEFAULT_ITEMS;
     system_variables.verbose = 0;
+    system_variables.allocator = DEFAULT_ALLOCATOR;
+    system_variables.hugepage = 0;
+    system_variables.affinity = DEFAULT_AFFINITY;
+    system_variables.lock = DEFAULT_LOCK;
     system_variables.bucket_size = DEFAULT_BUCKET_SIZE;
     system_variables.table_size = DEFAULT_TABLE_SIZE;
+    system_variables.read_ratio = DEFAULT_READ_RATIO;
+    system_variables.rcu = 0;
+#ifdef _PartitionedHash_
+    system_variables.owners = DEFAULT_OWNERS;
+#endif
+    system_variables.zipf_theta = 0.0;
+    system_variables.batch_size = DEFAULT_BATCH_SIZE;
+    system_variables.filter = NULL;
+    system_variables.miss_ratio = DEFAULT_MISS_RATIO;
+    system_variables.counters = 0;
+    system_variables.workload = NULL;
+    bench_config_init(&bench_config);
 }
 
 
 int main(int argc, char **argv)
 {
     char c;
+    uint64_t misses;
+    int ret;
+    lock_kind_t lock_kind;
 
     /*
      * init 
@@ -361,13 +836,17 @@ int main(int argc, char **argv)
     init_system_variables();
 
     /* options  */
-#if defined(_Hash_) || (_RefinableHash_) || (_StripedHash_)
-    while ((c = getopt(argc, argv, "t:n:b:vVh")) != -1) {
+#ifdef _Hash_
+    while ((c = getopt(argc, argv, "t:n:b:r:a:Hc:L:Rz:B:M:F:C:W:K:k:p:d:O:TEvVh")) != -1) {
+#elif defined(_RefinableHash_) || (_StripedHash_)
+    while ((c = getopt(argc, argv, "t:n:b:r:a:Hc:L:z:B:M:F:C:W:K:k:p:d:O:TEvVh")) != -1) {
+#elif defined(_PartitionedHash_)
+    while ((c = getopt(argc, argv, "t:n:s:P:r:a:Hc:L:z:B:M:F:C:W:K:k:p:d:O:TEvVh")) != -1) {
 #else
-#if defined(_OpenAddressHash_) || (_CuckooHash_)
-      while ((c = getopt(argc, argv, "t:n:s:vVh")) != -1) {
+#if defined(_OpenAddressHash_) || (_CuckooHash_) || (_LockFreeOpenAddressHash_) || (_BucketizedCuckooHash_) || (_HopscotchHash_)
+      while ((c = getopt(argc, argv, "t:n:s:r:a:Hc:L:z:B:M:F:C:W:K:k:p:d:O:TEvVh")) != -1) {
 #else
-    while ((c = getopt(argc, argv, "t:n:vVh")) != -1) {
+    while ((c = getopt(argc, argv, "t:n:r:a:Hc:L:z:B:M:F:C:W:K:k:p:d:O:TEvVh")) != -1) {
 #endif
 #endif
 	switch (c) {
@@ -377,18 +856,16 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Error: thread number %d is not valid\n",
 			system_variables.thread_num);
 		exit(-1);
-	    } else if (MAX_THREADS <= system_variables.thread_num)
-		system_variables.thread_num = MAX_THREADS;
-
+	    }
 	    break;
 	case 'n':		/* number of item */
-	    system_variables.item_num = strtol(optarg, NULL, 10);
+	    system_variables.item_num = strtoll(optarg, NULL, 10);
 	    if (system_variables.item_num <= 0) {
-		fprintf(stderr, "Error: item number %d is not valid\n",
+		fprintf(stderr, "Error: item number %lld is not valid\n",
 			system_variables.item_num);
 		exit(-1);
-	    } else if (MAX_ITEMS <= system_variables.item_num)
-		system_variables.item_num = MAX_ITEMS;
+	    }
+	    break;
 #if defined(_Hash_) || (_RefinableHash_) || (_StripedHash_)
 	case 'b':		/* initial bucket size */
 	    system_variables.bucket_size = strtol(optarg, NULL, 10);
@@ -400,7 +877,7 @@ int main(int argc, char **argv)
 		system_variables.bucket_size = MAX_BUCKET_SIZE;
 	    break;
 #endif
-#if defined(_OpenAddressHash_) || (_CuckooHash_)
+#if defined(_OpenAddressHash_) || (_CuckooHash_) || (_LockFreeOpenAddressHash_) || (_BucketizedCuckooHash_) || (_HopscotchHash_) || (_PartitionedHash_)
 	case 's':		/* initial table size */
 	    system_variables.table_size = strtol(optarg, NULL, 10);
 	    if (system_variables.table_size <= 0) {
@@ -411,6 +888,118 @@ int main(int argc, char **argv)
 		system_variables.table_size = MAX_TABLE_SIZE;
 	    break;
 #endif
+#ifdef _PartitionedHash_
+	case 'P':		/* number of owner threads */
+	    system_variables.owners = strtol(optarg, NULL, 10);
+	    if (system_variables.owners <= 0) {
+		fprintf(stderr, "Error: owner number %d is not valid\n",
+			system_variables.owners);
+		exit(-1);
+	    }
+	    break;
+#endif
+	case 'r':		/* read ratio */
+	    system_variables.read_ratio = strtol(optarg, NULL, 10);
+	    if (system_variables.read_ratio < 0) {
+		fprintf(stderr, "Error: read ratio %d is not valid\n",
+			system_variables.read_ratio);
+		exit(-1);
+	    } else if (MAX_READ_RATIO <= system_variables.read_ratio)
+		system_variables.read_ratio = MAX_READ_RATIO;
+	    break;
+	case 'a':		/* allocator */
+	    system_variables.allocator = optarg;
+	    break;
+	case 'H':		/* huge pages */
+	    system_variables.hugepage = 1;
+	    break;
+	case 'c':		/* thread placement */
+	    system_variables.affinity = optarg;
+	    break;
+	case 'L':		/* lock */
+	    system_variables.lock = optarg;
+	    break;
+	case 'R':		/* RCU readers */
+	    system_variables.rcu = 1;
+	    break;
+	case 'B':		/* lookup batch size */
+	    system_variables.batch_size = strtol(optarg, NULL, 10);
+	    if (system_variables.batch_size <= 0) {
+		fprintf(stderr, "Error: batch size %d is not valid\n",
+			system_variables.batch_size);
+		exit(-1);
+	    } else if (MAX_BATCH_SIZE <= system_variables.batch_size)
+		system_variables.batch_size = MAX_BATCH_SIZE;
+	    break;
+	case 'M':		/* miss ratio */
+	    system_variables.miss_ratio = strtol(optarg, NULL, 10);
+	    if (system_variables.miss_ratio < 0 || 100 < system_variables.miss_ratio) {
+		fprintf(stderr, "Error: miss ratio %d is not valid\n",
+			system_variables.miss_ratio);
+		exit(-1);
+	    }
+	    break;
+	case 'F':		/* filter */
+	    system_variables.filter = optarg;
+	    break;
+	case 'C':		/* counters */
+	    system_variables.counters = strtol(optarg, NULL, 10);
+	    if (system_variables.counters <= 0) {
+		fprintf(stderr, "Error: counter number %d is not valid\n",
+			system_variables.counters);
+		exit(-1);
+	    } else if (MAX_COUNTERS <= system_variables.counters)
+		system_variables.counters = MAX_COUNTERS;
+	    break;
+	case 'W':		/* workload bench */
+	    system_variables.workload = optarg;
+	    if (bench_parse_mix(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: mix %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'K':		/* key distribution */
+	    if (bench_parse_dist(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: distribution %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'k':		/* key range */
+	    bench_config.key_range = strtoull(optarg, NULL, 10);
+	    if (bench_config.key_range == 0) {
+		fprintf(stderr, "Error: key range %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'p':		/* prefill */
+	    bench_config.prefill = strtoull(optarg, NULL, 10);
+	    break;
+	case 'T':		/* latency histograms */
+	    bench_config.latency = 1;
+	    break;
+	case 'E':		/* hardware counters */
+	    bench_config.counters = 1;
+	    break;
+	case 'O':		/* open-loop rate */
+	    if (bench_parse_rate(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: rate %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'd':		/* duration */
+	    bench_config.duration = strtod(optarg, NULL);
+	    if (bench_config.duration <= 0.0) {
+		fprintf(stderr, "Error: duration %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'z':		/* skewed lookups */
+	    system_variables.zipf_theta = strtod(optarg, NULL);
+	    if (system_variables.zipf_theta <= 0.0) {
+		fprintf(stderr, "Error: zipf theta %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
 	case 'v':               /* verbose 1 */
 	    system_variables.verbose = 1;
 	    break;
@@ -427,14 +1016,51 @@ int main(int argc, char **argv)
 	}
     }
 
+    if ((allocator = allocator_create(system_variables.allocator,
+				      (system_variables.hugepage == 1) ? ALLOC_HUGEPAGE : 0)) == NULL) {
+	fprintf(stderr, "Error: allocator %s is not valid\n",
+		system_variables.allocator);
+	exit(-1);
+    }
+    set_allocator(allocator);
+
+    if ((affinity = affinity_create(system_variables.affinity)) == NULL) {
+	fprintf(stderr, "Error: affinity %s is not valid\n",
+		system_variables.affinity);
+	exit(-1);
+    }
+    bench_config.affinity = affinity;
+
+    if (lock_kind_by_name(system_variables.lock, &lock_kind) != 1) {
+	fprintf(stderr, "Error: lock %s is not valid\n",
+		system_variables.lock);
+	exit(-1);
+    }
+    set_lock_kind(lock_kind);
+
     /*
      * main work 
      */
-    if (workbench() != 0)
+    perf_counter_open(&dtlb_misses, PERF_DTLB_LOAD_MISSES);
+
+    if (system_variables.workload != NULL) {
+      if (workload() != 0)
+	exit(-1);
+    } else if (workbench() != 0)
       abort();
 
+    /* Read after all threads have exited, because their counts are summed at exit. */
+    if ((ret = perf_counter_read(&dtlb_misses, &misses)) != 0)
+      printf ("\tdTLB load misses: %llu%s\n", (unsigned long long int) misses,
+	      (ret == PERF_SCALED) ? " (scaled)" : "");
+    else
+      printf ("\tdTLB load misses: not available\n");
+    perf_counter_close(&dtlb_misses);
+
     free (stat_data);
+    free (result);
     free (work_thread_tptr);
+    affinity_destroy (affinity);
 
     return 0;
 }
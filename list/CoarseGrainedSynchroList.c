@@ -10,34 +10,36 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "common.h"
 #include "CoarseGrainedSynchroList.h"
+#include "registry.h"
 
-#define lock(_mtx_) pthread_mutex_lock(&(_mtx_))
-#define unlock(_mtx_) pthread_mutex_unlock(&(_mtx_))
+#define lock(_list_) lock_acquire((_list_)->lock_kind, &(_list_)->lock)
+#define unlock(_list_) lock_release((_list_)->lock_kind, &(_list_)->lock)
 #ifdef _FREE_
-#define free_node(_node_) free(_node_)
+#define free_node(_a_, _node_) allocator_free((_a_), _node_)
 #else
-#define free_node(_node_) ;
+#define free_node(_a_, _node_) ;
 #endif
 
-static node_t *create_node(const lkey_t, const val_t);
+static node_t *create_node(allocator_t *, const lkey_t, const val_t);
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'.
  *
  * success : return pointer of this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
   node_t *node;
   
-  if ((node = calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((node = allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return NULL;
   }
   node->key = key;
@@ -60,10 +62,10 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
   node_t *newNode;
   bool_t ret = true;
   
-  if ((newNode = create_node(key, val)) == NULL)
+  if ((newNode = create_node(list->allocator, key, val)) == NULL)
     return false;
   
-  lock(list->mtx);
+  lock(list);
   
   pred = list->head;
   curr = pred->next;
@@ -78,7 +80,7 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
     }
     
     if (curr != list->tail && key == curr->key) {
-      free_node(newNode);
+      free_node(list->allocator, newNode);
       ret = false;
     } else {
       newNode->next = curr;
@@ -86,7 +88,10 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
     }
   }
   
-  unlock(list->mtx);
+  unlock(list);
+
+  if (ret == true)
+    counter_inc(&list->setSize);
 
   return ret;
 }
@@ -104,7 +109,7 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
   node_t *pred, *curr;
   bool_t ret = true;
   
-  lock(list->mtx);
+  lock(list);
   
   pred = list->head;
   curr = pred->next;
@@ -121,12 +126,16 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
       *val = curr->val;
       
       pred->next = curr->next;
-      free_node(curr);
+      free_node(list->allocator, curr);
     } else
       ret = false;
   }
   
-  unlock(list->mtx);
+  unlock(list);
+
+  if (ret == true)
+    counter_dec(&list->setSize);
+
   return ret;
 }
 
@@ -143,7 +152,7 @@ bool_t find(list_t * list, const lkey_t key, val_t *val)
   node_t *pred, *curr;
   bool_t ret = true;
   
-  lock(list->mtx);
+  lock(list);
   
   pred = list->head;
   curr = pred->next;
@@ -163,10 +172,20 @@ bool_t find(list_t * list, const lkey_t key, val_t *val)
       ret = false;
   }
   
-  unlock(list->mtx);
+  unlock(list);
   return ret;
 }
 
+/*
+ * int64_t size(list_t * list)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(list_t * list)
+{
+  return counter_read_exact(&list->setSize);
+}
+
 /*
  * list_t *init_list(void)
  *
@@ -183,25 +202,34 @@ list_t *init_list(void)
     elog("calloc error");
     return NULL;
   }
+  list->allocator = get_allocator();
+  list->lock_kind = get_lock_kind();
   
-  if ((list->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->head = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
   
-  if ((list->tail = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->tail = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
   
   list->head->next = list->tail;
   list->tail->next = NULL;
-  list->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+
+  if (lock_init(list->lock_kind, &list->lock) != true)
+    goto end;
+  if (counter_init(&list->setSize) != true) {
+    lock_destroy(list->lock_kind, &list->lock);
+    goto end;
+  }
   
   return list;
   
  end:
-  free(list->head);
+  allocator_free(list->allocator, list->tail);
+  allocator_free(list->allocator, list->head);
   free(list);
   return NULL;
 }
@@ -217,13 +245,14 @@ void free_list(list_t * list)
 
   while (curr != list->tail) {
     next = curr->next;
-    free_node (curr);
+    free_node(list->allocator, curr);
     curr = next;
   }
 
-  free_node(list->head);
-  free_node(list->tail);
-  pthread_mutex_destroy(&list->mtx);
+  free_node(list->allocator, list->head);
+  free_node(list->allocator, list->tail);
+  lock_destroy(list->lock_kind, &list->lock);
+  counter_destroy(&list->setSize);
   free(list);
 }
 
@@ -246,6 +275,46 @@ void show_list(const list_t * l)
     printf("\n");
 }
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list();
+}
+
+static void ops_free(void *l)
+{
+    free_list((list_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((list_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (find((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((list_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t CoarseGrainedSynchroList_ops = {"CoarseGrainedSynchroList", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 #include <string.h>
@@ -266,6 +335,7 @@ int main (int argc, char **argv)
   }  
 
   show_list (list);
+  printf ("size = %lld\n", (long long int) size(list));
 
   for (i = 0; i < 5; i++) {
     delete (list, (lkey_t)i, &g);
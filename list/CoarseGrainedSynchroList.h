@@ -10,6 +10,9 @@
 #define _COARSEGRAINEDSYNCHRO_LIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _node_t
 {
@@ -22,13 +25,26 @@ typedef struct _list_t
 {
   node_t *head;
   node_t *tail;
-  pthread_mutex_t mtx;
+  lock_t lock;           /* lock of the whole list */
+  counter_t setSize;     /* number of nodes */
+  allocator_t *allocator; /* node allocator */
+  lock_kind_t lock_kind;  /* kind of the lock */
 } list_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)        CoarseGrainedSynchroList_add(__VA_ARGS__)
+#define delete(...)     CoarseGrainedSynchroList_delete(__VA_ARGS__)
+#define find(...)       CoarseGrainedSynchroList_find(__VA_ARGS__)
+#define size(...)       CoarseGrainedSynchroList_size(__VA_ARGS__)
+#define init_list(...)  CoarseGrainedSynchroList_init_list(__VA_ARGS__)
+#define free_list(...)  CoarseGrainedSynchroList_free_list(__VA_ARGS__)
+#define show_list(...)  CoarseGrainedSynchroList_show_list(__VA_ARGS__)
+
 bool_t add (list_t *, const lkey_t, const val_t);
 bool_t delete (list_t *, const lkey_t, val_t *);
 bool_t find (list_t *, const lkey_t, val_t *);
+int64_t size (list_t *);
 list_t * init_list (void);
 void free_list (list_t *);
 void show_list(const list_t *);
@@ -1,5 +1,5 @@
 /* ---------------------------------------------------------------------------
- * Fine-Grained Synchronization Singly-linked List: pthread_mutex version
+ * Fine-Grained Synchronization Singly-linked List: lock_t version
  * 
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Oct.25
  * Copyright (C) 2009-2025  suzuki hironobu
@@ -11,37 +11,42 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "FineGrainedSynchroList.h"
+#include "registry.h"
 
-static node_t *create_node(const lkey_t, const val_t);
+static node_t *create_node(list_t *, const lkey_t, const val_t);
 
-#define lock(_mtx_) pthread_mutex_lock(&_mtx_)
-#define unlock(_mtx_) pthread_mutex_unlock(&_mtx_)
+#define lock(_list_, _node_)    lock_acquire((_list_)->lock_kind, &(_node_)->lock)
+#define unlock(_list_, _node_)  lock_release((_list_)->lock_kind, &(_node_)->lock)
 #ifdef _FREE_
-#define free_node(node) do {pthread_mutex_destroy(&node->mtx);\
-    free(node);  }while(0);
+#define free_node(_list_, node) do {lock_destroy((_list_)->lock_kind, &node->lock); \
+    allocator_free((_list_)->allocator, node);  }while(0);
 #else
-#define free_node(node) ;
+#define free_node(_list_, node) ;
 #endif
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(list_t * list, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(list_t * list, const lkey_t key, const val_t val)
 {
     node_t *node;
 
-    if ((node = calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((node = allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
+      return NULL;
+    }
+    if (lock_init(list->lock_kind, &node->lock) != true) {
+      allocator_free(list->allocator, node);
       return NULL;
     }
-    node->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
 
     node->key = key;
     node->val = val;
@@ -64,30 +69,30 @@ bool add(list_t * list, const lkey_t key, const val_t val)
     node_t *newNode;
     bool ret = true;
 
-    if ((newNode = create_node(key, val)) == NULL)
+    if ((newNode = create_node(list, key, val)) == NULL)
       return false;
 
-    lock(list->head->mtx);  /* get lock of list->head. */
+    lock(list, list->head);  /* get lock of list->head. */
 
     pred = list->head;
     curr = pred->next;      /* curr is next node of list->head */
 
-    lock(curr->mtx);        /* get lock of curr */
+    lock(list, curr);        /* get lock of curr */
 
     if (curr == list->tail) {
       /* there is no node in the list */
 	list->head->next = newNode;
 	newNode->next = list->tail;
 
-	unlock(list->head->mtx);
-	unlock(curr->mtx);
+	unlock(list, list->head);
+	unlock(list, curr);
     } else {
 	while (curr != list->tail && curr->key < key) {
 	  /* getting locks of pred and curr */
-	  unlock(pred->mtx);
+	  unlock(list, pred);
 	  /* rename curr to pred. */
 	  pred = curr;  curr = curr->next; 
-	  lock(curr->mtx); 
+	  lock(list, curr); 
 	  /* getting locks of pred and curr. */
 	}
 
@@ -97,17 +102,20 @@ bool add(list_t * list, const lkey_t key, const val_t val)
 
 	if (curr != list->tail && key == curr->key) {  
 	  /* already there is a node has same key. */
-	    free_node(newNode);
+	    free_node(list, newNode);
 	    ret = false;
 	} else {	
 	    /* add node */
 	    newNode->next = curr;
 	    pred->next = newNode;
 	}
-	unlock(pred->mtx);
-	unlock(curr->mtx);
+	unlock(list, pred);
+	unlock(list, curr);
     }
 
+    if (ret == true)
+      counter_inc(&list->setSize);
+
     return ret;
 }
 
@@ -124,24 +132,24 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
     node_t *pred, *curr;
     bool_t ret = true;
 
-    lock(list->head->mtx);  /* get lock of list->head */
+    lock(list, list->head);  /* get lock of list->head */
 
     pred = list->head;
     curr = pred->next;      /* curr is the next node of list->head */
 
-    lock(curr->mtx);        /* get lock of curr */
+    lock(list, curr);        /* get lock of curr */
 
     if (curr == list->tail) {     
       /* there is no node in the list. */
-	unlock(list->head->mtx);
-	unlock(curr->mtx);
+	unlock(list, list->head);
+	unlock(list, curr);
 	ret = false;
     } else {
 	while (curr != list->tail && curr->key < key) {
-	    unlock(pred->mtx);
+	    unlock(list, pred);
 	    pred = curr;
 	    curr = curr->next;
-	    lock(curr->mtx);
+	    lock(list, curr);
 	}
 
 	/* assert((pred->key) < (newNode->key) <= (curr->key)) */
@@ -149,15 +157,18 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
 	  *val = curr->val;
 	  pred->next = curr->next;
 
-	  unlock(curr->mtx);	  free_node(curr); /* release lock of curr, and delete curr node. */
-	  unlock(pred->mtx);	  /* after curr node deletes, release lock of pred. */
+	  unlock(list, curr);	  free_node(list, curr); /* release lock of curr, and delete curr node. */
+	  unlock(list, pred);	  /* after curr node deletes, release lock of pred. */
 	} else {
-	  unlock(pred->mtx);
-	  unlock(curr->mtx);
+	  unlock(list, pred);
+	  unlock(list, curr);
 	  
 	  ret = false;
 	}
     }
+    if (ret == true)
+      counter_dec(&list->setSize);
+
     return ret;
 }
 
@@ -174,24 +185,24 @@ bool_t find(list_t * list, const lkey_t key, val_t *val)
     node_t *pred, *curr;
     bool_t ret = true;
 
-    lock(list->head->mtx);  /* get lock of list->head */
+    lock(list, list->head);  /* get lock of list->head */
 
     pred = list->head;
     curr = pred->next;      /* curr is the next node of list->head */
 
-    lock(curr->mtx);        /* get lock of curr */
+    lock(list, curr);        /* get lock of curr */
 
     if (curr == list->tail) {
       /* there is no node in the list. */
-      unlock(list->head->mtx);
-      unlock(curr->mtx);
+      unlock(list, list->head);
+      unlock(list, curr);
       ret = false;
     } else {
       while (curr != list->tail && curr->key < key) {
-	unlock(pred->mtx);
+	unlock(list, pred);
 	pred = curr;
 	curr = curr->next;
-	lock(curr->mtx);
+	lock(list, curr);
       }
       
       /*
@@ -203,13 +214,24 @@ bool_t find(list_t * list, const lkey_t key, val_t *val)
       else
 	ret = false;
       
-      unlock(pred->mtx);
-      unlock(curr->mtx);
+      unlock(list, pred);
+      unlock(list, curr);
     }
     return ret;
 }
 
 
+/*
+ * int64_t size(list_t * list)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(list_t * list)
+{
+    return counter_read_exact(&list->setSize);
+}
+
+
 /*
  * list_t *init_list(void)
  *
@@ -226,27 +248,32 @@ list_t *init_list(void)
       elog("calloc error");
       return NULL;
     }
+    list->allocator = get_allocator();
+    list->lock_kind = get_lock_kind();
     
-    if ((list->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
-      free (list);
+    if ((list->head = create_node(list, 0, 0)) == NULL)
       goto end;
-    }
-    list->head->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
     
-    if ((list->tail = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((list->tail = create_node(list, 0, 0)) == NULL)
       goto end;
-    }
-    list->tail->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
     
     list->head->next = list->tail;
     list->tail->next = NULL;
+
+    if (counter_init(&list->setSize) != true)
+      goto end;
   
   return list;
 
  end :
-  free (list->head);
+  if (list->tail != NULL) {
+    lock_destroy(list->lock_kind, &list->tail->lock);
+    allocator_free(list->allocator, list->tail);
+  }
+  if (list->head != NULL) {
+    lock_destroy(list->lock_kind, &list->head->lock);
+    allocator_free(list->allocator, list->head);
+  }
   free (list);
   return NULL;
 }
@@ -259,12 +286,15 @@ void free_list(list_t * list)
   while (curr != list->tail)
     {
       next = curr->next;
-      free_node (curr);
+      free_node(list, curr);
       curr = next;
     }
   
-  free(list->head);
-  free(list->tail);
+  lock_destroy(list->lock_kind, &list->head->lock);
+  allocator_free(list->allocator, list->head);
+  lock_destroy(list->lock_kind, &list->tail->lock);
+  allocator_free(list->allocator, list->tail);
+  counter_destroy(&list->setSize);
   free(list);
 }
 
@@ -285,6 +315,46 @@ void show_list(const list_t * l)
     printf("\n");
 }
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list();
+}
+
+static void ops_free(void *l)
+{
+    free_list((list_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((list_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (find((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((list_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t FineGrainedSynchroList_ops = {"FineGrainedSynchroList", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 
@@ -305,6 +375,7 @@ int main (int argc, char **argv)
     }
 
   show_list (list);
+  printf ("size = %lld\n", (long long int) size(list));
 
   for (i = 0; i < 5; i++) {
     delete (list, (lkey_t)i, &g);
@@ -1,5 +1,5 @@
 /* ---------------------------------------------------------------------------
- * Fine-Grained Synchronization Singly-linked List: pthread_mutex version
+ * Fine-Grained Synchronization Singly-linked List: lock_t version
  * 
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Oct.25
  * Copyright (C) 2009-2025  suzuki hironobu
@@ -10,24 +10,40 @@
 #define _FINEGRAINEDSYNCHROLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _node_t
 {
   lkey_t key;           /* key */
   val_t val;            /* value */
   struct _node_t *next; /* pointer to the next node */
-  pthread_mutex_t mtx;  /* lock */
+  lock_t lock;          /* lock */
 } node_t;
 
 typedef struct _list_t
 {
   node_t *head;
   node_t *tail;
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator; /* node allocator */
+  lock_kind_t lock_kind;  /* kind of the node locks */
 } list_t;
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)        FineGrainedSynchroList_add(__VA_ARGS__)
+#define delete(...)     FineGrainedSynchroList_delete(__VA_ARGS__)
+#define find(...)       FineGrainedSynchroList_find(__VA_ARGS__)
+#define size(...)       FineGrainedSynchroList_size(__VA_ARGS__)
+#define init_list(...)  FineGrainedSynchroList_init_list(__VA_ARGS__)
+#define free_list(...)  FineGrainedSynchroList_free_list(__VA_ARGS__)
+#define show_list(...)  FineGrainedSynchroList_show_list(__VA_ARGS__)
+
 bool_t add (list_t *, const lkey_t, const val_t);
 bool_t delete (list_t *, const lkey_t, val_t *);
 bool_t find (list_t *, const lkey_t, val_t *);
+int64_t size (list_t *);
 list_t * init_list (void);
 void free_list (list_t *);
 
@@ -15,18 +15,36 @@
 #include <assert.h>
 
 #include "LazySkiplist.h"
+#include "registry.h"
+#include "stats.h"
 #include "concurrent_skiplist.h"
 
-static skiplist_node_t *create_node(const int, const lkey_t, const val_t);
-static void free_node(skiplist_node_t *);
+static skiplist_node_t *create_node(skiplist_t *, const int, const lkey_t, const val_t);
+static void free_node(skiplist_t *, skiplist_node_t *);
+static void unlock_preds(skiplist_t *, skiplist_node_t **, const int);
 static bool_t _add(skiplist_t *, skiplist_node_t **, skiplist_node_t **, const lkey_t, const val_t);
 static bool_t _delete(skiplist_t *, skiplist_node_t **, skiplist_node_t **, const lkey_t, val_t *);
-static bool_t _find(skiplist_t *, skiplist_node_t **, skiplist_node_t **, const lkey_t);
+static val_t _find(skiplist_t *, skiplist_node_t **, skiplist_node_t **, const lkey_t);
 
 
 
-#define lock(_mtx_)      pthread_mutex_lock(&(_mtx_))
-#define unlock(_mtx_)    pthread_mutex_unlock(&(_mtx_))
+#define lock(_sl_, _node_)      lock_acquire((_sl_)->lock_kind, &(_node_)->lock)
+#define unlock(_sl_, _node_)    lock_release((_sl_)->lock_kind, &(_node_)->lock)
+
+/*
+ * A node may be the predecessor at several levels, and is locked only once:
+ * preds[level] is locked if it differs from preds[level - 1].
+ */
+#define first_pred(_preds_, _level_)  ((_level_) == 0 || (_preds_)[(_level_)] != (_preds_)[(_level_) - 1])
+
+static void unlock_preds(skiplist_t * sl, skiplist_node_t ** preds, const int highestLocked)
+{
+    int level;
+
+    for (level = highestLocked; level >= 0; level--)
+      if (first_pred(preds, level))
+	unlock(sl, preds[level]);
+}
 
 
 /*
@@ -66,6 +84,7 @@ static int search(const skiplist_t * sl, const lkey_t key, skiplist_node_t ** pr
 {
     int lFound, level;
     skiplist_node_t *pred, *curr;
+    STATS_DECLARE(path);
 
     pred = sl->head;
     lFound = -1;
@@ -76,6 +95,7 @@ static int search(const skiplist_t * sl, const lkey_t key, skiplist_node_t ** pr
       while (key > curr->key) {
 	pred = curr;
 	curr = pred->next[level];
+	STATS_COUNT(path);
       }
       
       if (lFound == -1 && key == curr->key)
@@ -85,12 +105,13 @@ static int search(const skiplist_t * sl, const lkey_t key, skiplist_node_t ** pr
       succs[level] = curr;
     }
 
+    STATS_RECORD(STATS_PATH, path);
     return lFound;
 }
 
 
 /*
- * static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+ * static skiplist_node_t *create_node(skiplist_t * sl, const int topLevel, const lkey_t key, const val_t val)
  *
  * Create a node '(key, val)' whose level is 'topLevel'.
  *
@@ -99,15 +120,16 @@ static int search(const skiplist_t * sl, const lkey_t key, skiplist_node_t ** pr
  */
 #define node_size(level)	  (sizeof(skiplist_node_t) + ((level + 1) * sizeof(skiplist_node_t *)))
 
-static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+static skiplist_node_t *create_node(skiplist_t * sl, const int topLevel, const lkey_t key, const val_t val)
 {
     skiplist_node_t *node;
-#ifndef PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
-    pthread_mutexattr_t mtx_attr;
-#endif
 
-    if ((node = (skiplist_node_t *) calloc(1, node_size(topLevel))) == NULL) {
-	elog("calloc error");
+    if ((node = (skiplist_node_t *) allocator_alloc(sl->allocator, node_size(topLevel))) == NULL) {
+	elog("allocator_alloc error");
+	return NULL;
+    }
+    if (lock_init(sl->lock_kind, &node->lock) != true) {
+	allocator_free(sl->allocator, node);
 	return NULL;
     }
 
@@ -115,31 +137,31 @@ static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const
     node->val = val;
     node->topLevel = topLevel;
 
-#ifdef PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP
-    node->mtx = (pthread_mutex_t) PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-#else
-    pthread_mutexattr_init(&mtx_attr);
-#ifdef PTHREAD_MUTEX_RECURSIVE_NP
-    pthread_mutexattr_settype(&mtx_attr, PTHREAD_MUTEX_RECURSIVE_NP);
-#else
-    pthread_mutexattr_settype(&mtx_attr, PTHREAD_MUTEX_RECURSIVE); /* for OSX */
-#endif
-    pthread_mutex_init(&node->mtx, &mtx_attr);
-#endif
-
     node->marked = false;
     node->fullyLinked = false;
 
     return node;
 }
 
-static void free_node(skiplist_node_t * node)
+static void free_node(skiplist_t * sl, skiplist_node_t * node)
 {
 #ifdef _FREE_
-    free(node);
+    lock_destroy(sl->lock_kind, &node->lock);
+    allocator_free(sl->allocator, node);
 #endif
 }
 
+/*
+ * int64_t size(skiplist_t * sl)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(skiplist_t * sl)
+{
+    return counter_read_exact(&sl->setSize);
+}
+
+
 /*
  * skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
  *
@@ -163,14 +185,16 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
     }
 
     sl->maxLevel = maxLevel;
+    sl->allocator = get_allocator();
+    sl->lock_kind = get_lock_kind();
 
-    if ((head = create_node(maxLevel, min, min)) == NULL) {
+    if ((head = create_node(sl, maxLevel, min, min)) == NULL) {
 	elog("create_node() error");
 	goto end;
     }
     head->fullyLinked = true;
 
-    if ((tail = create_node(maxLevel, max, max)) == NULL) {
+    if ((tail = create_node(sl, maxLevel, max, max)) == NULL) {
 	elog("create_node() error");
 	goto end;
     }
@@ -193,18 +217,27 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
 	abort();
     }
 
+    if (counter_init(&sl->setSize) != true)
+      goto end;
+
     return sl;
 
   end:
-    free(sl->head);
+    if (sl->head != NULL) {
+	lock_destroy(sl->lock_kind, &sl->head->lock);
+	allocator_free(sl->allocator, sl->head);
+    }
     free(sl);
     return NULL;
 }
 
 void free_list(skiplist_t * sl)
 {
-    free(sl->head);
-    free(sl->tail);
+    lock_destroy(sl->lock_kind, &sl->head->lock);
+    allocator_free(sl->allocator, sl->head);
+    lock_destroy(sl->lock_kind, &sl->tail->lock);
+    allocator_free(sl->allocator, sl->tail);
+    counter_destroy(&sl->setSize);
     free(sl);
 }
 
@@ -262,6 +295,7 @@ _add(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	  while (nodeFound->fullyLinked != true) {};
 	  return false;
 	}
+	STATS_INC(STATS_RETRY);
 	continue;
       }
       
@@ -275,7 +309,8 @@ _add(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	pred = preds[level];
 	succ = succs[level];
 	
-	lock(pred->mtx);  /* levelによって複数回lockされる可能性がある -> RECURSIVE_MUTEX */
+	if (first_pred(preds, level))
+	  lock(sl, pred);
 	
 	highestLocked = level;
 	valid = (pred->marked != true) && (succ->marked != true)
@@ -283,8 +318,8 @@ _add(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
       }
       
       if (valid != true) {
-	for (level = 0; level <= highestLocked; level++)
-	  unlock(preds[level]->mtx);
+	unlock_preds(sl, preds, highestLocked);
+	STATS_INC(STATS_RETRY);
 	continue;
       }
 
@@ -298,7 +333,7 @@ _add(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
       /*
        * step 3: Add new node to skiplist
        */      
-      newNode = create_node(topLevel, key, val);
+      newNode = create_node(sl, topLevel, key, val);
       
       for (level = 0; level <= topLevel; level++) {
 	newNode->next[level] = succs[level];
@@ -313,8 +348,7 @@ _add(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
      * step 4: Release lock
      */    
     assert(highestLocked == topLevel);
-    for (level = 0; level <= topLevel; level++)
-      unlock(preds[level]->mtx);
+    unlock_preds(sl, preds, topLevel);
     
     return true;
 }
@@ -332,7 +366,10 @@ bool_t add(skiplist_t * sl, const lkey_t key, const val_t val)
 {
   workspace_t *ws = get_workspace(sl); /* Return pointer to the workspace. (Each thread has one workspace.) */
   assert(ws != NULL);
-  return _add(sl, ws->preds, ws->succs, key, val);
+  if (_add(sl, ws->preds, ws->succs, key, val) != true)
+    return false;
+  counter_inc(&sl->setSize);
+  return true;
 }
 
 /*
@@ -349,7 +386,7 @@ _delete(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	const lkey_t key, val_t * val)
 {
     int topLevel = -1;
-    int i, lFound, level, highestLocked;
+    int lFound, level, highestLocked;
     skiplist_node_t *pred, *victim;
     bool_t isMarked = false;
     bool_t valid, flag;
@@ -394,9 +431,9 @@ _delete(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	if (isMarked != true) {
 	  topLevel = victim->topLevel;
 	  
-	  lock(victim->mtx);
+	  lock(sl, victim);
 	  if (victim->marked == true) {
-	    unlock(victim->mtx);
+	    unlock(sl, victim);
 	    return false;
 	  }
 	  victim->marked = true;
@@ -410,13 +447,15 @@ _delete(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	valid = true;
 	for (level = 0; (valid == true) && (level <= topLevel); level++) {
 	  pred = preds[level];
-	  lock(pred->mtx);
+	  if (first_pred(preds, level))
+	    lock(sl, pred);
 	  highestLocked = level;
 	  valid = (pred->marked != true) && (pred->next[level] == victim);
 	}
 	if (valid != true) {
 	  /* If lock of preds[] acquires fail, start over from the beginning. */
-	  for (i = 0; i <= highestLocked; i++)	      unlock(preds[i]->mtx);
+	  unlock_preds(sl, preds, highestLocked);
+	  STATS_INC(STATS_RETRY);
 	  continue;
 	}
 	
@@ -426,9 +465,8 @@ _delete(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
 	for (level = victim->topLevel; level >= 0; level--)
 	  preds[level]->next[level] = victim->next[level];
 	
-	unlock(victim->mtx);
-	for (i = 0; i <= lFound; i++) /* Release locks of preds[] */
-	  unlock(preds[i]->mtx);
+	unlock(sl, victim);
+	unlock_preds(sl, preds, lFound); /* Release locks of preds[] */
 	break;
       }
       else
@@ -436,7 +474,7 @@ _delete(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs,
     }
     
     *val = victim->val;
-    free_node(victim);
+    free_node(sl, victim);
 
     return true;
 }
@@ -454,18 +492,21 @@ bool_t delete(skiplist_t * sl, const lkey_t key, val_t * val)
 {
     workspace_t *ws = get_workspace(sl);
     assert(ws != NULL);
-    return _delete(sl, ws->preds, ws->succs, key, val);
+    if (_delete(sl, ws->preds, ws->succs, key, val) != true)
+      return false;
+    counter_dec(&sl->setSize);
+    return true;
 }
 
 /*
- * bool_t _find(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs, const lkey_t key)
+ * val_t _find(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs, const lkey_t key)
  *
  * Find node'(key, val)' by the key from skiplist 'sl', and write the val to *getval.
  *
  * success : return true
  * failure(not found) : return false
  */
-static bool_t _find(skiplist_t * sl, skiplist_node_t ** preds,
+static val_t _find(skiplist_t * sl, skiplist_node_t ** preds,
 		    skiplist_node_t ** succs, const lkey_t key)
 {
   int lFound;
@@ -516,6 +557,92 @@ val_t find(skiplist_t * sl, const lkey_t key)
 }
 
 
+/* State of a search in flight in find_batch(). */
+typedef struct _search_t {
+  int no;                            /* index of the key; -1 if this slot is idle */
+  int level;                         /* level being traversed */
+  skiplist_node_t *pred;             /* last node whose key is less than the key */
+  skiplist_node_t *curr;             /* prefetched node to examine next */
+} search_t;
+
+static void start_search(skiplist_t * sl, search_t * w, const int no)
+{
+    w->no = no;
+    w->level = sl->maxLevel - 1;
+    w->pred = sl->head;
+    w->curr = w->pred->next[w->level];
+    PREFETCH(w->curr);
+}
+
+/*
+ * int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from skiplist 'sl' without locking. found[i] tells
+ * whether keys[i] is found, and if so, getval[i] is its value.
+ *
+ * BATCH_WIDTH searches run interleaved: each one advances by a single node, prefetches
+ * the next node it will examine, and yields to the others, so that their cache misses
+ * overlap instead of being taken one by one. As in find(), a node counts only if it
+ * is fully linked and not marked.
+ *
+ * return the number of keys found
+ */
+int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    search_t s[BATCH_WIDTH];
+    search_t *w;
+    skiplist_node_t *curr;
+    int i, next = 0, active = 0, ret = 0;
+
+    for (i = 0; i < BATCH_WIDTH; i++) {
+      s[i].no = -1;
+      if (next < n) {
+	start_search(sl, &s[i], next++);
+	active++;
+      }
+    }
+
+    while (0 < active) {
+      for (i = 0; i < BATCH_WIDTH; i++) {
+	w = &s[i];
+	if (w->no < 0)
+	  continue;
+
+	curr = w->curr;
+	if (curr->key < keys[w->no]) {
+	  w->pred = curr;
+	  w->curr = curr->next[w->level];
+	  PREFETCH(w->curr);
+	  continue;
+	}
+	if (0 < w->level) {
+	  w->level--;
+	  w->curr = w->pred->next[w->level];
+	  PREFETCH(w->curr);
+	  continue;
+	}
+
+	if (curr->key == keys[w->no] && curr->fullyLinked == true && curr->marked != true) {
+	  found[w->no] = true;
+	  getval[w->no] = curr->val;
+	  ret++;
+	} else
+	  found[w->no] = false;
+
+	/* This search is done; start the next one in its slot. */
+	if (next < n)
+	  start_search(sl, w, next++);
+	else {
+	  w->no = -1;
+	  active--;
+	}
+      }
+    }
+
+    return ret;
+}
+
+
 void show_list(skiplist_t * sl)
 {
     int i;
@@ -538,6 +665,45 @@ void show_list(skiplist_t * sl)
 
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list(4, INT_MIN, INT_MAX);
+}
+
+static void ops_free(void *l)
+{
+    free_list((skiplist_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((skiplist_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((skiplist_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((skiplist_t *) l, (lkey_t) key) != (val_t) NULL) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((skiplist_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t LazySkiplist_ops = {"LazySkiplist", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 int main(int argc, char **argv)
@@ -560,6 +726,7 @@ int main(int argc, char **argv)
     }
 
     show_list(sl);
+    printf("size = %lld\n", (long long int) size(sl));
 
     for (i = t - 1; 1 <= i; i--) {
 	if (!delete(sl, nums[i], &gval))
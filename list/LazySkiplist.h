@@ -12,6 +12,9 @@
 #define _LAZYSKIPLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _skiplist_node_t {
   lkey_t key;                        /* key */
@@ -22,7 +25,7 @@ typedef struct _skiplist_node_t {
   bool_t marked;		     /* Logical delete flag */
   bool_t fullyLinked;
 
-  pthread_mutex_t mtx;
+  lock_t lock;
   struct _skiplist_node_t *next[1];  /* pointer to the next node */
 } skiplist_node_t;
 
@@ -32,6 +35,10 @@ typedef struct _skiplist_t {
   skiplist_node_t *tail;
 
   pthread_key_t workspace_key; 
+
+  counter_t setSize;                  /* number of nodes */
+  allocator_t *allocator;             /* node allocator */
+  lock_kind_t lock_kind;              /* kind of the node locks */
 } skiplist_t;
 
 typedef struct _workspace_t { 
@@ -40,9 +47,21 @@ typedef struct _workspace_t {
 } workspace_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)         LazySkiplist_add(__VA_ARGS__)
+#define delete(...)      LazySkiplist_delete(__VA_ARGS__)
+#define find(...)        LazySkiplist_find(__VA_ARGS__)
+#define find_batch(...)  LazySkiplist_find_batch(__VA_ARGS__)
+#define size(...)        LazySkiplist_size(__VA_ARGS__)
+#define show_list(...)   LazySkiplist_show_list(__VA_ARGS__)
+#define init_list(...)   LazySkiplist_init_list(__VA_ARGS__)
+#define free_list(...)   LazySkiplist_free_list(__VA_ARGS__)
+
 bool_t add(skiplist_t *, const lkey_t, const val_t);
 bool_t delete(skiplist_t *, const lkey_t, val_t *);
 val_t find(skiplist_t *, const lkey_t);
+int find_batch(skiplist_t *, const lkey_t *, const int, val_t *, bool_t *);
+int64_t size(skiplist_t *);
 void show_list(skiplist_t *);
 skiplist_t *init_list(const int, const lkey_t, const lkey_t);
 void free_list(skiplist_t *);
@@ -1,5 +1,5 @@
 /* ---------------------------------------------------------------------------
- * Lazy Synchronization Singly-linked List: pthread_mutex version
+ * Lazy Synchronization Singly-linked List: lock_t version
  * 
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Oct.25
  * Copyright (C) 2009-2025  suzuki hironobu
@@ -15,43 +15,48 @@
 #include <pthread.h>
 
 #include "LazySynchroList.h"
+#include "registry.h"
+#include "stats.h"
 
-static node_t *create_node(const lkey_t, const val_t);
+static node_t *create_node(list_t *, const lkey_t, const val_t);
 
-#define lock(mtx) pthread_mutex_lock(mtx)
-#define unlock(mtx) pthread_mutex_unlock(mtx)
+#define lock(_list_, _node_)    lock_acquire((_list_)->lock_kind, &(_node_)->lock)
+#define unlock(_list_, _node_)  lock_release((_list_)->lock_kind, &(_node_)->lock)
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(list_t * l, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(list_t * l, const lkey_t key, const val_t val)
 {
   node_t *node;
   
-  if ((node = calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error ");
+  if ((node = allocator_alloc(l->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
+    return NULL;
+  }
+  if (lock_init(l->lock_kind, &node->lock) != true) {
+    allocator_free(l->allocator, node);
     return NULL;
   }
     
   node->key = key;
   node->val = val;
   node->marked = false;
-  node->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
 
   return node;
 }
 
 #ifdef _FREE_
-#define free_node(_node)   do {			                  \
-                            pthread_mutex_destroy(&(_node->mtx));  \
-			    free(_node);}while(0);
+#define free_node(_l_, _node)   do {			                  \
+                            lock_destroy((_l_)->lock_kind, &(_node->lock));  \
+			    allocator_free((_l_)->allocator, _node);}while(0);
 #else
-#define free_node(_node)  ;
+#define free_node(_l_, _node)  ;
 #endif
 
 
@@ -71,7 +76,7 @@ bool_t add(list_t * l, const lkey_t key, const val_t val)
     node_t *newNode;
     bool_t ret = true;
 
-    if ((newNode = create_node(key, val)) == NULL)
+    if ((newNode = create_node(l, key, val)) == NULL)
       return false;
 
     while (1) {
@@ -89,13 +94,8 @@ bool_t add(list_t * l, const lkey_t key, const val_t val)
        * another thread does something (changes node, adds node, delete curr or pred).
        */
       
-      /* If lock acquires fail, start over from the beginning. */
-      if (lock(&pred->mtx) != 0) {
-	continue;
-      } else if (lock(&curr->mtx) != 0) {
-	unlock(&pred->mtx);
-	continue;
-      }
+      lock(l, pred);
+      lock(l, curr);
       
       assert ((pred->key < key) && (key <= curr->key));
       
@@ -103,17 +103,21 @@ bool_t add(list_t * l, const lkey_t key, const val_t val)
       if (validate(pred, curr)) {
 	if (key == curr->key) {
 	  ret = false;
-	  free_node(newNode);
+	  free_node(l, newNode);
 	} else {
 	  newNode->next = curr;
 	  pred->next = newNode;
 	}
 	/* end critical section */
-	unlock(&pred->mtx);	unlock(&curr->mtx);
+	unlock(l, pred);	unlock(l, curr);
 	break;
       }
-      unlock(&pred->mtx);      unlock(&curr->mtx);
+      unlock(l, pred);      unlock(l, curr);
+      STATS_INC(STATS_RETRY);
     }
+    if (ret == true)
+      counter_inc(&l->setSize);
+
     return ret;
 }
 
@@ -147,15 +151,11 @@ bool_t delete(list_t * l, const lkey_t key, val_t *val)
        * During this period, there is a possibility that 
        * another thread does something (changes node, adds node, delete curr or pred).
        */
-      /* If lock acquires fail, start over from the beginning. */
-      if (lock(&pred->mtx) != 0) {
-	continue;
-      } else if (lock(&curr->mtx) != 0) {
-	unlock(&pred->mtx);
-	continue;
-      }
+      lock(l, pred);
+      lock(l, curr);
       if (!(pred->key < key) || !(key <= curr->key)) {
-	unlock(&pred->mtx);	unlock(&curr->mtx);
+	unlock(l, pred);	unlock(l, curr);
+	STATS_INC(STATS_RETRY);
 	continue;
       }
 
@@ -167,17 +167,22 @@ bool_t delete(list_t * l, const lkey_t key, val_t *val)
 	  curr->marked = true;
 	  *val = curr->val;
 	  pred->next = curr->next;
-	  free_node(curr);
 	} else {
 	  ret = false;
 	}
 	/* end critical section */
-	unlock(&pred->mtx);	unlock(&curr->mtx);
+	unlock(l, pred);	unlock(l, curr);
+	if (ret == true)
+	  free_node(l, curr);
 	break;
       }
-      unlock(&pred->mtx);      unlock(&curr->mtx);
+      unlock(l, pred);      unlock(l, curr);
+      STATS_INC(STATS_RETRY);
     }
   }
+  if (ret == true)
+    counter_dec(&l->setSize);
+
   return ret;
 }
 
@@ -203,6 +208,16 @@ bool_t find(const list_t * list, const lkey_t key)
     return (curr->key == key && !curr->marked);
 }
 
+/*
+ * int64_t size(list_t * list)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(list_t * list)
+{
+  return counter_read_exact(&list->setSize);
+}
+
 list_t *init_list(void)
 {
   list_t *list;
@@ -211,18 +226,14 @@ list_t *init_list(void)
     elog("calloc error");
     return NULL;
   }
+  list->allocator = get_allocator();
+  list->lock_kind = get_lock_kind();
   
-  if ((list->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->head = create_node(list, 0, 0)) == NULL)
     goto end;
-  }
-  list->head->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
   
-  if ((list->tail = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->tail = create_node(list, 0, 0)) == NULL)
     goto end;
-  }
-  list->tail->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
   
   list->head->next = list->tail;
   list->tail->next = NULL;
@@ -230,10 +241,20 @@ list_t *init_list(void)
   list->head->key = INT_MIN;
   list->tail->key = INT_MAX;
 
+    if (counter_init(&list->setSize) != true)
+      goto end;
+
     return list;
 
  end:
-    free (list->head);
+    if (list->tail != NULL) {
+      lock_destroy(list->lock_kind, &list->tail->lock);
+      allocator_free(list->allocator, list->tail);
+    }
+    if (list->head != NULL) {
+      lock_destroy(list->lock_kind, &list->head->lock);
+      allocator_free(list->allocator, list->head);
+    }
     free (list);
     return NULL;
 }
@@ -246,12 +267,16 @@ void free_list(list_t * list)
   while (curr != list->tail)
     {
       next = curr->next;
-      free (curr);
+      lock_destroy(list->lock_kind, &curr->lock);
+      allocator_free(list->allocator, curr);
       curr = next;
     }
   
-  free(list->head);
-  free(list->tail);
+  lock_destroy(list->lock_kind, &list->head->lock);
+  allocator_free(list->allocator, list->head);
+  lock_destroy(list->lock_kind, &list->tail->lock);
+  allocator_free(list->allocator, list->tail);
+  counter_destroy(&list->setSize);
   free(list);
 }
 
@@ -271,6 +296,45 @@ void show_list(const list_t * list)
     printf("\n");
 }
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list();
+}
+
+static void ops_free(void *l)
+{
+    free_list((list_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((list_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((list_t *) l, (lkey_t) key) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((list_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t LazySynchroList_ops = {"LazySynchroList", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 
@@ -291,6 +355,7 @@ int main (int argc, char **argv)
     }
 
   show_list (list);
+  printf ("size = %lld\n", (long long int) size(list));
 
   for (i = 0; i < 5; i++) {
     delete (list, (lkey_t)i, &g);
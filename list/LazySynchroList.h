@@ -1,5 +1,5 @@
 /* ---------------------------------------------------------------------------
- * Lazy Synchronization Singly-linked List: pthread_mutex version
+ * Lazy Synchronization Singly-linked List: lock_t version
  * 
  * author: suzuki hironobu (hironobu@interdb.jp) 2009.Oct.25
  * Copyright (C) 2009-2025  suzuki hironobu
@@ -10,13 +10,16 @@
 #define _LAZYSYNCROLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
+#include "lock.h"
 
 typedef struct _node_t
 {
   lkey_t key;           /* key */
   val_t val;            /* value */
   bool_t marked;        /* Logical delete flag */
-  pthread_mutex_t mtx;  /* mutex lock */
+  lock_t lock;          /* lock */
   struct _node_t *next; /* pointer to the next node */
 } node_t;
 
@@ -24,12 +27,25 @@ typedef struct _list_t
 {
   node_t *head;
   node_t *tail;
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator; /* node allocator */
+  lock_kind_t lock_kind;  /* kind of the node locks */
 } list_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)        LazySynchroList_add(__VA_ARGS__)
+#define delete(...)     LazySynchroList_delete(__VA_ARGS__)
+#define find(...)       LazySynchroList_find(__VA_ARGS__)
+#define size(...)       LazySynchroList_size(__VA_ARGS__)
+#define init_list(...)  LazySynchroList_init_list(__VA_ARGS__)
+#define free_list(...)  LazySynchroList_free_list(__VA_ARGS__)
+#define show_list(...)  LazySynchroList_show_list(__VA_ARGS__)
+
 bool_t add (list_t *, const lkey_t, const val_t);
 bool_t delete (list_t *, const lkey_t, val_t *);
 bool_t find (const list_t *, const lkey_t);
+int64_t size (list_t *);
 list_t * init_list (void);
 void free_list (list_t *);
 void show_list(const list_t *);
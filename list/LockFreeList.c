@@ -17,8 +17,10 @@
 #include <assert.h>
 
 #include "LockFreeList.h"
+#include "registry.h"
+#include "stats.h"
 
-static node_t *create_node(const lkey_t, const val_t);
+static node_t *create_node(allocator_t *, const lkey_t, const val_t);
 static void helpFlagged (node_t *, node_t *);
 
 
@@ -32,6 +34,7 @@ cas(next_ref *addr, const next_ref oldp, const next_ref newp)
 		       :"m"(*(volatile next_ref *)addr), "a"(oldp.mark), "d"(oldp.node_ptr),
 			"b"(newp.mark), "c"(newp.node_ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #else
@@ -43,30 +46,31 @@ cas(next_ref *addr, const next_ref oldp, const next_ref newp)
 		       :"m"(*addr), "a"(oldp.mark), "d"(oldp.node_ptr),
 			"b"(newp.mark), "c"(newp.node_ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #endif
 
 #ifdef _FREE_
-#define free_node(_node_) free(_node_)
+#define free_node(_a_, _node_) allocator_free((_a_), _node_)
 #else
-#define free_node(_node_) ;
+#define free_node(_a_, _node_) ;
 #endif
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
     node_t *node;
 
-    if ((node = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((node = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
       return NULL;
     }
 
@@ -141,7 +145,7 @@ static node_t *search(list_t *list, const lkey_t key)
   node_t *curr, *next;
   if (searchFrom2(key, list->head, &curr, &next) != true)
     return NULL;
-  return curr;
+  return next;                  /* curr->key < key <= next->key */
 }
 
 
@@ -167,7 +171,7 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
     if (prev_node->key == key)
       return false;
     
-    if ((newNode = create_node(key, val)) == NULL)
+    if ((newNode = create_node(list->allocator, key, val)) == NULL)
       return false;
     
     while (1) {
@@ -180,6 +184,7 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
 	newNode->succ = make_ref(next_node, UNMARKED, UNFLAGGED);
 	if (cas(&prev_node->succ, make_ref(next_node, UNMARKED, UNFLAGGED), 
 		make_ref(newNode, UNMARKED, UNFLAGGED)) == true) {
+	  counter_inc(&list->setSize);
 	  return true;
 	}
 	else {
@@ -194,10 +199,11 @@ bool_t add(list_t * list, const lkey_t key, const val_t val)
 	}
       }
       
+      STATS_INC(STATS_RETRY);
       searchFrom2(key, list->head, &prev_node, &next_node);
       
       if (prev_node->key == key) {
-	free (newNode);
+	allocator_free(list->allocator, newNode);
 	return false;
       }
     }
@@ -237,6 +243,7 @@ tryFlag (node_t *prev_node, node_t *target_node, node_t **result_node)
     while (is_marked_ref(prev_node->succ)) {
       prev_node = prev_node->backlink;
     }
+    STATS_INC(STATS_RETRY);
   }
 
   searchFrom2(target_node->key, prev_node, &prev_node, &del_node);
@@ -309,7 +316,8 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
     return false;
 
   *val = del_node->val;
-  free_node(del_node);
+  free_node(list->allocator, del_node);
+  counter_dec(&list->setSize);
     
   return true;
 }
@@ -356,6 +364,17 @@ void show_list(const list_t * list)
 }
 
 
+/*
+ * int64_t size(list_t * list)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(list_t * list)
+{
+  return counter_read_exact(&list->setSize);
+}
+
+
 /*
  * list_t *init_list(void)
  *
@@ -372,14 +391,15 @@ list_t *init_list(void)
     elog("calloc error");
     return NULL;
   }
+  list->allocator = get_allocator();
   
-  if ((list->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->head = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
   
-  if ((list->tail = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->tail = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
 
@@ -391,10 +411,14 @@ list_t *init_list(void)
   list->tail->succ.mark = UNMARKED;
   list->tail->succ.node_ptr = NULL;
 
+  if (counter_init(&list->setSize) != true)
+    goto end;
+
   return list;
 
  end:
-  free (list->head);
+  allocator_free(list->allocator, list->tail);
+  allocator_free(list->allocator, list->head);
   free (list);
   return NULL;
 }
@@ -407,16 +431,56 @@ void free_list(list_t * list)
 
   while (curr != list->tail) {
     next = (node_t *)curr->succ.node_ptr;
-    free_node (curr);
+    free_node(list->allocator, curr);
     curr = next;
   }
 
-  free_node(list->head);
-  free_node(list->tail);
+  free_node(list->allocator, list->head);
+  free_node(list->allocator, list->tail);
+  counter_destroy(&list->setSize);
   free(list);
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list();
+}
+
+static void ops_free(void *l)
+{
+    free_list((list_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((list_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((list_t *) l, (lkey_t) key) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((list_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t LockFreeList_ops = {"LockFreeList", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 
@@ -436,6 +500,7 @@ int main (int argc, char **argv)
       add (list, (lkey_t)i, (val_t) i);
       show_list (list);
     }
+  printf ("size = %lld\n", (long long int) size(list));
 
   for (i = 0; i < 10; i++) {
     delete (list, (lkey_t)i, &g);
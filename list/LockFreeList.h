@@ -14,6 +14,8 @@
 #define _LOCKFREELIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 #define MARKED        0x00000001
 #define UNMARKED      0x00000000
@@ -42,11 +44,23 @@ typedef struct _list_t
 {
   node_t *head;
   node_t *tail;
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator; /* node allocator */
 } list_t;
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)        LockFreeList_add(__VA_ARGS__)
+#define delete(...)     LockFreeList_delete(__VA_ARGS__)
+#define find(...)       LockFreeList_find(__VA_ARGS__)
+#define size(...)       LockFreeList_size(__VA_ARGS__)
+#define init_list(...)  LockFreeList_init_list(__VA_ARGS__)
+#define free_list(...)  LockFreeList_free_list(__VA_ARGS__)
+#define show_list(...)  LockFreeList_show_list(__VA_ARGS__)
+
 bool_t add (list_t *, const lkey_t, const val_t);
 bool_t delete (list_t *, const lkey_t, val_t *);
 bool_t find (list_t *, const lkey_t);
+int64_t size (list_t *);
 list_t * init_list (void);
 void free_list (list_t *);
 
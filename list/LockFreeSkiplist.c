@@ -16,6 +16,8 @@
 #include <assert.h>
 
 #include "LockFreeSkiplist.h"
+#include "registry.h"
+#include "stats.h"
 #include "concurrent_skiplist.h"
 
 static inline bool_t 
@@ -31,6 +33,8 @@ cas(volatile tower_ref * addr, const tower_ref oldp,
 			 "c"(newp.next_node_ptr)
 			 :"memory");
 
+    STATS_CAS_RESULT(result != 0);
+
     return (((int) result != 0) ? true : false);
 }
 #else
@@ -45,6 +49,8 @@ cas(volatile tower_ref * addr, const tower_ref oldp,
 			 "c"(newp.next_node_ptr)
 			 :"memory");
 
+    STATS_CAS_RESULT(result != 0);
+
     return (((int) result != 0) ? true : false);
 }
 #endif
@@ -98,6 +104,7 @@ static bool_t search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds
     skiplist_node_t *pred, *curr, *succ;
     bool_t snip;
     node_stat marked;
+    STATS_DECLARE(path);
 
   retry:
     while (1) {
@@ -116,8 +123,10 @@ static bool_t search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds
 			      make_ref(curr, UNMARKED), make_ref(succ,
 								 UNMARKED));
 
-		    if (snip != true)
+		    if (snip != true) {
+			STATS_INC(STATS_RETRY);
 			goto retry;
+		    }
 
 		    curr = pred->tower[level].next_node_ptr;
 		    succ = curr->tower[level].next_node_ptr;
@@ -127,6 +136,7 @@ static bool_t search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds
 		if (key > curr->key) {
 		    pred = curr;
 		    curr = succ;
+		    STATS_COUNT(path);
 		} else
 		    break;
 	    }			// end while(1)
@@ -135,6 +145,7 @@ static bool_t search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds
 	    succs[level] = curr;
 	}			// end for()
 
+	STATS_RECORD(STATS_PATH, path);
 	return (curr->key == key ? true : false);
     }				// end while(1)
 
@@ -143,37 +154,32 @@ static bool_t search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds
 
 
 /*
- * skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+ * skiplist_node_t *create_node(allocator_t * a, const int topLevel, const lkey_t key, const val_t val)
  *
  * Create a node '(key, val)' whose level is 'topLevel'.
+ * The tower is allocated in the same block, just after the node.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
 
-#define node_size(level)	  (sizeof(skiplist_node_t) + (level * sizeof(skiplist_node_t *)))
+#define node_size(level)	  (sizeof(skiplist_node_t) + ((level + 1) * sizeof(tower_ref)))
 
-static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+static skiplist_node_t *create_node(allocator_t * a, const int topLevel, const lkey_t key, const val_t val)
 {
     skiplist_node_t *node;
     int level;
 
-    if ((node = (skiplist_node_t *) calloc(1, node_size(topLevel))) == NULL) {
-      elog("calloc error");
+    if ((node = (skiplist_node_t *) allocator_alloc(a, node_size(topLevel))) == NULL) {
+      elog("allocator_alloc error");
       return NULL;
     }
 
     node->key = key;
     node->val = val;
     node->topLevel = topLevel;
+    node->tower = (tower_ref *) (node + 1);
 
-    if ((node->tower =
-	 (tower_ref *) calloc(1, sizeof(tower_ref) * (topLevel + 1))) ==
-	NULL) {
-      elog("calloc error");
-	free(node);
-	return NULL;
-    }
     for (level = 0; level < topLevel; level++) {
 	node->tower[level].next_node_ptr = NULL;
 	node->tower[level].mark = UNMARKED;
@@ -182,14 +188,24 @@ static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const
     return node;
 }
 
-static void free_node(skiplist_node_t * node)
+static void free_node(allocator_t * a, skiplist_node_t * node)
 {
 #ifdef _FREE_
-      free(node->tower);
-      free(node);
+      allocator_free(a, node);
 #endif
 }
 
+/*
+ * int64_t size(skiplist_t * sl)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(skiplist_t * sl)
+{
+    return counter_read_exact(&sl->setSize);
+}
+
+
 /*
  * skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
  *
@@ -214,13 +230,14 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
     }
 
     sl->maxLevel = maxLevel;
+    sl->allocator = get_allocator();
 
-    if ((head = create_node(maxLevel, min, min)) == NULL) {
+    if ((head = create_node(sl->allocator, maxLevel, min, min)) == NULL) {
       elog("create_node() error");
       goto end;
     }
 
-    if ((tail = create_node(maxLevel, max, max)) == NULL) {
+    if ((tail = create_node(sl->allocator, maxLevel, max, max)) == NULL) {
       elog("create_node() error");
       goto end;
     }
@@ -239,22 +256,17 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
     }
 
 
+    if (counter_init(&sl->setSize) != true)
+      goto end;
+
     return sl;
  end:
-    free(sl->head);
+    allocator_free(sl->allocator, sl->head);
     free(sl);
     return NULL;
 }
 
 
-void free_skiplist(skiplist_t * sl)
-{
-    free_node(sl->head);
-    free_node(sl->tail);
-    free(sl);
-}
-
-
 static bool_t _add(skiplist_t * sl, skiplist_node_t ** preds,
 	 skiplist_node_t ** succs, const lkey_t key, const val_t val)
 {
@@ -270,7 +282,7 @@ static bool_t _add(skiplist_t * sl, skiplist_node_t ** preds,
 	if (search(sl, key, preds, succs) == true)
 	    return false;
 
-	newNode = create_node(topLevel, key, val);
+	newNode = create_node(sl->allocator, topLevel, key, val);
 
 	for (level = bottomLevel; level <= topLevel; level++) {
 	    newNode->tower[level].next_node_ptr = succs[level];
@@ -285,8 +297,10 @@ static bool_t _add(skiplist_t * sl, skiplist_node_t ** preds,
 	if (cas
 	    (&(*pred).tower[bottomLevel], make_ref(succ, UNMARKED),
 	     make_ref(newNode, UNMARKED))
-	    == false)
+	    == false) {
+	    STATS_INC(STATS_RETRY);
 	    continue;
+	}
 
 	for (level = bottomLevel + 1; level <= topLevel; level++) {
 	    while (1) {
@@ -317,7 +331,10 @@ bool_t add(skiplist_t * sl, const lkey_t key, const val_t val)
 {
     workspace_t *ws = get_workspace(sl);
     assert(ws != NULL);
-    return _add(sl, ws->preds, ws->succs, key, val);
+    if (_add(sl, ws->preds, ws->succs, key, val) != true)
+      return false;
+    counter_inc(&sl->setSize);
+    return true;
 }
 
 
@@ -364,7 +381,7 @@ static bool_t _delete(skiplist_t * sl, skiplist_node_t ** preds,
 	    if (iMarkedIt == true) {
 		search(sl, key, preds, succs);
 		*val = victim->val;
-		free_node(victim);
+		free_node(sl->allocator, victim);
 		return true;
 	    } else if (marked == MARKED)
 		return false;
@@ -386,10 +403,18 @@ bool_t delete(skiplist_t * sl, const lkey_t key, val_t * val)
 {
     workspace_t *ws = get_workspace(sl);
     assert(ws != NULL);
-    return _delete(sl, ws->preds, ws->succs, key, val);
+    if (_delete(sl, ws->preds, ws->succs, key, val) != true)
+      return false;
+    counter_dec(&sl->setSize);
+    return true;
 }
 
 
+/*
+ * bool_t _find(skiplist_t * sl, skiplist_node_t ** preds, skiplist_node_t ** succs, const lkey_t key)
+ *
+ * Wait-free search: marked nodes are stepped over, not snipped.
+ */
 static bool_t _find(skiplist_t * sl, skiplist_node_t ** preds,
 	      skiplist_node_t ** succs, const lkey_t key)
 {
@@ -397,13 +422,13 @@ static bool_t _find(skiplist_t * sl, skiplist_node_t ** preds,
     int bottomLevel = 0;
     skiplist_node_t *pred, *curr, *succ;
     node_stat marked = false;
-
+    STATS_DECLARE(path);
 
     pred = sl->head;
     curr = NULL;
     succ = NULL;
 
-    for (level = sl->maxLevel; level >= bottomLevel; level--) {
+    for (level = sl->maxLevel - 1; level >= bottomLevel; level--) {
 	curr = pred->tower[level].next_node_ptr;
 
 	while (1) {
@@ -411,7 +436,7 @@ static bool_t _find(skiplist_t * sl, skiplist_node_t ** preds,
 	    marked = curr->tower[level].mark;
 
 	    while (marked == MARKED) {
-		curr = pred->tower[level].next_node_ptr;
+		curr = succ;
 		succ = curr->tower[level].next_node_ptr;
 		marked = curr->tower[level].mark;
 	    }
@@ -419,11 +444,13 @@ static bool_t _find(skiplist_t * sl, skiplist_node_t ** preds,
 	    if (curr->key < key) {
 		pred = curr;
 		curr = succ;
+		STATS_COUNT(path);
 	    } else
 		break;
 	}			// end while(1)
     }
 
+    STATS_RECORD(STATS_PATH, path);
     return (curr->key == key ? true : false);
 }
 
@@ -444,10 +471,101 @@ val_t find(skiplist_t * sl, const lkey_t key)
 }
 
 
+/* State of a search in flight in find_batch(). */
+typedef struct _search_t {
+  int no;                            /* index of the key; -1 if this slot is idle */
+  int level;                         /* level being traversed */
+  skiplist_node_t *pred;             /* last node whose key is less than the key */
+  skiplist_node_t *curr;             /* prefetched node to examine next */
+} search_t;
+
+static void start_search(skiplist_t * sl, search_t * w, const int no)
+{
+    w->no = no;
+    w->level = sl->maxLevel - 1;
+    w->pred = sl->head;
+    w->curr = w->pred->tower[w->level].next_node_ptr;
+    PREFETCH(w->curr);
+}
+
+/*
+ * int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from skiplist 'sl'. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value.
+ *
+ * BATCH_WIDTH wait-free searches run interleaved: each one advances by a single node
+ * (stepping over marked ones as _find() does), prefetches the next node it will
+ * examine, and yields to the others, so that their cache misses overlap.
+ *
+ * return the number of keys found
+ */
+int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    search_t s[BATCH_WIDTH];
+    search_t *w;
+    skiplist_node_t *curr;
+    int i, next = 0, active = 0, ret = 0;
+
+    for (i = 0; i < BATCH_WIDTH; i++) {
+      s[i].no = -1;
+      if (next < n) {
+	start_search(sl, &s[i], next++);
+	active++;
+      }
+    }
+
+    while (0 < active) {
+      for (i = 0; i < BATCH_WIDTH; i++) {
+	w = &s[i];
+	if (w->no < 0)
+	  continue;
+
+	curr = w->curr;
+	if (curr->tower[w->level].mark == MARKED) {
+	  w->curr = curr->tower[w->level].next_node_ptr;
+	  PREFETCH(w->curr);
+	  continue;
+	}
+	if (curr->key < keys[w->no]) {
+	  w->pred = curr;
+	  w->curr = curr->tower[w->level].next_node_ptr;
+	  PREFETCH(w->curr);
+	  continue;
+	}
+	if (0 < w->level) {
+	  w->level--;
+	  w->curr = w->pred->tower[w->level].next_node_ptr;
+	  PREFETCH(w->curr);
+	  continue;
+	}
+
+	if (curr->key == keys[w->no]) {
+	  found[w->no] = true;
+	  getval[w->no] = curr->val;
+	  ret++;
+	} else
+	  found[w->no] = false;
+
+	/* This search is done; start the next one in its slot. */
+	if (next < n)
+	  start_search(sl, w, next++);
+	else {
+	  w->no = -1;
+	  active--;
+	}
+      }
+    }
+
+    return ret;
+}
+
+
 void free_list(skiplist_t * sl)
 {
-    free_node(sl->tail);
-    free_node(sl->head);
+    free_node(sl->allocator, sl->tail);
+    free_node(sl->allocator, sl->head);
+    counter_destroy(&sl->setSize);
     free(sl);
 }
 
@@ -483,6 +601,45 @@ void show_list(skiplist_t * sl)
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list(4, INT_MIN, INT_MAX);
+}
+
+static void ops_free(void *l)
+{
+    free_list((skiplist_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((skiplist_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((skiplist_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((skiplist_t *) l, (lkey_t) key) != (val_t) NULL) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((skiplist_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t LockFreeSkiplist_ops = {"LockFreeSkiplist", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 int main(int argc, char **argv)
@@ -502,6 +659,7 @@ int main(int argc, char **argv)
       add(sl, (nums[i] = i), i);
       printf("add %d\n", nums[i]);
       show_list(sl);
+      printf("size = %lld\n", (long long int) size(sl));
     }
 
     show_list(sl);
@@ -515,7 +673,7 @@ int main(int argc, char **argv)
     }
 
     free(nums);
-    free_skiplist(sl);
+    free_list(sl);
 
     return 0;
 }
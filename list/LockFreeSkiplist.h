@@ -13,6 +13,8 @@
 #define _LOCKFREESKIPLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 typedef intptr_t node_stat;
 #define MARKED  0
@@ -39,6 +41,9 @@ typedef struct _skiplist_t {
   skiplist_node_t *tail;
 
   pthread_key_t workspace_key;
+
+  counter_t setSize;                  /* number of nodes */
+  allocator_t *allocator;             /* node allocator */
 } skiplist_t;
 
 
@@ -48,9 +53,21 @@ typedef struct _workspace_t {
 } workspace_t;
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)         LockFreeSkiplist_add(__VA_ARGS__)
+#define delete(...)      LockFreeSkiplist_delete(__VA_ARGS__)
+#define find(...)        LockFreeSkiplist_find(__VA_ARGS__)
+#define find_batch(...)  LockFreeSkiplist_find_batch(__VA_ARGS__)
+#define size(...)        LockFreeSkiplist_size(__VA_ARGS__)
+#define show_list(...)   LockFreeSkiplist_show_list(__VA_ARGS__)
+#define init_list(...)   LockFreeSkiplist_init_list(__VA_ARGS__)
+#define free_list(...)   LockFreeSkiplist_free_list(__VA_ARGS__)
+
 bool_t add(skiplist_t *, const lkey_t, const val_t);
 bool_t delete(skiplist_t *, const lkey_t, val_t *);
 val_t find(skiplist_t *, const lkey_t);
+int find_batch(skiplist_t *, const lkey_t *, const int, val_t *, bool_t *);
+int64_t size(skiplist_t *);
 void show_list(skiplist_t *);
 skiplist_t *init_list(const int, const lkey_t, const lkey_t);
 void free_list(skiplist_t *);
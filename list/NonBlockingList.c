@@ -15,8 +15,10 @@
 #include <assert.h>
 
 #include "NonBlockingList.h"
+#include "registry.h"
+#include "stats.h"
 
-static node_t *create_node(const lkey_t, const val_t);
+static node_t *create_node(allocator_t *, const lkey_t, const val_t);
 static node_t *search(list_t *, const lkey_t, node_t **);
 static next_ref make_ref(const node_t *, const node_stat);
 
@@ -31,6 +33,7 @@ cas(next_ref * addr, const next_ref oldp, const next_ref newp)
 		       :"m"(*addr), "a"(oldp.mark), "d"(oldp.node_ptr),
 			"b"(newp.mark), "c"(newp.node_ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #else
@@ -42,15 +45,16 @@ cas(next_ref * addr, const next_ref oldp, const next_ref newp)
 		       :"m"(*addr), "a"(oldp.mark), "d"(oldp.node_ptr),
 			"b"(newp.mark), "c"(newp.node_ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #endif
 
 
 #ifdef _FREE_
-#define free_node(_node_) free(_node_)
+#define free_node(_a_, _node_) allocator_free((_a_), _node_)
 #else
-#define free_node(_node_) ;
+#define free_node(_a_, _node_) ;
 #endif
 
 
@@ -72,19 +76,19 @@ static next_ref make_ref(const node_t * node_ptr, const node_stat mark)
 #define get_marked_ref(ptr)    make_ref(ptr, MARKED)
 
 /*
- * node_t *create_node(const lkey_t key, const val_t val)
+ * node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
  *
  * Create node '(key, val)'.
  *
  * success : return pointer to this node
  * failure : return NULL
  */
-static node_t *create_node(const lkey_t key, const val_t val)
+static node_t *create_node(allocator_t * a, const lkey_t key, const val_t val)
 {
   node_t *node;
 
-  if ((node = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((node = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return NULL;
   }
 
@@ -129,6 +133,7 @@ static node_t *search(list_t * list, const lkey_t key, node_t **pred)
       /* step 2: check nodes are adjacent */
       if (pred_next == curr) {
 	if ((curr != list->tail) && (is_marked_ref(curr->next))) {
+	  STATS_INC(STATS_RETRY);
 	  goto search_again;
 	} else {	    
 	  assert (pred_next == curr);
@@ -169,7 +174,7 @@ bool add(list_t * list, const lkey_t key, const val_t val)
     node_t *curr;
     node_t *newNode;
 
-    if ((newNode = create_node(key, val)) == NULL)
+    if ((newNode = create_node(list->allocator, key, val)) == NULL)
       return false;
 
     do {
@@ -177,7 +182,7 @@ bool add(list_t * list, const lkey_t key, const val_t val)
       assert(pred->key < key && key <= curr->key);
 
       if ((curr != list->tail) && (curr->key == key)) {
-	free_node(newNode);
+	free_node(list->allocator, newNode);
 	return false;
       }
 
@@ -185,9 +190,11 @@ bool add(list_t * list, const lkey_t key, const val_t val)
       if (cas(&pred->next, make_ref(curr, UNMARKED), make_ref(newNode, UNMARKED)) == true) {
       	break;
       }
+      STATS_INC(STATS_RETRY);
     }
     while (1);
 
+    counter_inc(&list->setSize);
     return true;
 }
 
@@ -225,6 +232,7 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
 	if (cas(&(curr->next), make_ref(node_ptr, curr->next.mark), get_marked_ref(node_ptr)) == true)
 	  break;
       }      
+      STATS_INC(STATS_RETRY);
     }
     while (1);
     if (cas(&(pred->next), get_unmarked_ref(curr), get_unmarked_ref(curr_next)) != true) {
@@ -232,7 +240,8 @@ bool_t delete(list_t * list, const lkey_t key, val_t *val)
     }
 
     *val = curr->val;
-    free_node(curr);
+    free_node(list->allocator, curr);
+    counter_dec(&list->setSize);
     
     return ret;
 }
@@ -280,6 +289,17 @@ void show_list(const list_t * list)
 }
 
 
+/*
+ * int64_t size(list_t * list)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(list_t * list)
+{
+  return counter_read_exact(&list->setSize);
+}
+
+
 /*
  * list_t *init_list(void)
  *
@@ -296,14 +316,15 @@ list_t *init_list(void)
     elog("calloc error");
     return NULL;
   }
+  list->allocator = get_allocator();
   
-  if ((list->head = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->head = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
   
-  if ((list->tail = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((list->tail = (node_t *) allocator_alloc(list->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
 
@@ -313,10 +334,14 @@ list_t *init_list(void)
   list->tail->key = INT_MAX;
   list->tail->next = make_ref(NULL, UNMARKED);
 
+  if (counter_init(&list->setSize) != true)
+    goto end;
+
   return list;
 
  end:
-  free (list->head);
+  allocator_free(list->allocator, list->tail);
+  allocator_free(list->allocator, list->head);
   free (list);
   return NULL;
 }
@@ -330,16 +355,56 @@ void free_list(list_t * list)
   while (curr != list->tail) {
     next = (node_t *)get_ptr(curr->next);
 
-    free_node (curr);
+    free_node(list->allocator, curr);
     curr = next;
   }
 
-  free_node(list->head);
-  free_node(list->tail);
+  free_node(list->allocator, list->head);
+  free_node(list->allocator, list->tail);
+  counter_destroy(&list->setSize);
   free(list);
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list();
+}
+
+static void ops_free(void *l)
+{
+    free_list((list_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((list_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((list_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((list_t *) l, (lkey_t) key) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((list_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t NonBlockingList_ops = {"NonBlockingList", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 
@@ -360,6 +425,7 @@ int main (int argc, char **argv)
     }
 
   show_list (list);
+  printf ("size = %lld\n", (long long int) size(list));
 
   for (i = 0; i < 5; i++) {
     delete (list, (lkey_t)i, &g);
@@ -11,6 +11,8 @@
 #define _NONBLOCKINGLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 
 typedef intptr_t node_stat;
@@ -34,11 +36,23 @@ typedef struct _list_t
 {
   node_t *head;
   node_t *tail;
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator; /* node allocator */
 } list_t;
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)        NonBlockingList_add(__VA_ARGS__)
+#define delete(...)     NonBlockingList_delete(__VA_ARGS__)
+#define find(...)       NonBlockingList_find(__VA_ARGS__)
+#define size(...)       NonBlockingList_size(__VA_ARGS__)
+#define init_list(...)  NonBlockingList_init_list(__VA_ARGS__)
+#define free_list(...)  NonBlockingList_free_list(__VA_ARGS__)
+#define show_list(...)  NonBlockingList_show_list(__VA_ARGS__)
+
 bool_t add (list_t *, const lkey_t, const val_t);
 bool_t delete (list_t *, const lkey_t, val_t *);
 bool_t find (list_t *, const lkey_t);
+int64_t size (list_t *);
 list_t * init_list (void);
 void free_list (list_t *);
 
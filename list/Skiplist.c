@@ -13,10 +13,12 @@
 #include <assert.h>
 
 #include "Skiplist.h"
+#include "registry.h"
+#include "stats.h"
 
 static int search(skiplist_t *, const lkey_t, skiplist_node_t **, skiplist_node_t **);
-static skiplist_node_t *create_node(const int, const lkey_t, const val_t);
-static void free_node(skiplist_node_t *);
+static skiplist_node_t *create_node(allocator_t *, const int, const lkey_t, const val_t);
+static void free_node(allocator_t *, skiplist_node_t *);
 
 
 #define lock(_mtx_)    pthread_mutex_lock(&(_mtx_))
@@ -59,6 +61,7 @@ static int search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds,
 {
     int lFound, level;
     skiplist_node_t *pred, *curr;
+    STATS_DECLARE(path);
 
     pred = sl->head;
     lFound = -1;
@@ -69,6 +72,7 @@ static int search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds,
       while (key > curr->key) {
 	pred = curr;
 	curr = pred->next[level];
+	STATS_COUNT(path);
       }
       
       if (lFound == -1 && key == curr->key) 
@@ -78,12 +82,13 @@ static int search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds,
       succs[level] = curr;
     }
 
+    STATS_RECORD(STATS_PATH, path);
     return lFound;
 }
 
 
 /*
- * static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+ * static skiplist_node_t *create_node(allocator_t * a, const int topLevel, const lkey_t key, const val_t val)
  *
  * Create a node '(key, val)' whose level is 'topLevel'.
  *
@@ -92,12 +97,12 @@ static int search(skiplist_t * sl, const lkey_t key, skiplist_node_t ** preds,
  */
 #define node_size(level)	  (sizeof(skiplist_node_t) + (level * sizeof(skiplist_node_t *)))
 
-static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const val_t val)
+static skiplist_node_t *create_node(allocator_t * a, const int topLevel, const lkey_t key, const val_t val)
 {
     skiplist_node_t *node;
 
-    if ((node = (skiplist_node_t *) calloc(1, node_size(topLevel))) == NULL) {
-	elog("calloc error");
+    if ((node = (skiplist_node_t *) allocator_alloc(a, node_size(topLevel))) == NULL) {
+	elog("allocator_alloc error");
 	return NULL;
     }
 
@@ -108,14 +113,25 @@ static skiplist_node_t *create_node(const int topLevel, const lkey_t key, const
     return node;
 }
 
-static void free_node(skiplist_node_t * node)
+static void free_node(allocator_t * a, skiplist_node_t * node)
 {
 #ifdef _FREE_
-    free(node);
+    allocator_free(a, node);
 #endif
 }
 
 
+/*
+ * int64_t size(skiplist_t * sl)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the list.
+ */
+int64_t size(skiplist_t * sl)
+{
+    return counter_read_exact(&sl->setSize);
+}
+
+
 /*
  * skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
  *
@@ -141,12 +157,13 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
 
     sl->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
     sl->maxLevel = maxLevel;
+    sl->allocator = get_allocator();
 
-    if ((head = create_node(maxLevel, min, (val_t)NULL)) == NULL) {
+    if ((head = create_node(sl->allocator, maxLevel, min, (val_t)NULL)) == NULL) {
       elog("create_node() error");
       goto end;
     }
-    if ((tail = create_node(maxLevel, max, (val_t)NULL)) == NULL) {
+    if ((tail = create_node(sl->allocator, maxLevel, max, (val_t)NULL)) == NULL) {
       elog("create_node() error");
       goto end;
     }
@@ -167,11 +184,14 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
 	elog("calloc error");
 	goto end;
     }
+    if (counter_init(&sl->setSize) != true)
+	goto end;
+
     return sl;
 
  end:
-    free(head);
-    free(tail);
+    allocator_free(sl->allocator, head);
+    allocator_free(sl->allocator, tail);
     free(sl->preds);
     free(sl);
     return NULL;
@@ -181,10 +201,11 @@ skiplist_t *init_list(const int maxLevel, const lkey_t min, const lkey_t max)
 void free_list(skiplist_t * sl)
 {
   pthread_mutex_destroy(&sl->mtx);
-  free_node(sl->tail);
-  free_node(sl->head);
-  free_node((void *)sl->preds);
-  free_node((void *)sl->succs);
+  free_node(sl->allocator, sl->tail);
+  free_node(sl->allocator, sl->head);
+  free(sl->preds);
+  free(sl->succs);
+  counter_destroy(&sl->setSize);
   free(sl);
 }
 
@@ -212,7 +233,7 @@ bool_t add(skiplist_t * sl, const lkey_t key, const val_t val)
       topLevel = (r % sl->maxLevel);
       assert(0 <= topLevel && topLevel < sl->maxLevel);
 
-      newNode = create_node(topLevel, key, val);
+      newNode = create_node(sl->allocator, topLevel, key, val);
       
       for (level = 0; level <= topLevel; level++) {
 	newNode->next[level] = sl->succs[level];
@@ -222,6 +243,9 @@ bool_t add(skiplist_t * sl, const lkey_t key, const val_t val)
 
     unlock(sl->mtx);
 
+    if (ret == true)
+      counter_inc(&sl->setSize);
+
     return ret;
 }
 
@@ -251,11 +275,14 @@ bool_t delete(skiplist_t * sl, const lkey_t key, val_t * val)
 	sl->preds[level]->next[level] = victim->next[level];
       
       *val = victim->val;
-      free_node(victim);
+      free_node(sl->allocator, victim);
     }
 
     unlock(sl->mtx);
 
+    if (ret == true)
+      counter_dec(&sl->setSize);
+
     return ret;
 }
 
@@ -286,6 +313,95 @@ val_t find(skiplist_t * sl, const lkey_t key)
 }
 
 
+/* State of a search in flight in find_batch(). */
+typedef struct _search_t {
+  int no;                            /* index of the key; -1 if this slot is idle */
+  int level;                         /* level being traversed */
+  skiplist_node_t *pred;             /* last node whose key is less than the key */
+  skiplist_node_t *curr;             /* prefetched node to examine next */
+} search_t;
+
+static void start_search(skiplist_t * sl, search_t * w, const int no)
+{
+    w->no = no;
+    w->level = sl->maxLevel - 1;
+    w->pred = sl->head;
+    w->curr = w->pred->next[w->level];
+    PREFETCH(w->curr);
+}
+
+/*
+ * int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+ *
+ * Find the nodes of keys[0..n-1] from skiplist 'sl'. found[i] tells whether keys[i]
+ * is found, and if so, getval[i] is its value.
+ *
+ * BATCH_WIDTH searches run interleaved: each one advances by a single node, prefetches
+ * the next node it will examine, and yields to the others, so that their cache misses
+ * overlap instead of being taken one by one. The lock is taken once for the batch.
+ *
+ * return the number of keys found
+ */
+int find_batch(skiplist_t * sl, const lkey_t * keys, const int n, val_t * getval, bool_t * found)
+{
+    search_t s[BATCH_WIDTH];
+    search_t *w;
+    skiplist_node_t *curr;
+    int i, next = 0, active = 0, ret = 0;
+
+    lock(sl->mtx);
+
+    for (i = 0; i < BATCH_WIDTH; i++) {
+      s[i].no = -1;
+      if (next < n) {
+	start_search(sl, &s[i], next++);
+	active++;
+      }
+    }
+
+    while (0 < active) {
+      for (i = 0; i < BATCH_WIDTH; i++) {
+	w = &s[i];
+	if (w->no < 0)
+	  continue;
+
+	curr = w->curr;
+	if (curr->key < keys[w->no]) {
+	  w->pred = curr;
+	  w->curr = curr->next[w->level];
+	  PREFETCH(w->curr);
+	  continue;
+	}
+	if (0 < w->level) {
+	  w->level--;
+	  w->curr = w->pred->next[w->level];
+	  PREFETCH(w->curr);
+	  continue;
+	}
+
+	if (curr->key == keys[w->no]) {
+	  found[w->no] = true;
+	  getval[w->no] = curr->val;
+	  ret++;
+	} else
+	  found[w->no] = false;
+
+	/* This search is done; start the next one in its slot. */
+	if (next < n)
+	  start_search(sl, w, next++);
+	else {
+	  w->no = -1;
+	  active--;
+	}
+      }
+    }
+
+    unlock(sl->mtx);
+
+    return ret;
+}
+
+
 void show_list(skiplist_t * sl)
 {
     int i;
@@ -316,6 +432,45 @@ void show_list(skiplist_t * sl)
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_list(4, INT_MIN, INT_MAX);
+}
+
+static void ops_free(void *l)
+{
+    free_list((skiplist_t *) l);
+}
+
+static int ops_add(void *l, const uint64_t key)
+{
+    return (add((skiplist_t *) l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *l, const uint64_t key)
+{
+    val_t getval;
+    return (delete((skiplist_t *) l, (lkey_t) key, &getval) == true) ? 1 : 0;
+}
+
+static int ops_find(void *l, const uint64_t key)
+{
+    return (find((skiplist_t *) l, (lkey_t) key) != (val_t) NULL) ? 1 : 0;
+}
+
+static int64_t ops_size(void *l)
+{
+    return size((skiplist_t *) l);
+}
+
+/* The key range stops below the tail sentinel, INT_MAX. */
+const ds_ops_t Skiplist_ops = {"Skiplist", REGISTRY_LIST, INT_MAX - 1,
+    ops_init, ops_free, ops_add, ops_delete, ops_find, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 int main(int argc, char **argv)
@@ -337,6 +492,7 @@ int main(int argc, char **argv)
     }
 
     show_list(sl);
+    printf("size = %lld\n", (long long int) size(sl));
 
     for (i = t - 1; 1 <= i; i--) {
 	if (!delete(sl, nums[i], &gval))
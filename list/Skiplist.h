@@ -10,6 +10,8 @@
 #define _SKIPLIST_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 typedef struct _skiplist_node_t {
   lkey_t key;                        /* key */
@@ -29,11 +31,26 @@ typedef struct _skiplist_t {
 
   skiplist_node_t **preds;
   skiplist_node_t **succs;
+
+  counter_t setSize;                  /* number of nodes */
+  allocator_t *allocator;             /* node allocator */
 } skiplist_t;
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define add(...)         Skiplist_add(__VA_ARGS__)
+#define delete(...)      Skiplist_delete(__VA_ARGS__)
+#define find(...)        Skiplist_find(__VA_ARGS__)
+#define find_batch(...)  Skiplist_find_batch(__VA_ARGS__)
+#define size(...)        Skiplist_size(__VA_ARGS__)
+#define show_list(...)   Skiplist_show_list(__VA_ARGS__)
+#define init_list(...)   Skiplist_init_list(__VA_ARGS__)
+#define free_list(...)   Skiplist_free_list(__VA_ARGS__)
+
 bool_t add(skiplist_t *, const lkey_t, const val_t);
 bool_t delete(skiplist_t *, const lkey_t, val_t *);
 val_t find(skiplist_t *, const lkey_t);
+int find_batch(skiplist_t *, const lkey_t *, const int, val_t *, bool_t *);
+int64_t size(skiplist_t *);
 void show_list(skiplist_t *);
 skiplist_t *init_list(const int, const lkey_t, const lkey_t);
 void free_list(skiplist_t *);
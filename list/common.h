@@ -42,4 +42,7 @@ typedef intptr_t  val_t;
 				     __FUNCTION__, __FILE__, __LINE__,	\
 				     _message_); fflush(stderr);}while(0);
 
+#define PREFETCH(_addr_)  __builtin_prefetch((const void *) (_addr_), 0, 3)
+#define BATCH_WIDTH 8     /* searches in flight in find_batch() */
+
 #endif
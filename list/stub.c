@@ -8,6 +8,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -15,44 +16,88 @@
 #include <assert.h>
 
 #include "common.h"
+#include "alloc.h"
+#include "perf.h"
+#include "lock.h"
+#include "filter.h"
+#include "registry.h"
+#include "bench.h"
+#include "checksum.h"
+#include "affinity.h"
+#include "stats.h"
 
 #ifdef   _CoarseGrainedSynchroList_
 #include "CoarseGrainedSynchroList.h"
+#define STRUCTURE_NAME "CoarseGrainedSynchroList"
 #elif    _FineGrainedSynchroList_
 #include "FineGrainedSynchroList.h"
+#define STRUCTURE_NAME "FineGrainedSynchroList"
 #elif    _LazySynchroList_
 #include "LazySynchroList.h"
+#define STRUCTURE_NAME "LazySynchroList"
 #elif    _LockFreeList_
 #include "LockFreeList.h"
+#define STRUCTURE_NAME "LockFreeList"
 #elif    _NonBlockingList_
 #include "NonBlockingList.h"
+#define STRUCTURE_NAME "NonBlockingList"
 #elif    _Skiplist_
 #include "Skiplist.h"
+#define STRUCTURE_NAME "Skiplist"
 #elif    _LazySkiplist_
 #include "LazySkiplist.h"
+#define STRUCTURE_NAME "LazySkiplist"
 #elif    _LockFreeSkiplist_
 #include "LockFreeSkiplist.h"
+#define STRUCTURE_NAME "LockFreeSkiplist"
 #endif
 
 
 #define PIPE_MAXLINE 32
-#define MAX_THREADS 200
-#define MAX_ITEMS 30000
 #define MAX_LEVEL 16
+#define MAX_BATCH_SIZE 256
+#define ABSENT_KEYS 1000000             /* range of the keys looked up under -M */
 
 #define DEFAULT_THREADS 10
 #define DEFAULT_ITEMS 1000
+#define DEFAULT_ALLOCATOR "slab"
+#define DEFAULT_AFFINITY "none"
+#define DEFAULT_LOCK "ttas"
 #define DEFAULT_LEVEL 4
+#define DEFAULT_MISS_RATIO 0
 
 #if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
 static skiplist_t *list;
+#define lookup(_l_, _key_)  ((find((_l_), (_key_)) != (val_t) NULL) ? true : false)
 #else
 static list_t *list;
+#if defined(_CoarseGrainedSynchroList_) || (_FineGrainedSynchroList_)
+static inline bool_t lookup(list_t *l, const lkey_t key)
+{
+    val_t getval;
+    return find(l, key, &getval);
+}
+#else
+#define lookup(_l_, _key_)  find((_l_), (_key_))
 #endif
+#endif
+static filtered_t filtered;             /* list behind the filter of -F, if any */
+
 
+/*
+ * Results of each thread, on their own cache lines. The added keys and the
+ * deleted values are checked by streamed checksums (see util/checksum.h), so
+ * no memory grows with the number of items.
+ */
+typedef struct {
+    checksum_t added;
+    checksum_t deleted;
+    unsigned long long int lookups;
+    unsigned long long int absent_lookups;
+    unsigned long long int false_positives;
+} __attribute__((aligned(64))) thread_result_t;
 
-static long long int sum[MAX_THREADS];
-static long long int check[MAX_THREADS * MAX_ITEMS];
+static thread_result_t *result;
 
 static pthread_mutex_t begin_mtx;
 static pthread_cond_t begin_cond;
@@ -63,9 +108,17 @@ static unsigned int end_thread_num;
 
 typedef struct {
     int thread_num;
-    int item_num;
+    long long int item_num;
     int verbose;
+    char *allocator;
+    int hugepage;
+    char *affinity;
+    char *lock;
     int max_level;
+    int batch_size;
+    char *filter;
+    int miss_ratio;
+    char *workload;
 } system_variables_t;
 
 struct stat_time {
@@ -80,7 +133,12 @@ typedef struct stat_time stat_data_t;
 static double get_interval(struct timeval, struct timeval);
 static void master_thread(void);
 static void worker_thread(void *);
+static void lookup_keys(const uintptr_t, const lkey_t, const lkey_t);
+static int create_list(void);
 static int workbench(void);
+static int workload(void);
+static void create_filter(const uint64_t);
+static void report_filter(void);
 static void usage(char **);
 static void init_system_variables(void);
 
@@ -88,6 +146,10 @@ static void init_system_variables(void);
  * global variables
  */
 static system_variables_t system_variables;
+static bench_config_t bench_config;
+static allocator_t *allocator;
+static affinity_t *affinity;
+static perf_counter_t dtlb_misses;
 static pthread_t *work_thread_tptr;
 static pthread_t tid;
 static stat_data_t *stat_data;
@@ -124,6 +186,7 @@ static void master_thread(void)
 
     //    show_list(list);
     free_list(list);
+    allocator_destroy(allocator);
 
     /* display result */
     double tmp_itvl;
@@ -132,14 +195,21 @@ static void master_thread(void)
     double max_itvl = 0.0;
     long double itvl = 0.0;
 
-    unsigned long long int total = 0;
-    long long int count1, count2;
+    checksum_t added, deleted;
+    unsigned long long int total_lookups = 0;
+    unsigned long long int total_absent = 0;
+    unsigned long long int total_fp = 0;
 
     gettimeofday(&stat_data_end, NULL);
 
-    total = 0;
+    checksum_init(&added);
+    checksum_init(&deleted);
     for (i = 0; i < system_variables.thread_num; i++) {
-      total += sum[i];
+      checksum_merge(&added, &result[i].added);
+      checksum_merge(&deleted, &result[i].deleted);
+      total_lookups += result[i].lookups;
+      total_absent += result[i].absent_lookups;
+      total_fp += result[i].false_positives;
 
       tmp_itvl = get_interval(stat_data[i].begin, stat_data[i].end);
       
@@ -151,28 +221,35 @@ static void master_thread(void)
       if (0 < system_variables.verbose)
 	fprintf(stderr, "thread(%d) end %f[sec]\n", i, tmp_itvl);
     }
-    /*
-    if (total != (((system_variables.item_num * system_variables.thread_num) *
-		 ((system_variables.item_num * system_variables.thread_num) + 1)) / 2))
-    */
-    if (((system_variables.item_num * system_variables.thread_num) % 2) == 0) {
-      count1 = (system_variables.item_num * system_variables.thread_num) / 2;
-      count2 = (system_variables.item_num * system_variables.thread_num + 1);
-    }
-    else {
-      count1 = (system_variables.item_num * system_variables.thread_num + 1) / 2;
-      count2 = (system_variables.item_num * system_variables.thread_num);
-    }
-    if (total != (count1 * count2))
+    /* Every key is added and deleted exactly once, and deleted with its value. */
+    if (added.count != (uint64_t) system_variables.thread_num * system_variables.item_num
+	|| checksum_equal(&added, &deleted) != 1)
       fprintf (stderr, "RESULT: test FAILED!\n");
     else
       fprintf (stderr, "RESULT: test OK\n");
 
     fprintf (stderr, "condition =>\n");
     printf ("\t%d threads run\n", system_variables.thread_num);
-    printf ("\t%d items inserted and deleted / thread, total %d items\n",
+    affinity_report(affinity, system_variables.thread_num);
+    printf ("\tallocator: %s%s\n", system_variables.allocator,
+	    (system_variables.hugepage == 1) ? " (huge pages)" : "");
+    printf ("\tlock: %s\n", system_variables.lock);
+    printf ("\t%lld items inserted and deleted / thread, total %lld items\n",
 	    system_variables.item_num,
 	    system_variables.item_num * system_variables.thread_num);
+    if (0 < system_variables.batch_size)
+      printf ("\t%llu lookups in batches of %d\n",
+	      total_lookups, system_variables.batch_size);
+    if (0 < system_variables.miss_ratio)
+      printf ("\t%llu lookups of absent keys (miss ratio %d%%)\n",
+	      total_absent, system_variables.miss_ratio);
+    if (filtered.filter != NULL) {
+      report_filter();
+      if (0 < total_absent)
+	printf ("\t  false positive rate: %.4f%% (%llu of %llu absent keys passed)\n",
+		100.0 * total_fp / total_absent, total_fp, total_absent);
+    }
+    STATS_REPORT();
 
     assert(0 < system_variables.thread_num);
     ave_itvl = (double) (itvl / system_variables.thread_num);
@@ -188,13 +265,142 @@ static void master_thread(void)
 
 
 
+/*
+ * The list as a ds_ops_t, which the tests and the workload bench drive through
+ * the filter of -F (see filter.h): filtered_add() and filtered_delete() keep the
+ * filter in step with the list. Every key is added with itself as the value, and
+ * a delete leaves the value it took in deleted_value.
+ */
+static __thread val_t deleted_value;
+
+static int stub_add(void *l, const uint64_t key)
+{
+    return (add(l, (lkey_t) key, (val_t) key) == true) ? 1 : 0;
+}
+
+static int stub_delete(void *l, const uint64_t key)
+{
+    return (delete(l, (lkey_t) key, &deleted_value) == true) ? 1 : 0;
+}
+
+static int stub_find(void *l, const uint64_t key)
+{
+    return (lookup(l, (lkey_t) key) == true) ? 1 : 0;
+}
+
+static int64_t stub_size(void *l)
+{
+    return size(l);
+}
+
+static const ds_ops_t stub_ops = {STRUCTURE_NAME, REGISTRY_LIST, INT_MAX - 1,
+    NULL, NULL, stub_add, stub_delete, stub_find, stub_size};
+
+/* Create the filter of -F for 'capacity' keys in front of list. */
+static void create_filter(const uint64_t capacity)
+{
+    filter_t *filter = NULL;
+
+    if (system_variables.filter != NULL
+	&& (filter = filter_create(system_variables.filter, capacity)) == NULL) {
+      fprintf(stderr, "Error: filter %s is not valid\n", system_variables.filter);
+      abort();
+    }
+    filtered_init(&filtered, &stub_ops, list, filter);
+}
+
+/* Report the filter of -F, and destroy it. */
+static void report_filter(void)
+{
+    filter_t *filter = filtered.filter;
+
+    printf ("\tfilter: %s, %lu bytes, %.1f bits/key%s\n", filter_name(filter),
+	    (unsigned long) filter->size, 8.0 * filter->size / filter->capacity,
+	    (filter->overflow == 1) ? " (overflowed)" : "");
+    filter_destroy(filter);
+    filtered.filter = NULL;
+}
+
+/*
+ * void lookup_keys(const uintptr_t no, const lkey_t first, const lkey_t last)
+ *
+ * Look up (last - first + 1) keys picked at random from [first, last], which this
+ * thread has just inserted, batch_size at a time; every lookup must succeed. Under
+ * -M, miss_ratio percent of the keys are picked from ABSENT_KEYS keys above all
+ * others instead, and must not be found. The skiplists look up a batch through
+ * find_batch(), the other lists one key at a time.
+ *
+ * With -F, keys the filter rejects are not looked up in the list; absent keys
+ * that pass the filter are counted as false positives.
+ */
+static void lookup_keys(const uintptr_t no, const lkey_t first, const lkey_t last)
+{
+    lkey_t key[MAX_BATCH_SIZE];
+#if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
+    val_t getval[MAX_BATCH_SIZE];
+    bool_t found[MAX_BATCH_SIZE];
+#endif
+    bool_t absent[MAX_BATCH_SIZE];
+    const lkey_t absent_base = (lkey_t) system_variables.thread_num * system_variables.item_num + 1;
+    unsigned int seed = (unsigned int) no;
+    lkey_t done;
+    int i, m, n;
+
+    for (done = 0; done < last - first + 1; done += n) {
+      n = system_variables.batch_size;
+      if (last - first + 1 - done < n)
+	n = last - first + 1 - done;
+      for (i = 0; i < n; i++) {
+	absent[i] = (0 < system_variables.miss_ratio
+		     && rand_r(&seed) % 100 < system_variables.miss_ratio) ? true : false;
+	if (absent[i] == true) {
+	  key[i] = absent_base + (rand_r(&seed) % ABSENT_KEYS);
+	  result[no].absent_lookups++;
+	} else
+	  key[i] = first + (rand_r(&seed) % (last - first + 1));
+      }
+
+      /* Keep the keys the filter passes. */
+      for (i = m = 0; i < n; i++) {
+	if (filtered.filter != NULL) {
+	  if (filter_contains(filtered.filter, (uint64_t) key[i]) == 0) {
+	    if (absent[i] != true)
+	      fprintf (stderr, "ERROR[%lu]: filter rejected %lu\n", (uintptr_t)no, (uintptr_t)key[i]);
+	    continue;
+	  }
+	  if (absent[i] == true)
+	    result[no].false_positives++;
+	}
+	key[m] = key[i];
+	absent[m++] = absent[i];
+      }
+
+#if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
+      if (1 < m) {
+	find_batch(list, key, m, getval, found);
+	for (i = 0; i < m; i++)
+	  if ((absent[i] == true) ? (found[i] != false)
+	      : (found[i] != true || getval[i] != key[i]))
+	    fprintf (stderr, "ERROR[%lu]: find %lu\n", (uintptr_t)no, (uintptr_t)key[i]);
+	m = 0;
+      }
+#endif
+      for (i = 0; i < m; i++)
+	if (lookup(list, key[i]) != ((absent[i] == true) ? false : true))
+	  fprintf (stderr, "ERROR[%lu]: find %lu\n", (uintptr_t)no, (uintptr_t)key[i]);
+      result[no].lookups += n;
+    }
+}
+
 static void worker_thread(void *arg)
 {
     uintptr_t no = (uintptr_t) arg;
-    unsigned int i;
+    long long int i;
     lkey_t key;
     val_t getval;
 
+    affinity_pin(affinity, no);
+
     /*
      * increment begin_thread_num, and wait for broadcast signal from last created thread
      */
@@ -211,7 +417,6 @@ static void worker_thread(void *arg)
     }
 
     gettimeofday(&stat_data[no].begin, NULL);
-    sum[no] = 0;
 
     /*  main loop */
     key = no * system_variables.item_num;
@@ -221,8 +426,10 @@ static void worker_thread(void *arg)
 	fprintf(stderr, "thread[%lu] add: %lu\n", (uintptr_t)no,
 		(uintptr_t) key);
 
-      if (add(list, (lkey_t) key, (val_t)key) != true)
+      if (filtered_add(&filtered, (uint64_t) key) != 1)
 	fprintf (stderr, "ERROR[%lu]: add %lu\n", (uintptr_t)no, (uintptr_t)key);
+      else
+	checksum_add(&result[no].added, (uint64_t) key);
 
       if (1 < system_variables.verbose)
 	show_list(list);
@@ -231,14 +438,19 @@ static void worker_thread(void *arg)
       //      pthread_yield(NULL);
     }
 
+    if (0 < system_variables.batch_size)
+      lookup_keys(no, no * system_variables.item_num + 1, key);
+
     usleep(no * 10);
 
     key = no * system_variables.item_num;
     for (i = 0; i < system_variables.item_num; i++) {
       ++key;
-      if (delete(list, (lkey_t) key, &getval) != true) {
+      if (filtered_delete(&filtered, (uint64_t) key) != 1) {
 	printf ("ERROR[%lu]: del %lu\n", (uintptr_t)no, (uintptr_t)key);
+	continue;
       }
+      getval = deleted_value;
 
       if (1 < system_variables.verbose)
 	show_list(list);
@@ -246,9 +458,7 @@ static void worker_thread(void *arg)
       if (0 < system_variables.verbose)
 	fprintf(stderr, "delete: val = %ld\n", (lkey_t) getval);
       
-      sum[no] += getval;
-      
-      check[getval]++;
+      checksum_add(&result[no].deleted, (uint64_t) getval);
     }
 
     /* send signal */
@@ -259,6 +469,16 @@ static void worker_thread(void *arg)
     pthread_mutex_unlock(&end_mtx);
 }
 
+static int create_list(void)
+{
+#if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
+    list = init_list(system_variables.max_level, INT_MIN, INT_MAX);
+#else
+    list = init_list();
+#endif
+    return (list == NULL) ? -1 : 0;
+}
+
 static int workbench(void)
 {
     void *ret = NULL;
@@ -266,17 +486,19 @@ static int workbench(void)
 
     fprintf(stderr, "<<simple algorithm test bench>>\n");
 
-#if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
-    if ((list = init_list(system_variables.max_level, INT_MIN, INT_MAX)) == NULL) {
-#else
-    if ((list = init_list()) == NULL) {
-#endif
+    if (create_list() != 0) {
       elog("init_list() error");
       abort();
     }
 
-    for (i = 0; i < system_variables.thread_num * system_variables.item_num; i++)
-      check[i] = 0;
+    create_filter((uint64_t) system_variables.thread_num * system_variables.item_num);
+
+    if ((result = (thread_result_t *) aligned_alloc(64, system_variables.thread_num
+						    * sizeof(thread_result_t))) == NULL) {
+      elog("aligned_alloc error");
+      goto end;
+    }
+    memset(result, 0, system_variables.thread_num * sizeof(thread_result_t));
 
 
     if ((stat_data =
@@ -319,11 +541,51 @@ static int workbench(void)
 
  end:
     free(stat_data);
+    free(result);
     free(work_thread_tptr);
     return -1;
 }
 
 
+/*
+ * With -W, the list is driven by the workload bench (see util/bench.h)
+ * instead of the insert-then-delete test, behind the filter of -F if any.
+ */
+static int workload(void)
+{
+    bench_ops_t ops;
+    int ret;
+
+    if (create_list() != 0) {
+      elog("init_list() error");
+      abort();
+    }
+    if (INT_MAX < bench_config.key_range) {
+      fprintf(stderr, "Error: key range must be at most %d\n", INT_MAX);
+      return -1;
+    }
+
+    create_filter(bench_config.key_range);
+
+    ops.name = STRUCTURE_NAME;
+    ops.ds = &filtered;
+    ops.insert = filtered_add;
+    ops.delete = filtered_delete;
+    ops.lookup = filtered_find;
+    ops.size = filtered_size;
+
+    bench_config.thread_num = system_variables.thread_num;
+    bench_config.ops = system_variables.item_num;
+    ret = bench_run(&ops, &bench_config, NULL);
+    if (filtered.filter != NULL)
+      report_filter();
+
+    free_list(list);
+    allocator_destroy(allocator);
+    return (ret == 1) ? 0 : -1;
+}
+
+
 static void usage(char **argv)
 {
     fprintf(stderr, "simple algorithm test bench\n");
@@ -332,7 +594,24 @@ static void usage(char **argv)
     fprintf(stderr, "\t\t-n number_of_items<%d>\n", DEFAULT_ITEMS);
 #if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
     fprintf(stderr, "\t\t-l max_level_of_skiplist<%d>\n", DEFAULT_LEVEL);
+    fprintf(stderr, "\t\t-B batch_size     :look up the inserted keys batch_size at a time (find_batch)\n");
+#else
+    fprintf(stderr, "\t\t-B batch_size     :look up the inserted keys batch_size at a time\n");
 #endif
+    fprintf(stderr, "\t\t-M miss_ratio(%%)  :look up absent keys in miss_ratio%% of the lookups<%d>\n", DEFAULT_MISS_RATIO);
+    fprintf(stderr, "\t\t-F filter(bloom|cuckoo) :reject absent keys with a filter in front of the list\n");
+    fprintf(stderr, "\t\t-W mix(e.g. r90,i5,d5,s0) :run the workload bench with this mix of read, insert, delete and scan\n");
+    fprintf(stderr, "\t\t   -K dist(uniform|zipf[:theta]|latest[:theta]|hotspot[:keys:ops])<uniform>\n");
+    fprintf(stderr, "\t\t   -k key_range<%llu>  -p prefill<%llu>\n",
+	    (unsigned long long int) bench_config.key_range, (unsigned long long int) bench_config.prefill);
+    fprintf(stderr, "\t\t   -d seconds       :run for this long instead of number_of_items operations / thread\n");
+    fprintf(stderr, "\t\t   -T               :report per-operation latency percentiles\n");
+    fprintf(stderr, "\t\t   -E               :report hardware counters (cycles, LLC misses, ...) per operation\n");
+    fprintf(stderr, "\t\t   -O rate[:fixed|poisson] :open loop at this many operations / second of all threads\n");
+    fprintf(stderr, "\t\t-a allocator(malloc|slab)<%s>\n", DEFAULT_ALLOCATOR);
+    fprintf(stderr, "\t\t-H               :back tables and node pools with huge pages\n");
+    fprintf(stderr, "\t\t-c affinity(none|compact|scatter|smt|cpu_list e.g. 0,2,4-7)<%s>\n", DEFAULT_AFFINITY);
+    fprintf(stderr, "\t\t-L lock(pthread|ttas|ticket|mcs|clh)<%s>\n", DEFAULT_LOCK);
     fprintf(stderr, "\t\t-v               :verbose\n");
     fprintf(stderr, "\t\t-V               :debug mode\n");
     fprintf(stderr, "\t\t-h               :help\n");
@@ -345,12 +624,24 @@ static void init_system_variables(void)
     system_variables.item_num = DEFAULT_ITEMS;
     system_variables.max_level = DEFAULT_LEVEL;
     system_variables.verbose = 0;
+    system_variables.allocator = DEFAULT_ALLOCATOR;
+    system_variables.hugepage = 0;
+    system_variables.affinity = DEFAULT_AFFINITY;
+    system_variables.lock = DEFAULT_LOCK;
+    system_variables.batch_size = 0;
+    system_variables.filter = NULL;
+    system_variables.miss_ratio = DEFAULT_MISS_RATIO;
+    system_variables.workload = NULL;
+    bench_config_init(&bench_config);
 }
 
 
 int main(int argc, char **argv)
 {
     char c;
+    uint64_t misses;
+    int ret;
+    lock_kind_t lock_kind;
 
     /*
      * init 
@@ -365,9 +656,9 @@ int main(int argc, char **argv)
 
     /* options  */
 #if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
-    while ((c = getopt(argc, argv, "t:n:l:vVh")) != -1) {
+    while ((c = getopt(argc, argv, "t:n:l:B:M:F:W:K:k:p:d:O:TEa:Hc:L:vVh")) != -1) {
 #else
-    while ((c = getopt(argc, argv, "t:n:vVh")) != -1) {
+    while ((c = getopt(argc, argv, "t:n:B:M:F:W:K:k:p:d:O:TEa:Hc:L:vVh")) != -1) {
 #endif
 	switch (c) {
 	case 't':		/* number of thread */
@@ -376,18 +667,15 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Error: thread number %d is not valid\n",
 			system_variables.thread_num);
 		exit(-1);
-	    } else if (MAX_THREADS <= system_variables.thread_num)
-		system_variables.thread_num = MAX_THREADS;
-
+	    }
 	    break;
 	case 'n':		/* number of item */
-	    system_variables.item_num = strtol(optarg, NULL, 10);
+	    system_variables.item_num = strtoll(optarg, NULL, 10);
 	    if (system_variables.item_num <= 0) {
-		fprintf(stderr, "Error: item number %d is not valid\n",
+		fprintf(stderr, "Error: item number %lld is not valid\n",
 			system_variables.item_num);
 		exit(-1);
-	    } else if (MAX_ITEMS <= system_variables.item_num)
-		system_variables.item_num = MAX_ITEMS;
+	    }
 	    break;
 #if defined(_Skiplist_) || (_LazySkiplist_) || (_LockFreeSkiplist_)
 	case 'l':		/* max level of skiplist */
@@ -400,6 +688,80 @@ int main(int argc, char **argv)
 		system_variables.max_level = MAX_LEVEL;
 	    break;
 #endif
+	case 'B':		/* lookup batch size */
+	    system_variables.batch_size = strtol(optarg, NULL, 10);
+	    if (system_variables.batch_size <= 0) {
+		fprintf(stderr, "Error: batch size %d is not valid\n",
+			system_variables.batch_size);
+		exit(-1);
+	    } else if (MAX_BATCH_SIZE <= system_variables.batch_size)
+		system_variables.batch_size = MAX_BATCH_SIZE;
+	    break;
+	case 'M':		/* miss ratio */
+	    system_variables.miss_ratio = strtol(optarg, NULL, 10);
+	    if (system_variables.miss_ratio < 0 || 100 < system_variables.miss_ratio) {
+		fprintf(stderr, "Error: miss ratio %d is not valid\n",
+			system_variables.miss_ratio);
+		exit(-1);
+	    }
+	    break;
+	case 'F':		/* filter */
+	    system_variables.filter = optarg;
+	    break;
+	case 'W':		/* workload bench */
+	    system_variables.workload = optarg;
+	    if (bench_parse_mix(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: mix %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'K':		/* key distribution */
+	    if (bench_parse_dist(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: distribution %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'k':		/* key range */
+	    bench_config.key_range = strtoull(optarg, NULL, 10);
+	    if (bench_config.key_range == 0) {
+		fprintf(stderr, "Error: key range %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'p':		/* prefill */
+	    bench_config.prefill = strtoull(optarg, NULL, 10);
+	    break;
+	case 'T':		/* latency histograms */
+	    bench_config.latency = 1;
+	    break;
+	case 'E':		/* hardware counters */
+	    bench_config.counters = 1;
+	    break;
+	case 'O':		/* open-loop rate */
+	    if (bench_parse_rate(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: rate %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'd':		/* duration */
+	    bench_config.duration = strtod(optarg, NULL);
+	    if (bench_config.duration <= 0.0) {
+		fprintf(stderr, "Error: duration %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'a':		/* allocator */
+	    system_variables.allocator = optarg;
+	    break;
+	case 'H':		/* huge pages */
+	    system_variables.hugepage = 1;
+	    break;
+	case 'c':		/* thread placement */
+	    system_variables.affinity = optarg;
+	    break;
+	case 'L':		/* lock */
+	    system_variables.lock = optarg;
+	    break;
 	case 'v':               /* verbose 1 */
 	    system_variables.verbose = 1;
 	    break;
@@ -416,14 +778,64 @@ int main(int argc, char **argv)
 	}
     }
 
+    if ((allocator = allocator_create(system_variables.allocator,
+				      (system_variables.hugepage == 1) ? ALLOC_HUGEPAGE : 0)) == NULL) {
+	fprintf(stderr, "Error: allocator %s is not valid\n",
+		system_variables.allocator);
+	exit(-1);
+    }
+    set_allocator(allocator);
+
+    if ((affinity = affinity_create(system_variables.affinity)) == NULL) {
+	fprintf(stderr, "Error: affinity %s is not valid\n",
+		system_variables.affinity);
+	exit(-1);
+    }
+    bench_config.affinity = affinity;
+
+    /* The keys, and the absent keys above them, must stay below the tail sentinel. */
+    if (system_variables.workload == NULL
+	&& (long long int) INT_MAX - ABSENT_KEYS <= system_variables.item_num * system_variables.thread_num) {
+	fprintf(stderr, "Error: %d threads x %lld items exceed the key range\n",
+		system_variables.thread_num, system_variables.item_num);
+	exit(-1);
+    }
+
+    /* -M and -F only act on the lookup phase. */
+    if ((0 < system_variables.miss_ratio || system_variables.filter != NULL)
+	&& system_variables.batch_size == 0)
+      system_variables.batch_size = 1;
+
+    if (lock_kind_by_name(system_variables.lock, &lock_kind) != 1) {
+	fprintf(stderr, "Error: lock %s is not valid\n",
+		system_variables.lock);
+	exit(-1);
+    }
+    set_lock_kind(lock_kind);
+
     /*
      * main work 
      */
-    if (workbench() != 0)
+    perf_counter_open(&dtlb_misses, PERF_DTLB_LOAD_MISSES);
+
+    if (system_variables.workload != NULL) {
+      if (workload() != 0)
+	exit(-1);
+    } else if (workbench() != 0)
       abort();
 
+    /* Read after all threads have exited, because their counts are summed at exit. */
+    if ((ret = perf_counter_read(&dtlb_misses, &misses)) != 0)
+      printf ("\tdTLB load misses: %llu%s\n", (unsigned long long int) misses,
+	      (ret == PERF_SCALED) ? " (scaled)" : "");
+    else
+      printf ("\tdTLB load misses: not available\n");
+    perf_counter_close(&dtlb_misses);
+
     free (stat_data);
+    free (result);
     free (work_thread_tptr);
+    affinity_destroy (affinity);
 
     return 0;
 }
@@ -15,9 +15,11 @@
 #include <assert.h>
 
 #include "CASLockFreeQueue.h"
+#include "registry.h"
+#include "stats.h"
 
-static node_t *create_node(const val_t);
-static void free_node(node_t *);
+static node_t *create_node(allocator_t *, const val_t);
+static void free_node(allocator_t *, node_t *);
 
 
 static inline bool_t
@@ -30,6 +32,7 @@ cas(volatile pointer_t * addr, pointer_t oldp, const pointer_t newp)
 		       :"m"(*addr), "a"(oldp.count), "d"(oldp.ptr),
 		       "b"(newp.count), "c"(newp.ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #else
@@ -41,17 +44,18 @@ cas(volatile pointer_t * addr, const pointer_t oldp, const pointer_t newp)
 		       :"m"(*addr), "a"(oldp.count), "d"(oldp.ptr),
 			"b"(newp.count), "c"(newp.ptr)
 		       :"memory");
+  STATS_CAS_RESULT(result != 0);
   return (((int)result == 0) ? false:true);
 }
 #endif
 
 
-static node_t *create_node(const val_t val)
+static node_t *create_node(allocator_t * a, const val_t val)
 {
     node_t *node;
 
-    if ((node = (node_t *) calloc(1, sizeof(node_t))) == NULL) {
-      elog("calloc error");
+    if ((node = (node_t *) allocator_alloc(a, sizeof(node_t))) == NULL) {
+      elog("allocator_alloc error");
 	return NULL;
     }
 
@@ -62,10 +66,10 @@ static node_t *create_node(const val_t val)
     return node;
 }
 
-static void free_node(node_t * node)
+static void free_node(allocator_t * a, node_t * node)
 {
 #ifdef _FREE_
-    free(node);
+    allocator_free(a, node);
 #endif
 }
 
@@ -79,8 +83,9 @@ queue_t *init_queue(void)
       elog("calloc error");
 	return NULL;
     }
+    q->allocator = get_allocator();
 
-    if ((node = create_node((val_t)NULL)) == NULL) {
+    if ((node = create_node(q->allocator, (val_t)NULL)) == NULL) {
       elog("create_node() error");
       abort();
     }
@@ -88,11 +93,18 @@ queue_t *init_queue(void)
     q->head.ptr = node;
     q->tail.ptr = node;
 
+    if (counter_init(&q->setSize) != true) {
+      allocator_free(q->allocator, node);
+      free(q);
+      return NULL;
+    }
+
     return q;
 }
 
 void free_queue(queue_t * q)
 {
+  counter_destroy(&q->setSize);
   free(q);
 }
 
@@ -102,7 +114,7 @@ bool_t enq(queue_t * q, const val_t val)
     node_t *newNode;
     pointer_t tail, next, tmp;
 
-    if ((newNode = create_node(val)) == NULL)
+    if ((newNode = create_node(q->allocator, val)) == NULL)
 	return false;
 
     while (1) {
@@ -123,10 +135,12 @@ bool_t enq(queue_t * q, const val_t val)
 	    cas(&q->tail, tail, tmp);
 	  }
 	}
+	STATS_INC(STATS_RETRY);
     }
     tmp.ptr = newNode;    tmp.count = tail.count + 1;
     cas(&q->tail, tail, tmp);
 
+    counter_inc(&q->setSize);
     return true;
 }
 
@@ -158,13 +172,26 @@ bool_t deq(queue_t * q, val_t * val)
 	    }
 	  }
 	}
+	STATS_INC(STATS_RETRY);
     }
 
-    free_node (head.ptr);
+    free_node(q->allocator, head.ptr);
+    counter_dec(&q->setSize);
     return true;
 }
 
 
+/*
+ * int64_t size(queue_t * q)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the queue.
+ */
+int64_t size(queue_t * q)
+{
+    return counter_read_exact(&q->setSize);
+}
+
+
 void show_queue(queue_t * q)
 {
     node_t *curr;
@@ -178,6 +205,39 @@ void show_queue(queue_t * q)
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_queue();
+}
+
+static void ops_free(void *q)
+{
+    free_queue((queue_t *) q);
+}
+
+static int ops_add(void *q, const uint64_t key)
+{
+    return (enq((queue_t *) q, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *q, const uint64_t key)
+{
+    val_t getval;
+    return (deq((queue_t *) q, &getval) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *q)
+{
+    return size((queue_t *) q);
+}
+
+const ds_ops_t CASLockFreeQueue_ops = {"CASLockFreeQueue", REGISTRY_QUEUE, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, NULL, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 queue_t *q;
@@ -195,11 +255,13 @@ int main(int argc, char **argv)
       enq(q, i);
       show_queue(q);
     }
+    printf("size = %lld\n", (long long int) size(q));
 
     for (i = 0; i < max; i++) {
       deq(q, &val);
       show_queue(q);
     }
+    printf("size = %lld\n", (long long int) size(q));
 
     free_queue(q);
     return 0;
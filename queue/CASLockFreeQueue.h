@@ -14,6 +14,8 @@
 
 #include <inttypes.h>
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 typedef struct _pointer_t {
   intptr_t count;
@@ -31,12 +33,24 @@ typedef struct _queue_t
 {
   pointer_t head;
   pointer_t tail;
+
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator;  /* node allocator */
 } queue_t;
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define init_queue(...)  CASLockFreeQueue_init_queue(__VA_ARGS__)
+#define free_queue(...)  CASLockFreeQueue_free_queue(__VA_ARGS__)
+#define enq(...)         CASLockFreeQueue_enq(__VA_ARGS__)
+#define deq(...)         CASLockFreeQueue_deq(__VA_ARGS__)
+#define size(...)        CASLockFreeQueue_size(__VA_ARGS__)
+#define show_queue(...)  CASLockFreeQueue_show_queue(__VA_ARGS__)
+
 queue_t * init_queue (void);
 void free_queue (queue_t *);
 bool_t enq (queue_t *, const val_t);
 bool_t deq (queue_t *, val_t *);
+int64_t size(queue_t *);
 
 void show_queue(queue_t *);
 
@@ -16,18 +16,20 @@
 #include <pthread.h>
 
 #include "LLSCLockFreeQueue.h"
+#include "registry.h"
+#include "stats.h"
 
 static workspace_t *init_workspace();
 static void free_workspace(workspace_t *);
 static workspace_t *get_workspace(queue_t *);
 static node_t *LL(LLSCvar *, int *, node_t **);
-static bool_t SC(LLSCvar *, node_t *, int, node_t *);
+static bool_t SC(allocator_t *, LLSCvar *, node_t *, int, node_t *);
 static void transfer(node_t *, int);
-static void release(node_t *);
-static void unlink(LLSCvar *, int, node_t *);
-static void setNLPred(node_t *);
-static void setToBeFreed(node_t *);
-static node_t *create_node (val_t);
+static void release(allocator_t *, node_t *);
+static void unlink(allocator_t *, LLSCvar *, int, node_t *);
+static void setNLPred(allocator_t *, node_t *);
+static void setToBeFreed(allocator_t *, node_t *);
+static node_t *create_node (allocator_t *, val_t);
 
 #ifdef _X86_64_
 static inline bool_t cas(void *ptr, uint64_t oldv, uint64_t newv)
@@ -37,6 +39,7 @@ static inline bool_t cas(void *ptr, uint64_t oldv, uint64_t newv)
                        : "=a" (result)
                        : "q" (newv), "m" (*(uint64_t *)ptr),"0" (oldv)
                        : "memory");
+  STATS_CAS_RESULT(result == oldv);
   return ((result == oldv) ? true : false);
 }
 #define CAST(value)   (*((uint64_t *)&(value)))
@@ -49,6 +52,7 @@ static inline bool_t cas(void *ptr, uint32_t oldv, uint32_t newv)
                        : "=a" (result)
                        : "q" (newv), "m" (*(uint32_t *)ptr),"0" (oldv)
                        : "memory");
+  STATS_CAS_RESULT(result == oldv);
   return ((result == oldv) ? true : false);
 }
 
@@ -117,7 +121,7 @@ static node_t
 }
 
 static bool_t
-SC(LLSCvar *loc, node_t *nd, int myver, node_t *mynode)
+SC(allocator_t *a, LLSCvar *loc, node_t *nd, int myver, node_t *mynode)
 {
   EntryTag e, new;
   node_t *pred_nd = mynode->pred;
@@ -138,7 +142,7 @@ SC(LLSCvar *loc, node_t *nd, int myver, node_t *mynode)
       transfer(mynode, e.count);
     e = loc->entry;
   }
-  release(mynode);
+  release(a, mynode);
   return success;
 }
 
@@ -159,7 +163,7 @@ transfer(node_t *nd, int count)
 
 
 static void 
-release(node_t *nd)
+release(allocator_t *a, node_t *nd)
 {
   ExitTag pre, post;
   node_t *pred_nd = nd->pred;
@@ -175,15 +179,15 @@ release(node_t *nd)
   } while (!cas(&nd->exit, CAST(pre), CAST(post)));
   
   if (CLEAN(post))
-    setNLPred(pred_nd);
+    setNLPred(a, pred_nd);
 
   if (FREEABLE(post))
-    free(nd);
+    allocator_free(a, nd);
 }
 
 
 static void 
-unlink(LLSCvar *loc, int myver, node_t *mynode)
+unlink(allocator_t *a, LLSCvar *loc, int myver, node_t *mynode)
 {
   EntryTag e, new;
   do {
@@ -195,11 +199,11 @@ unlink(LLSCvar *loc, int myver, node_t *mynode)
     new.count = e.count - 1;
   }
   if (!cas(&loc->entry, CAST(e), CAST(new)))
-    release(mynode);
+    release(a, mynode);
 }
 
 static void 
-setNLPred(node_t *pred_nd)
+setNLPred(allocator_t *a, node_t *pred_nd)
 {
   ExitTag pre, post;
     do {
@@ -212,11 +216,11 @@ setNLPred(node_t *pred_nd)
     }
     } while (!cas(&pred_nd->exit, CAST(pre), CAST(post)));
   if (FREEABLE(post))
-    free(pred_nd);
+    allocator_free(a, pred_nd);
 }
 
 static void
-setToBeFreed(node_t *pred_nd) 
+setToBeFreed(allocator_t *a, node_t *pred_nd) 
 {
   ExitTag pre, post;
 
@@ -231,14 +235,14 @@ setToBeFreed(node_t *pred_nd)
   } while (!cas(&pred_nd->exit, CAST(pre), CAST(post)));
   
   if (FREEABLE(post)) 
-    free(pred_nd);
+    allocator_free(a, pred_nd);
 }
 
-static node_t *create_node (val_t val)
+static node_t *create_node (allocator_t *a, val_t val)
 {
   node_t *node;
-  if ((node = (node_t*)calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((node = (node_t*)allocator_alloc(a, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     return NULL;
   }
   node->val = val;
@@ -252,9 +256,9 @@ static node_t *create_node (val_t val)
 }
 
 #ifdef _FREE_
-#define free_node(node)  free(node)
+#define free_node(a, node)  allocator_free(a, node)
 #else
-#define free_node(node)  ;
+#define free_node(a, node)  ;
 #endif
 
 
@@ -265,7 +269,7 @@ bool_t enq(queue_t *q, val_t val)
   workspace_t *ws = get_workspace(q);
   assert(ws != NULL);
 
-  if ((nd = create_node(val)) == NULL) {
+  if ((nd = create_node(q->allocator, val)) == NULL) {
     return false;
   }
 
@@ -274,11 +278,13 @@ bool_t enq(queue_t *q, val_t val)
 
     nd->pred = tail;
     if (cas(&tail->next, (uintptr_t)NULL, CAST(nd))) {
-      SC(&q->tail, nd, ws->myver, ws->mynode);
+      SC(q->allocator, &q->tail, nd, ws->myver, ws->mynode);
+      counter_inc(&q->setSize);
       break;
     } 
     else {
-      SC(&q->tail, tail->next, ws->myver, ws->mynode);
+      SC(q->allocator, &q->tail, tail->next, ws->myver, ws->mynode);
+      STATS_INC(STATS_RETRY);
     }
   }
   return ret;
@@ -295,18 +301,20 @@ bool_t deq(queue_t *q, val_t *val)
     head = LL(&q->head, &ws->myver, &ws->mynode);
     next = head->next;
     if (next == NULL) {
-      unlink(&q->head, ws->myver, ws->mynode);
+      unlink(q->allocator, &q->head, ws->myver, ws->mynode);
       *val = (val_t)NULL;
       ret = false;
       break;
     }
     
-    if (SC(&q->head, next, ws->myver, ws->mynode)) {
+    if (SC(q->allocator, &q->head, next, ws->myver, ws->mynode)) {
       *val = next->val;
-      setToBeFreed(next);
-      free_node(next);
+      setToBeFreed(q->allocator, next);
+      free_node(q->allocator, next);
+      counter_dec(&q->setSize);
       break;
     }
+    STATS_INC(STATS_RETRY);
   }
   return ret;
 }
@@ -321,15 +329,17 @@ queue_t *init_queue (void)
     return NULL;
   }
 
+  q->allocator = get_allocator();
+
   q->tail.entry.ver = 0;
   q->tail.entry.count = 0;
   
-  if ((q->tail.ptr0 = (node_t *)calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((q->tail.ptr0 = (node_t *)allocator_alloc(q->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
-  if ((q->tail.ptr1 = (node_t *)calloc(1, sizeof(node_t))) == NULL) {
-    elog("calloc error");
+  if ((q->tail.ptr1 = (node_t *)allocator_alloc(q->allocator, sizeof(node_t))) == NULL) {
+    elog("allocator_alloc error");
     goto end;
   }
   
@@ -354,10 +364,14 @@ queue_t *init_queue (void)
     abort();
   }
 
+  if (counter_init(&q->setSize) != true)
+    goto end;
+
   return q;
 
  end:
-  free(q->tail.ptr0);
+  allocator_free(q->allocator, q->tail.ptr0);
+  allocator_free(q->allocator, q->tail.ptr1);
   free(q);
   return NULL;
 }
@@ -365,10 +379,22 @@ queue_t *init_queue (void)
 void
 free_queue(queue_t *q)
 {
+  counter_destroy(&q->setSize);
   free(q);
 }
 
 
+/*
+ * int64_t size(queue_t * q)
+ *
+ * Return the number of nodes. This is exact only while no thread updates the queue.
+ */
+int64_t size(queue_t * q)
+{
+    return counter_read_exact(&q->setSize);
+}
+
+
 void show_queue(queue_t * q)
 {
   LLSCvar e = q->head;
@@ -380,6 +406,39 @@ void show_queue(queue_t * q)
 }
 
 
+/*
+ * Registry entry; see util/registry.h.
+ */
+static void *ops_init(void)
+{
+    return init_queue();
+}
+
+static void ops_free(void *q)
+{
+    free_queue((queue_t *) q);
+}
+
+static int ops_add(void *q, const uint64_t key)
+{
+    return (enq((queue_t *) q, (val_t) key) == true) ? 1 : 0;
+}
+
+static int ops_delete(void *q, const uint64_t key)
+{
+    val_t getval;
+    return (deq((queue_t *) q, &getval) == true) ? 1 : 0;
+}
+
+static int64_t ops_size(void *q)
+{
+    return size((queue_t *) q);
+}
+
+const ds_ops_t LLSCLockFreeQueue_ops = {"LLSCLockFreeQueue", REGISTRY_QUEUE, INTPTR_MAX,
+    ops_init, ops_free, ops_add, ops_delete, NULL, ops_size};
+
+
 #ifdef _SINGLE_THREAD_
 
 queue_t *q;
@@ -397,11 +456,13 @@ int main(int argc, char **argv)
       enq(q, i);
       show_queue(q);
     }
+    printf("size = %lld\n", (long long int) size(q));
 
     for (i = 0; i < max; i++) {
       deq(q, &val);
       show_queue(q);
     }
+    printf("size = %lld\n", (long long int) size(q));
 
     free_queue(q);
     return 0;
@@ -13,6 +13,8 @@
 #define _LLSC_LOCKFREE_QUEUE_H_
 
 #include "common.h"
+#include "counter.h"
+#include "alloc.h"
 
 typedef struct _ExitTag {
   int count;
@@ -47,6 +49,9 @@ typedef struct _queue_t {
   LLSCvar head;
   LLSCvar tail;
   pthread_key_t workspace_key;
+
+  counter_t setSize;    /* number of nodes */
+  allocator_t *allocator;  /* node allocator */
 } queue_t;
 
 
@@ -56,8 +61,17 @@ typedef struct _workspace_t {
 } workspace_t __attribute__((aligned(16)));
 
 
+/* Public names are prefixed with the structure name; see util/registry.h. */
+#define enq(...)         LLSCLockFreeQueue_enq(__VA_ARGS__)
+#define deq(...)         LLSCLockFreeQueue_deq(__VA_ARGS__)
+#define size(...)        LLSCLockFreeQueue_size(__VA_ARGS__)
+#define init_queue(...)  LLSCLockFreeQueue_init_queue(__VA_ARGS__)
+#define free_queue(...)  LLSCLockFreeQueue_free_queue(__VA_ARGS__)
+#define show_queue(...)  LLSCLockFreeQueue_show_queue(__VA_ARGS__)
+
 bool_t enq(queue_t *, val_t);
 bool_t deq(queue_t *, val_t*);
+int64_t size(queue_t *);
 queue_t *init_queue (void);
 void free_queue(queue_t *);
 void show_queue(queue_t *);
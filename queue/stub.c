@@ -8,6 +8,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -15,32 +16,52 @@
 #include <assert.h>
 
 #include "common.h"
+#include "alloc.h"
+#include "perf.h"
+#include "bench.h"
+#include "checksum.h"
+#include "affinity.h"
+#include "stats.h"
 
 #ifdef   _Queue_
 #include "Queue.h"
+#define STRUCTURE_NAME "Queue"
 #elif    _LLSCLockFreeQueue_
 #include "LLSCLockFreeQueue.h"
+#define STRUCTURE_NAME "LLSCLockFreeQueue"
 #elif    _CASLockFreeQueue_
 #include "CASLockFreeQueue.h"
+#define STRUCTURE_NAME "CASLockFreeQueue"
 #elif    _TwoLockConcurrentQueue_
 #include "TwoLockConcurrentQueue.h"
+#define STRUCTURE_NAME "TwoLockConcurrentQueue"
 #elif    _BoundedQueue_
 #include "BoundedQueue.h"
+#define STRUCTURE_NAME "BoundedQueue"
 #endif
 
 
 #define PIPE_MAXLINE 32
-#define MAX_THREADS 200
-#define MAX_ITEMS 30000
 
 #define DEFAULT_THREADS 10
 #define DEFAULT_ITEMS 1000
+#define DEFAULT_ALLOCATOR "slab"
+#define DEFAULT_AFFINITY "none"
 
 queue_t *queue;
 
 
-static long long int sum[MAX_THREADS];
-static long long int check[MAX_THREADS * MAX_ITEMS + 1];
+/*
+ * Results of each thread, on their own cache lines. The enqueued keys and the
+ * dequeued values are checked by streamed checksums (see util/checksum.h), so
+ * no memory grows with the number of items.
+ */
+typedef struct {
+    checksum_t enqueued;
+    checksum_t dequeued;
+} __attribute__((aligned(64))) thread_result_t;
+
+static thread_result_t *result;
 
 static pthread_mutex_t begin_mtx;
 static pthread_cond_t begin_cond;
@@ -51,8 +72,12 @@ static unsigned int end_thread_num;
 
 typedef struct {
     int thread_num;
-    int item_num;
+    long long int item_num;
     int verbose;
+    char *allocator;
+    int hugepage;
+    char *affinity;
+    char *workload;
 } system_variables_t;
 
 struct stat_time {
@@ -67,7 +92,9 @@ typedef struct stat_time stat_data_t;
 static double get_interval(struct timeval, struct timeval);
 static void master_thread(void);
 static void worker_thread(void *);
+static int create_queue(void);
 static int workbench(void);
+static int workload(void);
 static void usage(char **);
 static void init_system_variables(void);
 
@@ -75,6 +102,10 @@ static void init_system_variables(void);
  * global variables
  */
 static system_variables_t system_variables;
+static bench_config_t bench_config;
+static allocator_t *allocator;
+static affinity_t *affinity;
+static perf_counter_t dtlb_misses;
 static pthread_t *work_thread_tptr;
 static pthread_t tid;
 static stat_data_t *stat_data;
@@ -110,6 +141,7 @@ static void master_thread(void)
     pthread_mutex_unlock(&end_mtx);
 
     free_queue(queue);
+    allocator_destroy(allocator);
 
     /* display result */
     double tmp_itvl;
@@ -118,14 +150,15 @@ static void master_thread(void)
     double max_itvl = 0.0;
     long double itvl = 0.0;
 
-    long long int total = 0;
-    long long int count1, count2;
+    checksum_t enqueued, dequeued;
 
     gettimeofday(&stat_data_end, NULL);
 
-    total = 0;
+    checksum_init(&enqueued);
+    checksum_init(&dequeued);
     for (i = 0; i < system_variables.thread_num; i++) {
-      total += sum[i];
+      checksum_merge(&enqueued, &result[i].enqueued);
+      checksum_merge(&dequeued, &result[i].dequeued);
 
       tmp_itvl = get_interval(stat_data[i].begin, stat_data[i].end);
       
@@ -138,29 +171,22 @@ static void master_thread(void)
 	fprintf(stderr, "thread(%d) end %f[sec]\n", i, tmp_itvl);
     }
 
-    /*
-    if (total != (((system_variables.item_num * system_variables.thread_num) *
-		 ((system_variables.item_num * system_variables.thread_num) + 1)) / 2))
-    */
-    if (((system_variables.item_num * system_variables.thread_num) % 2) == 0) {
-      count1 = (system_variables.item_num * system_variables.thread_num) / 2;
-      count2 = (system_variables.item_num * system_variables.thread_num + 1);
-    }
-    else {
-      count1 = (system_variables.item_num * system_variables.thread_num + 1) / 2;
-      count2 = (system_variables.item_num * system_variables.thread_num);
-    }
-
-    if (total != (count1 * count2))
+    /* Every key is enqueued and dequeued exactly once. */
+    if (enqueued.count != (uint64_t) system_variables.thread_num * system_variables.item_num
+	|| checksum_equal(&enqueued, &dequeued) != 1)
       fprintf (stderr, "RESULT: test FAILED!\n");
     else
       fprintf (stderr, "RESULT: test OK\n");
 
     fprintf (stderr, "condition =>\n");
     printf ("\t%d threads run\n", system_variables.thread_num);
-    printf ("\t%d items inserted and deleted / thread, total %d items\n",
+    affinity_report(affinity, system_variables.thread_num);
+    printf ("\tallocator: %s%s\n", system_variables.allocator,
+	    (system_variables.hugepage == 1) ? " (huge pages)" : "");
+    printf ("\t%lld items inserted and deleted / thread, total %lld items\n",
 	    system_variables.item_num,
 	    system_variables.item_num * system_variables.thread_num);
+    STATS_REPORT();
 
     assert(0 < system_variables.thread_num);
     ave_itvl = (double) (itvl / system_variables.thread_num);
@@ -179,10 +205,12 @@ static void master_thread(void)
 static void worker_thread(void *arg)
 {
     uintptr_t no = (uintptr_t) arg;
-    unsigned int i;
+    long long int i;
     lkey_t key;
     val_t getval;
 
+    affinity_pin(affinity, no);
+
     /*
      * increment begin_thread_num, and wait for broadcast signal from last created thread
      */
@@ -199,7 +227,6 @@ static void worker_thread(void *arg)
     }
 
     gettimeofday(&stat_data[no].begin, NULL);
-    sum[no] = 0;
 
     /*  main loop */
     key = no * system_variables.item_num;
@@ -211,6 +238,8 @@ static void worker_thread(void *arg)
 
       if (enq(queue, (lkey_t) key) != true)
 	fprintf (stderr, "ERROR[%lu]: add %lu\n", no, (uintptr_t)key);
+      else
+	checksum_add(&result[no].enqueued, (uint64_t) key);
 
       if (1 < system_variables.verbose)
 	show_queue(queue);
@@ -226,6 +255,7 @@ static void worker_thread(void *arg)
       ++key;
       if (deq(queue, &getval) != true) {
 	printf ("ERROR[%lu]: del %ld\n", no, getval);
+	continue;
       }
 
       if (0 < system_variables.verbose)
@@ -235,9 +265,7 @@ static void worker_thread(void *arg)
       if (1 < system_variables.verbose)
 	show_queue(queue);
       
-      sum[no] += getval;
-      
-      check[getval]++;
+      checksum_add(&result[no].dequeued, (uint64_t) getval);
       //      usleep(no);
       //      pthread_yield(NULL);  
     }
@@ -250,6 +278,16 @@ static void worker_thread(void *arg)
     pthread_mutex_unlock(&end_mtx);
 }
 
+static int create_queue(void)
+{
+#ifdef _BoundedQueue_
+    queue = init_queue(system_variables.thread_num * system_variables.item_num);
+#else
+    queue = init_queue();
+#endif
+    return (queue == NULL) ? -1 : 0;
+}
+
 static int workbench(void)
 {
     void *ret = NULL;
@@ -257,18 +295,17 @@ static int workbench(void)
 
     fprintf(stderr, "<<simple algorithm test bench>>\n");
 
-#ifdef _BoundedQueue_
-    if ((queue = init_queue(system_variables.thread_num * system_variables.item_num)) == NULL) {
-#else
-    if ((queue = init_queue()) == NULL) {
-#endif
+    if (create_queue() != 0) {
       elog("init_queue() error");
       abort();
     }
 
-    for (i = 0; i < system_variables.thread_num * system_variables.item_num; i++)
-      check[i] = 0;
-
+    if ((result = (thread_result_t *) aligned_alloc(64, system_variables.thread_num
+						    * sizeof(thread_result_t))) == NULL) {
+      elog("aligned_alloc error");
+      goto end;
+    }
+    memset(result, 0, system_variables.thread_num * sizeof(thread_result_t));
 
     if ((stat_data =
 	 calloc(system_variables.thread_num, sizeof(stat_data_t))) == NULL)
@@ -310,17 +347,75 @@ static int workbench(void)
 
  end:
     free(stat_data);
+    free(result);
     free(work_thread_tptr);
     return -1;
 }
 
 
+/*
+ * With -W, the queue is driven by the workload bench (see util/bench.h)
+ * instead of the enqueue-then-dequeue test. Inserts enqueue the key, and
+ * deletes dequeue whatever is at the head.
+ */
+static int bench_insert(void *q, const uint64_t key)
+{
+    return (enq((queue_t *) q, (val_t) key) == true) ? 1 : 0;
+}
+
+static int bench_delete(void *q, const uint64_t key)
+{
+    val_t getval;
+    return (deq((queue_t *) q, &getval) == true) ? 1 : 0;
+}
+
+static int64_t bench_size(void *q)
+{
+    return size((queue_t *) q);
+}
+
+static int workload(void)
+{
+    bench_ops_t ops;
+    int ret;
+
+    if (create_queue() != 0) {
+      elog("init_queue() error");
+      abort();
+    }
+
+    ops.name = STRUCTURE_NAME;
+    ops.ds = queue;
+    ops.insert = bench_insert;
+    ops.delete = bench_delete;
+    ops.lookup = NULL;
+    ops.size = bench_size;
+
+    bench_config.thread_num = system_variables.thread_num;
+    bench_config.ops = system_variables.item_num;
+    ret = bench_run(&ops, &bench_config, NULL);
+
+    free_queue(queue);
+    allocator_destroy(allocator);
+    return (ret == 1) ? 0 : -1;
+}
+
+
 static void usage(char **argv)
 {
     fprintf(stderr, "simple algorithm test bench\n");
     fprintf(stderr, "usage: %s [Options<default>]\n", argv[0]);
     fprintf(stderr, "\t\t-t number_of_threads<%d>\n", DEFAULT_THREADS);
     fprintf(stderr, "\t\t-n number_of_items<%d>\n", DEFAULT_ITEMS);
+    fprintf(stderr, "\t\t-W mix(e.g. i50,d50) :run the workload bench with this mix of insert(enq) and delete(deq)\n");
+    fprintf(stderr, "\t\t   -p prefill<%llu>\n", (unsigned long long int) bench_config.prefill);
+    fprintf(stderr, "\t\t   -d seconds       :run for this long instead of number_of_items operations / thread\n");
+    fprintf(stderr, "\t\t   -T               :report per-operation latency percentiles\n");
+    fprintf(stderr, "\t\t   -E               :report hardware counters (cycles, LLC misses, ...) per operation\n");
+    fprintf(stderr, "\t\t   -O rate[:fixed|poisson] :open loop at this many operations / second of all threads\n");
+    fprintf(stderr, "\t\t-a allocator(malloc|slab)<%s>\n", DEFAULT_ALLOCATOR);
+    fprintf(stderr, "\t\t-H               :back tables and node pools with huge pages\n");
+    fprintf(stderr, "\t\t-c affinity(none|compact|scatter|smt|cpu_list e.g. 0,2,4-7)<%s>\n", DEFAULT_AFFINITY);
     fprintf(stderr, "\t\t-v               :verbose\n");
     fprintf(stderr, "\t\t-V               :debug mode\n");
     fprintf(stderr, "\t\t-h               :help\n");
@@ -332,12 +427,19 @@ static void init_system_variables(void)
     system_variables.thread_num = DEFAULT_THREADS;
     system_variables.item_num = DEFAULT_ITEMS;
     system_variables.verbose = 0;
+    system_variables.allocator = DEFAULT_ALLOCATOR;
+    system_variables.hugepage = 0;
+    system_variables.affinity = DEFAULT_AFFINITY;
+    system_variables.workload = NULL;
+    bench_config_init(&bench_config);
 }
 
 
 int main(int argc, char **argv)
 {
     char c;
+    uint64_t misses;
+    int ret;
 
     /*
      * init 
@@ -351,7 +453,7 @@ int main(int argc, char **argv)
     init_system_variables();
 
     /* options  */
-    while ((c = getopt(argc, argv, "t:n:vVh")) != -1) {
+    while ((c = getopt(argc, argv, "t:n:W:p:d:O:TEa:Hc:vVh")) != -1) {
 	switch (c) {
 	case 't':		/* number of thread */
 	    system_variables.thread_num = strtol(optarg, NULL, 10);
@@ -359,19 +461,53 @@ int main(int argc, char **argv)
 		fprintf(stderr, "Error: thread number %d is not valid\n",
 			system_variables.thread_num);
 		exit(-1);
-	    } else if (MAX_THREADS <= system_variables.thread_num)
-		system_variables.thread_num = MAX_THREADS;
-
+	    }
 	    break;
 	case 'n':		/* number of item */
-	    system_variables.item_num = strtol(optarg, NULL, 10);
+	    system_variables.item_num = strtoll(optarg, NULL, 10);
 	    if (system_variables.item_num <= 0) {
-		fprintf(stderr, "Error: item number %d is not valid\n",
+		fprintf(stderr, "Error: item number %lld is not valid\n",
 			system_variables.item_num);
 		exit(-1);
-	    } else if (MAX_ITEMS <= system_variables.item_num)
-		system_variables.item_num = MAX_ITEMS;
-
+	    }
+	    break;
+	case 'W':		/* workload bench */
+	    system_variables.workload = optarg;
+	    if (bench_parse_mix(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: mix %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'p':		/* prefill */
+	    bench_config.prefill = strtoull(optarg, NULL, 10);
+	    break;
+	case 'T':		/* latency histograms */
+	    bench_config.latency = 1;
+	    break;
+	case 'E':		/* hardware counters */
+	    bench_config.counters = 1;
+	    break;
+	case 'O':		/* open-loop rate */
+	    if (bench_parse_rate(&bench_config, optarg) != 1) {
+		fprintf(stderr, "Error: rate %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'd':		/* duration */
+	    bench_config.duration = strtod(optarg, NULL);
+	    if (bench_config.duration <= 0.0) {
+		fprintf(stderr, "Error: duration %s is not valid\n", optarg);
+		exit(-1);
+	    }
+	    break;
+	case 'a':		/* allocator */
+	    system_variables.allocator = optarg;
+	    break;
+	case 'H':		/* huge pages */
+	    system_variables.hugepage = 1;
+	    break;
+	case 'c':		/* thread placement */
+	    system_variables.affinity = optarg;
 	    break;
 	case 'v':               /* verbose 1 */
 	    system_variables.verbose = 1;
@@ -389,14 +525,44 @@ int main(int argc, char **argv)
 	}
     }
 
+    if ((allocator = allocator_create(system_variables.allocator,
+				      (system_variables.hugepage == 1) ? ALLOC_HUGEPAGE : 0)) == NULL) {
+	fprintf(stderr, "Error: allocator %s is not valid\n",
+		system_variables.allocator);
+	exit(-1);
+    }
+    set_allocator(allocator);
+
+    if ((affinity = affinity_create(system_variables.affinity)) == NULL) {
+	fprintf(stderr, "Error: affinity %s is not valid\n",
+		system_variables.affinity);
+	exit(-1);
+    }
+    bench_config.affinity = affinity;
+
     /*
      * main work 
      */
-    if (workbench() != 0)
+    perf_counter_open(&dtlb_misses, PERF_DTLB_LOAD_MISSES);
+
+    if (system_variables.workload != NULL) {
+      if (workload() != 0)
+	exit(-1);
+    } else if (workbench() != 0)
       abort();
 
+    /* Read after all threads have exited, because their counts are summed at exit. */
+    if ((ret = perf_counter_read(&dtlb_misses, &misses)) != 0)
+      printf ("\tdTLB load misses: %llu%s\n", (unsigned long long int) misses,
+	      (ret == PERF_SCALED) ? " (scaled)" : "");
+    else
+      printf ("\tdTLB load misses: not available\n");
+    perf_counter_close(&dtlb_misses);
+
     free (stat_data);
+    free (result);
     free (work_thread_tptr);
+    affinity_destroy (affinity);
 
     return 0;
 }
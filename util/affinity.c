@@ -0,0 +1,325 @@
+/* ---------------------------------------------------------------------------
+ * Thread Placement
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "affinity.h"
+
+#define affinity_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#define REPORT_THREADS   64              /* threads listed by affinity_report() */
+
+static const char *policy_names[] = {"none", "compact", "scatter", "smt", "list"};
+
+
+#ifdef __linux__
+/* Read one integer from a file of /sys; return -1 if it can not be read. */
+static int read_topology(const int cpu, const char *name)
+{
+    char path[128];
+    FILE *fp;
+    int v;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    if ((fp = fopen(path, "r")) == NULL)
+      return -1;
+    if (fscanf(fp, "%d", &v) != 1)
+      v = -1;
+    fclose(fp);
+    return v;
+}
+
+/*
+ * int read_cpus(affinity_cpu_t * cpus, int * core_rank)
+ *
+ * Write the topology of the CPUs this process may run on to cpus[], and the
+ * rank of the core of each among the cores of its package to core_rank[].
+ * A CPU whose topology can not be read is taken as a core of its own in
+ * package 0.
+ *
+ * success : return the number of CPUs
+ * failure : return 0
+ */
+static int read_cpus(affinity_cpu_t * cpus, int *core_rank)
+{
+    cpu_set_t set;
+    int cpu, i, j, n = 0;
+
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+      affinity_elog("sched_getaffinity() error");
+      return 0;
+    }
+    for (cpu = 0; cpu < CPU_SETSIZE && n < AFFINITY_MAX_CPUS; cpu++) {
+      if (!CPU_ISSET(cpu, &set))
+	continue;
+      cpus[n].cpu = cpu;
+      cpus[n].package = read_topology(cpu, "physical_package_id");
+      cpus[n].core = read_topology(cpu, "core_id");
+      if (cpus[n].package < 0 || cpus[n].core < 0) {
+	cpus[n].package = 0;
+	cpus[n].core = cpu;
+      }
+      n++;
+    }
+
+    for (i = 0; i < n; i++) {
+      cpus[i].smt = 0;
+      for (j = 0; j < i; j++)
+	if (cpus[j].package == cpus[i].package && cpus[j].core == cpus[i].core)
+	  cpus[i].smt++;
+    }
+    /* Count the smaller cores of the package by their first CPUs. */
+    for (i = 0; i < n; i++) {
+      core_rank[i] = 0;
+      for (j = 0; j < n; j++)
+	if (cpus[j].package == cpus[i].package && cpus[j].core < cpus[i].core && cpus[j].smt == 0)
+	  core_rank[i]++;
+    }
+    return n;
+}
+#endif
+
+/* Sort keys of each policy, most significant first. */
+static int sort_key(const affinity_policy_t policy, const affinity_cpu_t * c,
+		    const int core_rank, int key[4])
+{
+    switch (policy) {
+    case AFFINITY_COMPACT:
+      key[0] = c->package; key[1] = c->smt; key[2] = c->core; key[3] = c->cpu;
+      return 1;
+    case AFFINITY_SCATTER:
+      key[0] = c->smt; key[1] = core_rank; key[2] = c->package; key[3] = c->cpu;
+      return 1;
+    case AFFINITY_SMT:
+      key[0] = c->package; key[1] = c->core; key[2] = c->smt; key[3] = c->cpu;
+      return 1;
+    default:
+      return 0;
+    }
+}
+
+/* Insertion sort of cpus[] by the keys of 'policy'; n is at most AFFINITY_MAX_CPUS. */
+static void sort_cpus(const affinity_policy_t policy, affinity_cpu_t * cpus, int *core_rank,
+		      const int n)
+{
+    affinity_cpu_t c;
+    int i, j, k, r, a[4], b[4];
+
+    for (i = 1; i < n; i++) {
+      c = cpus[i];
+      r = core_rank[i];
+      sort_key(policy, &c, r, a);
+      for (j = i; 0 < j; j--) {
+	sort_key(policy, &cpus[j - 1], core_rank[j - 1], b);
+	for (k = 0; k < 4 && a[k] == b[k]; k++)
+	  ;
+	if (k == 4 || b[k] < a[k])
+	  break;
+	cpus[j] = cpus[j - 1];
+	core_rank[j] = core_rank[j - 1];
+      }
+      cpus[j] = c;
+      core_rank[j] = r;
+    }
+}
+
+/*
+ * int parse_list(affinity_t * aff, const affinity_cpu_t * cpus, const int n, const char *str)
+ *
+ * Set the placement to the CPUs of 'str', such as "0,2,4-7"; each must be one
+ * this process may run on.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+static int parse_list(affinity_t * aff, const affinity_cpu_t * cpus, const int n, const char *str)
+{
+    const char *p = str;
+    char *end;
+    long first, last, cpu;
+    int i;
+
+    aff->cpu_num = 0;
+    while (*p != '\0') {
+      first = last = strtol(p, &end, 10);
+      if (end == p || first < 0)
+	return 0;
+      if (*end == '-') {
+	p = end + 1;
+	last = strtol(p, &end, 10);
+	if (end == p || last < first)
+	  return 0;
+      }
+      for (cpu = first; cpu <= last; cpu++) {
+	for (i = 0; i < n && cpus[i].cpu != cpu; i++)
+	  ;
+	if (i == n || AFFINITY_MAX_CPUS <= aff->cpu_num)
+	  return 0;
+	aff->order[aff->cpu_num++] = cpus[i];
+      }
+      if (*end == ',')
+	end++;
+      else if (*end != '\0')
+	return 0;
+      p = end;
+    }
+    return (0 < aff->cpu_num) ? 1 : 0;
+}
+
+/*
+ * affinity_t *affinity_create(const char *spec)
+ *
+ * Create the placement 'spec': none, compact, scatter, smt, or a list of CPUs.
+ *
+ * success : return the placement
+ * failure : return NULL
+ */
+affinity_t *affinity_create(const char *spec)
+{
+    affinity_t *aff;
+    int i;
+
+    if ((aff = (affinity_t *) calloc(1, sizeof(affinity_t))) == NULL) {
+      affinity_elog("calloc error");
+      return NULL;
+    }
+    if (isdigit((unsigned char) spec[0]))
+      aff->policy = AFFINITY_LIST;
+    else {
+      for (i = 0; i < AFFINITY_LIST; i++)
+	if (strcmp(spec, policy_names[i]) == 0)
+	  break;
+      if (i == AFFINITY_LIST)
+	goto end;
+      aff->policy = (affinity_policy_t) i;
+    }
+    if (aff->policy == AFFINITY_NONE)
+      return aff;
+
+#ifdef __linux__
+    {
+      affinity_cpu_t *cpus;
+      int *core_rank, n, j;
+
+      cpus = (affinity_cpu_t *) calloc(AFFINITY_MAX_CPUS, sizeof(affinity_cpu_t));
+      core_rank = (int *) calloc(AFFINITY_MAX_CPUS, sizeof(int));
+      aff->order = (affinity_cpu_t *) calloc(AFFINITY_MAX_CPUS, sizeof(affinity_cpu_t));
+      if (cpus == NULL || core_rank == NULL || aff->order == NULL) {
+	affinity_elog("calloc error");
+	free(cpus);
+	free(core_rank);
+	goto end;
+      }
+      if ((n = read_cpus(cpus, core_rank)) == 0) {
+	free(cpus);
+	free(core_rank);
+	goto end;
+      }
+
+      aff->cpus = n;
+      for (i = 0; i < n; i++) {
+	for (j = 0; j < i; j++)
+	  if (cpus[j].package == cpus[i].package)
+	    break;
+	aff->packages += (j == i) ? 1 : 0;
+	aff->cores += (cpus[i].smt == 0) ? 1 : 0;
+      }
+
+      if (aff->policy == AFFINITY_LIST) {
+	if (parse_list(aff, cpus, n, spec) != 1) {
+	  free(cpus);
+	  free(core_rank);
+	  goto end;
+	}
+      } else {
+	sort_cpus(aff->policy, cpus, core_rank, n);
+	memcpy(aff->order, cpus, n * sizeof(affinity_cpu_t));
+	aff->cpu_num = n;
+      }
+      free(cpus);
+      free(core_rank);
+      return aff;
+    }
+#endif
+
+ end:
+    affinity_destroy(aff);
+    return NULL;
+}
+
+void affinity_destroy(affinity_t * aff)
+{
+    if (aff == NULL)
+      return;
+    free(aff->order);
+    free(aff);
+}
+
+/*
+ * int affinity_pin(const affinity_t * aff, const int no)
+ *
+ * Pin the calling thread, the no-th thread of the bench, to its CPU.
+ *
+ * success : return 1
+ * failure : return 0; also if aff is NULL or its policy is none
+ */
+int affinity_pin(const affinity_t * aff, const int no)
+{
+    if (aff == NULL || aff->policy == AFFINITY_NONE || aff->cpu_num == 0)
+      return 0;
+#ifdef __linux__
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(aff->order[no % aff->cpu_num].cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      affinity_elog("pthread_setaffinity_np() error");
+      return 0;
+    }
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char *affinity_name(const affinity_t * aff)
+{
+    return policy_names[(aff == NULL) ? AFFINITY_NONE : aff->policy];
+}
+
+/*
+ * void affinity_report(const affinity_t * aff, const int thread_num)
+ *
+ * Print the policy, the topology, and the CPU of each of thread_num threads.
+ */
+void affinity_report(const affinity_t * aff, const int thread_num)
+{
+    int i;
+
+    if (aff == NULL || aff->policy == AFFINITY_NONE) {
+      printf ("\taffinity: none\n");
+      return;
+    }
+    printf ("\taffinity: %s over %d packages, %d cores, %d CPUs\n", affinity_name(aff),
+	    aff->packages, aff->cores, aff->cpus);
+    printf ("\t  CPU of each thread:");
+    for (i = 0; i < thread_num && i < REPORT_THREADS; i++)
+      printf (" %d", aff->order[i % aff->cpu_num].cpu);
+    if (REPORT_THREADS < thread_num)
+      printf (" ...");
+    printf ("\n");
+    if (aff->cpu_num < thread_num)
+      printf ("\t  %d threads share %d CPUs\n", thread_num, aff->cpu_num);
+}
@@ -0,0 +1,61 @@
+/* ---------------------------------------------------------------------------
+ * Thread Placement
+ *
+ * Pins the worker threads of the benches to CPUs by a placement policy, so
+ * that scalability curves are reproducible and show the effects of SMT and
+ * of the number of sockets:
+ *
+ *  none    : threads are not pinned, and float as the scheduler likes.
+ *  compact : fill one package (socket) before the next; within a package,
+ *            one thread on each core before the second SMT thread of any core.
+ *  scatter : spread the threads over the packages in turn, one thread on each
+ *            core of every package before the second SMT thread of any core.
+ *  smt     : SMT siblings first; all hardware threads of a core before the
+ *            next core, one package before the next.
+ *  list    : an explicit list of CPUs, such as "0,2,4-7", in thread order.
+ *
+ * The topology is read from /sys/devices/system/cpu/cpuN/topology
+ * (physical_package_id and core_id) for the CPUs this process may run on.
+ * Thread i runs on the i-th CPU of the placement, and threads beyond the
+ * number of CPUs wrap around. Pinning is supported on Linux only; elsewhere
+ * affinity_create() accepts only "none".
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+#define AFFINITY_MAX_CPUS  1024
+
+typedef enum {
+  AFFINITY_NONE = 0, AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_SMT, AFFINITY_LIST,
+} affinity_policy_t;
+
+typedef struct _affinity_cpu_t
+{
+  int cpu;
+  int package;                        /* physical_package_id */
+  int core;                           /* core_id, unique within the package */
+  int smt;                            /* rank of the CPU among the SMT siblings of its core */
+} affinity_cpu_t;
+
+typedef struct _affinity_t
+{
+  affinity_policy_t policy;
+  int cpu_num;                        /* number of CPUs in order[] */
+  affinity_cpu_t *order;              /* placement: thread i runs on order[i % cpu_num] */
+  int packages;                       /* topology of the CPUs this process may run on */
+  int cores;
+  int cpus;
+} affinity_t;
+
+
+affinity_t *affinity_create (const char *);
+void affinity_destroy (affinity_t *);
+int affinity_pin (const affinity_t *, const int);
+const char *affinity_name (const affinity_t *);
+void affinity_report (const affinity_t *, const int);
+
+#endif
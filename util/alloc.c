@@ -0,0 +1,545 @@
+/* ---------------------------------------------------------------------------
+ * Node Allocator
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "alloc.h"
+
+#define alloc_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#ifdef _X86_64_
+static inline int cas(void * volatile *addr, void *oldp, void *newp)
+{
+    void *result;
+    __asm__ __volatile__("lock; cmpxchgq %2,%1"
+			 : "=a" (result), "+m" (*addr)
+			 : "r" (newp), "0" (oldp)
+			 : "memory");
+    return (result == oldp);
+}
+
+static inline void *swap(void * volatile *addr, void *newp)
+{
+    __asm__ __volatile__("xchgq %0,%1"
+			 : "+r" (newp), "+m" (*addr)
+			 :
+			 : "memory");
+    return newp;
+}
+#else
+static inline int cas(void * volatile *addr, void *oldp, void *newp)
+{
+    return __sync_bool_compare_and_swap(addr, oldp, newp);
+}
+
+static inline void *swap(void * volatile *addr, void *newp)
+{
+    return __sync_lock_test_and_set(addr, newp);
+}
+#endif
+
+
+/*
+ * pages
+ */
+static size_t round_up(const size_t size, const size_t unit)
+{
+    return (size + unit - 1) / unit * unit;
+}
+
+static size_t page_length(const size_t size, const int flags)
+{
+    return round_up(size, (flags & ALLOC_HUGEPAGE) ? HUGE_PAGE_SIZE : (size_t) sysconf(_SC_PAGESIZE));
+}
+
+/*
+ * void *page_alloc(const size_t size, const int flags)
+ *
+ * Map 'size' bytes of zero-filled memory. With ALLOC_HUGEPAGE, the memory is
+ * aligned to HUGE_PAGE_SIZE and backed by huge pages if the system allows it.
+ *
+ * success : return pointer to the memory
+ * failure : return NULL
+ */
+void *page_alloc(const size_t size, const int flags)
+{
+    size_t len = page_length(size, flags);
+    char *p, *aligned;
+
+    if (!(flags & ALLOC_HUGEPAGE)) {
+      p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      return (p == MAP_FAILED) ? NULL : p;
+    }
+
+#ifdef MAP_HUGETLB
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+      return p;
+#endif
+
+    /* No reserved huge pages: map an aligned range and ask for transparent huge pages. */
+    p = mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      return NULL;
+    aligned = (char *) round_up((uintptr_t) p, HUGE_PAGE_SIZE);
+    if (p < aligned)
+      munmap(p, aligned - p);
+    if (aligned + len < p + len + HUGE_PAGE_SIZE)
+      munmap(aligned + len, (p + len + HUGE_PAGE_SIZE) - (aligned + len));
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+/* 'size' must be the size passed to page_alloc(), rounded up to HUGE_PAGE_SIZE with ALLOC_HUGEPAGE. */
+void page_free(void *ptr, const size_t size)
+{
+    if (ptr != NULL)
+      munmap(ptr, page_length(size, 0));
+}
+
+
+/* Header at the beginning of every region. */
+typedef struct _region_t
+{
+  size_t size;                 /* mapped size, or 0 if allocated with malloc */
+} __attribute__((aligned(64))) region_t;
+
+/*
+ * void *allocator_alloc_region(allocator_t * a, const size_t size)
+ *
+ * Allocate a zero-filled array, such as a bucket table, aligned to 64 bytes.
+ *
+ * success : return pointer to the array
+ * failure : return NULL
+ */
+void *allocator_alloc_region(allocator_t * a, const size_t size)
+{
+    region_t *r;
+    size_t len = sizeof(region_t) + size;
+
+    if (a->flags & ALLOC_HUGEPAGE) {
+      len = page_length(len, ALLOC_HUGEPAGE);
+      if ((r = (region_t *) page_alloc(len, ALLOC_HUGEPAGE)) == NULL) {
+	alloc_elog("page_alloc error");
+	return NULL;
+      }
+      r->size = len;
+    }
+    else {
+      if ((r = (region_t *) aligned_alloc(sizeof(region_t), round_up(len, sizeof(region_t)))) == NULL) {
+	alloc_elog("aligned_alloc error");
+	return NULL;
+      }
+      memset(r, 0, len);
+    }
+    return r + 1;
+}
+
+void allocator_free_region(allocator_t * a, void *ptr)
+{
+    region_t *r;
+
+    if (ptr == NULL)
+      return;
+    r = (region_t *) ptr - 1;
+    if (r->size == 0)
+      free(r);
+    else
+      page_free(r, r->size);
+}
+
+
+/*
+ * malloc allocator
+ */
+static void *malloc_alloc(allocator_t * a, const size_t size)
+{
+    return calloc(1, size);
+}
+
+static void malloc_free(allocator_t * a, void *ptr)
+{
+    free(ptr);
+}
+
+static void malloc_destroy(allocator_t * a)
+{
+}
+
+static allocator_t malloc_allocator_instance = {"malloc", 0, malloc_alloc, malloc_free, malloc_destroy};
+static allocator_t malloc_hugepage_allocator_instance = {"malloc", ALLOC_HUGEPAGE, malloc_alloc, malloc_free, malloc_destroy};
+
+allocator_t *malloc_allocator(void)
+{
+    return &malloc_allocator_instance;
+}
+
+
+/*
+ * slab allocator
+ */
+struct _heap_t;
+
+/* Header at the beginning of every slab, and of every large block. */
+typedef struct _slab_t
+{
+  struct _heap_t *owner;       /* heap which allocates from this slab; NULL for a large block */
+  size_t size;                 /* block size, or the whole size of a large block */
+  struct _slab_t *prev;        /* list of large blocks */
+  struct _slab_t *next;
+} __attribute__((aligned(64))) slab_t;
+
+#define SLAB_HEADER_SIZE   sizeof(slab_t)
+#define SLAB_MAX_BLOCK     (SLAB_ALIGN * SLAB_CLASSES)
+
+#define slab_of(_ptr_)     ((slab_t *) ((uintptr_t) (_ptr_) & ~((uintptr_t) SLAB_SIZE - 1)))
+#define class_of(_size_)   (((_size_) + SLAB_ALIGN - 1) / SLAB_ALIGN - 1)
+
+typedef struct _block_t
+{
+  struct _block_t *next;
+} block_t;
+
+typedef struct _size_class_t
+{
+  block_t *free;               /* free blocks of this heap */
+  char *bump;                  /* unused part of the current slab */
+  char *end;
+} size_class_t;
+
+typedef struct _heap_t
+{
+  void * volatile remote;      /* blocks freed by other threads (block_t list) */
+  char pad[64 - sizeof(void *)];
+
+  size_class_t cls[SLAB_CLASSES];
+  struct _slab_allocator_t *allocator;
+  struct _heap_t *next;        /* all heaps of the allocator */
+  struct _heap_t *next_orphan; /* heaps whose threads have exited */
+} __attribute__((aligned(64))) heap_t;
+
+typedef struct _chunk_t
+{
+  void *mem;                   /* page_alloc()ed if the allocator has ALLOC_HUGEPAGE */
+  struct _chunk_t *next;
+} chunk_t;
+
+typedef struct _slab_allocator_t
+{
+  allocator_t base;            /* must be the first member */
+  pthread_key_t heap_key;
+
+  pthread_mutex_t mtx;         /* protects the members below */
+  char *chunk_bump;            /* unused slabs of the current chunk */
+  char *chunk_end;
+  chunk_t *chunk;              /* all chunks */
+  heap_t *heap;                /* all heaps */
+  heap_t *orphan;              /* heaps to be reused by new threads */
+  slab_t *large;               /* large blocks in use */
+} slab_allocator_t;
+
+
+static void release_heap(void *arg)
+{
+    heap_t *heap = (heap_t *) arg;
+    slab_allocator_t *sa = heap->allocator;
+
+    /* Blocks of this heap may still be in use, so keep it for the next new thread. */
+    pthread_mutex_lock(&sa->mtx);
+    heap->next_orphan = sa->orphan;
+    sa->orphan = heap;
+    pthread_mutex_unlock(&sa->mtx);
+}
+
+static heap_t *get_heap(slab_allocator_t * sa)
+{
+    heap_t *heap = pthread_getspecific(sa->heap_key);
+
+    if (heap != NULL)
+      return heap;
+
+    pthread_mutex_lock(&sa->mtx);
+    if ((heap = sa->orphan) != NULL)
+      sa->orphan = heap->next_orphan;
+    else if ((heap = (heap_t *) aligned_alloc(64, sizeof(heap_t))) != NULL) {
+      memset(heap, 0, sizeof(heap_t));
+      heap->allocator = sa;
+      heap->next = sa->heap;
+      sa->heap = heap;
+    }
+    pthread_mutex_unlock(&sa->mtx);
+
+    if (heap == NULL) {
+      alloc_elog("aligned_alloc error");
+      return NULL;
+    }
+    if (pthread_setspecific(sa->heap_key, (void *) heap) != 0) {
+      alloc_elog("pthread_setspecific() error");
+      abort();
+    }
+    return heap;
+}
+
+static slab_t *new_slab(slab_allocator_t * sa)
+{
+    slab_t *slab = NULL;
+    chunk_t *c;
+
+    pthread_mutex_lock(&sa->mtx);
+    if (sa->chunk_bump == sa->chunk_end) {
+      if ((c = (chunk_t *) calloc(1, sizeof(chunk_t))) == NULL) {
+	alloc_elog("calloc error");
+	goto end;
+      }
+      if (sa->base.flags & ALLOC_HUGEPAGE)
+	c->mem = page_alloc(SLAB_CHUNK_SIZE, ALLOC_HUGEPAGE);
+      else
+	c->mem = aligned_alloc(SLAB_CHUNK_SIZE, SLAB_CHUNK_SIZE);
+      if (c->mem == NULL) {
+	alloc_elog("chunk allocation error");
+	free(c);
+	goto end;
+      }
+      c->next = sa->chunk;
+      sa->chunk = c;
+      sa->chunk_bump = (char *) c->mem;
+      sa->chunk_end = (char *) c->mem + SLAB_CHUNK_SIZE;
+    }
+    slab = (slab_t *) sa->chunk_bump;
+    sa->chunk_bump += SLAB_SIZE;
+
+ end:
+    pthread_mutex_unlock(&sa->mtx);
+    return slab;
+}
+
+/* Move the blocks freed by other threads to the free lists of this heap. */
+static void drain_remote(heap_t * heap)
+{
+    block_t *b, *next;
+    size_class_t *c;
+
+    b = (block_t *) swap(&heap->remote, NULL);
+    while (b != NULL) {
+      next = b->next;
+      c = &heap->cls[class_of(slab_of(b)->size)];
+      b->next = c->free;
+      c->free = b;
+      b = next;
+    }
+}
+
+static void *large_alloc(slab_allocator_t * sa, const size_t size)
+{
+    size_t len = (SLAB_HEADER_SIZE + size + SLAB_SIZE - 1) & ~((size_t) SLAB_SIZE - 1);
+    slab_t *slab;
+
+    if ((slab = (slab_t *) aligned_alloc(SLAB_SIZE, len)) == NULL) {
+      alloc_elog("aligned_alloc error");
+      return NULL;
+    }
+    memset(slab, 0, len);
+    slab->size = len;
+
+    pthread_mutex_lock(&sa->mtx);
+    slab->next = sa->large;
+    if (sa->large != NULL)
+      sa->large->prev = slab;
+    sa->large = slab;
+    pthread_mutex_unlock(&sa->mtx);
+
+    return (char *) slab + SLAB_HEADER_SIZE;
+}
+
+static void large_free(slab_allocator_t * sa, slab_t * slab)
+{
+    pthread_mutex_lock(&sa->mtx);
+    if (slab->prev != NULL)
+      slab->prev->next = slab->next;
+    else
+      sa->large = slab->next;
+    if (slab->next != NULL)
+      slab->next->prev = slab->prev;
+    pthread_mutex_unlock(&sa->mtx);
+
+    free(slab);
+}
+
+
+static void *slab_alloc(allocator_t * a, const size_t size)
+{
+    slab_allocator_t *sa = (slab_allocator_t *) a;
+    heap_t *heap;
+    size_class_t *c;
+    slab_t *slab;
+    block_t *b;
+    size_t bsize;
+
+    if (SLAB_MAX_BLOCK < size)
+      return large_alloc(sa, size);
+
+    if ((heap = get_heap(sa)) == NULL)
+      return NULL;
+    bsize = (size == 0) ? SLAB_ALIGN : (size + SLAB_ALIGN - 1) & ~((size_t) SLAB_ALIGN - 1);
+    c = &heap->cls[class_of(bsize)];
+
+    if (c->free == NULL && heap->remote != NULL)
+      drain_remote(heap);
+
+    if ((b = c->free) != NULL)
+      c->free = b->next;
+    else {
+      if (c->end - c->bump < (ptrdiff_t) bsize) {
+	if ((slab = new_slab(sa)) == NULL)
+	  return NULL;
+	slab->owner = heap;
+	slab->size = bsize;
+	c->bump = (char *) slab + SLAB_HEADER_SIZE;
+	c->end = (char *) slab + SLAB_SIZE;
+      }
+      b = (block_t *) c->bump;
+      c->bump += bsize;
+    }
+
+    memset(b, 0, bsize);
+    return b;
+}
+
+static void slab_free(allocator_t * a, void *ptr)
+{
+    slab_allocator_t *sa = (slab_allocator_t *) a;
+    slab_t *slab;
+    heap_t *owner;
+    block_t *b = (block_t *) ptr;
+    void *head;
+    size_class_t *c;
+
+    if (ptr == NULL)
+      return;
+
+    slab = slab_of(ptr);
+    if ((owner = slab->owner) == NULL) {
+      large_free(sa, slab);
+      return;
+    }
+
+    if (owner == pthread_getspecific(sa->heap_key)) {
+      c = &owner->cls[class_of(slab->size)];
+      b->next = c->free;
+      c->free = b;
+    }
+    else {
+      do {
+	head = owner->remote;
+	b->next = (block_t *) head;
+      } while (!cas(&owner->remote, head, b));
+    }
+}
+
+/* No thread may use the allocator, or any memory allocated from it, after this. */
+static void slab_destroy(allocator_t * a)
+{
+    slab_allocator_t *sa = (slab_allocator_t *) a;
+    chunk_t *c, *cnext;
+    heap_t *h, *hnext;
+    slab_t *s, *snext;
+
+    pthread_key_delete(sa->heap_key);
+
+    for (c = sa->chunk; c != NULL; c = cnext) {
+      cnext = c->next;
+      if (sa->base.flags & ALLOC_HUGEPAGE)
+	page_free(c->mem, SLAB_CHUNK_SIZE);
+      else
+	free(c->mem);
+      free(c);
+    }
+    for (h = sa->heap; h != NULL; h = hnext) {
+      hnext = h->next;
+      free(h);
+    }
+    for (s = sa->large; s != NULL; s = snext) {
+      snext = s->next;
+      free(s);
+    }
+    pthread_mutex_destroy(&sa->mtx);
+    free(sa);
+}
+
+
+/*
+ * allocator_t *slab_allocator_create(const int flags)
+ *
+ * 'flags' is 0 or ALLOC_HUGEPAGE.
+ *
+ * success : return pointer to a new slab allocator
+ * failure : return NULL
+ */
+allocator_t *slab_allocator_create(const int flags)
+{
+    slab_allocator_t *sa;
+
+    if ((sa = (slab_allocator_t *) calloc(1, sizeof(slab_allocator_t))) == NULL) {
+      alloc_elog("calloc error");
+      return NULL;
+    }
+    sa->base.name = "slab";
+    sa->base.flags = flags;
+    sa->base.alloc = slab_alloc;
+    sa->base.free = slab_free;
+    sa->base.destroy = slab_destroy;
+
+    if (pthread_key_create(&sa->heap_key, release_heap) != 0) {
+      alloc_elog("pthread_key_create() error");
+      free(sa);
+      return NULL;
+    }
+    sa->mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER;
+
+    return &sa->base;
+}
+
+
+/*
+ * allocator_t *allocator_create(const char *name, const int flags)
+ *
+ * Return a new allocator by name, "malloc" or "slab", or NULL.
+ */
+allocator_t *allocator_create(const char *name, const int flags)
+{
+    if (strcmp(name, "malloc") == 0)
+      return (flags & ALLOC_HUGEPAGE) ? &malloc_hugepage_allocator_instance : malloc_allocator();
+    if (strcmp(name, "slab") == 0)
+      return slab_allocator_create(flags);
+    return NULL;
+}
+
+
+static allocator_t *default_allocator = NULL;
+
+/*
+ * allocator_t *get_allocator(void)
+ *
+ * Return the allocator that init functions give to new structures.
+ */
+allocator_t *get_allocator(void)
+{
+    return (default_allocator == NULL) ? malloc_allocator() : default_allocator;
+}
+
+void set_allocator(allocator_t * a)
+{
+    default_allocator = a;
+}
@@ -0,0 +1,77 @@
+/* ---------------------------------------------------------------------------
+ * Node Allocator
+ *
+ * A small allocator interface for the nodes of the lists, hash tables and queues.
+ * Every structure takes the allocator returned by get_allocator() when it is
+ * initialized, and allocates and frees all its nodes through it.
+ *
+ * Two allocators are provided:
+ *
+ *  malloc_allocator()      : calloc() and free(), the default.
+ *  slab_allocator_create() : per-thread slabs of fixed-size blocks. Sizes are
+ *                            rounded up to SLAB_ALIGN bytes, so nodes of different
+ *                            types, and skiplist nodes of different heights, fall
+ *                            into SLAB_CLASSES size classes. A thread allocates
+ *                            from its own slabs without any lock or atomic
+ *                            instruction. A block freed by another thread is
+ *                            pushed to the owner's remote list, and the owner
+ *                            takes the whole list back when it runs out of
+ *                            blocks. Memory is returned to the system only by
+ *                            allocator_destroy().
+ *
+ * Large arrays such as bucket tables are not nodes; they are allocated with
+ * allocator_alloc_region(). If the allocator was created with ALLOC_HUGEPAGE,
+ * regions and slab chunks are backed by 2 MB pages: reserved huge pages
+ * (MAP_HUGETLB) if the system has any, transparent huge pages (MADV_HUGEPAGE)
+ * otherwise.
+ *
+ * The huge page policy is therefore not an option of each structure's init:
+ * it belongs to the allocator, and set_allocator() makes one allocator the
+ * allocator of every structure initialized after it, in the whole process.
+ * To give structures different policies, create an allocator for each and set
+ * it before initializing the structure, as bench/bench does for each run.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include <stddef.h>
+
+#define SLAB_ALIGN       16                    /* block sizes are multiples of this */
+#define SLAB_CLASSES     64                    /* blocks up to SLAB_ALIGN * SLAB_CLASSES bytes */
+#define SLAB_SIZE        (16 * 1024)           /* power of 2; slabs are aligned to their size */
+#define SLAB_CHUNK_SIZE  (2 * 1024 * 1024)     /* slabs are carved out of chunks of this size */
+
+#define HUGE_PAGE_SIZE   (2 * 1024 * 1024)
+#define ALLOC_HUGEPAGE   0x01                  /* flag: back memory with huge pages */
+
+typedef struct _allocator_t
+{
+  const char *name;
+  int flags;                                               /* ALLOC_* */
+  void *(*alloc) (struct _allocator_t *, const size_t);   /* return zero-filled memory */
+  void (*free) (struct _allocator_t *, void *);
+  void (*destroy) (struct _allocator_t *);
+} allocator_t;
+
+
+allocator_t *malloc_allocator (void);
+allocator_t *slab_allocator_create (const int);
+allocator_t *allocator_create (const char *, const int);
+
+allocator_t *get_allocator (void);
+void set_allocator (allocator_t *);
+
+void *page_alloc (const size_t, const int);
+void page_free (void *, const size_t);
+void *allocator_alloc_region (allocator_t *, const size_t);
+void allocator_free_region (allocator_t *, void *);
+
+#define allocator_alloc(_a_, _size_)   ((_a_)->alloc((_a_), (_size_)))
+#define allocator_free(_a_, _ptr_)     ((_a_)->free((_a_), (_ptr_)))
+#define allocator_destroy(_a_)         ((_a_)->destroy(_a_))
+
+#endif
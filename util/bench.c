@@ -0,0 +1,738 @@
+/* ---------------------------------------------------------------------------
+ * Workload Bench Driver
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "bench.h"
+#include "hist.h"
+#include "perf.h"
+#include "stats.h"
+
+#define bench_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#ifdef _X86_64_
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    __asm__ __volatile__("lock; xaddq %0,%1"
+			 : "+r" (val), "+m" (*addr)
+			 :
+			 : "memory");
+    return val;
+}
+
+#define cpu_relax()   __asm__ __volatile__("pause" ::: "memory")
+#else
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    return __sync_fetch_and_add(addr, val);
+}
+
+#define cpu_relax()   __asm__ __volatile__("" ::: "memory")
+#endif
+
+static const char *op_names[] = {"read", "insert", "delete", "scan"};
+static const char op_letters[] = "rids";
+static const char *dist_names[] = {"uniform", "zipfian", "latest", "hotspot"};
+static const char *arrival_names[] = {"fixed", "poisson"};
+
+
+/*
+ * Zipfian ranks in [0, n), by the method of Gray et al., "Quickly Generating
+ * Billion-Record Synthetic Databases" (also used by YCSB). zeta(n) is summed
+ * once, in O(n).
+ */
+typedef struct _zipf_t
+{
+  uint64_t n;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+  double half_pow_theta;
+} zipf_t;
+
+static void zipf_init(zipf_t * z, const uint64_t n, const double theta)
+{
+    double zeta2 = 1.0 + pow(0.5, theta);
+    uint64_t i;
+
+    z->n = n;
+    z->theta = theta;
+    z->alpha = 1.0 / (1.0 - theta);
+    z->zetan = 0.0;
+    for (i = 1; i <= n; i++)
+      z->zetan += 1.0 / pow((double) i, theta);
+    z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / z->zetan);
+    z->half_pow_theta = pow(0.5, theta);
+}
+
+static uint64_t zipf_next(const zipf_t * z, const double u)
+{
+    double uz = u * z->zetan;
+    uint64_t r;
+
+    if (uz < 1.0)
+      return 0;
+    if (uz < 1.0 + z->half_pow_theta)
+      return 1;
+    r = (uint64_t) (z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+    return (r < z->n) ? r : z->n - 1;
+}
+
+
+/* 64-bit finalizer of MurmurHash3. */
+static inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* xorshift64*; the state must not be 0. */
+static inline uint64_t next_rand(uint64_t * state)
+{
+    uint64_t x = *state;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* Uniform in [0, 1). */
+static inline double next_double(uint64_t * state)
+{
+    return (next_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+
+typedef struct _worker_t
+{
+  pthread_t tid;
+  int no;
+  uint64_t seed;
+  uint64_t count[BENCH_OPS];          /* operations issued */
+  uint64_t success[BENCH_OPS];        /* operations that returned 1 */
+  double elapsed;
+  hist_t *hist;                       /* BENCH_OPS histograms if cfg->latency is set */
+  uint64_t event[PERF_EVENTS];        /* hardware counters if cfg->counters is set */
+  unsigned int event_ok;              /* bit e: event[e] was counted */
+  unsigned int event_scaled;          /* bit e: event[e] was multiplexed and scaled */
+  uint64_t late;                      /* open loop: operations started more than one interval late */
+} __attribute__((aligned(BENCH_CACHE_LINE_SIZE))) worker_t;
+
+/* State of the current bench_run(); runs do not overlap. */
+static struct {
+  const bench_ops_t *ops;
+  const bench_config_t *cfg;
+  zipf_t zipf;
+  volatile uint64_t ready;            /* workers waiting for 'start' */
+  volatile int start;
+  volatile int stop;
+  volatile uint64_t next_key;         /* BENCH_LATEST: key of the next insert */
+  int timed;                          /* 1: record the latency histograms */
+  double gap;                         /* open loop: mean ticks between the operations of a worker */
+} run;
+
+
+/*
+ * void bench_config_init(bench_config_t * cfg)
+ *
+ * Set the defaults: 90% reads and 5% each of inserts and deletes over 100000
+ * uniform keys, half of them prefilled, 100000 operations per thread.
+ */
+void bench_config_init(bench_config_t * cfg)
+{
+    memset(cfg, 0, sizeof(bench_config_t));
+    cfg->thread_num = 1;
+    cfg->mix[BENCH_READ] = 90;
+    cfg->mix[BENCH_INSERT] = 5;
+    cfg->mix[BENCH_DELETE] = 5;
+    cfg->mix[BENCH_SCAN] = 0;
+    cfg->dist = BENCH_UNIFORM;
+    cfg->zipf_theta = BENCH_ZIPF_THETA;
+    cfg->hot_keys = BENCH_HOT_KEYS;
+    cfg->hot_ops = BENCH_HOT_OPS;
+    cfg->key_range = 100000;
+    cfg->prefill = 50000;
+    cfg->duration = 0.0;
+    cfg->ops = 100000;
+    cfg->scan_length = BENCH_SCAN_LENGTH;
+}
+
+/*
+ * int bench_parse_mix(bench_config_t * cfg, const char *str)
+ *
+ * Parse an operation mix such as "r80,i10,d10": a letter of r(ead), i(nsert),
+ * d(elete) or s(can) followed by its percentage. Omitted operations get 0%.
+ *
+ * success : return 1
+ * failure(syntax error, or the percentages do not sum to 100) : return 0
+ */
+int bench_parse_mix(bench_config_t * cfg, const char *str)
+{
+    int mix[BENCH_OPS] = {0, 0, 0, 0};
+    const char *p = str, *l;
+    char *end;
+    long v;
+    int sum = 0;
+
+    while (*p != '\0') {
+      if ((l = strchr(op_letters, *p)) == NULL)
+	return 0;
+      v = strtol(p + 1, &end, 10);
+      if (end == p + 1 || v < 0 || 100 < v)
+	return 0;
+      mix[l - op_letters] = (int) v;
+      sum += (int) v;
+      p = end;
+      if (*p == ',')
+	p++;
+      else if (*p != '\0')
+	return 0;
+    }
+    if (sum != 100)
+      return 0;
+    memcpy(cfg->mix, mix, sizeof(mix));
+    return 1;
+}
+
+/*
+ * int bench_parse_dist(bench_config_t * cfg, const char *str)
+ *
+ * Parse a key distribution: "uniform", "zipf[:theta]", "latest[:theta]" or
+ * "hotspot[:hot_keys:hot_ops]", where hot_keys and hot_ops are fractions.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int bench_parse_dist(bench_config_t * cfg, const char *str)
+{
+    const char *arg = strchr(str, ':');
+    size_t len = (arg == NULL) ? strlen(str) : (size_t) (arg - str);
+    double a, b;
+
+    if (len == strlen("uniform") && strncmp(str, "uniform", len) == 0 && arg == NULL) {
+      cfg->dist = BENCH_UNIFORM;
+      return 1;
+    }
+    if ((len == strlen("zipf") && strncmp(str, "zipf", len) == 0)
+	|| (len == strlen("latest") && strncmp(str, "latest", len) == 0)) {
+      if (arg != NULL && (sscanf(arg + 1, "%lf", &a) != 1 || a <= 0.0 || 1.0 <= a))
+	return 0;
+      cfg->dist = (str[0] == 'z') ? BENCH_ZIPFIAN : BENCH_LATEST;
+      if (arg != NULL)
+	cfg->zipf_theta = a;
+      return 1;
+    }
+    if (len == strlen("hotspot") && strncmp(str, "hotspot", len) == 0) {
+      if (arg != NULL && (sscanf(arg + 1, "%lf:%lf", &a, &b) != 2
+			  || a <= 0.0 || 1.0 <= a || b < 0.0 || 1.0 < b))
+	return 0;
+      cfg->dist = BENCH_HOTSPOT;
+      if (arg != NULL) {
+	cfg->hot_keys = a;
+	cfg->hot_ops = b;
+      }
+      return 1;
+    }
+    return 0;
+}
+
+/*
+ * int bench_parse_rate(bench_config_t * cfg, const char *str)
+ *
+ * Parse an open-loop rate: "rate[:fixed|poisson]", the operations per second
+ * of all threads, such as "1e6" or "500000:poisson". Arrivals are fixed by
+ * default.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int bench_parse_rate(bench_config_t * cfg, const char *str)
+{
+    char *end;
+    double rate;
+    int i;
+
+    rate = strtod(str, &end);
+    if (end == str || rate <= 0.0)
+      return 0;
+    if (*end == '\0') {
+      cfg->rate = rate;
+      cfg->arrival = BENCH_FIXED;
+      return 1;
+    }
+    if (*end != ':')
+      return 0;
+    for (i = 0; i <= BENCH_POISSON; i++)
+      if (strcmp(end + 1, arrival_names[i]) == 0) {
+	cfg->rate = rate;
+	cfg->arrival = (bench_arrival_t) i;
+	return 1;
+      }
+    return 0;
+}
+
+
+static inline bench_op_t pick_op(const bench_config_t * cfg, uint64_t * seed)
+{
+    int r = (int) (next_rand(seed) % 100);
+    int op;
+
+    for (op = 0; op < BENCH_OPS - 1; op++)
+      if ((r -= cfg->mix[op]) < 0)
+	break;
+    return (bench_op_t) op;
+}
+
+/* Key of a read, delete or scan, or of an insert unless the distribution is BENCH_LATEST. */
+static inline uint64_t pick_key(const bench_config_t * cfg, uint64_t * seed)
+{
+    const uint64_t range = cfg->key_range;
+    uint64_t hot, newest;
+
+    switch (cfg->dist) {
+    case BENCH_ZIPFIAN:
+      return 1 + mix64(zipf_next(&run.zipf, next_double(seed))) % range;
+    case BENCH_LATEST:
+      newest = run.next_key - 1;
+      if (newest == 0)
+	return 1;
+      return newest - zipf_next(&run.zipf, next_double(seed)) % newest;
+    case BENCH_HOTSPOT:
+      hot = (uint64_t) (cfg->hot_keys * range);
+      if (hot == 0)
+	hot = 1;
+      if (hot == range || next_double(seed) < cfg->hot_ops)
+	return 1 + next_rand(seed) % hot;
+      return hot + 1 + next_rand(seed) % (range - hot);
+    default:
+      return 1 + next_rand(seed) % range;
+    }
+}
+
+static void *worker_thread(void *arg)
+{
+    worker_t *w = (worker_t *) arg;
+    const bench_ops_t *ops = run.ops;
+    const bench_config_t *cfg = run.cfg;
+    uint64_t i, key, k, t0 = 0, due = 0;
+    bench_op_t op;
+    double begin, next = 0.0;
+    int j, ret, e, counted;
+    perf_counter_t pc[PERF_EVENTS];
+
+    affinity_pin(cfg->affinity, w->no);
+    for (e = 0; e < PERF_EVENTS; e++)
+      if (cfg->counters != 1 || perf_thread_open(&pc[e], (perf_event_t) e) != 1)
+	pc[e].fd = -1;
+    fetch_and_add64(&run.ready, 1);
+    while (run.start == 0)
+      cpu_relax();
+    for (e = 0; e < PERF_EVENTS; e++)
+      perf_counter_enable(&pc[e]);
+    begin = now();
+    if (0.0 < cfg->rate)
+      next = (double) hist_ticks();
+
+    for (i = 0; (0.0 < cfg->duration) ? (run.stop == 0) : (i < cfg->ops); i++) {
+      op = pick_op(cfg, &w->seed);
+      if (op == BENCH_INSERT && cfg->dist == BENCH_LATEST)
+	key = fetch_and_add64(&run.next_key, 1);
+      else
+	key = pick_key(cfg, &w->seed);
+
+      if (0.0 < cfg->rate) {
+	/* Wait until the operation is due, and time it from then, not from when it starts. */
+	due = (uint64_t) next;
+	while ((t0 = hist_ticks()) < due && run.stop == 0)
+	  cpu_relax();
+	if (run.stop != 0)
+	  break;
+	if (run.gap < (double) (t0 - due))
+	  w->late++;
+	t0 = due;
+	next += (cfg->arrival == BENCH_POISSON) ? -log(1.0 - next_double(&w->seed)) * run.gap : run.gap;
+      } else if (run.timed == 1)
+	t0 = hist_ticks();
+      switch (op) {
+      case BENCH_READ:
+	ret = ops->lookup(ops->ds, key);
+	break;
+      case BENCH_INSERT:
+	ret = ops->insert(ops->ds, key);
+	break;
+      case BENCH_DELETE:
+	ret = ops->delete(ops->ds, key);
+	break;
+      default:
+	/* A scan succeeds if it finds at least one key. */
+	for (ret = 0, j = 0, k = key; j < cfg->scan_length; j++, k++)
+	  ret |= ops->lookup(ops->ds, k);
+	break;
+      }
+      if (run.timed == 1)
+	hist_record(&w->hist[op], hist_ticks() - t0);
+      w->count[op]++;
+      w->success[op] += ret;
+    }
+
+    w->elapsed = now() - begin;
+    for (e = 0; e < PERF_EVENTS; e++) {
+      perf_counter_disable(&pc[e]);
+      if ((counted = perf_counter_read(&pc[e], &w->event[e])) != 0)
+	w->event_ok |= 1U << e;
+      if (counted == PERF_SCALED)
+	w->event_scaled |= 1U << e;
+      perf_counter_close(&pc[e]);
+    }
+    return NULL;
+}
+
+
+/* Prefill the structure; return the number of keys added. */
+static uint64_t prefill(const bench_ops_t * ops, const bench_config_t * cfg)
+{
+    uint64_t i, n = cfg->prefill, added = 0;
+
+    if (cfg->dist == BENCH_LATEST) {
+      for (i = 1; i <= n; i++)
+	added += ops->insert(ops->ds, i);
+      run.next_key = n + 1;
+      return added;
+    }
+    if (cfg->key_range < n)
+      n = cfg->key_range;
+    /* Spread the keys evenly over the key range. */
+    for (i = 0; i < n; i++)
+      added += ops->insert(ops->ds, 1 + i * cfg->key_range / n);
+    return added;
+}
+
+/* Number of keys in the structure, by size() or by looking up every key that may be there. */
+static int64_t count_keys(const bench_ops_t * ops, const bench_config_t * cfg)
+{
+    uint64_t key, max_key;
+    int64_t n = 0;
+
+    if (ops->size != NULL)
+      return ops->size(ops->ds);
+
+    max_key = (cfg->dist == BENCH_LATEST) ? run.next_key - 1 : cfg->key_range;
+    for (key = 1; key <= max_key; key++)
+      n += ops->lookup(ops->ds, key);
+    return n;
+}
+
+static void report_latency(const bench_config_t * cfg, const worker_t * w)
+{
+    const double tpn = hist_ticks_per_ns();
+    hist_t *h;
+    int i, op;
+
+    if ((h = (hist_t *) malloc(sizeof(hist_t))) == NULL) {
+      bench_elog("malloc error");
+      return;
+    }
+    printf ("\tlatency [ns]%s (%.3f ticks/ns):\n",
+	    (0.0 < cfg->rate) ? " from the scheduled start" : "", tpn);
+    for (op = 0; op < BENCH_OPS; op++) {
+      hist_init(h);
+      for (i = 0; i < cfg->thread_num; i++)
+	hist_merge(h, &w[i].hist[op]);
+      if (h->total == 0)
+	continue;
+      printf ("\t  %-6s p50 = %.0f, p99 = %.0f, p99.9 = %.0f, max = %.0f\n", op_names[op],
+	      hist_percentile(h, 50.0) / tpn, hist_percentile(h, 99.0) / tpn,
+	      hist_percentile(h, 99.9) / tpn, h->max / tpn);
+    }
+    free(h);
+}
+
+/*
+ * Report each hardware counter per operation; n/a unless every thread counted it,
+ * and marked as scaled if some thread's count was.
+ */
+static void report_counters(const bench_config_t * cfg, const worker_t * w, const uint64_t total)
+{
+    uint64_t sum;
+    int i, e, ok, scaled;
+
+    printf ("\thardware counters / operation:\n");
+    for (e = 0; e < PERF_EVENTS; e++) {
+      for (sum = 0, ok = 1, scaled = 0, i = 0; i < cfg->thread_num; i++) {
+	if ((w[i].event_ok & (1U << e)) == 0)
+	  ok = 0;
+	if ((w[i].event_scaled & (1U << e)) != 0)
+	  scaled = 1;
+	sum += w[i].event[e];
+      }
+      if (ok == 1 && 0 < total)
+	printf ("\t  %-17s %12.3f%s\n", perf_event_name((perf_event_t) e), (double) sum / total,
+		(scaled == 1) ? " (scaled)" : "");
+      else
+	printf ("\t  %-17s %12s\n", perf_event_name((perf_event_t) e), "n/a");
+    }
+}
+
+static uint64_t total_ops(const bench_config_t * cfg, const worker_t * w)
+{
+    uint64_t total = 0;
+    int i, op;
+
+    for (i = 0; i < cfg->thread_num; i++)
+      for (op = 0; op < BENCH_OPS; op++)
+	total += w[i].count[op];
+    return total;
+}
+
+/*
+ * Write the throughput, the latency of all operations merged, and the dTLB
+ * misses / operation to *result.
+ */
+static void summarize(const bench_config_t * cfg, const worker_t * w, const uint64_t total,
+		      const double interval, bench_result_t * result)
+{
+    hist_t *h;
+    double tpn;
+    uint64_t late = 0, misses = 0;
+    int i, op, ok = (cfg->counters == 1 && 0 < total) ? 1 : 0;
+
+    memset(result, 0, sizeof(bench_result_t));
+    result->ops = total;
+    result->interval = interval;
+    result->throughput = (0.0 < interval) ? total / interval : 0.0;
+    for (i = 0; i < cfg->thread_num; i++) {
+      late += w[i].late;
+      if ((w[i].event_ok & (1U << PERF_DTLB_LOAD_MISSES)) == 0)
+	ok = 0;
+      if ((w[i].event_scaled & (1U << PERF_DTLB_LOAD_MISSES)) != 0)
+	result->dtlb_scaled = 1;
+      misses += w[i].event[PERF_DTLB_LOAD_MISSES];
+    }
+    result->late = (0 < total) ? (double) late / total : 0.0;
+    result->dtlb_misses = (ok == 1) ? (double) misses / total : -1.0;
+
+    if (run.timed != 1)
+      return;
+    if ((h = (hist_t *) malloc(sizeof(hist_t))) == NULL) {
+      bench_elog("malloc error");
+      return;
+    }
+    hist_init(h);
+    for (i = 0; i < cfg->thread_num; i++)
+      for (op = 0; op < BENCH_OPS; op++)
+	hist_merge(h, &w[i].hist[op]);
+    if (0 < h->total) {
+      tpn = hist_ticks_per_ns();
+      result->p50 = hist_percentile(h, 50.0) / tpn;
+      result->p99 = hist_percentile(h, 99.0) / tpn;
+      result->p999 = hist_percentile(h, 99.9) / tpn;
+      result->max = h->max / tpn;
+    }
+    free(h);
+}
+
+static void report(const bench_ops_t * ops, const bench_config_t * cfg, const worker_t * w,
+		   const uint64_t added, const double interval, bench_result_t * result)
+{
+    uint64_t count[BENCH_OPS], success[BENCH_OPS], total = 0;
+    double min_itvl = 0.0, max_itvl = 0.0, ave_itvl = 0.0;
+    int i, op;
+
+    memset(count, 0, sizeof(count));
+    memset(success, 0, sizeof(success));
+    for (i = 0; i < cfg->thread_num; i++) {
+      for (op = 0; op < BENCH_OPS; op++) {
+	count[op] += w[i].count[op];
+	success[op] += w[i].success[op];
+      }
+      if (i == 0 || w[i].elapsed < min_itvl)
+	min_itvl = w[i].elapsed;
+      if (max_itvl < w[i].elapsed)
+	max_itvl = w[i].elapsed;
+      ave_itvl += w[i].elapsed / cfg->thread_num;
+    }
+    for (op = 0; op < BENCH_OPS; op++)
+      total += count[op];
+
+    fprintf (stderr, "condition =>\n");
+    printf ("\t%s, %d threads run\n", ops->name, cfg->thread_num);
+    affinity_report(cfg->affinity, cfg->thread_num);
+    printf ("\tmix: read %d%%, insert %d%%, delete %d%%, scan %d%%",
+	    cfg->mix[BENCH_READ], cfg->mix[BENCH_INSERT], cfg->mix[BENCH_DELETE],
+	    cfg->mix[BENCH_SCAN]);
+    if (0 < cfg->mix[BENCH_SCAN])
+      printf (" of %d keys", cfg->scan_length);
+    printf ("\n");
+    if (ops->lookup == NULL)
+      printf ("\t%llu items prefilled\n", (unsigned long long int) added);
+    else {
+      printf ("\tkeys: %s", dist_names[cfg->dist]);
+      if (cfg->dist == BENCH_ZIPFIAN || cfg->dist == BENCH_LATEST)
+	printf (" (theta %.2f)", cfg->zipf_theta);
+      else if (cfg->dist == BENCH_HOTSPOT)
+	printf (" (%.0f%% of the operations on %.0f%% of the keys)", 100.0 * cfg->hot_ops,
+		100.0 * cfg->hot_keys);
+      printf (" over %llu keys, %llu prefilled\n", (unsigned long long int) cfg->key_range,
+	      (unsigned long long int) added);
+    }
+    if (0.0 < cfg->duration)
+      printf ("\t%.1f seconds\n", cfg->duration);
+    else
+      printf ("\t%llu operations / thread\n", (unsigned long long int) cfg->ops);
+    if (0.0 < cfg->rate)
+      printf ("\topen loop: %s arrivals at %.0f ops/s (%.0f ops/s / thread)\n",
+	      arrival_names[cfg->arrival], cfg->rate, cfg->rate / cfg->thread_num);
+
+    fprintf (stderr, "performance =>\n\tinterval =  %f [sec]\n", interval);
+    fprintf (stderr, "\tthread info:\n\t  ave. = %f[sec], min = %f[sec], max = %f[sec]\n",
+	     ave_itvl, min_itvl, max_itvl);
+    printf ("\tthroughput = %.3f Mops/s (%llu operations)\n",
+	    (0.0 < interval) ? total / interval * 1e-6 : 0.0, (unsigned long long int) total);
+    for (op = 0; op < BENCH_OPS; op++)
+      if (0 < count[op])
+	printf ("\t  %-6s %12llu ops, %5.1f%% succeeded\n", op_names[op],
+		(unsigned long long int) count[op], 100.0 * success[op] / count[op]);
+
+    summarize(cfg, w, total, interval, result);
+    if (0.0 < cfg->rate)
+      printf ("\tachieved %.1f%% of the target rate, %.2f%% of the operations started late\n",
+	      100.0 * result->throughput / cfg->rate, 100.0 * result->late);
+    if (run.timed == 1)
+      report_latency(cfg, w);
+    if (cfg->counters == 1)
+      report_counters(cfg, w, total);
+    STATS_REPORT();
+}
+
+
+/*
+ * int bench_run(const bench_ops_t * ops, const bench_config_t * cfg, bench_result_t * result)
+ *
+ * Prefill the structure of 'ops', run the workload 'cfg' on it with
+ * cfg->thread_num threads, report the results, and check the number of keys
+ * left in the structure. If 'result' is not NULL, write the summary to it.
+ *
+ * success : return 1
+ * failure(invalid configuration, or the structure lost or gained keys) : return 0
+ */
+int bench_run(const bench_ops_t * ops, const bench_config_t * cfg, bench_result_t * result)
+{
+    bench_result_t summary;
+    worker_t *w;
+    uint64_t added, seed;
+    int64_t expected, left;
+    double begin, interval;
+    struct timespec ts;
+    int i, ret = 1;
+
+    if (ops->lookup == NULL && (0 < cfg->mix[BENCH_READ] || 0 < cfg->mix[BENCH_SCAN])) {
+      fprintf(stderr, "Error: %s has no lookup; the mix may contain only i and d\n", ops->name);
+      return 0;
+    }
+    if (cfg->key_range == 0 || cfg->thread_num <= 0) {
+      bench_elog("invalid configuration");
+      return 0;
+    }
+
+    memset((void *) &run, 0, sizeof(run));
+    run.ops = ops;
+    run.cfg = cfg;
+    run.timed = (cfg->latency == 1 || 0.0 < cfg->rate) ? 1 : 0;
+    if (cfg->dist == BENCH_ZIPFIAN || cfg->dist == BENCH_LATEST)
+      zipf_init(&run.zipf, cfg->key_range, cfg->zipf_theta);
+
+    if ((w = (worker_t *) aligned_alloc(BENCH_CACHE_LINE_SIZE, cfg->thread_num * sizeof(worker_t))) == NULL) {
+      bench_elog("aligned_alloc error");
+      return 0;
+    }
+    memset(w, 0, cfg->thread_num * sizeof(worker_t));
+    if (run.timed == 1) {
+      hist_ticks_per_ns();          /* calibrate before the run */
+      if (0.0 < cfg->rate)
+	run.gap = hist_ticks_per_ns() * 1e9 * cfg->thread_num / cfg->rate;
+      for (i = 0; i < cfg->thread_num; i++)
+	if ((w[i].hist = (hist_t *) calloc(BENCH_OPS, sizeof(hist_t))) == NULL) {
+	  bench_elog("calloc error");
+	  abort();
+	}
+    }
+
+    if (cfg->quiet != 1)
+      fprintf(stderr, "<<workload bench>>\n");
+    added = prefill(ops, cfg);
+    STATS_RESET();
+
+    seed = (uint64_t) time(NULL);
+    for (i = 0; i < cfg->thread_num; i++) {
+      w[i].no = i;
+      w[i].seed = mix64(seed + i) | 1;
+      if (pthread_create(&w[i].tid, NULL, worker_thread, &w[i]) != 0) {
+	bench_elog("pthread_create() error");
+	abort();
+      }
+    }
+
+    while (run.ready < (uint64_t) cfg->thread_num)
+      cpu_relax();
+    begin = now();
+    run.start = 1;
+
+    if (0.0 < cfg->duration) {
+      ts.tv_sec = (time_t) cfg->duration;
+      ts.tv_nsec = (long) ((cfg->duration - ts.tv_sec) * 1e9);
+      while (nanosleep(&ts, &ts) != 0)
+	;
+      run.stop = 1;
+    }
+    for (i = 0; i < cfg->thread_num; i++)
+      if (pthread_join(w[i].tid, NULL) != 0) {
+	bench_elog("pthread_join() error");
+	abort();
+      }
+    interval = now() - begin;
+
+    /* Report before counting the keys, so that the stats cover the timed run only. */
+    if (cfg->quiet == 1)
+      summarize(cfg, w, total_ops(cfg, w), interval, (result != NULL) ? result : &summary);
+    else
+      report(ops, cfg, w, added, interval, (result != NULL) ? result : &summary);
+
+    expected = (int64_t) added;
+    for (i = 0; i < cfg->thread_num; i++)
+      expected += w[i].success[BENCH_INSERT] - w[i].success[BENCH_DELETE];
+    if ((left = count_keys(ops, cfg)) != expected) {
+      fprintf (stderr, "RESULT: test FAILED! (%lld keys left, %lld expected)\n",
+	       (long long int) left, (long long int) expected);
+      ret = 0;
+    } else if (cfg->quiet != 1)
+      fprintf (stderr, "RESULT: test OK\n");
+
+    for (i = 0; i < cfg->thread_num; i++)
+      free(w[i].hist);
+    free(w);
+    return ret;
+}
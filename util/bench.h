@@ -0,0 +1,143 @@
+/* ---------------------------------------------------------------------------
+ * Workload Bench Driver
+ *
+ * A workload-driven driver shared by the queue, list and hash benches. The
+ * stub of a structure describes it by a bench_ops_t, and bench_run() drives it
+ * with a mix of read, insert, delete and scan operations whose keys follow
+ * one of these distributions over [1, key_range]:
+ *
+ *  BENCH_UNIFORM : every key is equally likely.
+ *  BENCH_ZIPFIAN : zipfian(theta) popularity; the ranks are scattered over
+ *                  the key range by a hash, so hot keys are not adjacent.
+ *  BENCH_LATEST  : inserts append new keys above all others, and the other
+ *                  operations pick the recently inserted keys with zipfian
+ *                  skew (the YCSB "latest" distribution).
+ *  BENCH_HOTSPOT : hot_ops of the operations go to the lowest hot_keys of
+ *                  the key range, the rest to the other keys.
+ *
+ * The structure is prefilled with 'prefill' keys before the timed run, which
+ * lasts 'duration' seconds, or 'ops' operations per thread if duration is 0.
+ * A scan is scan_length lookups of consecutive keys. Queues have no lookup:
+ * their mix may only contain inserts (enqueue) and deletes (dequeue).
+ *
+ * bench_run() reports the throughput in Mops/s and, per operation type, the
+ * number of operations and how many of them succeeded. If 'latency' is set,
+ * every operation is also timed with hist_ticks() into a per-thread histogram
+ * of its type (see hist.h), and the merged histograms are reported as p50,
+ * p99, p99.9 and max in nanoseconds. It then checks that the structure holds
+ * exactly the prefilled keys plus the successful inserts minus the successful
+ * deletes.
+ *
+ * If 'counters' is set, each worker also counts the cycles, instructions, LLC
+ * misses, dTLB load misses, branch misses and locked instructions of its own
+ * timed loop with perf_thread_open() (see perf.h), and the sums are reported
+ * per operation; a counter that some thread could not open, or that never ran,
+ * is reported as n/a, and one that the kernel multiplexed with the others in
+ * some thread is scaled to the whole loop (see perf.h) and marked as scaled.
+ *
+ * If 'affinity' is set, worker i is pinned to its CPU (see affinity.h) before
+ * the run starts, and the placement is reported with the results.
+ *
+ * By default the load is closed-loop: each worker issues its next operation
+ * as soon as the previous one returns, so a stall (a stop-the-world resize,
+ * a preempted lock holder) delays the operations that would have arrived
+ * during it without their latency showing it (coordinated omission). If
+ * 'rate' is set, the load is open-loop instead: each worker schedules its
+ * operations at rate / thread_num per second, at fixed intervals or as a
+ * Poisson process ('arrival'), and waits only for operations that are not due
+ * yet. A worker that falls behind issues its overdue operations back to back,
+ * and the latency of every operation is recorded from its scheduled start,
+ * so it includes the time it waited behind the stall. bench_run() then
+ * records the latency histograms, and reports the achieved rate and the share
+ * of operations that started more than one interval late.
+ *
+ * If 'result' of bench_run() is not NULL, the throughput and the latency
+ * percentiles of all operations are also written to it, for the sweeps of
+ * bench/bench, which may set 'quiet' to print nothing else.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <inttypes.h>
+
+#include "affinity.h"
+
+#define BENCH_CACHE_LINE_SIZE  64
+#define BENCH_SCAN_LENGTH      16      /* lookups per scan */
+#define BENCH_ZIPF_THETA       0.99    /* default skew of zipfian and latest */
+#define BENCH_HOT_KEYS         0.2     /* default hotspot: 20% of the keys ... */
+#define BENCH_HOT_OPS          0.8     /* ... get 80% of the operations */
+
+typedef enum {
+  BENCH_READ = 0, BENCH_INSERT, BENCH_DELETE, BENCH_SCAN, BENCH_OPS,
+} bench_op_t;
+
+typedef enum {
+  BENCH_UNIFORM = 0, BENCH_ZIPFIAN, BENCH_LATEST, BENCH_HOTSPOT,
+} bench_dist_t;
+
+typedef enum {
+  BENCH_FIXED = 0, BENCH_POISSON,
+} bench_arrival_t;
+
+/*
+ * A structure under test. Every function returns 1 on success and 0 on
+ * failure (key exists, key not found, queue empty). lookup is NULL for
+ * queues, whose delete ignores the key. size may be NULL, in which case the
+ * keys are counted by lookups at the end.
+ */
+typedef struct _bench_ops_t
+{
+  const char *name;
+  void *ds;                           /* the structure, passed to every function */
+  int (*insert) (void *, const uint64_t);
+  int (*delete) (void *, const uint64_t);
+  int (*lookup) (void *, const uint64_t);
+  int64_t (*size) (void *);
+} bench_ops_t;
+
+typedef struct _bench_config_t
+{
+  int thread_num;
+  int mix[BENCH_OPS];                 /* percent of each operation; sums to 100 */
+  bench_dist_t dist;
+  double zipf_theta;                  /* BENCH_ZIPFIAN and BENCH_LATEST, in (0, 1) */
+  double hot_keys;                    /* BENCH_HOTSPOT */
+  double hot_ops;
+  uint64_t key_range;
+  uint64_t prefill;
+  double duration;                    /* seconds; 0: run 'ops' operations per thread */
+  uint64_t ops;
+  int scan_length;
+  int latency;                        /* 1: record per-operation latency histograms */
+  int counters;                       /* 1: count hardware events per thread (see perf.h) */
+  const affinity_t *affinity;         /* placement of the worker threads; NULL: not pinned */
+  double rate;                        /* operations / second of all threads; 0: closed loop */
+  bench_arrival_t arrival;            /* open loop: schedule of the operations */
+  int quiet;                          /* 1: report only failures; the caller reads the result */
+} bench_config_t;
+
+/* Summary of a run. */
+typedef struct _bench_result_t
+{
+  uint64_t ops;                       /* operations done by all threads */
+  double interval;                    /* seconds */
+  double throughput;                  /* operations / second */
+  double p50, p99, p999, max;         /* latency of all operations [ns]; 0 unless recorded */
+  double late;                        /* open loop: share of operations started late */
+  double dtlb_misses;                 /* dTLB load misses / operation if counted; -1 otherwise */
+  int dtlb_scaled;                    /* 1: the counter was multiplexed and its count scaled */
+} bench_result_t;
+
+
+void bench_config_init (bench_config_t *);
+int bench_parse_mix (bench_config_t *, const char *);
+int bench_parse_dist (bench_config_t *, const char *);
+int bench_parse_rate (bench_config_t *, const char *);
+int bench_run (const bench_ops_t *, const bench_config_t *, bench_result_t *);
+
+#endif
@@ -0,0 +1,37 @@
+/* ---------------------------------------------------------------------------
+ * Streamed Checksums
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <string.h>
+
+#include "checksum.h"
+
+void checksum_init(checksum_t * c)
+{
+    memset(c, 0, sizeof(checksum_t));
+}
+
+/*
+ * void checksum_merge(checksum_t * dst, const checksum_t * src)
+ *
+ * Add the values of 'src' to 'dst'.
+ */
+void checksum_merge(checksum_t * dst, const checksum_t * src)
+{
+    dst->count += src->count;
+    dst->sum += src->sum;
+    dst->hash += src->hash;
+}
+
+/*
+ * int checksum_equal(const checksum_t * a, const checksum_t * b)
+ *
+ * Return 1 if 'a' and 'b' have summed the same values, otherwise 0.
+ */
+int checksum_equal(const checksum_t * a, const checksum_t * b)
+{
+    return (a->count == b->count && a->sum == b->sum && a->hash == b->hash) ? 1 : 0;
+}
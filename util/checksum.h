@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------------------
+ * Streamed Checksums
+ *
+ * The benches verify a run without remembering its keys. Each thread folds
+ * every key it puts into the structure into one checksum_t and every value it
+ * gets back into another, and after the run the checksums of all threads,
+ * merged by checksum_merge(), must be equal. A checksum_t holds the number
+ * of values, their sum, and the sum of a 64-bit mix of each, all modulo 2^64.
+ * The sum of the mixes is a multiset hash: a lost, duplicated or corrupted
+ * value goes unnoticed only if the mixes happen to cancel out, with
+ * probability about 2^-64.
+ *
+ * checksum_add() is a few instructions on a checksum private to the thread,
+ * and the memory needed does not grow with the number of operations.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include <inttypes.h>
+
+typedef struct _checksum_t
+{
+  uint64_t count;                     /* number of values */
+  uint64_t sum;                       /* sum of the values */
+  uint64_t hash;                      /* sum of checksum_mix() of the values */
+} checksum_t;
+
+
+/* 64-bit finalizer of MurmurHash3. */
+static inline uint64_t checksum_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline void checksum_add(checksum_t * c, const uint64_t v)
+{
+    c->count++;
+    c->sum += v;
+    c->hash += checksum_mix(v);
+}
+
+
+void checksum_init (checksum_t *);
+void checksum_merge (checksum_t *, const checksum_t *);
+int checksum_equal (const checksum_t *, const checksum_t *);
+
+#endif
@@ -0,0 +1,153 @@
+/* ---------------------------------------------------------------------------
+ * Sharded Counter
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "counter.h"
+
+#ifdef _X86_64_
+static inline int64_t fetch_and_add(volatile int64_t * addr, int64_t val)
+{
+  __asm__ __volatile__("lock; xaddq %0,%1"
+                       : "+r" (val), "+m" (*addr)
+                       :
+                       : "memory");
+  return val;
+}
+
+static inline int64_t swap(volatile int64_t * addr, int64_t val)
+{
+  __asm__ __volatile__("xchgq %0,%1"
+                       : "+r" (val), "+m" (*addr)
+                       :
+                       : "memory");
+  return val;
+}
+#else
+static inline int64_t fetch_and_add(volatile int64_t * addr, int64_t val)
+{
+  return __sync_fetch_and_add(addr, val);
+}
+
+static inline int64_t swap(volatile int64_t * addr, int64_t val)
+{
+  return __sync_lock_test_and_set(addr, val);
+}
+#endif
+
+
+static volatile int64_t next_shard = 0;
+static __thread int my_shard = -1;
+
+/* Threads get shards round-robin on their first update of any counter. */
+static inline int get_shard(void)
+{
+    if (my_shard < 0)
+      my_shard = (int) (fetch_and_add(&next_shard, 1) % COUNTER_SHARDS);
+    return my_shard;
+}
+
+
+/*
+ * int counter_init(counter_t * c)
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int counter_init(counter_t * c)
+{
+    c->count = 0;
+    if ((c->shard = (counter_shard_t *) aligned_alloc(sizeof(counter_shard_t),
+						      COUNTER_SHARDS * sizeof(counter_shard_t))) == NULL) {
+      fprintf(stderr, "%s():%s:%u: aligned_alloc error\n", __FUNCTION__, __FILE__, __LINE__);
+      return 0;
+    }
+    memset(c->shard, 0, COUNTER_SHARDS * sizeof(counter_shard_t));
+    return 1;
+}
+
+void counter_destroy(counter_t * c)
+{
+    free(c->shard);
+    c->shard = NULL;
+}
+
+
+/*
+ * void counter_add(counter_t * c, const int64_t val)
+ *
+ * Add 'val' to the shard of the calling thread. The central count is written
+ * only when the shard has drifted by COUNTER_BATCH or more.
+ */
+void counter_add(counter_t * c, const int64_t val)
+{
+    counter_shard_t *s = &c->shard[get_shard()];
+    int64_t v;
+
+    /* The shard is shared only if there are more than COUNTER_SHARDS threads. */
+    v = fetch_and_add(&s->count, val) + val;
+    if (v >= COUNTER_BATCH || v <= -COUNTER_BATCH)
+      fetch_and_add(&c->count, swap(&s->count, 0));
+}
+
+
+/*
+ * int64_t counter_read(const counter_t * c)
+ *
+ * Return the central count, which does not include the values still kept in the shards.
+ */
+int64_t counter_read(const counter_t * c)
+{
+    return c->count;
+}
+
+
+/*
+ * int64_t counter_read_exact(const counter_t * c)
+ *
+ * Return the central count plus all shards. This is exact when no thread is
+ * updating the counter; otherwise it is some value the counter passed through
+ * during the call, give or take the concurrent updates.
+ */
+int64_t counter_read_exact(const counter_t * c)
+{
+    int64_t sum = c->count;
+    int i;
+
+    for (i = 0; i < COUNTER_SHARDS; i++)
+      sum += c->shard[i].count;
+    return sum;
+}
+
+
+/*
+ * int counter_compare(const counter_t * c, const int64_t rhs)
+ *
+ * Compare the counter with 'rhs': return 1 if greater, -1 if less, 0 if equal.
+ * Use the approximate count when it is far enough from 'rhs' to decide,
+ * and fall back to counter_read_exact() otherwise.
+ */
+int counter_compare(const counter_t * c, const int64_t rhs)
+{
+    int64_t count = c->count;
+    int64_t error = (int64_t) COUNTER_BATCH * (next_shard < COUNTER_SHARDS ? next_shard : COUNTER_SHARDS);
+
+    if (count - rhs > error)
+      return 1;
+    if (rhs - count > error)
+      return -1;
+
+    count = counter_read_exact(c);
+    if (count > rhs)
+      return 1;
+    else if (count < rhs)
+      return -1;
+    return 0;
+}
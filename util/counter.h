@@ -0,0 +1,45 @@
+/* ---------------------------------------------------------------------------
+ * Sharded Counter
+ *
+ * A counter split into per-thread shards, in the manner of the Linux percpu_counter.
+ * Each thread adds to its own cache line, and folds the shard into the central
+ * count only when it exceeds COUNTER_BATCH. So counter_read() is cheap but may be
+ * off by up to (number of threads * COUNTER_BATCH), and counter_read_exact() sums
+ * all shards.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _COUNTER_H_
+#define _COUNTER_H_
+
+#include <inttypes.h>
+
+#define COUNTER_SHARDS  64      /* threads beyond this share shards */
+#define COUNTER_BATCH   32      /* maximum absolute value kept in a shard */
+
+typedef struct _counter_shard_t
+{
+  volatile int64_t count;
+} __attribute__((aligned(64))) counter_shard_t;
+
+
+typedef struct _counter_t
+{
+  volatile int64_t count;       /* central count */
+  counter_shard_t *shard;       /* shard array (length = COUNTER_SHARDS) */
+} counter_t;
+
+
+int counter_init (counter_t *);
+void counter_destroy (counter_t *);
+void counter_add (counter_t *, const int64_t);
+int64_t counter_read (const counter_t *);
+int64_t counter_read_exact (const counter_t *);
+int counter_compare (const counter_t *, const int64_t);
+
+#define counter_inc(_c_)  counter_add((_c_), 1)
+#define counter_dec(_c_)  counter_add((_c_), -1)
+
+#endif
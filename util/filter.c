@@ -0,0 +1,465 @@
+/* ---------------------------------------------------------------------------
+ * Membership Filters
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+
+#define filter_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#define BLOCK_WORDS    8                         /* 64-bit words per bloom block */
+#define BLOCK_BITS     (BLOCK_WORDS * 64)
+#define LANE_BITS      16                        /* bits of a cuckoo fingerprint */
+#define LANE_MASK      ((uint64_t) 0xffff)
+
+#ifdef _X86_64_
+static inline int cas64(volatile uint64_t * addr, uint64_t oldv, uint64_t newv)
+{
+    uint64_t result;
+    __asm__ __volatile__("lock; cmpxchgq %2,%1"
+			 : "=a" (result), "+m" (*addr)
+			 : "r" (newv), "0" (oldv)
+			 : "memory");
+    return (result == oldv);
+}
+
+static inline void fetch_and_or64(volatile uint64_t * addr, uint64_t val)
+{
+    __asm__ __volatile__("lock; orq %1,%0"
+			 : "+m" (*addr)
+			 : "r" (val)
+			 : "memory");
+}
+
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    __asm__ __volatile__("lock; xaddq %0,%1"
+			 : "+r" (val), "+m" (*addr)
+			 :
+			 : "memory");
+    return val;
+}
+
+#define cpu_relax()      __asm__ __volatile__("pause" ::: "memory")
+/* Loads are not reordered with other loads on x86. */
+#define read_barrier()   __asm__ __volatile__("" ::: "memory")
+#else
+static inline int cas64(volatile uint64_t * addr, uint64_t oldv, uint64_t newv)
+{
+    return __sync_bool_compare_and_swap(addr, oldv, newv);
+}
+
+static inline void fetch_and_or64(volatile uint64_t * addr, uint64_t val)
+{
+    __sync_fetch_and_or(addr, val);
+}
+
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    return __sync_fetch_and_add(addr, val);
+}
+
+#define cpu_relax()      __asm__ __volatile__("" ::: "memory")
+#define read_barrier()   __sync_synchronize()
+#endif
+
+static const char *filter_names[] = {"bloom", "cuckoo"};
+
+
+/* 64-bit finalizer of MurmurHash3. */
+static inline uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t pow2_at_least(uint64_t n)
+{
+    uint64_t p = 1;
+
+    while (p < n)
+      p <<= 1;
+    return p;
+}
+
+
+/*
+ * Blocked Bloom filter
+ *
+ * The low bits of the hash select the block, and FILTER_BLOOM_HASHES 9-bit
+ * fields of a second hash select the bits in it.
+ */
+static void bloom_add(filter_t * f, const uint64_t key)
+{
+    uint64_t h = mix64(key);
+    volatile uint64_t *block = f->word + BLOCK_WORDS * (h & f->mask);
+    uint64_t bits = mix64(h ^ 0x9e3779b97f4a7c15ULL);
+    unsigned int b;
+    int i;
+
+    for (i = 0; i < FILTER_BLOOM_HASHES; i++, bits >>= 9) {
+      b = (unsigned int) (bits & (BLOCK_BITS - 1));
+      /* Skip the locked OR if the bit is already set, so as not to dirty the line. */
+      if ((block[b >> 6] & (1ULL << (b & 63))) == 0)
+	fetch_and_or64(&block[b >> 6], 1ULL << (b & 63));
+    }
+}
+
+static int bloom_contains(filter_t * f, const uint64_t key)
+{
+    uint64_t h = mix64(key);
+    volatile uint64_t *block = f->word + BLOCK_WORDS * (h & f->mask);
+    uint64_t bits = mix64(h ^ 0x9e3779b97f4a7c15ULL);
+    unsigned int b;
+    int i;
+
+    for (i = 0; i < FILTER_BLOOM_HASHES; i++, bits >>= 9) {
+      b = (unsigned int) (bits & (BLOCK_BITS - 1));
+      if ((block[b >> 6] & (1ULL << (b & 63))) == 0)
+	return 0;
+    }
+    return 1;
+}
+
+
+/*
+ * Cuckoo filter
+ *
+ * A key has a fingerprint and two candidate buckets, i1 and i2 = i1 ^ hash(fp),
+ * so a fingerprint can be moved to its other bucket without the key. A bucket
+ * is one 64-bit word of FILTER_CUCKOO_SLOTS lanes; an empty lane is 0.
+ */
+static inline uint64_t fingerprint(const uint64_t h)
+{
+    uint64_t fp = h >> (64 - LANE_BITS);
+
+    return (fp == 0) ? 1 : fp;
+}
+
+static inline uint64_t alt_bucket(const filter_t * f, const uint64_t i, const uint64_t fp)
+{
+    return (i ^ mix64(fp)) & f->mask;
+}
+
+/* Return the lane of bucket b that holds fp, or -1. fp = 0 looks for an empty lane. */
+static inline int find_lane(const uint64_t b, const uint64_t fp)
+{
+    int lane;
+
+    for (lane = 0; lane < FILTER_CUCKOO_SLOTS; lane++)
+      if (((b >> (lane * LANE_BITS)) & LANE_MASK) == fp)
+	return lane;
+    return -1;
+}
+
+static int insert_fp(filter_t * f, const uint64_t i, const uint64_t fp)
+{
+    uint64_t b;
+    int lane;
+
+    do {
+      b = f->word[i];
+      if ((lane = find_lane(b, 0)) < 0)
+	return 0;
+    } while (cas64(&f->word[i], b, b | (fp << (lane * LANE_BITS))) != 1);
+    return 1;
+}
+
+static int remove_fp(filter_t * f, const uint64_t i, const uint64_t fp)
+{
+    uint64_t b;
+    int lane;
+
+    do {
+      b = f->word[i];
+      if ((lane = find_lane(b, fp)) < 0)
+	return 0;
+    } while (cas64(&f->word[i], b, b & ~(LANE_MASK << (lane * LANE_BITS))) != 1);
+    return 1;
+}
+
+/*
+ * Called with f->lock held when both buckets are full: evict fingerprints to
+ * their other buckets until one fits. The evicted fingerprint is in no bucket
+ * while it is moved, so the version is odd during the whole relocation.
+ */
+static int relocate(filter_t * f, uint64_t i, uint64_t fp)
+{
+    uint64_t b, victim;
+    int kick, lane;
+
+    fetch_and_add64(&f->version, 1);
+    for (kick = 0; kick < FILTER_CUCKOO_MAX_KICKS; kick++) {
+      if (insert_fp(f, i, fp) == 1)
+	break;
+      lane = (int) ((fp ^ kick) % FILTER_CUCKOO_SLOTS);
+      b = f->word[i];
+      victim = (b >> (lane * LANE_BITS)) & LANE_MASK;
+      if (cas64(&f->word[i], b, (b & ~(LANE_MASK << (lane * LANE_BITS)))
+		| (fp << (lane * LANE_BITS))) != 1)
+	continue;
+      if (victim == 0)            /* the lane was emptied by a delete */
+	break;
+      fp = victim;
+      i = alt_bucket(f, i, fp);
+    }
+    if (kick == FILTER_CUCKOO_MAX_KICKS)
+      f->overflow = 1;            /* set before the version becomes even */
+    fetch_and_add64(&f->version, 1);
+
+    return (kick == FILTER_CUCKOO_MAX_KICKS) ? 0 : 1;
+}
+
+static int cuckoo_add(filter_t * f, const uint64_t key)
+{
+    uint64_t h = mix64(key);
+    uint64_t fp = fingerprint(h);
+    uint64_t i1 = h & f->mask;
+    uint64_t i2 = alt_bucket(f, i1, fp);
+    int ret;
+
+    if (insert_fp(f, i1, fp) == 1 || insert_fp(f, i2, fp) == 1)
+      return 1;
+
+    lock_acquire(f->lock_kind, &f->lock);
+    ret = relocate(f, (h & 1) ? i1 : i2, fp);
+    lock_release(f->lock_kind, &f->lock);
+    return ret;
+}
+
+static void cuckoo_delete(filter_t * f, const uint64_t key)
+{
+    uint64_t h = mix64(key);
+    uint64_t fp = fingerprint(h);
+    uint64_t i1 = h & f->mask;
+    uint64_t i2 = alt_bucket(f, i1, fp);
+
+    if (remove_fp(f, i1, fp) == 1 || remove_fp(f, i2, fp) == 1)
+      return;
+
+    /* The fingerprint may be being relocated; it has settled once we hold the lock. */
+    lock_acquire(f->lock_kind, &f->lock);
+    if (remove_fp(f, i1, fp) != 1)
+      remove_fp(f, i2, fp);
+    lock_release(f->lock_kind, &f->lock);
+}
+
+static int cuckoo_contains(filter_t * f, const uint64_t key)
+{
+    uint64_t h = mix64(key);
+    uint64_t fp = fingerprint(h);
+    uint64_t i1 = h & f->mask;
+    uint64_t i2 = alt_bucket(f, i1, fp);
+    uint64_t v;
+    int retry;
+
+    for (retry = 0; retry < FILTER_READ_RETRIES; retry++) {
+      v = f->version;
+      read_barrier();
+      if (f->overflow == 1)
+	return 1;
+      if ((v & 1) == 0) {
+	if (0 <= find_lane(f->word[i1], fp) || 0 <= find_lane(f->word[i2], fp))
+	  return 1;
+	read_barrier();
+	if (f->version == v)
+	  return 0;
+      }
+      cpu_relax();
+    }
+    return 1;                     /* a false positive is always allowed */
+}
+
+
+/*
+ * filter_t *filter_create(const char *name, const uint64_t capacity)
+ *
+ * Create the filter 'name' ("bloom" or "cuckoo") sized for 'capacity' keys.
+ *
+ * success : return pointer to the filter
+ * failure(unknown name, or no memory) : return NULL
+ */
+filter_t *filter_create(const char *name, const uint64_t capacity)
+{
+    filter_t *f;
+    uint64_t n;
+
+    if ((f = (filter_t *) calloc(1, sizeof(filter_t))) == NULL) {
+      filter_elog("calloc error");
+      return NULL;
+    }
+
+    if (strcmp(name, filter_names[FILTER_BLOOM]) == 0) {
+      f->kind = FILTER_BLOOM;
+      n = pow2_at_least((capacity * FILTER_BLOOM_BITS_PER_KEY + BLOCK_BITS - 1) / BLOCK_BITS);
+      f->size = n * BLOCK_WORDS * sizeof(uint64_t);
+    } else if (strcmp(name, filter_names[FILTER_CUCKOO]) == 0) {
+      f->kind = FILTER_CUCKOO;
+      n = pow2_at_least((uint64_t) (capacity / (FILTER_CUCKOO_SLOTS * FILTER_CUCKOO_LOAD)) + 1);
+      if (n < 2)
+	n = 2;
+      f->size = n * sizeof(uint64_t);
+      f->lock_kind = get_lock_kind();
+      if (lock_init(f->lock_kind, &f->lock) != 1) {
+	filter_elog("lock_init error");
+	free(f);
+	return NULL;
+      }
+    } else {
+      free(f);
+      return NULL;
+    }
+    f->capacity = capacity;
+    f->mask = n - 1;
+
+    if ((f->word = (volatile uint64_t *) aligned_alloc(64, (f->size + 63) & ~((size_t) 63))) == NULL) {
+      filter_elog("aligned_alloc error");
+      if (f->kind == FILTER_CUCKOO)
+	lock_destroy(f->lock_kind, &f->lock);
+      free(f);
+      return NULL;
+    }
+    memset((void *) f->word, 0, f->size);
+    return f;
+}
+
+void filter_destroy(filter_t * f)
+{
+    if (f->kind == FILTER_CUCKOO)
+      lock_destroy(f->lock_kind, &f->lock);
+    free((void *) f->word);
+    free(f);
+}
+
+/*
+ * int filter_add(filter_t * f, const uint64_t key)
+ *
+ * success : return 1
+ * failure(the cuckoo filter overflowed) : return 0; filter_contains() returns 1
+ *                                         for every key from now on
+ */
+int filter_add(filter_t * f, const uint64_t key)
+{
+    if (f->kind == FILTER_BLOOM) {
+      bloom_add(f, key);
+      return 1;
+    }
+    return cuckoo_add(f, key);
+}
+
+void filter_delete(filter_t * f, const uint64_t key)
+{
+    if (f->kind == FILTER_CUCKOO)
+      cuckoo_delete(f, key);
+}
+
+/*
+ * int filter_contains(filter_t * f, const uint64_t key)
+ *
+ * key may be present : return 1
+ * key is absent      : return 0
+ */
+int filter_contains(filter_t * f, const uint64_t key)
+{
+    if (f->kind == FILTER_BLOOM)
+      return bloom_contains(f, key);
+    return cuckoo_contains(f, key);
+}
+
+const char *filter_name(const filter_t * f)
+{
+    return filter_names[f->kind];
+}
+
+
+/*
+ * void filtered_init(filtered_t * f, const ds_ops_t * ops, void *ds, filter_t * filter)
+ *
+ * Put 'filter', if not NULL, in front of the structure 'ds' of 'ops'.
+ */
+void filtered_init(filtered_t * f, const ds_ops_t * ops, void *ds, filter_t * filter)
+{
+    f->ops = ops;
+    f->ds = ds;
+    f->filter = filter;
+}
+
+/*
+ * int filtered_add(void *f, const uint64_t key)
+ *
+ * Add 'key' to the filter, then to the structure; take it back from the filter
+ * if the structure does not add it.
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int filtered_add(void *f, const uint64_t key)
+{
+    filtered_t *fs = (filtered_t *) f;
+
+    if (fs->filter != NULL)
+      filter_add(fs->filter, key);      /* on overflow the filter passes every key */
+    if (fs->ops->add(fs->ds, key) == 1)
+      return 1;
+    if (fs->filter != NULL)
+      filter_delete(fs->filter, key);
+    return 0;
+}
+
+/*
+ * int filtered_delete(void *f, const uint64_t key)
+ *
+ * Delete 'key' from the structure, then from the filter.
+ *
+ * success : return 1
+ * failure(not found) : return 0
+ */
+int filtered_delete(void *f, const uint64_t key)
+{
+    filtered_t *fs = (filtered_t *) f;
+
+    if (fs->ops->delete(fs->ds, key) != 1)
+      return 0;
+    if (fs->filter != NULL)
+      filter_delete(fs->filter, key);
+    return 1;
+}
+
+/*
+ * int filtered_find(void *f, const uint64_t key)
+ *
+ * Find 'key' in the structure, unless the filter rejects it.
+ *
+ * found : return 1
+ * not found, or rejected : return 0
+ */
+int filtered_find(void *f, const uint64_t key)
+{
+    filtered_t *fs = (filtered_t *) f;
+
+    if (fs->filter != NULL && filter_contains(fs->filter, key) == 0)
+      return 0;
+    return fs->ops->find(fs->ds, key);
+}
+
+/*
+ * int64_t filtered_size(void *f)
+ *
+ * The number of keys in the structure, which must have a size().
+ */
+int64_t filtered_size(void *f)
+{
+    filtered_t *fs = (filtered_t *) f;
+
+    return fs->ops->size(fs->ds);
+}
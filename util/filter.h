@@ -0,0 +1,97 @@
+/* ---------------------------------------------------------------------------
+ * Membership Filters
+ *
+ * Approximate set membership, used as a pre-filter in front of a list or a
+ * hash table: filter_contains() never returns 0 for a key that was added and
+ * not deleted, so a lookup that the filter rejects need not touch the
+ * structure. It may return 1 for an absent key (a false positive).
+ *
+ * Two filters are provided:
+ *
+ *  FILTER_BLOOM  : blocked Bloom filter. All FILTER_BLOOM_HASHES bits of a key
+ *                  lie in one 64-byte block, so a lookup reads one cache line.
+ *                  filter_add() sets the bits with atomic OR and takes no lock.
+ *                  Bits can not be cleared: filter_delete() does nothing, and
+ *                  deleted keys remain false positives.
+ *  FILTER_CUCKOO : cuckoo filter of 16-bit fingerprints, FILTER_CUCKOO_SLOTS
+ *                  per 64-bit bucket, that supports deletion. filter_add() and
+ *                  filter_delete() update a bucket with one CAS; only an
+ *                  insertion that has to relocate fingerprints takes the lock.
+ *                  Lookups take no lock, and retry if a relocation ran
+ *                  concurrently. If a relocation fails, the filter overflows
+ *                  and filter_contains() returns 1 for every key from then on.
+ *
+ * Only keys that were added may be deleted, i.e. delete a key from the filter
+ * after deleting it from the structure, never on a failed delete.
+ *
+ * filtered_t puts a filter in front of any structure described by a ds_ops_t
+ * (see registry.h) in this order: filtered_add() adds the key to the filter
+ * before the structure, and takes it back if the add fails; filtered_delete()
+ * deletes it from the filter after a successful delete from the structure;
+ * filtered_find() looks in the structure only if filter_contains() passes
+ * the key; filtered_size() counts the keys of the structure. They have the signatures of the ds_ops_t functions and take the
+ * filtered_t as the structure, so that they can stand in for them. With no
+ * filter, they call the structure directly.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "lock.h"
+#include "registry.h"
+
+#define FILTER_BLOOM_BITS_PER_KEY  10    /* bits per key of capacity */
+#define FILTER_BLOOM_HASHES        6     /* bits set per key */
+#define FILTER_CUCKOO_SLOTS        4     /* fingerprints per bucket */
+#define FILTER_CUCKOO_LOAD         0.9   /* maximum load factor the table is sized for */
+#define FILTER_CUCKOO_MAX_KICKS    500   /* relocations before the filter overflows */
+#define FILTER_READ_RETRIES        16    /* lookups return 1 after this many retries */
+
+typedef enum {
+  FILTER_BLOOM = 0, FILTER_CUCKOO,
+} filter_kind_t;
+
+typedef struct _filter_t
+{
+  filter_kind_t kind;
+  uint64_t capacity;                  /* number of keys the filter is sized for */
+  size_t size;                        /* bytes of the word array */
+  uint64_t mask;                      /* number of blocks or buckets - 1 */
+  volatile uint64_t *word;            /* bloom blocks, or cuckoo buckets */
+
+  /* cuckoo filter only */
+  lock_kind_t lock_kind;
+  lock_t lock;                        /* serializes relocations */
+  volatile uint64_t version;          /* odd while a relocation runs */
+  volatile int overflow;              /* 1 once a fingerprint was lost */
+} filter_t;
+
+/* A structure behind a filter; see filtered_add(). */
+typedef struct _filtered_t
+{
+  const ds_ops_t *ops;
+  void *ds;
+  filter_t *filter;                   /* NULL: no filter */
+} filtered_t;
+
+
+filter_t *filter_create (const char *, const uint64_t);
+void filter_destroy (filter_t *);
+int filter_add (filter_t *, const uint64_t);
+void filter_delete (filter_t *, const uint64_t);
+int filter_contains (filter_t *, const uint64_t);
+const char *filter_name (const filter_t *);
+
+void filtered_init (filtered_t *, const ds_ops_t *, void *, filter_t *);
+int filtered_add (void *, const uint64_t);
+int filtered_delete (void *, const uint64_t);
+int filtered_find (void *, const uint64_t);
+int64_t filtered_size (void *);
+
+#endif
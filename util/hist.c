@@ -0,0 +1,111 @@
+/* ---------------------------------------------------------------------------
+ * Latency Histograms
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hist.h"
+
+#define CALIBRATION_NS   20000000ULL     /* 20 ms */
+
+
+/* Largest value that falls into bucket 'i'. */
+static uint64_t highest_value(const unsigned int i)
+{
+    unsigned int shift;
+
+    if (i < HIST_SUB_BUCKETS)
+      return i;
+    shift = (i >> HIST_SUB_BITS) - 1;
+    return (((uint64_t) HIST_SUB_BUCKETS + (i & (HIST_SUB_BUCKETS - 1))) << shift)
+      + ((1ULL << shift) - 1);
+}
+
+void hist_init(hist_t * h)
+{
+    memset(h, 0, sizeof(hist_t));
+}
+
+/*
+ * void hist_merge(hist_t * dst, const hist_t * src)
+ *
+ * Add the values of 'src' to 'dst'.
+ */
+void hist_merge(hist_t * dst, const hist_t * src)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+      dst->count[i] += src->count[i];
+    dst->total += src->total;
+    if (dst->max < src->max)
+      dst->max = src->max;
+}
+
+/*
+ * uint64_t hist_percentile(const hist_t * h, const double p)
+ *
+ * Return the value below or at which 'p' percent of the values of 'h' lie,
+ * rounded up to the end of its bucket, and never more than the maximum.
+ * Return 0 if 'h' is empty.
+ */
+uint64_t hist_percentile(const hist_t * h, const double p)
+{
+    uint64_t rank, seen = 0, v;
+    int i;
+
+    if (h->total == 0)
+      return 0;
+    rank = (uint64_t) (p / 100.0 * h->total + 0.5);
+    if (rank == 0)
+      rank = 1;
+    for (i = 0; i < HIST_BUCKETS; i++)
+      if (rank <= (seen += h->count[i])) {
+	v = highest_value(i);
+	return (v < h->max) ? v : h->max;
+      }
+    return h->max;
+}
+
+#ifdef _X86_64_
+static uint64_t raw_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/*
+ * double hist_ticks_per_ns(void)
+ *
+ * Return the rate of hist_ticks(), measured against CLOCK_MONOTONIC_RAW over
+ * CALIBRATION_NS on the first call.
+ */
+double hist_ticks_per_ns(void)
+{
+    static double rate = 0.0;
+#ifdef _X86_64_
+    uint64_t t0, n0, t1, n1;
+
+    if (rate != 0.0)
+      return rate;
+    n0 = raw_ns();
+    t0 = hist_ticks();
+    do {
+      n1 = raw_ns();
+      t1 = hist_ticks();
+    } while (n1 - n0 < CALIBRATION_NS);
+    rate = (double) (t1 - t0) / (double) (n1 - n0);
+#else
+    /* hist_ticks() already counts nanoseconds. */
+    rate = 1.0;
+#endif
+    return rate;
+}
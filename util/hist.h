@@ -0,0 +1,81 @@
+/* ---------------------------------------------------------------------------
+ * Latency Histograms
+ *
+ * Log-linear histograms in the style of HdrHistogram: every power of two is
+ * split into HIST_SUB_BUCKETS linear sub-buckets, so a value is kept with a
+ * relative error below 1 / HIST_SUB_BUCKETS (3.1%) over the whole 64-bit range,
+ * in a fixed array of counters. hist_record() is a few instructions and
+ * takes no lock: each thread records into its own histogram, and the
+ * histograms are merged with hist_merge() after the threads exit.
+ *
+ * Values are ticks of hist_ticks(): the TSC on x86_64, read after an lfence
+ * so that it is not taken before the preceding instructions complete, or
+ * CLOCK_MONOTONIC_RAW nanoseconds elsewhere. hist_ticks_per_ns() calibrates
+ * the TSC against CLOCK_MONOTONIC_RAW once, and assumes an invariant TSC.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _HIST_H_
+#define _HIST_H_
+
+#include <inttypes.h>
+#include <time.h>
+
+#define HIST_SUB_BITS      5
+#define HIST_SUB_BUCKETS   (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS       ((64 - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct _hist_t
+{
+  uint64_t count[HIST_BUCKETS];
+  uint64_t total;                     /* number of values */
+  uint64_t max;
+} hist_t;
+
+
+#ifdef _X86_64_
+static inline uint64_t hist_ticks(void)
+{
+    uint32_t lo, hi;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a" (lo), "=d" (hi) :: "memory");
+    return ((uint64_t) hi << 32) | lo;
+}
+#else
+static inline uint64_t hist_ticks(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static inline unsigned int hist_index(const uint64_t v)
+{
+    unsigned int shift;
+
+    if (v < HIST_SUB_BUCKETS)
+      return (unsigned int) v;
+    /* v has 64 - clz(v) bits; keep the top HIST_SUB_BITS + 1 of them. */
+    shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+    return ((shift + 1) << HIST_SUB_BITS) + (unsigned int) ((v >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+static inline void hist_record(hist_t * h, const uint64_t v)
+{
+    h->count[hist_index(v)]++;
+    h->total++;
+    if (h->max < v)
+      h->max = v;
+}
+
+
+void hist_init (hist_t *);
+void hist_merge (hist_t *, const hist_t *);
+uint64_t hist_percentile (const hist_t *, const double);
+double hist_ticks_per_ns (void);
+
+#endif
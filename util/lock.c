@@ -0,0 +1,576 @@
+/* ---------------------------------------------------------------------------
+ * Lock Primitives
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "lock.h"
+#include "stats.h"
+
+#define lock_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#ifdef _X86_64_
+static inline uint32_t fetch_and_add32(volatile uint32_t * addr, uint32_t val)
+{
+    __asm__ __volatile__("lock; xaddl %0,%1"
+			 : "+r" (val), "+m" (*addr)
+			 :
+			 : "memory");
+    return val;
+}
+
+static inline uint32_t swap32(volatile uint32_t * addr, uint32_t val)
+{
+    __asm__ __volatile__("xchgl %0,%1"
+			 : "+r" (val), "+m" (*addr)
+			 :
+			 : "memory");
+    return val;
+}
+
+static inline void *swap_ptr(void * volatile *addr, void *newp)
+{
+    __asm__ __volatile__("xchgq %0,%1"
+			 : "+r" (newp), "+m" (*addr)
+			 :
+			 : "memory");
+    return newp;
+}
+
+static inline int cas_ptr(void * volatile *addr, void *oldp, void *newp)
+{
+    void *result;
+    __asm__ __volatile__("lock; cmpxchgq %2,%1"
+			 : "=a" (result), "+m" (*addr)
+			 : "r" (newp), "0" (oldp)
+			 : "memory");
+    return (result == oldp);
+}
+
+#define cpu_relax()     __asm__ __volatile__("pause" ::: "memory")
+/* Stores are not reordered with older loads and stores on x86. */
+#define release_barrier()   __asm__ __volatile__("" ::: "memory")
+#else
+static inline uint32_t fetch_and_add32(volatile uint32_t * addr, uint32_t val)
+{
+    return __sync_fetch_and_add(addr, val);
+}
+
+static inline uint32_t swap32(volatile uint32_t * addr, uint32_t val)
+{
+    return __sync_lock_test_and_set(addr, val);
+}
+
+static inline void *swap_ptr(void * volatile *addr, void *newp)
+{
+    return __sync_lock_test_and_set(addr, newp);
+}
+
+static inline int cas_ptr(void * volatile *addr, void *oldp, void *newp)
+{
+    return __sync_bool_compare_and_swap(addr, oldp, newp);
+}
+
+#define cpu_relax()         __sync_synchronize()
+#define release_barrier()   __sync_synchronize()
+#endif
+
+
+static inline void spin_wait(unsigned int *spin)
+{
+    cpu_relax();
+    if (++(*spin) % LOCK_SPIN_LIMIT == 0)
+      sched_yield();
+}
+
+
+/*
+ * Queue nodes of MCS and CLH
+ */
+typedef struct _qnode_t
+{
+  struct _qnode_t * volatile next;  /* MCS: successor; free list of the thread */
+  volatile int locked;
+} __attribute__((aligned(64))) qnode_t;
+
+/* A queue lock held by this thread, and the queue node used to acquire it. */
+typedef struct _held_t
+{
+  lock_t *lock;
+  qnode_t *node;                    /* MCS: own node; CLH: node released to the successor */
+  qnode_t *pred;                    /* CLH: predecessor's node, which becomes ours */
+} held_t;
+
+typedef struct _lock_thread_t
+{
+  held_t *held;                     /* stack of held queue locks */
+  int held_num;
+  int held_max;
+  qnode_t *pool;                    /* free queue nodes */
+} lock_thread_t;
+
+static __thread lock_thread_t *self = NULL;
+static pthread_key_t self_key;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+static void release_self(void *arg)
+{
+    lock_thread_t *t = (lock_thread_t *) arg;
+    qnode_t *q;
+
+    /* Nodes in the pool are not referenced by any lock or other thread. */
+    while ((q = t->pool) != NULL) {
+      t->pool = q->next;
+      free(q);
+    }
+    free(t->held);
+    free(t);
+    self = NULL;
+}
+
+static void create_self_key(void)
+{
+    pthread_key_create(&self_key, release_self);
+}
+
+static lock_thread_t *get_self(void)
+{
+    if (self == NULL) {
+      if ((self = (lock_thread_t *) calloc(1, sizeof(lock_thread_t))) == NULL) {
+	lock_elog("calloc error");
+	abort();
+      }
+      pthread_once(&self_once, create_self_key);
+      pthread_setspecific(self_key, self);
+    }
+    return self;
+}
+
+static qnode_t *new_qnode(void)
+{
+    qnode_t *q;
+
+    if ((q = (qnode_t *) aligned_alloc(sizeof(qnode_t), sizeof(qnode_t))) == NULL) {
+      lock_elog("aligned_alloc error");
+      abort();
+    }
+    return q;
+}
+
+static qnode_t *get_qnode(lock_thread_t * t)
+{
+    qnode_t *q;
+
+    if ((q = t->pool) == NULL)
+      return new_qnode();
+    t->pool = q->next;
+    return q;
+}
+
+static void put_qnode(lock_thread_t * t, qnode_t * q)
+{
+    q->next = t->pool;
+    t->pool = q;
+}
+
+static void push_held(lock_thread_t * t, lock_t * l, qnode_t * node, qnode_t * pred)
+{
+    held_t *h;
+
+    if (t->held_num == t->held_max) {
+      t->held_max = (t->held_max == 0) ? 16 : t->held_max * 2;
+      if ((h = (held_t *) realloc(t->held, t->held_max * sizeof(held_t))) == NULL) {
+	lock_elog("realloc error");
+	abort();
+      }
+      t->held = h;
+    }
+    h = &t->held[t->held_num++];
+    h->lock = l;
+    h->node = node;
+    h->pred = pred;
+}
+
+/* Locks are usually released in the reverse order, so search from the top. */
+static held_t pop_held(lock_thread_t * t, lock_t * l)
+{
+    held_t h;
+    int i;
+
+    for (i = t->held_num - 1; 0 <= i; i--)
+      if (t->held[i].lock == l)
+	break;
+    if (i < 0) {
+      lock_elog("lock is not held");
+      abort();
+    }
+    h = t->held[i];
+    t->held[i] = t->held[--t->held_num];
+    return h;
+}
+
+
+/*
+ * TTAS
+ */
+static void ttas_acquire(lock_t * l)
+{
+    unsigned int spin = 0;
+    unsigned int backoff = TTAS_BACKOFF_MIN;
+    unsigned int i;
+
+    while (1) {
+      while (l->word != 0)
+	spin_wait(&spin);
+      if (swap32(&l->word, 1) == 0)
+	return;
+      for (i = 0; i < backoff; i++)
+	cpu_relax();
+      if (backoff < TTAS_BACKOFF_MAX)
+	backoff <<= 1;
+    }
+}
+
+static void ttas_release(lock_t * l)
+{
+    release_barrier();
+    l->word = 0;
+}
+
+
+/*
+ * Ticket
+ */
+static void ticket_acquire(lock_t * l)
+{
+    unsigned int spin = 0;
+    uint32_t my = fetch_and_add32(&l->ticket.next, 1);
+
+    while (l->ticket.owner != my)
+      spin_wait(&spin);
+}
+
+static void ticket_release(lock_t * l)
+{
+    release_barrier();
+    l->ticket.owner = l->ticket.owner + 1;
+}
+
+
+/*
+ * MCS
+ */
+static void mcs_acquire(lock_t * l)
+{
+    lock_thread_t *t = get_self();
+    qnode_t *q = get_qnode(t);
+    qnode_t *pred;
+    unsigned int spin = 0;
+
+    q->next = NULL;
+    q->locked = 1;
+    if ((pred = (qnode_t *) swap_ptr(&l->tail, q)) != NULL) {
+      pred->next = q;
+      while (q->locked != 0)
+	spin_wait(&spin);
+    }
+    push_held(t, l, q, NULL);
+}
+
+static void mcs_release(lock_t * l)
+{
+    lock_thread_t *t = get_self();
+    held_t h = pop_held(t, l);
+    qnode_t *q = h.node;
+    unsigned int spin = 0;
+
+    if (q->next == NULL) {
+      if (cas_ptr(&l->tail, q, NULL)) {
+	put_qnode(t, q);
+	return;
+      }
+      /* A successor has swapped the tail but not linked itself yet. */
+      while (q->next == NULL)
+	spin_wait(&spin);
+    }
+    release_barrier();
+    q->next->locked = 0;
+    put_qnode(t, q);
+}
+
+
+/*
+ * CLH
+ */
+static void clh_acquire(lock_t * l)
+{
+    lock_thread_t *t = get_self();
+    qnode_t *q = get_qnode(t);
+    qnode_t *pred;
+    unsigned int spin = 0;
+
+    q->locked = 1;
+    pred = (qnode_t *) swap_ptr(&l->tail, q);
+    while (pred->locked != 0)
+      spin_wait(&spin);
+    push_held(t, l, q, pred);
+}
+
+static void clh_release(lock_t * l)
+{
+    lock_thread_t *t = get_self();
+    held_t h = pop_held(t, l);
+
+    release_barrier();
+    h.node->locked = 0;
+    /* Nobody spins on the predecessor's node any more, so it becomes ours. */
+    put_qnode(t, h.pred);
+}
+
+
+/*
+ * int lock_init(const lock_kind_t kind, lock_t * l)
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int lock_init(const lock_kind_t kind, lock_t * l)
+{
+    qnode_t *q;
+
+    memset(l, 0, sizeof(lock_t));
+    switch (kind) {
+    case LOCK_PTHREAD:
+      if ((l->mtx = (pthread_mutex_t *) malloc(sizeof(pthread_mutex_t))) == NULL) {
+	lock_elog("malloc error");
+	return 0;
+      }
+      pthread_mutex_init(l->mtx, NULL);
+      break;
+    case LOCK_CLH:
+      if ((q = (qnode_t *) aligned_alloc(sizeof(qnode_t), sizeof(qnode_t))) == NULL) {
+	lock_elog("aligned_alloc error");
+	return 0;
+      }
+      q->next = NULL;
+      q->locked = 0;
+      l->tail = q;
+      break;
+    default:
+      break;
+    }
+    return 1;
+}
+
+void lock_destroy(const lock_kind_t kind, lock_t * l)
+{
+    switch (kind) {
+    case LOCK_PTHREAD:
+      if (l->mtx != NULL) {
+	pthread_mutex_destroy(l->mtx);
+	free(l->mtx);
+      }
+      break;
+    case LOCK_CLH:
+      free(l->tail);
+      break;
+    default:
+      break;
+    }
+    memset(l, 0, sizeof(lock_t));
+}
+
+void lock_acquire(const lock_kind_t kind, lock_t * l)
+{
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    switch (kind) {
+    case LOCK_PTHREAD:
+      pthread_mutex_lock(l->mtx);
+      break;
+    case LOCK_TTAS:
+      ttas_acquire(l);
+      break;
+    case LOCK_TICKET:
+      ticket_acquire(l);
+      break;
+    case LOCK_MCS:
+      mcs_acquire(l);
+      break;
+    case LOCK_CLH:
+      clh_acquire(l);
+      break;
+    }
+#ifdef _STATS_
+    /* Kept for STATS_STRIPE(), which the caller may call next. */
+    stats_get()->last_wait = hist_ticks() - t0;
+    stats_record(STATS_LOCK_WAIT, stats_self->last_wait);
+#endif
+}
+
+void lock_release(const lock_kind_t kind, lock_t * l)
+{
+    switch (kind) {
+    case LOCK_PTHREAD:
+      pthread_mutex_unlock(l->mtx);
+      break;
+    case LOCK_TTAS:
+      ttas_release(l);
+      break;
+    case LOCK_TICKET:
+      ticket_release(l);
+      break;
+    case LOCK_MCS:
+      mcs_release(l);
+      break;
+    case LOCK_CLH:
+      clh_release(l);
+      break;
+    }
+}
+
+
+/*
+ * Reader-writer lock
+ */
+static uint32_t next_reader_slot = 0;
+static __thread int reader_slot = -1;
+
+static inline volatile uint32_t *my_indicator(rwlock_t * rw)
+{
+    if (reader_slot < 0)
+      reader_slot = fetch_and_add32(&next_reader_slot, 1) % RWLOCK_READER_SLOTS;
+    return &rw->reader[reader_slot].count;
+}
+
+/*
+ * int rwlock_init(const lock_kind_t kind, rwlock_t * rw)
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int rwlock_init(const lock_kind_t kind, rwlock_t * rw)
+{
+    size_t size = RWLOCK_READER_SLOTS * sizeof(reader_slot_t);
+
+    if ((rw->reader = (reader_slot_t *) aligned_alloc(sizeof(reader_slot_t), size)) == NULL) {
+      lock_elog("aligned_alloc error");
+      return 0;
+    }
+    memset(rw->reader, 0, size);
+    rw->writer = 0;
+    if (lock_init(kind, &rw->lock) != 1) {
+      free(rw->reader);
+      rw->reader = NULL;
+      return 0;
+    }
+    return 1;
+}
+
+void rwlock_destroy(const lock_kind_t kind, rwlock_t * rw)
+{
+    lock_destroy(kind, &rw->lock);
+    free(rw->reader);
+    rw->reader = NULL;
+}
+
+/*
+ * The locked increments order the reader's indicator before its read of the flag,
+ * and the writer's flag before its reads of the indicators, so at least one of
+ * them sees the other.
+ */
+void rwlock_read_lock(rwlock_t * rw)
+{
+    volatile uint32_t *count = my_indicator(rw);
+    unsigned int spin = 0;
+
+    while (1) {
+      fetch_and_add32(count, 1);
+      if (rw->writer == 0)
+	return;
+      fetch_and_add32(count, (uint32_t) -1);
+      while (rw->writer != 0)
+	spin_wait(&spin);
+    }
+}
+
+void rwlock_read_unlock(rwlock_t * rw)
+{
+    fetch_and_add32(my_indicator(rw), (uint32_t) -1);
+}
+
+void rwlock_write_lock(const lock_kind_t kind, rwlock_t * rw)
+{
+    unsigned int spin = 0;
+    int i;
+    STATS_DECLARE(t0);
+
+    STATS_TICKS(t0);
+    lock_acquire(kind, &rw->lock);
+    fetch_and_add32(&rw->writer, 1);
+    for (i = 0; i < RWLOCK_READER_SLOTS; i++)
+      while (rw->reader[i].count != 0)
+	spin_wait(&spin);
+#ifdef _STATS_
+    /* Let STATS_STRIPE() count the wait for the readers as well. */
+    stats_get()->last_wait = hist_ticks() - t0;
+#endif
+}
+
+void rwlock_write_unlock(const lock_kind_t kind, rwlock_t * rw)
+{
+    release_barrier();
+    rw->writer = 0;
+    lock_release(kind, &rw->lock);
+}
+
+
+static const char *lock_names[] = {"pthread", "ttas", "ticket", "mcs", "clh"};
+
+/*
+ * int lock_kind_by_name(const char *name, lock_kind_t * kind)
+ *
+ * success : return 1, and write the kind of 'name' to *kind
+ * failure(unknown name) : return 0
+ */
+int lock_kind_by_name(const char *name, lock_kind_t * kind)
+{
+    int i;
+
+    for (i = 0; i < sizeof(lock_names) / sizeof(lock_names[0]); i++)
+      if (strcmp(name, lock_names[i]) == 0) {
+	*kind = (lock_kind_t) i;
+	return 1;
+      }
+    return 0;
+}
+
+const char *lock_kind_name(const lock_kind_t kind)
+{
+    return lock_names[kind];
+}
+
+
+static lock_kind_t default_lock_kind = LOCK_TTAS;
+
+/*
+ * lock_kind_t get_lock_kind(void)
+ *
+ * Return the lock kind that newly initialized structures use.
+ */
+lock_kind_t get_lock_kind(void)
+{
+    return default_lock_kind;
+}
+
+void set_lock_kind(const lock_kind_t kind)
+{
+    default_lock_kind = kind;
+}
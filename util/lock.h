@@ -0,0 +1,100 @@
+/* ---------------------------------------------------------------------------
+ * Lock Primitives
+ *
+ * One lock type, lock_t (8 bytes), with several implementations selected at
+ * run time by lock_kind_t. The size is what every lock costs in the structure
+ * that embeds it, such as a list node; the allocation is what lock_init()
+ * adds on the heap, outside the node allocator, which lock_destroy() frees:
+ *
+ *  LOCK_PTHREAD : pthread_mutex_t. 8 bytes + a 40-byte malloc, and one more
+ *                 pointer to follow on each operation.
+ *  LOCK_TTAS    : test-and-test-and-set spin lock with exponential backoff.
+ *                 8 bytes (one 32-bit word used), no allocation. The default.
+ *  LOCK_TICKET  : ticket lock; threads get the lock in FIFO order. 8 bytes,
+ *                 no allocation.
+ *  LOCK_MCS     : Mellor-Crummey and Scott queue lock; each waiter spins on
+ *                 its own queue node. 8 bytes, no allocation.
+ *  LOCK_CLH     : Craig, Landin and Hagersten queue lock; each waiter spins on
+ *                 its predecessor's queue node. A free lock keeps one queue
+ *                 node: 8 bytes + a 64-byte aligned_alloc.
+ *
+ * The FIFO kinds hand the lock to the next waiter even if it is preempted, so
+ * they are slow when there are more threads than CPUs.
+ *
+ * Queue nodes are kept per thread and recycled, so lock_acquire() and
+ * lock_release() take only the lock. A thread must not acquire a lock it
+ * already holds, and waiters yield the CPU after LOCK_SPIN_LIMIT spins.
+ *
+ * Every structure takes the kind returned by get_lock_kind() when it is
+ * initialized, and passes it to all the functions below.
+ *
+ * rwlock_t is a reader-writer lock built on lock_t. Writers serialize on the
+ * lock_t and raise a flag; readers never touch a shared counter. Each reader
+ * increments its own indicator, one cache line per thread, and checks the flag;
+ * a writer waits until all indicators are zero. Threads beyond
+ * RWLOCK_READER_SLOTS share indicators. Waiting writers block new readers.
+ * An rwlock_t is 24 bytes + its lock_t's allocation + RWLOCK_READER_SLOTS
+ * cache lines (1 KB) allocated by rwlock_init(), so it suits lock stripes
+ * rather than nodes.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _LOCK_H_
+#define _LOCK_H_
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#define LOCK_SPIN_LIMIT     1024    /* spins before a waiting thread yields the CPU */
+#define TTAS_BACKOFF_MIN    4       /* pause instructions after the first failed attempt */
+#define TTAS_BACKOFF_MAX    1024
+#define RWLOCK_READER_SLOTS 16      /* reader indicators per rwlock_t */
+
+typedef enum {
+  LOCK_PTHREAD = 0, LOCK_TTAS, LOCK_TICKET, LOCK_MCS, LOCK_CLH,
+} lock_kind_t;
+
+typedef union _lock_t
+{
+  volatile uint32_t word;               /* TTAS: 0 = free, 1 = held */
+  struct {
+    volatile uint32_t next;             /* next ticket to hand out */
+    volatile uint32_t owner;            /* ticket now served */
+  } ticket;
+  void * volatile tail;                 /* MCS, CLH: last queue node */
+  pthread_mutex_t *mtx;                 /* pthread */
+} lock_t;
+
+typedef struct _reader_slot_t
+{
+  volatile uint32_t count;              /* read locks held by the threads of this slot */
+} __attribute__((aligned(64))) reader_slot_t;
+
+typedef struct _rwlock_t
+{
+  lock_t lock;                          /* writers' lock */
+  volatile uint32_t writer;             /* 1 while a writer holds the lock or drains readers */
+  reader_slot_t *reader;                /* RWLOCK_READER_SLOTS indicators, allocated by rwlock_init() */
+} rwlock_t;
+
+
+int lock_init (const lock_kind_t, lock_t *);
+void lock_destroy (const lock_kind_t, lock_t *);
+void lock_acquire (const lock_kind_t, lock_t *);
+void lock_release (const lock_kind_t, lock_t *);
+
+int rwlock_init (const lock_kind_t, rwlock_t *);
+void rwlock_destroy (const lock_kind_t, rwlock_t *);
+void rwlock_read_lock (rwlock_t *);
+void rwlock_read_unlock (rwlock_t *);
+void rwlock_write_lock (const lock_kind_t, rwlock_t *);
+void rwlock_write_unlock (const lock_kind_t, rwlock_t *);
+
+int lock_kind_by_name (const char *, lock_kind_t *);
+const char *lock_kind_name (const lock_kind_t);
+lock_kind_t get_lock_kind (void);
+void set_lock_kind (const lock_kind_t);
+
+#endif
@@ -0,0 +1,200 @@
+/* ---------------------------------------------------------------------------
+ * Hardware Performance Counters
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "perf.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define MEM_INST_RETIRED_LOCK_LOADS  0x21d0  /* umask 0x21, event 0xd0 */
+
+/* Return 1 if this is an Intel CPU, whose raw event numbers we know. */
+static int is_intel(void)
+{
+    static int intel = -1;
+    char line[256];
+    FILE *fp;
+
+    if (intel != -1)
+      return intel;
+    intel = 0;
+    if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+      return intel;
+    while (fgets(line, sizeof(line), fp) != NULL)
+      if (strncmp(line, "vendor_id", 9) == 0) {
+	intel = (strstr(line, "GenuineIntel") != NULL) ? 1 : 0;
+	break;
+      }
+    fclose(fp);
+    return intel;
+}
+
+static int set_attr(struct perf_event_attr *attr, const perf_event_t event, const int inherit)
+{
+    memset(attr, 0, sizeof(struct perf_event_attr));
+    attr->size = sizeof(struct perf_event_attr);
+
+    switch (event) {
+    case PERF_DTLB_LOAD_MISSES:
+      attr->type = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_DTLB
+	| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+	| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_CYCLES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_LLC_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PERF_BRANCH_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    case PERF_LOCK_LOADS:
+      if (is_intel() != 1)
+	return 0;
+      attr->type = PERF_TYPE_RAW;
+      attr->config = MEM_INST_RETIRED_LOCK_LOADS;
+      break;
+    default:
+      return 0;
+    }
+    attr->disabled = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr->inherit = inherit;    /* 1: count the threads created later */
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    return 1;
+}
+#endif
+
+static const char *event_names[] = {
+  "dTLB load misses", "cycles", "instructions", "LLC misses", "branch misses", "lock loads",
+};
+
+/*
+ * int perf_counter_open(perf_counter_t * pc, const perf_event_t event)
+ *
+ * Open and start counter 'event' of this process.
+ *
+ * success : return 1
+ * failure : return 0, and pc is marked as not available
+ */
+int perf_counter_open(perf_counter_t * pc, const perf_event_t event)
+{
+    pc->fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    if (set_attr(&attr, event, 1) != 1)
+      return 0;
+    if ((pc->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0)) < 0) {
+      pc->fd = -1;
+      return 0;
+    }
+    ioctl(pc->fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(pc->fd, PERF_EVENT_IOC_ENABLE, 0);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * int perf_thread_open(perf_counter_t * pc, const perf_event_t event)
+ *
+ * Open counter 'event' of the calling thread only, disabled; start it by
+ * perf_counter_enable().
+ *
+ * success : return 1
+ * failure : return 0, and pc is marked as not available
+ */
+int perf_thread_open(perf_counter_t * pc, const perf_event_t event)
+{
+    pc->fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+
+    if (set_attr(&attr, event, 0) != 1)
+      return 0;
+    if ((pc->fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0)) < 0) {
+      pc->fd = -1;
+      return 0;
+    }
+    ioctl(pc->fd, PERF_EVENT_IOC_RESET, 0);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void perf_counter_enable(const perf_counter_t * pc)
+{
+#ifdef __linux__
+    if (0 <= pc->fd)
+      ioctl(pc->fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+void perf_counter_disable(const perf_counter_t * pc)
+{
+#ifdef __linux__
+    if (0 <= pc->fd)
+      ioctl(pc->fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+}
+
+/*
+ * int perf_counter_read(const perf_counter_t * pc, uint64_t * value)
+ *
+ * Read the count, scaled by time enabled / time running if the counter was
+ * multiplexed with other events.
+ *
+ * success : return PERF_EXACT, or PERF_SCALED if the count was scaled, and
+ *           write the count to *value
+ * failure(not available, or the counter never ran) : return 0
+ */
+int perf_counter_read(const perf_counter_t * pc, uint64_t * value)
+{
+    uint64_t buf[3];            /* value, time enabled, time running */
+
+    if (pc->fd < 0)
+      return 0;
+    if (read(pc->fd, buf, sizeof(buf)) != sizeof(buf) || buf[2] == 0)
+      return 0;
+    if (buf[2] < buf[1]) {
+      *value = (uint64_t) ((double) buf[0] * buf[1] / buf[2]);
+      return PERF_SCALED;
+    }
+    *value = buf[0];
+    return PERF_EXACT;
+}
+
+void perf_counter_close(perf_counter_t * pc)
+{
+    if (0 <= pc->fd)
+      close(pc->fd);
+    pc->fd = -1;
+}
+
+const char *perf_event_name(const perf_event_t event)
+{
+    return (0 <= (int) event && event < PERF_EVENTS) ? event_names[event] : "unknown";
+}
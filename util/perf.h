@@ -0,0 +1,55 @@
+/* ---------------------------------------------------------------------------
+ * Hardware Performance Counters
+ *
+ * A thin wrapper of perf_event_open(2). A counter opened by the main thread
+ * with perf_counter_open() also counts every thread created after it, so open
+ * it before the worker threads start and read it after they exit.
+ * perf_event_open() is often restricted (see /proc/sys/kernel/perf_event_paranoid)
+ * or not supported in virtual machines; in that case perf_counter_open()
+ * returns 0 and the benches report the counter as not available.
+ *
+ * perf_thread_open() instead counts only the calling thread, and starts
+ * disabled, so that a worker can count just its timed loop between
+ * perf_counter_enable() and perf_counter_disable(). PERF_LOCK_LOADS counts
+ * the retired locked (atomic read-modify-write) instructions; there is no
+ * generic event for it, so it is opened as the raw event
+ * MEM_INST_RETIRED.LOCK_LOADS on Intel CPUs and is not available elsewhere.
+ *
+ * The kernel multiplexes the counters when more events are open than the PMU
+ * has counters, so a counter may run for only part of the time it is enabled.
+ * perf_counter_read() then scales the count by time enabled / time running and
+ * returns PERF_SCALED, so that the caller can flag the value as an estimate;
+ * a counter that never ran is not available.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#include <inttypes.h>
+
+typedef enum {
+  PERF_DTLB_LOAD_MISSES = 0, PERF_CYCLES, PERF_INSTRUCTIONS, PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES, PERF_LOCK_LOADS, PERF_EVENTS,
+} perf_event_t;
+
+#define PERF_EXACT  1                   /* perf_counter_read(): counted all the time */
+#define PERF_SCALED 2                   /* perf_counter_read(): multiplexed and scaled */
+
+typedef struct _perf_counter_t
+{
+  int fd;                       /* -1 if not available */
+} perf_counter_t;
+
+
+int perf_counter_open (perf_counter_t *, const perf_event_t);
+int perf_thread_open (perf_counter_t *, const perf_event_t);
+void perf_counter_enable (const perf_counter_t *);
+void perf_counter_disable (const perf_counter_t *);
+int perf_counter_read (const perf_counter_t *, uint64_t *);
+void perf_counter_close (perf_counter_t *);
+const char *perf_event_name (const perf_event_t);
+
+#endif
@@ -0,0 +1,254 @@
+/* ---------------------------------------------------------------------------
+ * Read-Copy-Update
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rcu.h"
+
+#define rcu_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#ifdef _X86_64_
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    __asm__ __volatile__("lock; xaddq %0,%1"
+			 : "+r" (val), "+m" (*addr)
+			 :
+			 : "memory");
+    return val;
+}
+
+/* Loads are not reordered with later stores on x86. */
+#define quiescent_barrier()   __asm__ __volatile__("" ::: "memory")
+#else
+static inline uint64_t fetch_and_add64(volatile uint64_t * addr, uint64_t val)
+{
+    return __sync_fetch_and_add(addr, val);
+}
+
+#define quiescent_barrier()   __sync_synchronize()
+#endif
+
+
+static volatile uint64_t rcu_gp = 1;          /* grace period counter */
+
+static rcu_thread_t *registry = NULL;         /* registered threads */
+static pthread_mutex_t registry_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread rcu_thread_t *self = NULL;
+static pthread_key_t self_key;
+static pthread_once_t self_once = PTHREAD_ONCE_INIT;
+
+static void unregister_self(void *arg)
+{
+    rcu_thread_t *t = (rcu_thread_t *) arg;
+    rcu_thread_t **p;
+
+    pthread_mutex_lock(&registry_mtx);
+    for (p = &registry; *p != NULL; p = &(*p)->next)
+      if (*p == t) {
+	*p = t->next;
+	break;
+      }
+    pthread_mutex_unlock(&registry_mtx);
+    free(t);
+    self = NULL;
+}
+
+static void create_self_key(void)
+{
+    pthread_key_create(&self_key, unregister_self);
+}
+
+/*
+ * Registration and the scan in reclaim() are serialized by registry_mtx, so a
+ * batch closed before a thread registers cannot hold anything it will read.
+ */
+static void register_self(void)
+{
+    rcu_thread_t *t;
+
+    if ((t = (rcu_thread_t *) aligned_alloc(sizeof(rcu_thread_t), sizeof(rcu_thread_t))) == NULL) {
+      rcu_elog("aligned_alloc error");
+      abort();
+    }
+    pthread_once(&self_once, create_self_key);
+
+    pthread_mutex_lock(&registry_mtx);
+    t->ctr = rcu_gp;
+    t->next = registry;
+    registry = t;
+    pthread_mutex_unlock(&registry_mtx);
+
+    pthread_setspecific(self_key, t);
+    self = t;
+}
+
+
+void rcu_read_lock(void)
+{
+    if (self == NULL)
+      register_self();
+}
+
+void rcu_read_unlock(void)
+{
+    rcu_quiescent_state();
+}
+
+void rcu_quiescent_state(void)
+{
+    rcu_thread_t *t = self;
+
+    if (t == NULL)
+      return;
+    quiescent_barrier();
+    t->ctr = rcu_gp;
+}
+
+void rcu_thread_offline(void)
+{
+    rcu_thread_t *t = self;
+
+    if (t == NULL)
+      return;
+    quiescent_barrier();
+    t->ctr = 0;
+}
+
+void rcu_thread_online(void)
+{
+    if (self == NULL) {
+      register_self();
+      return;
+    }
+    self->ctr = rcu_gp;
+    __sync_synchronize();        /* the store must be visible before the thread reads again */
+}
+
+
+/*
+ * Oldest grace period that some registered thread may still be in.
+ */
+static uint64_t oldest_reader(void)
+{
+    rcu_thread_t *t;
+    uint64_t min = UINT64_MAX;
+
+    pthread_mutex_lock(&registry_mtx);
+    for (t = registry; t != NULL; t = t->next)
+      if (t->ctr != 0 && t->ctr < min)
+	min = t->ctr;
+    pthread_mutex_unlock(&registry_mtx);
+    return min;
+}
+
+static void free_batch(rcu_retire_t * r, rcu_batch_t * b)
+{
+    int i;
+
+    for (i = 0; i < b->num; i++)
+      b->func[i](r->arg, b->ptr[i]);
+    free(b);
+}
+
+static void reclaim(rcu_retire_t * r)
+{
+    rcu_batch_t *b;
+    uint64_t min;
+
+    if (r->head == NULL)
+      return;
+    min = oldest_reader();
+    while ((b = r->head) != NULL && b->gp <= min) {
+      r->head = b->next;
+      if (r->head == NULL)
+	r->tail = NULL;
+      free_batch(r, b);
+    }
+}
+
+
+/*
+ * int rcu_retire_init(rcu_retire_t * r, void *arg)
+ *
+ * success : return 1
+ * failure : return 0
+ */
+int rcu_retire_init(rcu_retire_t * r, void *arg)
+{
+    memset(r, 0, sizeof(rcu_retire_t));
+    r->arg = arg;
+    return 1;
+}
+
+/*
+ * void rcu_retire(rcu_retire_t * r, void *ptr, rcu_free_t func)
+ *
+ * Call func(r->arg, ptr) after a grace period. 'ptr' must already be
+ * unreachable for new readers.
+ */
+void rcu_retire(rcu_retire_t * r, void *ptr, rcu_free_t func)
+{
+    rcu_batch_t *b;
+
+    if ((b = r->current) == NULL) {
+      if ((b = (rcu_batch_t *) malloc(sizeof(rcu_batch_t))) == NULL) {
+	rcu_elog("malloc error");
+	abort();
+      }
+      b->next = NULL;
+      b->num = 0;
+      r->current = b;
+    }
+    b->ptr[b->num] = ptr;
+    b->func[b->num] = func;
+    if (++b->num == RCU_BATCH_SIZE)
+      rcu_retire_flush(r);
+}
+
+/*
+ * void rcu_retire_flush(rcu_retire_t * r)
+ *
+ * Close the current batch, and free the batches whose grace period has passed.
+ */
+void rcu_retire_flush(rcu_retire_t * r)
+{
+    rcu_batch_t *b;
+
+    if ((b = r->current) != NULL) {
+      r->current = NULL;
+      /* The locked add also orders the unlinks of the batch before the new period. */
+      b->gp = fetch_and_add64(&rcu_gp, 1) + 1;
+      if (r->tail == NULL)
+	r->head = b;
+      else
+	r->tail->next = b;
+      r->tail = b;
+    }
+    reclaim(r);
+}
+
+/*
+ * void rcu_retire_destroy(rcu_retire_t * r)
+ *
+ * Free all retired objects at once. No reader may access the structure any more.
+ */
+void rcu_retire_destroy(rcu_retire_t * r)
+{
+    rcu_batch_t *b;
+
+    while ((b = r->head) != NULL) {
+      r->head = b->next;
+      free_batch(r, b);
+    }
+    if (r->current != NULL)
+      free_batch(r, r->current);
+    memset(r, 0, sizeof(rcu_retire_t));
+}
@@ -0,0 +1,73 @@
+/* ---------------------------------------------------------------------------
+ * Read-Copy-Update
+ *
+ * Quiescent-state-based reclamation for read-mostly structures. Readers take
+ * no lock and execute no atomic read-modify-write instruction:
+ *
+ *  rcu_read_lock()   : registers the calling thread on its first call.
+ *  rcu_read_unlock() : reports a quiescent state, i.e. copies the global grace
+ *                      period counter to the thread's own cache line. The
+ *                      thread must not keep any pointer into the structure
+ *                      after this call.
+ *  rcu_quiescent_state() : the same, for threads between operations that did
+ *                      not read, such as writers.
+ *
+ * Writers serialize among themselves, unlink objects, and hand them to
+ * rcu_retire(). Retired objects are kept in batches; a closed batch is freed
+ * once every registered thread has reported a quiescent state after the
+ * batch was closed. Writers never wait: rcu_retire() frees whatever batches
+ * have become safe and returns.
+ *
+ * A registered thread that stops calling rcu_read_unlock() delays reclamation
+ * until it exits or calls rcu_thread_offline().
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _RCU_H_
+#define _RCU_H_
+
+#include <inttypes.h>
+
+#define RCU_BATCH_SIZE   64          /* retired objects per batch */
+
+typedef void (*rcu_free_t) (void *, void *);    /* (arg of rcu_retire_init(), object) */
+
+typedef struct _rcu_thread_t
+{
+  volatile uint64_t ctr;              /* grace period seen at the last quiescent state; 0 = offline */
+  struct _rcu_thread_t *next;
+} __attribute__((aligned(64))) rcu_thread_t;
+
+typedef struct _rcu_batch_t
+{
+  struct _rcu_batch_t *next;
+  uint64_t gp;                        /* grace period that must pass before freeing */
+  int num;
+  void *ptr[RCU_BATCH_SIZE];
+  rcu_free_t func[RCU_BATCH_SIZE];
+} rcu_batch_t;
+
+/* Retired objects of one structure. Callers serialize all calls on it. */
+typedef struct _rcu_retire_t
+{
+  void *arg;                          /* first argument of the free functions */
+  rcu_batch_t *current;               /* batch being filled */
+  rcu_batch_t *head;                  /* closed batches, oldest first */
+  rcu_batch_t *tail;
+} rcu_retire_t;
+
+
+void rcu_read_lock (void);
+void rcu_read_unlock (void);
+void rcu_quiescent_state (void);
+void rcu_thread_offline (void);
+void rcu_thread_online (void);
+
+int rcu_retire_init (rcu_retire_t *, void *);
+void rcu_retire (rcu_retire_t *, void *, rcu_free_t);
+void rcu_retire_flush (rcu_retire_t *);
+void rcu_retire_destroy (rcu_retire_t *);
+
+#endif
@@ -0,0 +1,50 @@
+/* ---------------------------------------------------------------------------
+ * Structure Registry
+ *
+ * Every structure exports its functions with its name as a prefix: its header
+ * maps the short names, add(), delete(), find(), init_list() and so on, to
+ * <Structure>_add() and the like, so that code including one header reads as
+ * before, while any number of structures can be linked into one program.
+ *
+ * Each structure also describes itself by a ds_ops_t named <Structure>_ops,
+ * defined at the end of its .c file. init() creates an instance with the
+ * defaults of its stub (-b, -s, -l, -P) and the current allocator and lock
+ * kind; add(), delete() and find() return 1 on success and 0 on failure
+ * (key exists, key not found, queue empty). A queue enqueues the key on add(),
+ * dequeues on delete() regardless of the key, and has no find().
+ *
+ * registry[] in bench/registry.c lists the ops of every structure, and
+ * registry_find() looks one up by name.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _REGISTRY_H_
+#define _REGISTRY_H_
+
+#include <inttypes.h>
+
+typedef enum {
+  REGISTRY_QUEUE = 0, REGISTRY_LIST, REGISTRY_HASH,
+} registry_family_t;
+
+typedef struct _ds_ops_t
+{
+  const char *name;
+  registry_family_t family;
+  uint64_t max_key;                   /* largest key add() accepts */
+  void *(*init) (void);               /* NULL on error */
+  void (*free) (void *);
+  int (*add) (void *, const uint64_t);
+  int (*delete) (void *, const uint64_t);
+  int (*find) (void *, const uint64_t);   /* NULL for queues */
+  int64_t (*size) (void *);           /* NULL if the structure cannot count its keys */
+} ds_ops_t;
+
+
+extern const ds_ops_t *const registry[];
+
+const ds_ops_t *registry_find (const char *);
+
+#endif
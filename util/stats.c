@@ -0,0 +1,169 @@
+/* ---------------------------------------------------------------------------
+ * Hot-Path Statistics
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+#ifdef _STATS_
+
+#define stats_elog(_msg_)  fprintf(stderr, "%s():%s:%u: %s\n", __FUNCTION__, __FILE__, __LINE__, _msg_)
+
+#define REPORT_STRIPES   8               /* stripes listed by stats_report() */
+
+__thread stats_t *stats_self = NULL;
+
+static stats_t *stats_list = NULL;
+static pthread_mutex_t stats_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *counter_names[] = {
+  "CAS", "CAS failed", "retries", "relocate", "relocate failed", "resizes",
+};
+
+static const char *dist_names[] = {
+  "lock wait [ns]", "probe length", "chain length", "kick chain", "search path", "resize [ns]",
+};
+
+/*
+ * stats_t *stats_register(void)
+ *
+ * Allocate the stats_t of the calling thread, and add it to the list of all.
+ * It is kept until the process exits, so that the stats of the threads that
+ * have exited are still reported.
+ */
+stats_t *stats_register(void)
+{
+    stats_t *s;
+
+    if ((s = (stats_t *) aligned_alloc(64, sizeof(stats_t))) == NULL) {
+      stats_elog("aligned_alloc error");
+      abort();
+    }
+    memset(s, 0, sizeof(stats_t));
+
+    pthread_mutex_lock(&stats_mtx);
+    s->next = stats_list;
+    stats_list = s;
+    pthread_mutex_unlock(&stats_mtx);
+
+    stats_self = s;
+    return s;
+}
+
+void stats_reset(void)
+{
+    stats_t *s;
+    stats_t *next;
+
+    pthread_mutex_lock(&stats_mtx);
+    for (s = stats_list; s != NULL; s = s->next) {
+      next = s->next;
+      memset(s, 0, sizeof(stats_t));
+      s->next = next;
+    }
+    pthread_mutex_unlock(&stats_mtx);
+}
+
+/* Upper bound of the bucket in which the 'p' percentile of dv falls, at most its max. */
+static uint64_t percentile(const stats_dist_value_t * dv, const double p)
+{
+    uint64_t n = 0, rank = (uint64_t) (dv->count * p / 100.0);
+    int i;
+
+    for (i = 0; i < STATS_BUCKETS; i++) {
+      n += dv->bucket[i];
+      if (rank < n)
+	return (i == 0) ? 0 : (i == 64 || dv->max < ((uint64_t) 1 << i)) ? dv->max : (((uint64_t) 1 << i) - 1);
+    }
+    return dv->max;
+}
+
+/*
+ * void stats_report(void)
+ *
+ * Merge the stats_t of all threads, and print the counters and
+ * distributions that were recorded, and the stripes that waited longest.
+ */
+void stats_report(void)
+{
+    stats_t *sum, *s;
+    stats_dist_value_t *dv;
+    double tpn, scale;
+    uint64_t wait;
+    int i, j, k, top[REPORT_STRIPES];
+
+    if ((sum = (stats_t *) calloc(1, sizeof(stats_t))) == NULL) {
+      stats_elog("calloc error");
+      return;
+    }
+    pthread_mutex_lock(&stats_mtx);
+    for (s = stats_list; s != NULL; s = s->next) {
+      for (i = 0; i < STATS_COUNTERS; i++)
+	sum->counter[i] += s->counter[i];
+      for (i = 0; i < STATS_DISTS; i++) {
+	sum->dist[i].count += s->dist[i].count;
+	sum->dist[i].sum += s->dist[i].sum;
+	if (sum->dist[i].max < s->dist[i].max)
+	  sum->dist[i].max = s->dist[i].max;
+	for (j = 0; j < STATS_BUCKETS; j++)
+	  sum->dist[i].bucket[j] += s->dist[i].bucket[j];
+      }
+      for (i = 0; i < STATS_STRIPES; i++) {
+	sum->stripe_wait[i] += s->stripe_wait[i];
+	sum->stripe_count[i] += s->stripe_count[i];
+      }
+    }
+    pthread_mutex_unlock(&stats_mtx);
+
+    tpn = hist_ticks_per_ns();
+    printf ("\tstats:\n");
+    for (i = 0; i < STATS_COUNTERS; i++)
+      if (0 < sum->counter[i])
+	printf ("\t  %-16s %llu\n", counter_names[i], (unsigned long long int) sum->counter[i]);
+    if (0 < sum->counter[STATS_CAS])
+      printf ("\t  %-16s %.2f%%\n", "CAS failure rate",
+	      100.0 * sum->counter[STATS_CAS_FAIL] / sum->counter[STATS_CAS]);
+
+    for (i = 0; i < STATS_DISTS; i++) {
+      dv = &sum->dist[i];
+      if (dv->count == 0)
+	continue;
+      scale = (i == STATS_LOCK_WAIT || i == STATS_RESIZE_TIME) ? 1.0 / tpn : 1.0;
+      printf ("\t  %-16s n = %llu, mean = %.1f, p99 <= %.0f, max = %.0f\n", dist_names[i],
+	      (unsigned long long int) dv->count, scale * dv->sum / dv->count,
+	      scale * percentile(dv, 99.0), scale * dv->max);
+    }
+
+    /* The stripes with the longest total lock wait, longest first. */
+    for (k = 0; k < REPORT_STRIPES; k++) {
+      top[k] = -1;
+      for (i = 0; i < STATS_STRIPES; i++) {
+	for (j = 0; j < k && top[j] != i; j++)
+	  ;
+	if (j == k && 0 < sum->stripe_count[i]
+	    && (top[k] < 0 || sum->stripe_wait[top[k]] < sum->stripe_wait[i]))
+	  top[k] = i;
+      }
+      if (top[k] < 0)
+	break;
+    }
+    if (0 < k) {
+      for (wait = 0, i = 0; i < STATS_STRIPES; i++)
+	wait += sum->stripe_wait[i];
+      printf ("\t  lock wait by stripe (stripe %% %d: total [ns], share, acquisitions):\n", STATS_STRIPES);
+      for (j = 0; j < k; j++)
+	printf ("\t    %3d: %.0f, %.1f%%, %llu\n", top[j], sum->stripe_wait[top[j]] / tpn,
+		(0 < wait) ? 100.0 * sum->stripe_wait[top[j]] / wait : 0.0,
+		(unsigned long long int) sum->stripe_count[top[j]]);
+    }
+    free(sum);
+}
+
+#endif
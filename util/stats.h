@@ -0,0 +1,132 @@
+/* ---------------------------------------------------------------------------
+ * Hot-Path Statistics
+ *
+ * Counters and value distributions recorded inside the structures, to tell
+ * why a structure slows down: failed CAS and restarted operations in the
+ * lock-free algorithms, lock acquisition time (in lock_acquire(), and per
+ * stripe where the structure reports its stripe with STATS_STRIPE()), probe
+ * and chain lengths, cuckoo kick chains and relocate() outcomes, skiplist
+ * search paths, and the number and duration of resizes.
+ *
+ * The layer is compiled in only with -D_STATS_ (make STATS=1); otherwise every
+ * STATS_*() macro below expands to nothing (or to a void expression), and the
+ * structures run exactly the code they run without it. Each thread records into its own stats_t,
+ * allocated on its first record and kept until exit, so recording takes no
+ * lock and shares no cache line. STATS_RESET() zeroes and STATS_REPORT()
+ * merges and prints the stats_t of all threads; call them only while no
+ * thread records.
+ *
+ * Durations are ticks of hist_ticks() (see hist.h), reported in nanoseconds.
+ *
+ * Copyright (C) 2009-2025  suzuki hironobu
+ *
+ * ---------------------------------------------------------------------------
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <inttypes.h>
+
+typedef enum {
+  STATS_CAS = 0,                      /* CAS instructions issued */
+  STATS_CAS_FAIL,                     /* ... that failed */
+  STATS_RETRY,                        /* operations restarted from the top */
+  STATS_RELOCATE,                     /* cuckoo relocate() calls */
+  STATS_RELOCATE_FAIL,                /* ... that found no free slot, and led to a resize */
+  STATS_RESIZE,                       /* resizes done */
+  STATS_COUNTERS,
+} stats_counter_t;
+
+typedef enum {
+  STATS_LOCK_WAIT = 0,                /* ticks spent in lock_acquire() */
+  STATS_PROBE,                        /* slots probed by an open-addressing operation */
+  STATS_CHAIN,                        /* nodes visited in a bucket chain */
+  STATS_KICKS,                        /* keys displaced by one cuckoo insert */
+  STATS_PATH,                         /* nodes visited by one skiplist search */
+  STATS_RESIZE_TIME,                  /* ticks of one resize */
+  STATS_DISTS,
+} stats_dist_t;
+
+#define STATS_BUCKETS   65              /* bucket i > 0 of a distribution: values in [2^(i-1), 2^i) */
+#define STATS_STRIPES   64              /* stripes beyond this share the counters of stripe % 64 */
+
+typedef struct _stats_dist_value_t
+{
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t bucket[STATS_BUCKETS];
+} stats_dist_value_t;
+
+typedef struct _stats_t
+{
+  uint64_t counter[STATS_COUNTERS];
+  stats_dist_value_t dist[STATS_DISTS];
+  uint64_t last_wait;                 /* ticks of this thread's last lock_acquire() */
+  uint64_t stripe_wait[STATS_STRIPES];
+  uint64_t stripe_count[STATS_STRIPES];
+  struct _stats_t *next;              /* all stats_t, for STATS_RESET() and STATS_REPORT() */
+} __attribute__((aligned(64))) stats_t;
+
+
+#ifdef _STATS_
+#include "hist.h"
+
+extern __thread stats_t *stats_self;
+stats_t *stats_register (void);
+void stats_reset (void);
+void stats_report (void);
+
+static inline stats_t *stats_get(void)
+{
+    return (stats_self != NULL) ? stats_self : stats_register();
+}
+
+static inline void stats_record(const stats_dist_t d, const uint64_t v)
+{
+    stats_dist_value_t *dv = &stats_get()->dist[d];
+
+    dv->count++;
+    dv->sum += v;
+    if (dv->max < v)
+      dv->max = v;
+    dv->bucket[(v == 0) ? 0 : 64 - __builtin_clzll(v)]++;
+}
+
+static inline void stats_stripe(const unsigned int stripe)
+{
+    stats_t *s = stats_get();
+
+    s->stripe_wait[stripe % STATS_STRIPES] += s->last_wait;
+    s->stripe_count[stripe % STATS_STRIPES]++;
+}
+
+#define STATS_INC(_c_)            (stats_get()->counter[(_c_)]++)
+#define STATS_CAS_RESULT(_ok_)    do {stats_t *_s_ = stats_get(); _s_->counter[STATS_CAS]++; \
+                                      if (!(_ok_)) _s_->counter[STATS_CAS_FAIL]++;} while (0)
+#define STATS_RECORD(_d_, _v_)    stats_record((_d_), (uint64_t) (_v_))
+#define STATS_STRIPE(_i_)         stats_stripe((unsigned int) (_i_))
+/* A local counter for lengths and a start time, declared only with _STATS_. */
+#define STATS_DECLARE(_v_)        uint64_t _v_ = 0
+#define STATS_COUNT(_v_)          ((_v_)++)
+#define STATS_TICKS(_v_)          ((_v_) = hist_ticks())
+#define STATS_SINCE(_d_, _v_)     stats_record((_d_), hist_ticks() - (_v_))
+#define STATS_RESET()             stats_reset()
+#define STATS_REPORT()            stats_report()
+
+#else
+
+#define STATS_INC(_c_)            ((void) 0)
+#define STATS_CAS_RESULT(_ok_)    ((void) 0)
+#define STATS_RECORD(_d_, _v_)    ((void) 0)
+#define STATS_STRIPE(_i_)         ((void) 0)
+#define STATS_DECLARE(_v_)
+#define STATS_COUNT(_v_)          ((void) 0)
+#define STATS_TICKS(_v_)          ((void) 0)
+#define STATS_SINCE(_d_, _v_)     ((void) 0)
+#define STATS_RESET()             ((void) 0)
+#define STATS_REPORT()            ((void) 0)
+
+#endif
+
+#endif